@@ -0,0 +1,229 @@
+#!/bin/sh
+
+# Benchmark the decoding tools (cffdump, pgmdump and redump), for
+# tracking their performance from one commit to the next.
+#
+# Each tool is run in a few modes over a fixed set of traces generated
+# with rdgen.  Those are the same on every machine (rdgen's output only
+# depends on its options and seed), and stand in for real traces, which
+# are too big to check in and may not be freely shared.  Any *.rd or
+# *.rd.gz put under bench/ are benchmarked too, but they are for local
+# use and not checked in.  Each run is repeated a few times,
+# keeping the best wall time, and the results are written to
+# bench-results.txt, one line per tool/mode/trace:
+#
+#    tool mode trace bytes wall_s cpu_s MB/s peak_rss_kB
+#
+# These are compared against the baseline (bench/baseline.txt, which is
+# specific to a machine so not checked in), if there is one.  Use --save
+# to make the results the new baseline.
+#
+# Before benchmarking, cffdump --jobs is checked against a serial run
+# (see check_jobs below), and a mismatch is reported along with any
+# failed runs.
+
+dir=`cd \`dirname $0\` && pwd`
+runs=3
+save=0
+baseline=$dir/bench/baseline.txt
+results=bench-results.txt
+work=bench-tmp
+
+while [ $# -gt 0 ]; do
+	case $1 in
+	--runs)
+		runs=$2
+		shift
+		;;
+	--save)
+		save=1
+		;;
+	--baseline)
+		baseline=$2
+		shift
+		;;
+	--output)
+		results=$2
+		shift
+		;;
+	*)
+		echo "Usage: $0 [--runs N] [--save] [--baseline FILE] [--output FILE]"
+		exit 1
+		;;
+	esac
+	shift
+done
+
+for t in rdgen benchrun; do
+	if [ ! -x $dir/$t ]; then
+		echo "$t is not built, try: make bench"
+		exit 1
+	fi
+done
+
+mkdir -p $work || exit 1
+work=`cd $work && pwd`
+case $results in
+/*) ;;
+*) results=`pwd`/$results ;;
+esac
+
+# the generated traces:
+traces=""
+gen() {
+	name=$1
+	shift
+	echo "generating: $name"
+	$dir/rdgen "$@" $work/$name || exit 1
+	traces="$traces $work/$name"
+}
+
+gen a220.rd           --gpu-id 220 --submits 2000 --draws 10
+gen a320.rd           --gpu-id 320 --submits 2000 --draws 10 --shaders 8
+gen a420-indirect.rd  --gpu-id 420 --submits 2000 --draws 10 --shaders 8 --load-state indirect
+gen a530-ib2.rd       --gpu-id 530 --submits 2000 --draws 20 --shaders 8 --depth 2
+gen a530.rd.gz        --gpu-id 530 --submits 2000 --draws 20 --shaders 8 --buffers 16
+
+for f in $dir/bench/*.rd $dir/bench/*.rd.gz; do
+	if [ -f $f ]; then
+		traces="$traces $f"
+	fi
+done
+
+# run tool with args over trace, and add the best of the runs to the
+# results:
+bench() {
+	tool=$1
+	mode=$2
+	trace=$3
+	args=$4
+
+	if [ ! -x $dir/$tool ]; then
+		return
+	fi
+
+	echo "running: $tool $mode `basename $trace`"
+
+	i=0
+	while [ $i -lt $runs ]; do
+		# run in the work dir, for the files --dump-shaders writes:
+		(cd $work && $dir/benchrun $dir/$tool $args $trace)
+		i=$((i + 1))
+	done | awk -v tool=$tool -v mode=$mode -v trace=`basename $trace` \
+			-v bytes=`wc -c < $trace` '
+		$4 != 0 { status = $4 }
+		(NR == 1) || ($1 < wall) { wall = $1; cpu = $2 }
+		$3 > rss { rss = $3 }
+		END {
+			if (status != "") {
+				printf("# %s %s %s failed: %s\n", tool, mode, trace, status)
+				exit
+			}
+			printf("%s\t%s\t%s\t%d\t%.3f\t%.3f\t%.2f\t%d\n", tool, mode,
+					trace, bytes, wall, cpu,
+					(wall > 0) ? bytes / wall / 1e6 : 0, rss)
+		}' >> $results
+}
+
+rev=`cd $dir && git describe --always --dirty 2>/dev/null`
+echo "# `date -u +%Y-%m-%dT%H:%M:%SZ` $rev" > $results
+echo "# tool mode trace bytes wall_s cpu_s MB/s peak_rss_kB" >> $results
+
+# --jobs has to give the same result as a serial run.  The check uses a
+# script, which looks at the bin state set up in the CP_SET_RENDER_MODE
+# IBs, as the parent's prepass has to decode those too, for the state
+# that the workers start from:
+check_jobs() {
+	if [ ! -x $dir/cffdump ]; then
+		return
+	fi
+
+	trace=$work/a530-render-mode.rd
+	script=$work/binstate.lua
+
+	echo "checking: cffdump --jobs `basename $trace`"
+
+	$dir/rdgen --gpu-id 530 --submits 500 --draws 4 --render-mode $trace || exit 1
+	cat > $script <<EOF
+local n, sum = 0, 0
+function draw(primtype, nindx)
+  n = n + 1
+  for _,reg in ipairs({0x0bc2, 0xe140, 0xe211, 0xe212}) do
+    sum = sum + regs.val(reg)
+  end
+end
+function end_cmdstream()
+  local result = { n = n, sum = sum }
+  n, sum = 0, 0
+  return result
+end
+function reduce(results)
+  for _,result in ipairs(results) do
+    n = n + result.n
+    sum = sum + result.sum
+  end
+end
+function finish()
+  io.write(string.format("draws: %d, bin state: %.0f\\n", n, sum))
+end
+EOF
+
+	$dir/cffdump --no-index --script $script $trace > $work/serial.txt 2>&1
+	$dir/cffdump --no-index --jobs 4 --script $script $trace > $work/jobs.txt 2>&1
+	if ! cmp -s $work/serial.txt $work/jobs.txt; then
+		echo "# cffdump --jobs `basename $trace` failed: differs from serial run" >> $results
+	fi
+}
+
+check_jobs
+
+for trace in $traces; do
+	bench cffdump full         $trace "--no-index"
+	bench cffdump summary      $trace "--no-index --summary"
+	bench cffdump query        $trace "--no-index --query GRAS_SC_WINDOW_SCISSOR_TL"
+	bench cffdump script       $trace "--no-index --script $dir/scripts/primcount.lua"
+	bench cffdump dump-shaders $trace "--no-index --dump-shaders"
+	bench pgmdump full         $trace ""
+	bench pgmdump dump-shaders $trace "--dump-shaders"
+	bench redump  full         $trace ""
+done
+
+save_to=$baseline
+
+echo
+if [ -f $baseline ]; then
+	echo "results (compared to $baseline):"
+else
+	echo "results (no baseline, use --save to store one):"
+fi
+
+if [ ! -f $baseline ]; then
+	baseline=""
+fi
+
+awk -v baseline=$baseline '
+	FILENAME == baseline {
+		if ($0 !~ /^#/) {
+			mbs[$1" "$2" "$3] = $7
+			rss[$1" "$2" "$3] = $8
+		}
+		next
+	}
+	/^#/ { next }
+	{
+		key = $1" "$2" "$3
+		printf("  %-8s %-13s %-22s %9.2f MB/s %9d kB", $1, $2, $3, $7, $8)
+		if ((key in mbs) && (mbs[key] > 0) && (rss[key] > 0)) {
+			printf("   %+6.1f%% %+6.1f%%", 100 * ($7 / mbs[key] - 1),
+					100 * ($8 / rss[key] - 1))
+		}
+		printf("\n")
+	}' $baseline $results
+
+grep "^# .* failed" $results
+
+if [ $save = 1 ]; then
+	mkdir -p `dirname $save_to`
+	cp $results $save_to
+	echo "saved baseline: $save_to"
+fi
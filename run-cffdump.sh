@@ -3,6 +3,7 @@
 dir=`dirname $0`
 cffdump_args=""
 pgmdump_args=""
+files=""
 
 for f in $*; do
 	if [ $f = "--no-color" ]; then
@@ -35,12 +36,18 @@ for f in $*; do
 		continue
 	fi
 
-	echo "$f"
-	if [ -x $dir/cffdump ]; then
-		$dir/cffdump $cffdump_args $f > ${f%%.rd}-cffdump.txt
-	fi
-	if [ -x $dir/pgmdump ]; then
-		$dir/pgmdump $pgmdump_args $f > ${f%%.rd}-pgmdump.txt
-	fi
+	files="$files $f"
 done
 
+if [ -z "$files" ]; then
+	exit 0
+fi
+
+# decode all the files in parallel, skipping ones whose output is
+# already up to date:
+if [ -x $dir/cffdump ]; then
+	$dir/cffdump --batch --jobs 0 $cffdump_args $files
+fi
+if [ -x $dir/pgmdump ]; then
+	$dir/pgmdump --batch --jobs 0 $pgmdump_args $files
+fi
@@ -74,26 +74,24 @@ function draw(primtype, nindx)
   -- populate current regs.  For now just consider ones that have
   -- been written.. maybe we need to make that configurable in
   -- case it filters out too many registers.
-  for regbase=0,0xffff do
-    if regs.written(regbase) ~= 0 then
-      local regval = regs.val(regbase)
-
-      -- track reg vals per draw:
-      regtbl[regbase] = regval
-
-      -- also track which reg vals appear in which tests:
-      local uniq_regvals = results[gpuname]["regvals"][regbase]
-      if uniq_regvals == nil then
-        uniq_regvals = {}
-        results[gpuname]["regvals"][regbase] = uniq_regvals;
-      end
-      local drawlist = uniq_regvals[regval]
-      if drawlist == nil then
-        drawlist = {}
-        uniq_regvals[regval] = drawlist
-      end
-      table.insert(drawlist, testname .. "." .. didx)
+  for _,regbase in ipairs(regs.written_list()) do
+    local regval = regs.val(regbase)
+
+    -- track reg vals per draw:
+    regtbl[regbase] = regval
+
+    -- also track which reg vals appear in which tests:
+    local uniq_regvals = results[gpuname]["regvals"][regbase]
+    if uniq_regvals == nil then
+      uniq_regvals = {}
+      results[gpuname]["regvals"][regbase] = uniq_regvals;
+    end
+    local drawlist = uniq_regvals[regval]
+    if drawlist == nil then
+      drawlist = {}
+      uniq_regvals[regval] = drawlist
     end
+    table.insert(drawlist, testname .. "." .. didx)
   end
 
   -- TODO maybe we want to whitelist a few well known regs, for the
@@ -0,0 +1,37 @@
+-- A script to count the draws of each primitive type, as an example of
+-- a script that can be run in parallel, ie:
+--
+--   cffdump --jobs 0 --script scripts/primcount.lua foo.rd
+--
+-- Each worker counts the draws in its part of the cmdstream, and
+-- returns the counts from end_cmdstream().  The counts from each
+-- worker are merged in reduce().
+
+local counts = nil
+local totals = {}
+
+function start_cmdstream(name)
+  counts = {}
+end
+
+function draw(primtype, nindx)
+  counts[primtype] = (counts[primtype] or 0) + 1
+end
+
+function end_cmdstream()
+  return counts
+end
+
+function reduce(results)
+  for _,result in ipairs(results) do
+    for primtype,n in pairs(result) do
+      totals[primtype] = (totals[primtype] or 0) + n
+    end
+  end
+end
+
+function finish()
+  for primtype,n in pairs(totals) do
+    io.write(string.format("%s: %d\n", primtype, n))
+  end
+end
@@ -2,6 +2,9 @@ io.write("HELLO WORLD\n")
 
 r = rnn.init("a320")
 
+-- resolved once, rather than by name at each draw:
+rop_code = rnn.handle(r, "RB_MRT[0].CONTROL.ROP_CODE")
+
 function start_cmdstream(name)
   io.write("START: " .. name .. "\n")
 end
@@ -12,9 +15,29 @@ function draw(primtype, nindx)
   io.write("RB_MRT[0].CONTROL.ROP_CODE: " .. r.RB_MRT[0].CONTROL.ROP_CODE .. "\n")
   io.write("SP_VS_OUT[0].A_COMPMASK: " .. r.SP_VS_OUT[0].A_COMPMASK .. "\n")
   io.write("RB_DEPTH_CONTROL.Z_ENABLE: " .. tostring(r.RB_DEPTH_CONTROL.Z_ENABLE) .. "\n")
+  io.write("RB_MRT[0].CONTROL.ROP_CODE (handle): " .. rop_code() .. "\n")
+  for i = 1, #regs.dirty do
+    io.write(string.format("dirty: %04x = %08x\n", regs.dirty[i], regs.state[regs.dirty[i]]))
+  end
   io.write("0x2280: written=" .. regs.written(0x2280) .. ", lastval=" .. regs.lastval(0x2280) .. ", val=" .. regs.val(0x2280) .. "\n")
 end
 
+-- finer grained hooks, filtered before calling into the script:
+hooks.packets("CP_EVENT_WRITE", "CP_LOAD_STATE")
+hooks.regs(0x2280)
+
+function packet(name, opcode, pkt, level)
+  io.write(string.format("PACKET: %s (%02x), %d dwords\n", name, opcode, #pkt))
+end
+
+function reg_write(regbase, val)
+  io.write(string.format("REG_WRITE: %04x = %08x\n", regbase, val))
+end
+
+function event(name, event)
+  io.write("EVENT: " .. tostring(name) .. "\n")
+end
+
 function end_cmdstream()
   io.write("END\n")
 end
@@ -0,0 +1,367 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#include <assert.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analyze.h"
+#include "rnnutil.h"
+
+uint32_t reg_val(uint32_t regbase);
+uint32_t reg_written_list(const uint32_t **regs);
+
+struct gpu {
+	char *name;             /* name of directory of the captures */
+	unsigned gpu_id;
+	struct rnn *rnn;
+};
+
+struct test {
+	char *name;
+};
+
+/* the list of draws in which a register had a value: */
+struct entry {
+	uint32_t gpu, regbase, val;
+	uint64_t fingerprint;   /* hash of draws[], to speed up comparing */
+	uint32_t *draws;
+	uint32_t ndraws, maxdraws;
+	uint32_t group;         /* entries with the same list of draws */
+};
+
+/* hash table of 64 bit keys to index: */
+struct table {
+	uint64_t *keys;
+	uint32_t *vals;
+	uint32_t size, count;
+};
+
+static struct gpu *gpus;
+static uint32_t ngpus;
+
+static struct test *tests;
+static uint32_t ntests;
+
+/* draw id to (test, didx): */
+static uint64_t *draws;
+static uint32_t ndraws;
+
+static struct entry *entries;
+static uint32_t nentries;
+
+static struct table draw_table, entry_table;
+
+/* current capture: */
+static int cur_gpu = -1, cur_test = -1;
+static uint32_t cur_didx;
+
+static uint64_t hash64(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ull;
+	key ^= key >> 33;
+	return key;
+}
+
+static uint32_t * table_slot(struct table *t, uint64_t key, int *found)
+{
+	uint32_t i;
+
+	if (2 * (t->count + 1) > t->size) {
+		struct table old = *t;
+
+		t->size = t->size ? 2 * t->size : 1024;
+		t->keys = calloc(t->size, sizeof(*t->keys));
+		t->vals = malloc(t->size * sizeof(*t->vals));
+		assert(t->keys && t->vals);
+		memset(t->vals, 0xff, t->size * sizeof(*t->vals));
+
+		for (i = 0; i < old.size; i++) {
+			int dummy;
+			if (old.vals[i] != ~0u)
+				*table_slot(t, old.keys[i], &dummy) = old.vals[i];
+		}
+
+		free(old.keys);
+		free(old.vals);
+	}
+
+	for (i = hash64(key) & (t->size - 1); ; i = (i + 1) & (t->size - 1)) {
+		if (t->vals[i] == ~0u) {
+			t->keys[i] = key;
+			t->count++;
+			*found = 0;
+			return &t->vals[i];
+		}
+		if (t->keys[i] == key) {
+			*found = 1;
+			return &t->vals[i];
+		}
+	}
+}
+
+static void * grow(void *ptr, uint32_t n, size_t sz)
+{
+	/* grow by powers of two: */
+	if (n & (n - 1))
+		return ptr;
+	ptr = realloc(ptr, (n ? 2 * n : 1) * sz);
+	assert(ptr);
+	return ptr;
+}
+
+void analyze_start_cmdstream(const char *filename)
+{
+	char *dir = strdup(filename), *base = strdup(filename);
+	const char *gpuname = basename(dirname(dir));
+	const char *testname = basename(base);
+	uint32_t i;
+
+	for (i = 0; i < ngpus; i++)
+		if (!strcmp(gpus[i].name, gpuname))
+			break;
+
+	if (i == ngpus) {
+		gpus = grow(gpus, ngpus, sizeof(*gpus));
+		memset(&gpus[ngpus], 0, sizeof(gpus[0]));
+		gpus[ngpus++].name = strdup(gpuname);
+	}
+	cur_gpu = i;
+
+	for (i = 0; i < ntests; i++)
+		if (!strcmp(tests[i].name, testname))
+			break;
+
+	if (i == ntests) {
+		tests = grow(tests, ntests, sizeof(*tests));
+		tests[ntests++].name = strdup(testname);
+	}
+	cur_test = i;
+
+	cur_didx = 0;
+
+	free(dir);
+	free(base);
+}
+
+void analyze_draw(const char *primtype, unsigned gpu_id)
+{
+	const uint32_t *regs;
+	uint32_t i, n, draw;
+	uint64_t key;
+	int found;
+
+	/* internal clears/restores/resolves: */
+	if ((cur_test < 0) || (primtype && !strcmp(primtype, "DI_PT_RECTLIST")))
+		return;
+
+	if (!gpus[cur_gpu].gpu_id)
+		gpus[cur_gpu].gpu_id = gpu_id;
+
+	/* draws are named by test and index, so the same draw in captures
+	 * from different generations is the same draw:
+	 */
+	key = ((uint64_t)cur_test << 32) | cur_didx++;
+	draw = *table_slot(&draw_table, key, &found);
+	if (!found) {
+		draws = grow(draws, ndraws, sizeof(*draws));
+		draws[ndraws] = key;
+		draw = *table_slot(&draw_table, key, &found) = ndraws++;
+	}
+
+	n = reg_written_list(&regs);
+	for (i = 0; i < n; i++) {
+		uint32_t val = reg_val(regs[i]);
+		struct entry *e;
+		uint32_t *slot;
+
+		key = ((uint64_t)cur_gpu << 48) | ((uint64_t)regs[i] << 32) | val;
+		slot = table_slot(&entry_table, key, &found);
+		if (!found) {
+			entries = grow(entries, nentries, sizeof(*entries));
+			e = &entries[nentries];
+			memset(e, 0, sizeof(*e));
+			e->gpu = cur_gpu;
+			e->regbase = regs[i];
+			e->val = val;
+			*slot = nentries++;
+		}
+
+		e = &entries[*slot];
+		e->draws = grow(e->draws, e->ndraws, sizeof(*e->draws));
+		e->draws[e->ndraws++] = draw;
+		e->fingerprint = hash64(e->fingerprint ^ (draw + 1));
+	}
+}
+
+void analyze_end_cmdstream(void)
+{
+	cur_gpu = cur_test = -1;
+}
+
+/* order entries by list of draws: */
+static int cmp_drawlist(const void *a, const void *b)
+{
+	const struct entry *ea = *(const struct entry **)a;
+	const struct entry *eb = *(const struct entry **)b;
+
+	if (ea->fingerprint != eb->fingerprint)
+		return (ea->fingerprint < eb->fingerprint) ? -1 : 1;
+	if (ea->ndraws != eb->ndraws)
+		return (ea->ndraws < eb->ndraws) ? -1 : 1;
+	return memcmp(ea->draws, eb->draws, ea->ndraws * sizeof(ea->draws[0]));
+}
+
+/* order entries by gpu, register, and then order first seen: */
+static int cmp_report(const void *a, const void *b)
+{
+	const struct entry *ea = *(const struct entry **)a;
+	const struct entry *eb = *(const struct entry **)b;
+
+	if (ea->gpu != eb->gpu)
+		return (ea->gpu < eb->gpu) ? -1 : 1;
+	if (ea->regbase != eb->regbase)
+		return (ea->regbase < eb->regbase) ? -1 : 1;
+	return (ea < eb) ? -1 : (ea > eb);
+}
+
+static void print_drawlist(struct entry *e)
+{
+	uint32_t i;
+
+	printf("\n");
+	for (i = 0; i < e->ndraws; i++) {
+		uint64_t draw = draws[e->draws[i]];
+		printf("%s%s.%u", i ? ":" : "", tests[draw >> 32].name,
+				(uint32_t)draw);
+	}
+	printf(":\n");
+}
+
+static void print_entry(struct entry *e, int nocolor)
+{
+	struct gpu *gpu = &gpus[e->gpu];
+	const struct rnnreg *info;
+	const char *name;
+
+	if (!gpu->rnn) {
+		char gen[16];
+		/* prefer the gpu-id from the capture over the directory name: */
+		if (gpu->gpu_id)
+			snprintf(gen, sizeof(gen), "a%u", gpu->gpu_id);
+		else
+			snprintf(gen, sizeof(gen), "%s", gpu->name);
+		gpu->rnn = rnn_new(nocolor);
+		rnn_load(gpu->rnn, gen);
+	}
+
+	info = rnn_lookupreg(gpu->rnn, e->regbase);
+	name = rnn_regname(gpu->rnn, e->regbase, !nocolor);
+
+	if (name)
+		printf("  %s:%s:\t%08x  ", gpu->name, name, e->val);
+	else
+		printf("  %s:<%04x>:\t%08x  ", gpu->name, e->regbase, e->val);
+
+	if (info->name && info->typeinfo) {
+		char *decoded = rnndec_decodeval(gpu->rnn->vc, info->typeinfo,
+				e->val, info->width);
+		printf("%s\n", decoded);
+		free(decoded);
+	} else {
+		printf("%08x\n", e->val);
+	}
+}
+
+void analyze_finish(int nocolor)
+{
+	struct entry **byreport, **bylist;
+	uint32_t i, j, ngroups = 0;
+	uint32_t *groups, *group_start, *group_next;
+
+	printf("Analyzing Data...\n");
+
+	if (!nentries)
+		return;
+
+	byreport = malloc(nentries * sizeof(*byreport));
+	bylist = malloc(nentries * sizeof(*bylist));
+	assert(byreport && bylist);
+
+	for (i = 0; i < nentries; i++)
+		byreport[i] = bylist[i] = &entries[i];
+
+	/* group entries with identical lists of draws: */
+	qsort(bylist, nentries, sizeof(*bylist), cmp_drawlist);
+	for (i = 0; i < nentries; i++) {
+		if (i && cmp_drawlist(&bylist[i - 1], &bylist[i]))
+			ngroups++;
+		bylist[i]->group = ngroups;
+	}
+	ngroups++;
+
+	qsort(byreport, nentries, sizeof(*byreport), cmp_report);
+
+	/* link the entries of each group, in report order: */
+	groups = malloc(ngroups * sizeof(*groups));
+	group_start = malloc(ngroups * sizeof(*group_start));
+	group_next = malloc(nentries * sizeof(*group_next));
+	assert(groups && group_start && group_next);
+	memset(group_start, 0xff, ngroups * sizeof(*group_start));
+	memset(groups, 0xff, ngroups * sizeof(*groups));
+
+	for (i = nentries; i-- > 0; ) {
+		uint32_t g = byreport[i]->group;
+		group_next[i] = group_start[g];
+		group_start[g] = i;
+	}
+
+	/* and dump each group, the first time one of its entries is seen: */
+	for (i = 0; i < nentries; i++) {
+		uint32_t g = byreport[i]->group;
+
+		if (groups[g] != ~0u)
+			continue;
+		groups[g] = i;
+
+		print_drawlist(byreport[i]);
+		for (j = group_start[g]; j != ~0u; j = group_next[j])
+			print_entry(byreport[j], nocolor);
+	}
+
+	free(groups);
+	free(group_start);
+	free(group_next);
+	free(byreport);
+	free(bylist);
+}
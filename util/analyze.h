@@ -0,0 +1,55 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#ifndef ANALYZE_H_
+#define ANALYZE_H_
+
+#include <stdint.h>
+
+/* Native version of scripts/analyze.lua (cffdump --analyze), which
+ * compares a set of equivalent captures from various generations,
+ * looking for equivalencies between registers, ie:
+ *
+ *    cffdump --analyze a320/quad-flat-*.rd a420/quad-flat-*.rd
+ *
+ * Captures are grouped by the name of the directory they are in, and
+ * draws are named by capture name and index.  For each group, each
+ * unique value of each register is tracked along with the list of
+ * draws in which the register had that value.  At the end, registers
+ * (from any group) with the same list of draws are reported together.
+ *
+ * Like the script, DI_PT_RECTLIST draws (which are internal clears,
+ * restores and resolves) are ignored.
+ */
+
+void analyze_start_cmdstream(const char *filename);
+void analyze_draw(const char *primtype, unsigned gpu_id);
+void analyze_end_cmdstream(void);
+void analyze_finish(int nocolor);
+
+#endif /* ANALYZE_H_ */
@@ -0,0 +1,365 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <zlib.h>
+
+#include "batch.h"
+#include "output.h"
+
+/* worker exit status: */
+#define BATCH_DONE     0
+#define BATCH_FAILED   1
+#define BATCH_SKIPPED  2
+
+struct batch_job {
+	pid_t pid;
+	const char *filename;
+};
+
+char * batch_name(const char *filename)
+{
+	static const char *exts[] = { ".rd.gz", ".rd" };
+	size_t len = strlen(filename);
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		size_t n = strlen(exts[i]);
+		if ((len > n) && !strcmp(filename + len - n, exts[i])) {
+			len -= n;
+			break;
+		}
+	}
+
+	return strndup(filename, len);
+}
+
+static char * batch_outname(const char *tool, const char *filename)
+{
+	char *name, *outname;
+
+	name = batch_name(filename);
+	if (!name)
+		return NULL;
+
+	if (asprintf(&outname, "%s-%s.txt", name, tool) < 0)
+		outname = NULL;
+	free(name);
+
+	return outname;
+}
+
+int batch_crc(const char *filename, uint32_t *crc, uint64_t *size)
+{
+	static char buf[0x100000];
+	ssize_t n;
+	int fd;
+
+	*crc = crc32(0, NULL, 0);
+	*size = 0;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	while ((n = read(fd, buf, sizeof(buf))) != 0) {
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			close(fd);
+			return -1;
+		}
+		*crc = crc32(*crc, (const Bytef *)buf, n);
+		*size += n;
+	}
+
+	close(fd);
+
+	return 0;
+}
+
+/* the tool binary itself stands in for its version, so that outputs are
+ * regenerated whenever the tool is rebuilt with changes:
+ */
+static char * batch_version(const char *tool)
+{
+	uint32_t crc;
+	uint64_t size;
+	char *version;
+
+	if (batch_crc("/proc/self/exe", &crc, &size))
+		return strdup(tool);
+
+	if (asprintf(&version, "%s-%08x-%llu", tool, crc,
+			(unsigned long long)size) < 0)
+		return NULL;
+
+	return version;
+}
+
+/* the stamp identifies the input contents, tool version and options
+ * used:
+ */
+static char * batch_stamp(const char *filename, const char *version,
+		const char *options)
+{
+	uint32_t crc;
+	uint64_t size;
+	char *stamp;
+
+	if (batch_crc(filename, &crc, &size))
+		return NULL;
+
+	if (asprintf(&stamp, "%08x %llu %s %s\n", crc,
+			(unsigned long long)size, version, options) < 0)
+		return NULL;
+
+	return stamp;
+}
+
+static int batch_uptodate(const char *outname, const char *stampname,
+		const char *stamp)
+{
+	char buf[4096];
+	size_t n;
+	FILE *f;
+
+	if (access(outname, F_OK))
+		return 0;
+
+	f = fopen(stampname, "r");
+	if (!f)
+		return 0;
+
+	n = fread(buf, 1, sizeof(buf) - 1, f);
+	buf[n] = '\0';
+	fclose(f);
+
+	return !strcmp(buf, stamp);
+}
+
+static int batch_write(const char *filename, const char *str)
+{
+	FILE *f = fopen(filename, "w");
+	int ret;
+
+	if (!f)
+		return -1;
+
+	ret = (fputs(str, f) < 0);
+	ret |= fclose(f);
+
+	return ret ? -1 : 0;
+}
+
+/* runs in the worker process: */
+static int batch_file(const char *tool, const char *version,
+		const char *options, const char *filename,
+		int (*fxn)(const char *filename, void *data), void *data)
+{
+	char *outname, *stampname, *tmpname, *stamp;
+	int ret;
+
+	outname = batch_outname(tool, filename);
+	if (!outname)
+		return BATCH_FAILED;
+
+	if ((asprintf(&stampname, "%s.stamp", outname) < 0) ||
+			(asprintf(&tmpname, "%s.tmp", outname) < 0))
+		return BATCH_FAILED;
+
+	stamp = batch_stamp(filename, version, options);
+	if (!stamp) {
+		fprintf(stderr, "could not read: %s\n", filename);
+		return BATCH_FAILED;
+	}
+
+	if (batch_uptodate(outname, stampname, stamp))
+		return BATCH_SKIPPED;
+
+	/* in case we fail part way through: */
+	unlink(stampname);
+
+	if (out_init(tmpname)) {
+		fprintf(stderr, "could not open output: %s\n", tmpname);
+		return BATCH_FAILED;
+	}
+
+	ret = fxn(filename, data);
+
+	if (fflush(stdout))
+		ret = -1;
+
+	if (ret) {
+		unlink(tmpname);
+		return BATCH_FAILED;
+	}
+
+	if (rename(tmpname, outname) || batch_write(stampname, stamp)) {
+		fprintf(stderr, "could not write output: %s\n", outname);
+		return BATCH_FAILED;
+	}
+
+	return BATCH_DONE;
+}
+
+/* wait for any worker to finish, and report it: */
+static int batch_wait(struct batch_job *jobs, int njobs)
+{
+	const char *result;
+	pid_t pid;
+	int i, status;
+
+	do {
+		pid = wait(&status);
+	} while ((pid < 0) && (errno == EINTR));
+
+	if (pid < 0)
+		return 0;
+
+	for (i = 0; i < njobs; i++)
+		if (jobs[i].pid == pid)
+			break;
+
+	if (i == njobs)
+		return 0;
+
+	if (!WIFEXITED(status)) {
+		result = "crashed";
+		status = BATCH_FAILED;
+	} else {
+		status = WEXITSTATUS(status);
+		if (status == BATCH_DONE)
+			result = "done";
+		else if (status == BATCH_SKIPPED)
+			result = "up to date";
+		else
+			result = "failed";
+	}
+
+	printf("%s: %s\n", jobs[i].filename, result);
+	fflush(stdout);
+
+	jobs[i].pid = 0;
+
+	return (status == BATCH_FAILED) ? 1 : 0;
+}
+
+char * batch_options(char **argv, int n)
+{
+	size_t len = 1;
+	char *options;
+	int i;
+
+	for (i = 1; i < n; i++)
+		len += strlen(argv[i]) + 1;
+
+	options = calloc(1, len);
+	if (!options)
+		return NULL;
+
+	for (i = 1; i < n; i++) {
+		if (!strcmp(argv[i], "--batch") || !strcmp(argv[i], "--profile"))
+			continue;
+		if (!strcmp(argv[i], "--jobs") || !strcmp(argv[i], "-j")) {
+			i++;
+			continue;
+		}
+		if (options[0])
+			strcat(options, " ");
+		strcat(options, argv[i]);
+	}
+
+	return options;
+}
+
+int batch_run(const char *tool, const char *options, char **files, int nfiles,
+		int njobs, int (*fxn)(const char *filename, void *data), void *data)
+{
+	struct batch_job *jobs;
+	char *version;
+	int i, j, running = 0, failed = 0;
+
+	if (njobs < 1)
+		njobs = 1;
+	if (!options)
+		options = "";
+
+	version = batch_version(tool);
+	jobs = calloc(njobs, sizeof(*jobs));
+	if (!version || !jobs) {
+		free(version);
+		free(jobs);
+		return nfiles;
+	}
+
+	for (i = 0; i < nfiles; i++) {
+		pid_t pid;
+
+		if (running == njobs) {
+			failed += batch_wait(jobs, njobs);
+			running--;
+		}
+
+		fflush(stdout);
+
+		pid = fork();
+		if (pid < 0) {
+			fprintf(stderr, "could not fork: %m\n");
+			failed += nfiles - i;
+			break;
+		}
+
+		if (pid == 0)
+			_exit(batch_file(tool, version, options, files[i], fxn, data));
+
+		for (j = 0; (j < njobs - 1) && jobs[j].pid; j++)
+			;
+		jobs[j].pid = pid;
+		jobs[j].filename = files[i];
+		running++;
+	}
+
+	while (running--)
+		failed += batch_wait(jobs, njobs);
+
+	free(version);
+	free(jobs);
+
+	return failed;
+}
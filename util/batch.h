@@ -0,0 +1,69 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <stdint.h>
+
+/* Batch mode, for running one of the tools over many files (ie. a
+ * regression corpus).  Each input file is handled by a forked worker
+ * process, up to njobs at a time, with stdout redirected to
+ * "<name>-<tool>.txt", where name is the input filename without the
+ * .rd or .rd.gz extension.
+ *
+ * Next to each output, "<output>.stamp" records the crc32 of the input,
+ * the tool version (the crc32 of the tool binary) and the tool options
+ * that the output was generated with.  If all still match, the file is
+ * skipped.
+ *
+ * fxn is called in the worker process, and should return zero on
+ * success.  Returns the number of files which failed.
+ */
+/* join the options, argv[1] up to (but not including) argv[n], into a
+ * string for the stamp, leaving out --batch, --jobs and --profile which
+ * do not affect the output:
+ */
+char * batch_options(char **argv, int n);
+
+/* the input filename without the .rd or .rd.gz extension, which the
+ * outputs are named after.  Anything else a worker writes (ie. dumped
+ * shaders) should be named after it too, so that the workers don't
+ * clobber each other's files:
+ */
+char * batch_name(const char *filename);
+
+int batch_run(const char *tool, const char *options, char **files, int nfiles,
+		int njobs, int (*fxn)(const char *filename, void *data), void *data);
+
+/* the crc32 and size of a file, ie. of "/proc/self/exe" to identify the
+ * version of the running tool, returns non-zero if it can't be read:
+ */
+int batch_crc(const char *filename, uint32_t *crc, uint64_t *size);
+
+#endif /* BATCH_H_ */
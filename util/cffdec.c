@@ -0,0 +1,1714 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "redump.h"
+#include "rnnutil.h"
+#include "cffdec.h"
+
+/* To avoid a linear search of buffers[] for every address lookup, we
+ * keep a table of the buffers sorted by gpuaddr, and another sorted by
+ * hostptr, which are rebuilt on the first lookup after buffers are
+ * added (ie. once per submit).  Buffers can overlap, in which case the
+ * lookup returns the first one in buffers[], same as a linear search
+ * would.
+ */
+struct interval {
+	uint64_t start, end;
+	uint64_t maxend;   /* max end of this and all preceding intervals */
+	int buf;           /* index in buffers[] */
+};
+
+struct interval_table {
+	struct interval *intervals;
+	int n, max;
+};
+
+/* Register state snapshots are a two level tree of pages of register
+ * values, shared between snapshots and copied on write, so a snapshot
+ * only costs the pages which changed since the previous one.
+ */
+#define SNAP_PAGE_SHIFT 6
+#define SNAP_PAGE_REGS  (1 << SNAP_PAGE_SHIFT)
+#define SNAP_DIR_SHIFT  5
+#define SNAP_DIR_PAGES  (1 << SNAP_DIR_SHIFT)
+#define SNAP_NDIRS      (CFFDEC_MAXREGS >> (SNAP_PAGE_SHIFT + SNAP_DIR_SHIFT))
+
+struct snap_page {
+	unsigned refcnt;
+	uint64_t written;            /* bitmask of written registers */
+	uint32_t vals[SNAP_PAGE_REGS];
+};
+
+struct snap_dir {
+	unsigned refcnt;
+	struct snap_page *pages[SNAP_DIR_PAGES];
+};
+
+struct snap {
+	struct snap_dir *dirs[SNAP_NDIRS];
+};
+
+/* An IB which was nothing but register writes, see cffdec_enable_memo(),
+ * keyed by its contents (and needs_wfi, which changes what it does):
+ */
+struct memo {
+	uint64_t hash;
+	uint32_t *dwords;         /* copy of the IB contents */
+	uint32_t sizedwords;
+	int wfi_in, wfi_out;      /* needs_wfi before and after the IB */
+	int pure;
+	int packets;              /* whether it has more than register writes */
+	int draw;                 /* draw_count when first seen */
+	struct {
+		uint32_t regbase, val;
+	} *writes;
+	unsigned nwrites, maxwrites;
+};
+
+#define MEMO_SLOTS 4096
+
+enum gen { A2XX, A3XX, A4XX, A5XX, NGENS };
+
+struct cffdec {
+	const struct cffdec_funcs *funcs;
+	void *data;
+	unsigned gpu_id;
+	struct cffdec_state state;
+
+	struct cffdec_buffer *buffers;
+	int nbuffers, maxbuffers;
+	struct interval_table gpuaddr_table, hostptr_table;
+	int buffers_dirty;
+
+	uint32_t vals[CFFDEC_MAXREGS];
+	uint8_t written[CFFDEC_MAXREGS / 8];
+	uint8_t rewritten[CFFDEC_MAXREGS / 8];   /* written since last draw */
+
+	/* registers set in written/rewritten, so that we don't have to
+	 * scan all of them for each draw:
+	 */
+	uint32_t written_regs[CFFDEC_MAXREGS];
+	uint32_t nwritten;
+	uint32_t rewritten_regs[CFFDEC_MAXREGS];
+	uint32_t nrewritten;
+
+	/* register state snapshots, with the rewritten registers folded
+	 * into cur before they are cleared:
+	 */
+	int snapshots;
+	struct snap cur;
+	struct snap *snaps;
+	unsigned nsnaps, maxsnaps;
+	size_t snap_bytes;
+
+	/* register database, one per generation, so switching back to a
+	 * generation already seen keeps what was already decoded:
+	 */
+	int color;
+	struct rnn *rnns[NGENS];
+	struct rnn *rnn;          /* for the current gen, NULL until needed */
+	enum gen gen;
+	struct cffdec_enums enums;
+	struct cffdec_reg *regs;  /* special registers of the current gen */
+	uint16_t reg_map[CFFDEC_MAXREGS];   /* index+1 in regs[], or zero */
+	uint32_t scissor_tl, scissor_br;
+
+	int memo;
+	struct memo *memos[MEMO_SLOTS];
+	struct memo *recording;   /* for the innermost IB being decoded */
+};
+
+static void snap_fold(struct cffdec *dec);
+static void snap_release(struct cffdec *dec, struct snap *snap);
+
+static void memo_reset(struct cffdec *dec);
+static void free_enums(struct cffdec *dec);
+
+static const struct cffdec_funcs no_funcs;
+
+struct cffdec * cffdec_new(unsigned gpu_id, const struct cffdec_funcs *funcs,
+		void *data)
+{
+	struct cffdec *dec = calloc(1, sizeof(*dec));
+	assert(dec);
+	dec->funcs = funcs ? funcs : &no_funcs;
+	dec->data = data;
+	dec->gpu_id = gpu_id;
+	return dec;
+}
+
+void cffdec_free(struct cffdec *dec)
+{
+	if (!dec)
+		return;
+	cffdec_reset_buffers(dec);
+	cffdec_free_snapshots(dec);
+	free(dec->buffers);
+	snap_release(dec, &dec->cur);
+	free(dec->snaps);
+	free(dec->gpuaddr_table.intervals);
+	free(dec->hostptr_table.intervals);
+	memo_reset(dec);
+	free_enums(dec);
+	free(dec->regs);
+	free(dec);
+}
+
+void cffdec_set_gpu_id(struct cffdec *dec, unsigned gpu_id)
+{
+	dec->gpu_id = gpu_id;
+}
+
+unsigned cffdec_gpu_id(struct cffdec *dec)
+{
+	return dec->gpu_id;
+}
+
+void * cffdec_data(struct cffdec *dec)
+{
+	return dec->data;
+}
+
+void cffdec_set_color(struct cffdec *dec, int color)
+{
+	dec->color = color;
+}
+
+void cffdec_reset(struct cffdec *dec)
+{
+	dec->state.draw_count = 0;
+	memo_reset(dec);
+	cffdec_clear_written(dec);
+}
+
+const struct cffdec_state * cffdec_state(struct cffdec *dec)
+{
+	return &dec->state;
+}
+
+void cffdec_enable_memo(struct cffdec *dec)
+{
+	dec->memo = 1;
+}
+
+/*
+ * Buffer map:
+ */
+
+void cffdec_add_buffer(struct cffdec *dec, uint64_t gpuaddr, void *hostptr,
+		unsigned int len, int mapped)
+{
+	struct cffdec_buffer *buf;
+
+	if (dec->nbuffers == dec->maxbuffers) {
+		dec->maxbuffers = max(16, 2 * dec->maxbuffers);
+		dec->buffers = realloc(dec->buffers,
+				dec->maxbuffers * sizeof(*dec->buffers));
+		assert(dec->buffers);
+	}
+
+	buf = &dec->buffers[dec->nbuffers++];
+	buf->hostptr = hostptr;
+	buf->len = len;
+	buf->gpuaddr = gpuaddr;
+	buf->mapped = mapped;
+
+	dec->buffers_dirty = 1;
+}
+
+void cffdec_reset_buffers(struct cffdec *dec)
+{
+	int i;
+
+	for (i = 0; i < dec->nbuffers; i++) {
+		if (!dec->buffers[i].mapped)
+			free(dec->buffers[i].hostptr);
+		dec->buffers[i].hostptr = NULL;
+	}
+	dec->nbuffers = 0;
+	dec->buffers_dirty = 1;
+}
+
+static int interval_cmp(const void *a, const void *b)
+{
+	const struct interval *ia = a, *ib = b;
+	if (ia->start != ib->start)
+		return (ia->start < ib->start) ? -1 : 1;
+	return ia->buf - ib->buf;
+}
+
+static void interval_build(struct cffdec *dec, struct interval_table *t,
+		int by_hostptr)
+{
+	uint64_t maxend = 0;
+	int i;
+
+	if (t->max < dec->nbuffers) {
+		t->max = dec->maxbuffers;
+		t->intervals = realloc(t->intervals, t->max * sizeof(*t->intervals));
+		assert(t->intervals);
+	}
+
+	t->n = 0;
+	for (i = 0; i < dec->nbuffers; i++) {
+		struct cffdec_buffer *buf = &dec->buffers[i];
+		struct interval *iv = &t->intervals[t->n];
+
+		if (!buf->len)
+			continue;
+
+		if (by_hostptr)
+			iv->start = (uintptr_t)buf->hostptr;
+		else
+			iv->start = buf->gpuaddr;
+		iv->end = iv->start + buf->len;
+		iv->buf = i;
+		t->n++;
+	}
+
+	qsort(t->intervals, t->n, sizeof(*t->intervals), interval_cmp);
+
+	for (i = 0; i < t->n; i++) {
+		maxend = max(maxend, t->intervals[i].end);
+		t->intervals[i].maxend = maxend;
+	}
+}
+
+static struct cffdec_buffer * interval_find(struct cffdec *dec,
+		struct interval_table *t, uint64_t addr)
+{
+	int lo = 0, hi, i, found = -1;
+
+	if (dec->buffers_dirty) {
+		interval_build(dec, &dec->gpuaddr_table, 0);
+		interval_build(dec, &dec->hostptr_table, 1);
+		dec->buffers_dirty = 0;
+	}
+
+	/* find the last interval starting at or before addr: */
+	hi = t->n;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (t->intervals[mid].start <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* and then walk back through any others which could contain addr: */
+	for (i = lo - 1; (i >= 0) && (t->intervals[i].maxend > addr); i--) {
+		struct interval *iv = &t->intervals[i];
+		if ((addr < iv->end) && ((found < 0) || (iv->buf < found)))
+			found = iv->buf;
+	}
+
+	return (found < 0) ? NULL : &dec->buffers[found];
+}
+
+struct cffdec_buffer * cffdec_find_gpuaddr(struct cffdec *dec, uint64_t gpuaddr)
+{
+	return interval_find(dec, &dec->gpuaddr_table, gpuaddr);
+}
+
+struct cffdec_buffer * cffdec_find_hostptr(struct cffdec *dec, void *hostptr)
+{
+	return interval_find(dec, &dec->hostptr_table, (uintptr_t)hostptr);
+}
+
+uint64_t cffdec_gpuaddr(struct cffdec *dec, void *hostptr)
+{
+	struct cffdec_buffer *buf = cffdec_find_hostptr(dec, hostptr);
+	if (buf)
+		return buf->gpuaddr + (hostptr - buf->hostptr);
+	return 0;
+}
+
+uint64_t cffdec_gpubaseaddr(struct cffdec *dec, uint64_t gpuaddr)
+{
+	struct cffdec_buffer *buf;
+	if (!gpuaddr)
+		return 0;
+	buf = cffdec_find_gpuaddr(dec, gpuaddr);
+	if (buf)
+		return buf->gpuaddr;
+	return 0;
+}
+
+void * cffdec_hostptr(struct cffdec *dec, uint64_t gpuaddr)
+{
+	struct cffdec_buffer *buf;
+	if (!gpuaddr)
+		return 0;
+	buf = cffdec_find_gpuaddr(dec, gpuaddr);
+	if (buf)
+		return buf->hostptr + (gpuaddr - buf->gpuaddr);
+	return 0;
+}
+
+unsigned cffdec_hostlen(struct cffdec *dec, uint64_t gpuaddr)
+{
+	struct cffdec_buffer *buf;
+	if (!gpuaddr)
+		return 0;
+	buf = cffdec_find_gpuaddr(dec, gpuaddr);
+	if (buf)
+		return buf->len + buf->gpuaddr - gpuaddr;
+	return 0;
+}
+
+/*
+ * Register state:
+ */
+
+uint32_t cffdec_reg_val(struct cffdec *dec, uint32_t regbase)
+{
+	if (regbase >= CFFDEC_MAXREGS)
+		return 0;
+	return dec->vals[regbase];
+}
+
+const uint32_t * cffdec_reg_vals(struct cffdec *dec)
+{
+	return dec->vals;
+}
+
+int cffdec_reg_written(struct cffdec *dec, uint32_t regbase)
+{
+	if (regbase >= CFFDEC_MAXREGS)
+		return 0;
+	return !!(dec->written[regbase/8] & (1 << (regbase % 8)));
+}
+
+int cffdec_reg_rewritten(struct cffdec *dec, uint32_t regbase)
+{
+	if (regbase >= CFFDEC_MAXREGS)
+		return 0;
+	return !!(dec->rewritten[regbase/8] & (1 << (regbase % 8)));
+}
+
+void cffdec_reg_set(struct cffdec *dec, uint32_t regbase, uint32_t val)
+{
+	/* type4 packets have a 19 bit offset, but nothing real is up there: */
+	if (regbase >= CFFDEC_MAXREGS)
+		return;
+	if (!cffdec_reg_written(dec, regbase))
+		dec->written_regs[dec->nwritten++] = regbase;
+	if (!cffdec_reg_rewritten(dec, regbase))
+		dec->rewritten_regs[dec->nrewritten++] = regbase;
+	dec->vals[regbase] = val;
+	dec->written[regbase/8] |= (1 << (regbase % 8));
+	dec->rewritten[regbase/8] |= (1 << (regbase % 8));
+}
+
+void cffdec_reg_restore(struct cffdec *dec, uint32_t regbase, uint32_t val)
+{
+	if (regbase >= CFFDEC_MAXREGS)
+		return;
+	dec->vals[regbase] = val;
+}
+
+static int cmp_regbase(const void *a, const void *b)
+{
+	uint32_t ra = *(const uint32_t *)a, rb = *(const uint32_t *)b;
+	return (ra > rb) - (ra < rb);
+}
+
+uint32_t cffdec_written_list(struct cffdec *dec, const uint32_t **regs)
+{
+	qsort(dec->written_regs, dec->nwritten, sizeof(dec->written_regs[0]),
+			cmp_regbase);
+	*regs = dec->written_regs;
+	return dec->nwritten;
+}
+
+uint32_t cffdec_rewritten_list(struct cffdec *dec, const uint32_t **regs)
+{
+	qsort(dec->rewritten_regs, dec->nrewritten, sizeof(dec->rewritten_regs[0]),
+			cmp_regbase);
+	*regs = dec->rewritten_regs;
+	return dec->nrewritten;
+}
+
+void cffdec_clear_rewritten(struct cffdec *dec)
+{
+	uint32_t i;
+
+	if (dec->snapshots)
+		snap_fold(dec);
+
+	for (i = 0; i < dec->nrewritten; i++)
+		dec->rewritten[dec->rewritten_regs[i]/8] = 0;
+	dec->nrewritten = 0;
+}
+
+void cffdec_clear_written(struct cffdec *dec)
+{
+	memset(dec->written, 0, sizeof(dec->written));
+	dec->nwritten = 0;
+	cffdec_clear_rewritten(dec);
+	snap_release(dec, &dec->cur);
+}
+
+/*
+ * Register state snapshots:
+ */
+
+static void * snap_alloc(struct cffdec *dec, size_t sz)
+{
+	void *ptr = malloc(sz);
+	assert(ptr);
+	dec->snap_bytes += sz;
+	return ptr;
+}
+
+static void snap_free(struct cffdec *dec, void *ptr, size_t sz)
+{
+	dec->snap_bytes -= sz;
+	free(ptr);
+}
+
+static void page_unref(struct cffdec *dec, struct snap_page *page)
+{
+	if (page && !--page->refcnt)
+		snap_free(dec, page, sizeof(*page));
+}
+
+static void dir_unref(struct cffdec *dec, struct snap_dir *dir)
+{
+	int i;
+
+	if (!dir || --dir->refcnt)
+		return;
+
+	for (i = 0; i < SNAP_DIR_PAGES; i++)
+		page_unref(dec, dir->pages[i]);
+	snap_free(dec, dir, sizeof(*dir));
+}
+
+static void snap_release(struct cffdec *dec, struct snap *snap)
+{
+	int i;
+
+	for (i = 0; i < SNAP_NDIRS; i++) {
+		dir_unref(dec, snap->dirs[i]);
+		snap->dirs[i] = NULL;
+	}
+}
+
+/* get a writable page of cur for regbase, copying the dir and page if
+ * they are shared with a snapshot:
+ */
+static struct snap_page * snap_page_for_write(struct cffdec *dec,
+		uint32_t regbase)
+{
+	unsigned d = regbase >> (SNAP_PAGE_SHIFT + SNAP_DIR_SHIFT);
+	unsigned p = (regbase >> SNAP_PAGE_SHIFT) & (SNAP_DIR_PAGES - 1);
+	struct snap_dir *dir = dec->cur.dirs[d];
+	struct snap_page *page;
+	int i;
+
+	if (!dir) {
+		dir = snap_alloc(dec, sizeof(*dir));
+		memset(dir, 0, sizeof(*dir));
+		dir->refcnt = 1;
+		dec->cur.dirs[d] = dir;
+	} else if (dir->refcnt > 1) {
+		struct snap_dir *old = dir;
+		dir = snap_alloc(dec, sizeof(*dir));
+		*dir = *old;
+		dir->refcnt = 1;
+		for (i = 0; i < SNAP_DIR_PAGES; i++)
+			if (dir->pages[i])
+				dir->pages[i]->refcnt++;
+		dir_unref(dec, old);
+		dec->cur.dirs[d] = dir;
+	}
+
+	page = dir->pages[p];
+	if (!page) {
+		page = snap_alloc(dec, sizeof(*page));
+		memset(page, 0, sizeof(*page));
+		page->refcnt = 1;
+		dir->pages[p] = page;
+	} else if (page->refcnt > 1) {
+		struct snap_page *old = page;
+		page = snap_alloc(dec, sizeof(*page));
+		*page = *old;
+		page->refcnt = 1;
+		page_unref(dec, old);
+		dir->pages[p] = page;
+	}
+
+	return page;
+}
+
+/* update cur with the registers rewritten since the last fold: */
+static void snap_fold(struct cffdec *dec)
+{
+	uint32_t i;
+
+	for (i = 0; i < dec->nrewritten; i++) {
+		uint32_t regbase = dec->rewritten_regs[i];
+		uint32_t val = dec->vals[regbase];
+		unsigned idx = regbase & (SNAP_PAGE_REGS - 1);
+		uint64_t bit = (uint64_t)1 << idx;
+		struct snap_dir *dir;
+		struct snap_page *page = NULL;
+
+		/* don't copy pages (if they are shared with a snapshot) for
+		 * registers which were rewritten with the same value, or have
+		 * already been folded:
+		 */
+		dir = dec->cur.dirs[regbase >> (SNAP_PAGE_SHIFT + SNAP_DIR_SHIFT)];
+		if (dir)
+			page = dir->pages[(regbase >> SNAP_PAGE_SHIFT) & (SNAP_DIR_PAGES - 1)];
+		if (page && (page->written & bit) && (page->vals[idx] == val))
+			continue;
+
+		page = snap_page_for_write(dec, regbase);
+		page->vals[idx] = val;
+		page->written |= bit;
+	}
+}
+
+void cffdec_enable_snapshots(struct cffdec *dec)
+{
+	uint32_t i;
+
+	if (dec->snapshots)
+		return;
+
+	dec->snapshots = 1;
+
+	/* start from the current state: */
+	for (i = 0; i < dec->nwritten; i++) {
+		uint32_t regbase = dec->written_regs[i];
+		struct snap_page *page = snap_page_for_write(dec, regbase);
+		unsigned idx = regbase & (SNAP_PAGE_REGS - 1);
+		page->vals[idx] = dec->vals[regbase];
+		page->written |= (uint64_t)1 << idx;
+	}
+}
+
+void cffdec_free_snapshots(struct cffdec *dec)
+{
+	unsigned i;
+
+	for (i = 0; i < dec->nsnaps; i++)
+		snap_release(dec, &dec->snaps[i]);
+	dec->nsnaps = 0;
+}
+
+int cffdec_snapshot(struct cffdec *dec)
+{
+	struct snap *snap;
+	int i;
+
+	if (!dec->snapshots)
+		return -1;
+
+	snap_fold(dec);
+
+	if (dec->nsnaps == dec->maxsnaps) {
+		dec->maxsnaps = max(64, 2 * dec->maxsnaps);
+		dec->snaps = realloc(dec->snaps, dec->maxsnaps * sizeof(*dec->snaps));
+		assert(dec->snaps);
+	}
+
+	snap = &dec->snaps[dec->nsnaps];
+	*snap = dec->cur;
+	for (i = 0; i < SNAP_NDIRS; i++)
+		if (snap->dirs[i])
+			snap->dirs[i]->refcnt++;
+
+	return dec->nsnaps++;
+}
+
+unsigned cffdec_num_snapshots(struct cffdec *dec)
+{
+	return dec->nsnaps;
+}
+
+size_t cffdec_snapshot_size(struct cffdec *dec)
+{
+	return dec->snap_bytes + (dec->maxsnaps * sizeof(*dec->snaps));
+}
+
+static struct snap_page * snap_page(struct cffdec *dec, unsigned n,
+		uint32_t regbase)
+{
+	struct snap_dir *dir;
+
+	if ((n >= dec->nsnaps) || (regbase >= CFFDEC_MAXREGS))
+		return NULL;
+
+	dir = dec->snaps[n].dirs[regbase >> (SNAP_PAGE_SHIFT + SNAP_DIR_SHIFT)];
+	if (!dir)
+		return NULL;
+
+	return dir->pages[(regbase >> SNAP_PAGE_SHIFT) & (SNAP_DIR_PAGES - 1)];
+}
+
+uint32_t cffdec_snapshot_val(struct cffdec *dec, unsigned n, uint32_t regbase)
+{
+	struct snap_page *page = snap_page(dec, n, regbase);
+	if (!page)
+		return 0;
+	return page->vals[regbase & (SNAP_PAGE_REGS - 1)];
+}
+
+int cffdec_snapshot_written(struct cffdec *dec, unsigned n, uint32_t regbase)
+{
+	struct snap_page *page = snap_page(dec, n, regbase);
+	if (!page)
+		return 0;
+	return !!(page->written & ((uint64_t)1 << (regbase & (SNAP_PAGE_REGS - 1))));
+}
+
+static unsigned diff_pages(struct snap_page *pa, struct snap_page *pb,
+		uint32_t pagebase, cffdec_diff_func fxn, void *data)
+{
+	static const struct snap_page empty;
+	uint64_t written;
+	unsigned i, n = 0;
+
+	if (!pa)
+		pa = (struct snap_page *)&empty;
+	if (!pb)
+		pb = (struct snap_page *)&empty;
+
+	written = pa->written | pb->written;
+
+	for (i = 0; i < SNAP_PAGE_REGS; i++) {
+		uint64_t bit = (uint64_t)1 << i;
+
+		if (!(written & bit))
+			continue;
+		if (((pa->written ^ pb->written) & bit) ||
+				(pa->vals[i] != pb->vals[i])) {
+			if (fxn)
+				fxn(data, pagebase + i,
+						!!(pa->written & bit), pa->vals[i],
+						!!(pb->written & bit), pb->vals[i]);
+			n++;
+		}
+	}
+
+	return n;
+}
+
+unsigned cffdec_snapshot_diff(struct cffdec *dec, unsigned a, unsigned b,
+		cffdec_diff_func fxn, void *data)
+{
+	unsigned d, p, n = 0;
+
+	if ((a >= dec->nsnaps) || (b >= dec->nsnaps))
+		return 0;
+
+	for (d = 0; d < SNAP_NDIRS; d++) {
+		struct snap_dir *da = dec->snaps[a].dirs[d];
+		struct snap_dir *db = dec->snaps[b].dirs[d];
+
+		/* shared dirs/pages are unchanged: */
+		if (da == db)
+			continue;
+
+		for (p = 0; p < SNAP_DIR_PAGES; p++) {
+			struct snap_page *pa = da ? da->pages[p] : NULL;
+			struct snap_page *pb = db ? db->pages[p] : NULL;
+			uint32_t pagebase =
+				((d << SNAP_DIR_SHIFT) | p) << SNAP_PAGE_SHIFT;
+
+			if (pa == pb)
+				continue;
+
+			n += diff_pages(pa, pb, pagebase, fxn, data);
+		}
+	}
+
+	return n;
+}
+
+/*
+ * Register database:
+ */
+
+static const char *gen_names[NGENS] = {
+		[A2XX] = "a2xx",
+		[A3XX] = "a3xx",
+		[A4XX] = "a4xx",
+		[A5XX] = "a5xx",
+};
+
+struct reg_def {
+	const char *name;
+	enum cffdec_reg_kind kind;
+};
+
+/*
+ * Registers with special handling (rnndec_decode() handles rest):
+ */
+#define REG(x, kind) { #x, CFFDEC_REG_ ## kind }
+static const struct reg_def reg_a2xx[] = {
+		REG(CP_SCRATCH_REG0, SCRATCH),
+		REG(CP_SCRATCH_REG1, SCRATCH),
+		REG(CP_SCRATCH_REG2, SCRATCH),
+		REG(CP_SCRATCH_REG3, SCRATCH),
+		REG(CP_SCRATCH_REG4, SCRATCH),
+		REG(CP_SCRATCH_REG5, SCRATCH),
+		REG(CP_SCRATCH_REG6, SCRATCH),
+		REG(CP_SCRATCH_REG7, SCRATCH),
+		REG(VSC_PIPE[0].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x1].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x1].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x1].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x2].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x2].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x2].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x3].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x3].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x3].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x4].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x4].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x4].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x5].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x5].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x5].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x6].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x6].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x6].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x7].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x7].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x7].DATA_LENGTH, VSC_PIPE_LENGTH),
+		{NULL},
+}, reg_a3xx[] = {
+		REG(CP_SCRATCH_REG0, SCRATCH),
+		REG(CP_SCRATCH_REG1, SCRATCH),
+		REG(CP_SCRATCH_REG2, SCRATCH),
+		REG(CP_SCRATCH_REG3, SCRATCH),
+		REG(CP_SCRATCH_REG4, SCRATCH),
+		REG(CP_SCRATCH_REG5, SCRATCH),
+		REG(CP_SCRATCH_REG6, SCRATCH),
+		REG(CP_SCRATCH_REG7, SCRATCH),
+		REG(VSC_SIZE_ADDRESS, GPUADDR),
+		REG(VSC_PIPE[0].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x1].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x1].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x1].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x2].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x2].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x2].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x3].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x3].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x3].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x4].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x4].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x4].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x5].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x5].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x5].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x6].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x6].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x6].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VSC_PIPE[0x7].CONFIG, VSC_PIPE_CONFIG),
+		REG(VSC_PIPE[0x7].DATA_ADDRESS, VSC_PIPE_ADDRESS),
+		REG(VSC_PIPE[0x7].DATA_LENGTH, VSC_PIPE_LENGTH),
+		REG(VFD_FETCH[0].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x1].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x1].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x2].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x2].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x3].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x3].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x4].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x4].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x5].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x5].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x6].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x6].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x7].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x7].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x8].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x8].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x9].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x9].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0xa].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0xa].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0xb].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0xb].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0xc].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0xc].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0xd].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0xd].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0xe].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0xe].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0xf].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0xf].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(SP_VS_PVT_MEM_ADDR_REG, GPUADDR),
+		REG(SP_FS_PVT_MEM_ADDR_REG, GPUADDR),
+		REG(SP_VS_OBJ_START_REG, SHADER),
+		REG(SP_FS_OBJ_START_REG, SHADER),
+		REG(TPL1_TP_FS_BORDER_COLOR_BASE_ADDR, GPUADDR),
+		{NULL},
+}, reg_a4xx[] = {
+		REG(CP_SCRATCH[0].REG, SCRATCH),
+		REG(CP_SCRATCH[0x1].REG, SCRATCH),
+		REG(CP_SCRATCH[0x2].REG, SCRATCH),
+		REG(CP_SCRATCH[0x3].REG, SCRATCH),
+		REG(CP_SCRATCH[0x4].REG, SCRATCH),
+		REG(CP_SCRATCH[0x5].REG, SCRATCH),
+		REG(CP_SCRATCH[0x6].REG, SCRATCH),
+		REG(CP_SCRATCH[0x7].REG, SCRATCH),
+		REG(SP_VS_PVT_MEM_ADDR, GPUADDR),
+		REG(SP_FS_PVT_MEM_ADDR, GPUADDR),
+		REG(SP_GS_PVT_MEM_ADDR, GPUADDR),
+		REG(SP_HS_PVT_MEM_ADDR, GPUADDR),
+		REG(SP_DS_PVT_MEM_ADDR, GPUADDR),
+		REG(SP_CS_PVT_MEM_ADDR, GPUADDR),
+		REG(SP_VS_OBJ_START, SHADER),
+		REG(SP_FS_OBJ_START, SHADER),
+		REG(SP_GS_OBJ_START, SHADER),
+		REG(SP_HS_OBJ_START, SHADER),
+		REG(SP_DS_OBJ_START, SHADER),
+		REG(SP_CS_OBJ_START, SHADER),
+		REG(VFD_FETCH[0].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x1].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x1].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x2].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x2].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x3].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x3].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x4].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x4].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x5].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x5].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x6].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x6].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x7].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x7].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x8].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x8].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x9].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x9].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0xa].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0xa].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0xb].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0xb].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0xc].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0xc].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0xd].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0xd].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0xe].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0xe].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0xf].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0xf].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x10].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x10].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x11].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x11].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x12].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x12].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x13].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x13].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x14].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x14].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x15].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x15].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x16].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x16].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x17].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x17].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x18].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x18].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x19].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x19].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x1a].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x1a].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x1b].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x1b].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x1c].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x1c].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x1d].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x1d].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x1e].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x1e].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(VFD_FETCH[0x1f].INSTR_0, VFD_FETCH_INSTR_0),
+		REG(VFD_FETCH[0x1f].INSTR_1, VFD_FETCH_INSTR_1),
+		REG(TPL1_TP_VS_BORDER_COLOR_BASE_ADDR, GPUADDR),
+		REG(TPL1_TP_HS_BORDER_COLOR_BASE_ADDR, GPUADDR),
+		REG(TPL1_TP_DS_BORDER_COLOR_BASE_ADDR, GPUADDR),
+		REG(TPL1_TP_GS_BORDER_COLOR_BASE_ADDR, GPUADDR),
+		REG(TPL1_TP_FS_BORDER_COLOR_BASE_ADDR, GPUADDR),
+		{NULL},
+}, reg_a5xx[] = {
+		REG(CP_SCRATCH[0x4].REG, SCRATCH5),
+		REG(CP_SCRATCH[0x5].REG, SCRATCH5),
+		REG(CP_SCRATCH[0x6].REG, SCRATCH5),
+		REG(CP_SCRATCH[0x7].REG, SCRATCH5),
+		REG(SP_VS_OBJ_START_LO, GPUADDR_LO),
+		REG(SP_VS_OBJ_START_HI, SHADER_HI),
+		REG(SP_HS_OBJ_START_LO, GPUADDR_LO),
+		REG(SP_HS_OBJ_START_HI, SHADER_HI),
+		REG(SP_DS_OBJ_START_LO, GPUADDR_LO),
+		REG(SP_DS_OBJ_START_HI, SHADER_HI),
+		REG(SP_GS_OBJ_START_LO, GPUADDR_LO),
+		REG(SP_GS_OBJ_START_HI, SHADER_HI),
+		REG(SP_FS_OBJ_START_LO, GPUADDR_LO),
+		REG(SP_FS_OBJ_START_HI, SHADER_HI),
+		REG(SP_CS_OBJ_START_LO, GPUADDR_LO),
+		REG(SP_CS_OBJ_START_HI, SHADER_HI),
+		REG(TPL1_VS_TEX_CONST_LO, GPUADDR_LO),
+		REG(TPL1_VS_TEX_CONST_HI, TEX_CONST_HI),
+		REG(TPL1_VS_TEX_SAMP_LO,  GPUADDR_LO),
+		REG(TPL1_VS_TEX_SAMP_HI,  TEX_SAMP_HI),
+		REG(TPL1_HS_TEX_CONST_LO, GPUADDR_LO),
+		REG(TPL1_HS_TEX_CONST_HI, TEX_CONST_HI),
+		REG(TPL1_HS_TEX_SAMP_LO,  GPUADDR_LO),
+		REG(TPL1_HS_TEX_SAMP_HI,  TEX_SAMP_HI),
+		REG(TPL1_DS_TEX_CONST_LO, GPUADDR_LO),
+		REG(TPL1_DS_TEX_CONST_HI, TEX_CONST_HI),
+		REG(TPL1_DS_TEX_SAMP_LO,  GPUADDR_LO),
+		REG(TPL1_DS_TEX_SAMP_HI,  TEX_SAMP_HI),
+		REG(TPL1_GS_TEX_CONST_LO, GPUADDR_LO),
+		REG(TPL1_GS_TEX_CONST_HI, TEX_CONST_HI),
+		REG(TPL1_GS_TEX_SAMP_LO,  GPUADDR_LO),
+		REG(TPL1_GS_TEX_SAMP_HI,  TEX_SAMP_HI),
+		REG(TPL1_FS_TEX_CONST_LO, GPUADDR_LO),
+		REG(TPL1_FS_TEX_CONST_HI, TEX_CONST_HI),
+		REG(TPL1_FS_TEX_SAMP_LO,  GPUADDR_LO),
+		REG(TPL1_FS_TEX_SAMP_HI,  TEX_SAMP_HI),
+		REG(TPL1_CS_TEX_CONST_LO, GPUADDR_LO),
+		REG(TPL1_CS_TEX_CONST_HI, TEX_CONST_HI),
+		REG(TPL1_CS_TEX_SAMP_LO,  GPUADDR_LO),
+		REG(TPL1_CS_TEX_SAMP_HI,  TEX_SAMP_HI),
+		REG(TPL1_TP_BORDER_COLOR_BASE_ADDR_LO,  GPUADDR_LO),
+		REG(TPL1_TP_BORDER_COLOR_BASE_ADDR_HI,  GPUADDR_HI),
+//		REG(RB_MRT_FLAG_BUFFER[0].ADDR_LO, GPUADDR_LO),
+//		REG(RB_MRT_FLAG_BUFFER[0].ADDR_HI, GPUADDR_HI),
+//		REG(RB_MRT_FLAG_BUFFER[1].ADDR_LO, GPUADDR_LO),
+//		REG(RB_MRT_FLAG_BUFFER[1].ADDR_HI, GPUADDR_HI),
+//		REG(RB_MRT_FLAG_BUFFER[2].ADDR_LO, GPUADDR_LO),
+//		REG(RB_MRT_FLAG_BUFFER[2].ADDR_HI, GPUADDR_HI),
+//		REG(RB_MRT_FLAG_BUFFER[3].ADDR_LO, GPUADDR_LO),
+//		REG(RB_MRT_FLAG_BUFFER[3].ADDR_HI, GPUADDR_HI),
+//		REG(RB_MRT_FLAG_BUFFER[4].ADDR_LO, GPUADDR_LO),
+//		REG(RB_MRT_FLAG_BUFFER[4].ADDR_HI, GPUADDR_HI),
+//		REG(RB_MRT_FLAG_BUFFER[5].ADDR_LO, GPUADDR_LO),
+//		REG(RB_MRT_FLAG_BUFFER[5].ADDR_HI, GPUADDR_HI),
+//		REG(RB_MRT_FLAG_BUFFER[6].ADDR_LO, GPUADDR_LO),
+//		REG(RB_MRT_FLAG_BUFFER[6].ADDR_HI, GPUADDR_HI),
+//		REG(RB_MRT_FLAG_BUFFER[7].ADDR_LO, GPUADDR_LO),
+//		REG(RB_MRT_FLAG_BUFFER[7].ADDR_HI, GPUADDR_HI),
+//		REG(RB_BLIT_FLAG_DST_LO, GPUADDR_LO),
+//		REG(RB_BLIT_FLAG_DST_HI, GPUADDR_HI),
+//		REG(RB_MRT[0].BASE_LO, GPUADDR_LO),
+//		REG(RB_MRT[0].BASE_HI, GPUADDR_HI),
+//		REG(RB_DEPTH_BUFFER_BASE_LO, GPUADDR_LO),
+//		REG(RB_DEPTH_BUFFER_BASE_HI, GPUADDR_HI),
+//		REG(RB_DEPTH_FLAG_BUFFER_BASE_LO, GPUADDR_LO),
+//		REG(RB_DEPTH_FLAG_BUFFER_BASE_HI, GPUADDR_HI),
+//		REG(RB_BLIT_DST_LO, GPUADDR_LO),
+//		REG(RB_BLIT_DST_HI, GPUADDR_HI),
+
+//		REG(RB_2D_SRC_LO, GPUADDR_LO),
+//		REG(RB_2D_SRC_HI, GPUADDR_HI),
+//		REG(RB_2D_SRC_FLAGS_LO, GPUADDR_LO),
+//		REG(RB_2D_SRC_FLAGS_HI, GPUADDR_HI),
+//		REG(RB_2D_DST_LO, GPUADDR_LO),
+//		REG(RB_2D_DST_HI, GPUADDR_HI),
+//		REG(RB_2D_DST_FLAGS_LO, GPUADDR_LO),
+//		REG(RB_2D_DST_FLAGS_HI, GPUADDR_HI),
+
+		{NULL},
+};
+
+static const struct reg_def *reg_defs[NGENS] = {
+		[A2XX] = reg_a2xx,
+		[A3XX] = reg_a3xx,
+		[A4XX] = reg_a4xx,
+		[A5XX] = reg_a5xx,
+};
+
+static enum gen gpu_gen(unsigned gpu_id)
+{
+	if (gpu_id >= 500)
+		return A5XX;
+	else if (gpu_id >= 400)
+		return A4XX;
+	else if (gpu_id >= 300)
+		return A3XX;
+	else
+		return A2XX;
+}
+
+static void free_enums(struct cffdec *dec)
+{
+	rnn_enumtab_free(dec->enums.adreno_pm4_type3_packets);
+	rnn_enumtab_free(dec->enums.pc_di_primtype);
+	rnn_enumtab_free(dec->enums.pc_di_src_sel);
+	rnn_enumtab_free(dec->enums.vgt_event_type);
+	rnn_enumtab_free(dec->enums.render_mode_cmd);
+	rnn_enumtab_free(dec->enums.cp_blit_cmd);
+	memset(&dec->enums, 0, sizeof(dec->enums));
+}
+
+static void init_gen(struct cffdec *dec, enum gen gen)
+{
+	const struct reg_def *defs = reg_defs[gen];
+	struct rnn *rnn;
+	unsigned i, n;
+
+	if (!dec->rnns[gen]) {
+		dec->rnns[gen] = rnn_new(!dec->color);
+		rnn_load(dec->rnns[gen], gen_names[gen]);
+	}
+
+	rnn = dec->rnn = dec->rnns[gen];
+	dec->gen = gen;
+
+	free_enums(dec);
+#define ENUM(name) dec->enums.name = rnn_enumtab(rnn, #name)
+	ENUM(adreno_pm4_type3_packets);
+	ENUM(pc_di_primtype);
+	ENUM(pc_di_src_sel);
+	ENUM(vgt_event_type);
+	ENUM(render_mode_cmd);
+	ENUM(cp_blit_cmd);
+#undef ENUM
+
+	for (n = 0; defs[n].name; n++)
+		;
+
+	free(dec->regs);
+	dec->regs = calloc(n, sizeof(dec->regs[0]));
+	assert(dec->regs || !n);
+	memset(dec->reg_map, 0, sizeof(dec->reg_map));
+
+	for (i = 0; i < n; i++) {
+		struct cffdec_reg *reg = &dec->regs[i];
+		const char *idx = strchr(defs[i].name, '[');
+
+		reg->name = defs[i].name;
+		reg->kind = defs[i].kind;
+		reg->regbase = rnn_regbase(rnn, reg->name);
+		reg->idx = idx ? strtol(idx + 1, NULL, 0) : 0;
+
+		if (!reg->regbase) {
+			fprintf(stderr, "invalid register name: %s\n", reg->name);
+			continue;
+		}
+
+		/* first entry wins, same as a linear search: */
+		if ((reg->regbase < CFFDEC_MAXREGS) && !dec->reg_map[reg->regbase])
+			dec->reg_map[reg->regbase] = i + 1;
+	}
+
+	if (gen == A5XX) {
+		dec->scissor_tl = rnn_regbase(rnn, "GRAS_SC_WINDOW_SCISSOR_TL");
+		dec->scissor_br = rnn_regbase(rnn, "GRAS_SC_WINDOW_SCISSOR_BR");
+	} else {
+		dec->scissor_tl = dec->scissor_br = 0;
+	}
+}
+
+/* loaded for the current gpu_id the first time it is needed, defaulting
+ * to a2xx so older rd files prior to RD_GPU_ID can still be parsed:
+ */
+struct rnn * cffdec_rnn(struct cffdec *dec)
+{
+	enum gen gen = gpu_gen(dec->gpu_id);
+
+	if (!dec->rnn || (gen != dec->gen))
+		init_gen(dec, gen);
+
+	return dec->rnn;
+}
+
+const struct cffdec_enums * cffdec_enums(struct cffdec *dec)
+{
+	cffdec_rnn(dec);
+	return &dec->enums;
+}
+
+const struct cffdec_reg * cffdec_special_reg(struct cffdec *dec,
+		uint32_t regbase)
+{
+	cffdec_rnn(dec);
+	if ((regbase >= CFFDEC_MAXREGS) || !dec->reg_map[regbase])
+		return NULL;
+	return &dec->regs[dec->reg_map[regbase] - 1];
+}
+
+/*
+ * IB memos:
+ */
+
+static void memo_free(struct memo *memo)
+{
+	if (!memo)
+		return;
+	free(memo->dwords);
+	free(memo->writes);
+	free(memo);
+}
+
+static void memo_reset(struct cffdec *dec)
+{
+	unsigned i;
+
+	for (i = 0; i < MEMO_SLOTS; i++) {
+		memo_free(dec->memos[i]);
+		dec->memos[i] = NULL;
+	}
+}
+
+/* called for anything in an IB that can't just be replayed: */
+static void memo_impure(struct cffdec *dec)
+{
+	if (dec->recording)
+		dec->recording->pure = 0;
+}
+
+static void memo_write(struct memo *memo, uint32_t regbase, uint32_t val)
+{
+	if (!memo->pure)
+		return;
+	if (memo->nwrites == memo->maxwrites) {
+		memo->maxwrites = max(2 * memo->maxwrites, 64);
+		memo->writes = realloc(memo->writes,
+				memo->maxwrites * sizeof(memo->writes[0]));
+		assert(memo->writes);
+	}
+	memo->writes[memo->nwrites].regbase = regbase;
+	memo->writes[memo->nwrites].val = val;
+	memo->nwrites++;
+}
+
+static uint64_t memo_hash(struct cffdec *dec, uint32_t *dwords,
+		uint32_t sizedwords)
+{
+	uint64_t hash = 14695981039346656037ull;
+	uint32_t i;
+
+	for (i = 0; i < sizedwords; i++)
+		hash = (hash ^ dwords[i]) * 1099511628211ull;
+
+	return hash ^ dec->state.needs_wfi;
+}
+
+static struct memo **memo_slot(struct cffdec *dec, uint64_t hash)
+{
+	return &dec->memos[(hash ^ (hash >> 32)) & (MEMO_SLOTS - 1)];
+}
+
+static struct memo *memo_find(struct cffdec *dec, uint64_t hash,
+		uint32_t *dwords, uint32_t sizedwords)
+{
+	struct memo *memo = *memo_slot(dec, hash);
+
+	if (!memo || (memo->hash != hash) || (memo->sizedwords != sizedwords) ||
+			(memo->wfi_in != dec->state.needs_wfi))
+		return NULL;
+
+	if (memcmp(memo->dwords, dwords, sizedwords * 4))
+		return NULL;
+
+	return memo;
+}
+
+static struct memo *memo_new(struct cffdec *dec, uint64_t hash,
+		uint32_t sizedwords)
+{
+	struct memo *memo = calloc(1, sizeof(*memo));
+
+	assert(memo);
+	memo->hash = hash;
+	memo->sizedwords = sizedwords;
+	memo->wfi_in = dec->state.needs_wfi;
+	memo->pure = 1;
+	memo->draw = dec->state.draw_count;
+
+	return memo;
+}
+
+/* keep the memo for a just decoded IB, if it is worth keeping: */
+static void memo_finish(struct cffdec *dec, struct memo *memo,
+		uint32_t *dwords)
+{
+	struct memo **slot;
+
+	if (!memo->pure) {
+		memo_free(memo);
+		return;
+	}
+
+	memo->dwords = malloc(memo->sizedwords * 4);
+	assert(memo->dwords);
+	memcpy(memo->dwords, dwords, memo->sizedwords * 4);
+	memo->wfi_out = dec->state.needs_wfi;
+
+	slot = memo_slot(dec, memo->hash);
+	memo_free(*slot);
+	*slot = memo;
+}
+
+/*
+ * Cmdstream walker:
+ */
+
+#define OP(x) [CP_ ## x] = 1
+
+/* packets which do more than write registers (or which cffdump prints
+ * more than the register writes of), so an IB containing any of them is
+ * not memoized.  Everything else (NOPs, waits, etc) just gets a mention
+ * in ib_repeat():
+ */
+static const uint8_t impure_ops[0x100] = {
+		OP(INDIRECT_BUFFER),
+		OP(INDIRECT_BUFFER_PFD),
+		OP(REG_RMW),
+		OP(REG_TO_MEM),
+		OP(MEM_WRITE),
+		OP(EVENT_WRITE),
+		OP(RUN_OPENCL),
+		OP(DRAW_INDX),
+		OP(DRAW_INDX_2),
+		OP(SET_CONSTANT),
+		OP(IM_LOAD_IMMEDIATE),
+		OP(WIDE_REG_WRITE),
+		OP(LOAD_STATE),
+		OP(SET_BIN),
+		OP(SET_DRAW_STATE),
+		OP(DRAW_INDX_OFFSET),
+		OP(EXEC_CS),
+		OP(EXEC_CS_INDIRECT),
+		OP(SET_RENDER_MODE),
+		OP(BLIT),
+		OP(CONTEXT_REG_BUNCH),
+		OP(DRAW_INDIRECT),
+		OP(DRAW_INDX_INDIRECT),
+};
+
+static void decode(struct cffdec *dec, uint32_t *dwords, uint32_t sizedwords,
+		int level);
+
+static int is_64b(struct cffdec *dec)
+{
+	return dec->gpu_id >= 500;
+}
+
+/* CP_EVENT_WRITE of a BLIT event, which on a5xx is a draw of sorts: */
+static int is_blit_event(struct cffdec *dec, uint32_t *dwords)
+{
+	const char *name;
+
+	if (dec->gpu_id <= 500)
+		return 0;
+
+	name = rnn_enumtab_name(cffdec_enums(dec)->vgt_event_type, dwords[0]);
+
+	return name && !strcmp(name, "BLIT");
+}
+
+static int is_draw(struct cffdec *dec, uint32_t opcode, uint32_t *dwords)
+{
+	switch (opcode) {
+	case CP_DRAW_INDX:
+	case CP_DRAW_INDX_2:
+	case CP_DRAW_INDX_OFFSET:
+	case CP_DRAW_INDX_INDIRECT:
+	case CP_DRAW_INDIRECT:
+	case CP_RUN_OPENCL:
+	case CP_EXEC_CS:
+	case CP_EXEC_CS_INDIRECT:
+	case CP_BLIT:
+		return 1;
+	case CP_EVENT_WRITE:
+		return is_blit_event(dec, dwords);
+	default:
+		return 0;
+	}
+}
+
+static void write_reg(struct cffdec *dec, uint32_t regbase, uint32_t val,
+		int level)
+{
+	struct cffdec_state *state = &dec->state;
+	const struct cffdec_reg *reg;
+
+	cffdec_reg_set(dec, regbase, val);
+	if (dec->recording)
+		memo_write(dec->recording, regbase, val);
+
+	reg = cffdec_special_reg(dec, regbase);
+	if (reg) {
+		memo_impure(dec);
+		switch (reg->kind) {
+		case CFFDEC_REG_VSC_PIPE_CONFIG:
+			if (reg->idx < ARRAY_SIZE(state->vsc_pipe))
+				state->vsc_pipe[reg->idx].config = val;
+			break;
+		case CFFDEC_REG_VSC_PIPE_ADDRESS:
+			if (reg->idx < ARRAY_SIZE(state->vsc_pipe))
+				state->vsc_pipe[reg->idx].address = val;
+			break;
+		case CFFDEC_REG_VSC_PIPE_LENGTH:
+			if (reg->idx < ARRAY_SIZE(state->vsc_pipe))
+				state->vsc_pipe[reg->idx].length = val;
+			break;
+		case CFFDEC_REG_VFD_FETCH_INSTR_0:
+			if (reg->idx < ARRAY_SIZE(state->vfd_fetch_instr_0))
+				state->vfd_fetch_instr_0[reg->idx] = val;
+			break;
+		case CFFDEC_REG_GPUADDR_LO:
+			state->gpuaddr_lo = val;
+			break;
+		default:
+			break;
+		}
+	}
+
+	/* on a5xx, how gpu addresses are printed depends on the other half
+	 * of the address and on the current buffers, so an IB writing them
+	 * can't be memoized:
+	 */
+	if (dec->recording && is_64b(dec) &&
+			(rnn_lookupreg(dec->rnn, regbase)->flags &
+					(RNN_REG_ADDR_LO | RNN_REG_ADDR_HI)))
+		memo_impure(dec);
+
+	if (dec->funcs->reg_write)
+		dec->funcs->reg_write(dec, regbase, val, level);
+}
+
+static void draw(struct cffdec *dec, uint32_t opcode, uint32_t prim_type,
+		uint32_t num_indices, int level)
+{
+	struct cffdec_draw draw = {
+			.opcode = opcode,
+			.prim_type = prim_type,
+			.num_indices = num_indices,
+			.level = level,
+	};
+
+	if (dec->funcs->draw)
+		dec->funcs->draw(dec, &draw);
+
+	/* with snapshots, snapshot index matches draw_count: */
+	cffdec_snapshot(dec);
+	cffdec_clear_rewritten(dec);
+
+	dec->state.draw_count++;
+}
+
+/* decode an IB (or draw state group, etc): */
+static void indirect(struct cffdec *dec, uint32_t opcode, uint64_t gpuaddr,
+		uint32_t sizedwords, int level)
+{
+	const struct cffdec_funcs *funcs = dec->funcs;
+	struct cffdec_state *state = &dec->state;
+	struct memo *outer = dec->recording, *memo = NULL;
+	int type = state->type;
+	uint32_t i;
+	struct cffdec_ib ib = {
+			.opcode = opcode,
+			.gpuaddr = gpuaddr,
+			.dwords = cffdec_hostptr(dec, gpuaddr),
+			.sizedwords = sizedwords,
+			.level = level,
+	};
+
+	if (funcs->ib && !funcs->ib(dec, &ib))
+		return;
+
+	if (!ib.dwords || (state->ib + 1 >= CFFDEC_MAXDEPTH))
+		return;
+
+	/* only the innermost IBs are memoized: */
+	memo_impure(dec);
+
+	if (dec->memo && sizedwords) {
+		uint64_t hash = memo_hash(dec, ib.dwords, sizedwords);
+
+		memo = memo_find(dec, hash, ib.dwords, sizedwords);
+		if (memo && (!funcs->ib_repeat || funcs->ib_repeat(dec, &ib,
+				memo->draw, memo->packets))) {
+			for (i = 0; i < memo->nwrites; i++)
+				write_reg(dec, memo->writes[i].regbase,
+						memo->writes[i].val, ib.level);
+			state->needs_wfi = memo->wfi_out;
+			if (funcs->ib_end)
+				funcs->ib_end(dec, &ib);
+			return;
+		}
+
+		memo = memo_new(dec, hash, sizedwords);
+	}
+
+	dec->recording = memo;
+	state->ib++;
+	decode(dec, ib.dwords, sizedwords, ib.level);
+	state->ib--;
+	dec->recording = outer;
+
+	state->type = type;
+	state->opcode = opcode;
+
+	if (memo)
+		memo_finish(dec, memo, ib.dwords);
+
+	if (funcs->ib_end)
+		funcs->ib_end(dec, &ib);
+}
+
+/* dwords is the payload, after the packet header: */
+static void decode_packet(struct cffdec *dec, uint32_t opcode,
+		uint32_t *dwords, uint32_t sizedwords, int level)
+{
+	struct cffdec_state *state = &dec->state;
+	uint64_t addr;
+	uint32_t i, reg;
+
+	switch (opcode) {
+	case CP_INDIRECT_BUFFER:
+	case CP_INDIRECT_BUFFER_PFD:
+		if (is_64b(dec)) {
+			/* a5xx+.. high 32b of gpu addr, then size: */
+			addr = dwords[0] | (((uint64_t)dwords[1]) << 32);
+			indirect(dec, opcode, addr, dwords[2], level + 1);
+		} else {
+			indirect(dec, opcode, dwords[0], dwords[1], level + 1);
+		}
+		break;
+	case CP_SET_DRAW_STATE:
+		for (i = 0; i < sizedwords; ) {
+			uint32_t count = dwords[i] & 0xffff;
+
+			if (is_64b(dec)) {
+				addr = dwords[i + 1] | (((uint64_t)dwords[i + 2]) << 32);
+				i += 3;
+			} else {
+				addr = dwords[i + 1];
+				i += 2;
+			}
+
+			indirect(dec, opcode, addr, count, level + 1);
+		}
+		break;
+	case CP_SET_RENDER_MODE:
+		state->render_mode = dwords[0];
+		if (sizedwords >= 4)
+			state->mode = dwords[3];
+		/* the second address is cmdstream, the first isn't: */
+		if (sizedwords >= 8) {
+			addr = dwords[6] | (((uint64_t)dwords[7]) << 32);
+			indirect(dec, opcode, addr, dwords[5], level + 1);
+		}
+		break;
+	case CP_WAIT_FOR_IDLE:
+		state->needs_wfi = 0;
+		break;
+	case CP_REG_RMW:
+		reg = dwords[0] & 0xffff;
+		write_reg(dec, reg, (cffdec_reg_val(dec, reg) & dwords[1]) | dwords[2],
+				level);
+		break;
+	case CP_SET_CONSTANT:
+		if (((dwords[0] >> 16) & 0xf) != 0x4)
+			break;
+		reg = (dwords[0] & 0xffff) + 0x2000;
+		if (dwords[0] & 0x80000000) {
+			/* TODO: not sure what happens w/ payload != 2.. */
+			if (sizedwords >= 3)
+				write_reg(dec, reg, dwords[2] + cffdec_reg_val(dec, dwords[1]),
+						level);
+		} else {
+			for (i = 1; i < sizedwords; i++)
+				write_reg(dec, reg++, dwords[i], level);
+		}
+		break;
+	case CP_WIDE_REG_WRITE:
+		reg = dwords[0] & 0xffff;
+		for (i = 1; i < sizedwords; i++)
+			write_reg(dec, reg++, dwords[i], level);
+		break;
+	case CP_CONTEXT_REG_BUNCH:
+		/* NOTE: seems to write same reg multiple times.. */
+		for (i = 0; i + 1 < sizedwords; i += 2)
+			write_reg(dec, dwords[i], dwords[i + 1], level);
+		break;
+	case CP_SET_BIN:
+		state->bin_x1 = dwords[1] & 0xffff;
+		state->bin_y1 = dwords[1] >> 16;
+		state->bin_x2 = dwords[2] & 0xffff;
+		state->bin_y2 = dwords[2] >> 16;
+		break;
+	case CP_DRAW_INDX:
+		state->draws[state->ib]++;
+		/* don't bother with the dummy draw_indx's: */
+		if (dwords[2] > 0)
+			draw(dec, opcode, dwords[1] & 0x1f, dwords[2], level);
+		state->needs_wfi = 1;
+		break;
+	case CP_DRAW_INDX_2:
+		state->draws[state->ib]++;
+		if (dwords[2] > 0)
+			draw(dec, opcode, dwords[1] & 0x1f, dwords[2], level);
+		break;
+	case CP_DRAW_INDX_OFFSET:
+		if (dwords[2] > 0)
+			draw(dec, opcode, dwords[0] & 0x1f, dwords[2], level);
+		break;
+	case CP_DRAW_INDX_INDIRECT:
+	case CP_DRAW_INDIRECT:
+		draw(dec, opcode, dwords[0] & 0x1f, 0, level);
+		break;
+	case CP_RUN_OPENCL:
+		draw(dec, opcode, 0, 1, level);
+		break;
+	case CP_EXEC_CS:
+	case CP_EXEC_CS_INDIRECT:
+	case CP_BLIT:
+		draw(dec, opcode, 0, 0, level);
+		break;
+	case CP_EVENT_WRITE:
+		if (is_blit_event(dec, dwords))
+			draw(dec, opcode, 0, 0, level);
+		break;
+	}
+}
+
+static void decode(struct cffdec *dec, uint32_t *dwords, uint32_t sizedwords,
+		int level)
+{
+	const struct cffdec_funcs *funcs = dec->funcs;
+	struct cffdec_state *state = &dec->state;
+	int dwords_left = sizedwords;
+	uint32_t i;
+
+	state->draws[state->ib] = 0;
+
+	while (dwords_left > 0) {
+		uint32_t count, opcode;
+		int type;
+
+		if (pkt_is_type0(dwords[0])) {
+			type = 0;
+			count = type0_pkt_size(dwords[0]) + 1;
+			opcode = type0_pkt_offset(dwords[0]);
+		} else if (pkt_is_type4(dwords[0])) {
+			/* basically the same(ish) as type0 prior to a5xx */
+			type = 4;
+			count = type4_pkt_size(dwords[0]) + 1;
+			opcode = type4_pkt_offset(dwords[0]);
+		} else if (pkt_is_type3(dwords[0])) {
+			type = 3;
+			count = type3_pkt_size(dwords[0]) + 1;
+			opcode = cp_type3_opcode(dwords[0]);
+		} else if (pkt_is_type7(dwords[0])) {
+			type = 7;
+			count = type7_pkt_size(dwords[0]) + 1;
+			opcode = cp_type7_opcode(dwords[0]);
+		} else if (pkt_is_type2(dwords[0])) {
+			type = 2;
+			count = 1;
+			opcode = 0;
+		} else {
+			memo_impure(dec);
+			if (funcs->error)
+				funcs->error(dec, CFFDEC_BAD_PACKET, dwords, dwords_left);
+			return;
+		}
+
+		state->type = type;
+		state->opcode = opcode;
+
+		if ((type == 3) || (type == 7)) {
+			if (dec->recording)
+				dec->recording->packets = 1;
+			if (impure_ops[opcode & 0xff])
+				memo_impure(dec);
+
+			/* on a5xx, the bin is the window scissor at each draw: */
+			if ((500 <= dec->gpu_id) && (dec->gpu_id < 600) &&
+					is_draw(dec, opcode, dwords + 1)) {
+				uint32_t tl = cffdec_reg_val(dec, dec->scissor_tl);
+				uint32_t br = cffdec_reg_val(dec, dec->scissor_br);
+
+				state->bin_x1 = tl & 0xffff;
+				state->bin_y1 = tl >> 16;
+				state->bin_x2 = br & 0xffff;
+				state->bin_y2 = br >> 16;
+			}
+		}
+
+		if (funcs->packet)
+			funcs->packet(dec, type, opcode, dwords, count, level);
+
+		if ((type == 0) || (type == 4)) {
+			for (i = 1; i < count; i++)
+				write_reg(dec, opcode + i - 1, dwords[i], level);
+		} else if ((type == 3) || (type == 7)) {
+			decode_packet(dec, opcode, dwords + 1, count - 1, level);
+		}
+
+		if (funcs->packet_end)
+			funcs->packet_end(dec, type, opcode, dwords, count, level);
+
+		dwords += count;
+		dwords_left -= count;
+	}
+
+	if ((dwords_left < 0) && funcs->error)
+		funcs->error(dec, CFFDEC_OVERRUN, dwords, dwords_left);
+}
+
+void cffdec_decode(struct cffdec *dec, uint32_t *dwords, uint32_t sizedwords)
+{
+	if (!dwords)
+		return;
+
+	dec->state.needs_wfi = 0;
+	dec->state.ib = 0;
+
+	/* make sure the register database is loaded for the gpu_id: */
+	cffdec_rnn(dec);
+
+	decode(dec, dwords, sizedwords, 0);
+}
@@ -0,0 +1,340 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#ifndef CFFDEC_H_
+#define CFFDEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "adreno_pm4.xml.h"
+
+struct rnn;
+struct rnnenumtab;
+
+/* libcffdec, the cmdstream decoder without the text output.  All of
+ * the state (buffer map, register values, where the walker is in the
+ * cmdstream, etc) lives in a cffdec context, so several can be used at
+ * once (ie. one per thread), and the user is told about what is in the
+ * cmdstream via callbacks:
+ *
+ *    dec = cffdec_new(gpu_id, &funcs, data);
+ *    for each file:
+ *       cffdec_reset(dec);
+ *       for each submit:
+ *          cffdec_reset_buffers(dec);
+ *          for each buffer:
+ *             cffdec_add_buffer(dec, gpuaddr, hostptr, len, mapped);
+ *          cffdec_decode(dec, cffdec_hostptr(dec, cmdaddr), sizedwords);
+ *    cffdec_free(dec);
+ *
+ * The context only tracks state, it does not own the buffer contents.
+ */
+
+#define CFFDEC_MAXREGS 0x10000
+#define CFFDEC_MAXDEPTH 16    /* IB nesting, real cmdstream only uses a few */
+
+struct cffdec;
+
+struct cffdec_buffer {
+	void *hostptr;
+	unsigned int len;
+	uint64_t gpuaddr;
+	int mapped;    /* hostptr points into mmap'd file, not malloc'd */
+};
+
+struct cffdec_draw {
+	uint32_t opcode;         /* CP_DRAW_INDX, CP_EXEC_CS, CP_BLIT, etc */
+	uint32_t prim_type;      /* pc_di_primtype, if opcode is a draw */
+	uint32_t num_indices;    /* zero for indirect draws, CP_EXEC_CS, blits */
+	int level;
+};
+
+struct cffdec_ib {
+	uint32_t opcode;         /* of the packet pointing at it */
+	uint64_t gpuaddr;
+	uint32_t *dwords;        /* NULL if it isn't in any of the buffers */
+	uint32_t sizedwords;
+	int level;               /* level to decode it at, ib() can change it */
+};
+
+enum cffdec_error {
+	CFFDEC_BAD_PACKET,       /* bad header, the rest of the IB is skipped */
+	CFFDEC_OVERRUN,          /* the last packet ran past the end of the IB */
+};
+
+/* All of the callbacks are optional.  The type is 0, 2, 3, 4 or 7, the
+ * opcode is the register offset for type0/type4 packets, and dwords
+ * includes the packet header.  The level is just passed through, it
+ * starts at zero for the cmdstream and is one more for each IB, unless
+ * ib() says otherwise.
+ */
+struct cffdec_funcs {
+	/* called before and after the walker handles each packet: */
+	void (*packet)(struct cffdec *dec, int type, uint32_t opcode,
+			uint32_t *dwords, uint32_t sizedwords, int level);
+	void (*packet_end)(struct cffdec *dec, int type, uint32_t opcode,
+			uint32_t *dwords, uint32_t sizedwords, int level);
+	/* called after each register write, see cffdec_state() for the
+	 * packet it is from:
+	 */
+	void (*reg_write)(struct cffdec *dec, uint32_t regbase, uint32_t val,
+			int level);
+	/* called at each draw/blit/compute dispatch, after which the list
+	 * of registers rewritten since the previous draw is cleared:
+	 */
+	void (*draw)(struct cffdec *dec, const struct cffdec_draw *draw);
+	/* called for each IB (or draw state group, etc), return zero to
+	 * skip it, otherwise ib_end() is called once it is decoded:
+	 */
+	int (*ib)(struct cffdec *dec, struct cffdec_ib *ib);
+	void (*ib_end)(struct cffdec *dec, struct cffdec_ib *ib);
+	/* with cffdec_enable_memo(), called when an IB of nothing but
+	 * register writes is seen again, with the draw it was first seen
+	 * at, and whether it had any other packets (NOPs, waits, etc).
+	 * Return zero to decode it in full anyway, otherwise the register
+	 * writes are just replayed:
+	 */
+	int (*ib_repeat)(struct cffdec *dec, struct cffdec_ib *ib, int draw,
+			int packets);
+	void (*error)(struct cffdec *dec, enum cffdec_error error,
+			uint32_t *dwords, int dwords_left);
+};
+
+/* Registers which the walker (or its users) need to know more about
+ * than their value:
+ */
+enum cffdec_reg_kind {
+	CFFDEC_REG_SCRATCH = 1,       /* CP scratch registers */
+	CFFDEC_REG_SCRATCH5,          /* CP scratch registers 4-7, a5xx */
+	CFFDEC_REG_VSC_PIPE_CONFIG,
+	CFFDEC_REG_VSC_PIPE_ADDRESS,
+	CFFDEC_REG_VSC_PIPE_LENGTH,
+	CFFDEC_REG_VFD_FETCH_INSTR_0,
+	CFFDEC_REG_VFD_FETCH_INSTR_1,
+	CFFDEC_REG_GPUADDR,           /* address of a buffer */
+	CFFDEC_REG_GPUADDR_LO,        /* low half of the _HI written next */
+	CFFDEC_REG_GPUADDR_HI,
+	CFFDEC_REG_SHADER,            /* address of a shader */
+	CFFDEC_REG_SHADER_HI,
+	CFFDEC_REG_TEX_CONST_HI,
+	CFFDEC_REG_TEX_SAMP_HI,
+};
+
+struct cffdec_reg {
+	const char *name;
+	enum cffdec_reg_kind kind;
+	uint32_t regbase;
+	int idx;                 /* pipe/fetch index, for VSC_PIPE/VFD_FETCH */
+};
+
+/* What the walker keeps track of, besides the register values: */
+struct cffdec_state {
+	int type;                /* packet being decoded, as for packet() */
+	uint32_t opcode;
+	int ib;                  /* IB nesting, zero for the cmdstream */
+	int draws[CFFDEC_MAXDEPTH];   /* CP_DRAW_INDX[_2]s so far in each IB */
+	int draw_count;          /* draws so far, since cffdec_reset() */
+	int needs_wfi;           /* set by draws, until CP_WAIT_FOR_IDLE */
+	uint32_t render_mode, mode;   /* from CP_SET_RENDER_MODE */
+	/* from CP_SET_BIN, or the window scissor at each draw on a5xx: */
+	uint32_t bin_x1, bin_y1, bin_x2, bin_y2;
+	struct {
+		uint32_t config, address, length;
+	} vsc_pipe[8];
+	uint32_t vfd_fetch_instr_0[32];
+	uint32_t gpuaddr_lo;     /* last CFFDEC_REG_GPUADDR_LO written */
+};
+
+/* enums which are looked up for every packet/draw/event: */
+struct cffdec_enums {
+	struct rnnenumtab *adreno_pm4_type3_packets;
+	struct rnnenumtab *pc_di_primtype;
+	struct rnnenumtab *pc_di_src_sel;
+	struct rnnenumtab *vgt_event_type;
+	struct rnnenumtab *render_mode_cmd;
+	struct rnnenumtab *cp_blit_cmd;
+};
+
+struct cffdec * cffdec_new(unsigned gpu_id, const struct cffdec_funcs *funcs,
+		void *data);
+void cffdec_free(struct cffdec *dec);
+void * cffdec_data(struct cffdec *dec);
+void cffdec_set_gpu_id(struct cffdec *dec, unsigned gpu_id);
+unsigned cffdec_gpu_id(struct cffdec *dec);
+/* colorize what is decoded with cffdec_rnn(), before it is first used: */
+void cffdec_set_color(struct cffdec *dec, int color);
+
+/* start of a new file, forgets the draw count, IB memos and which
+ * registers were written (but not their values):
+ */
+void cffdec_reset(struct cffdec *dec);
+
+/* decode a cmdstream, which must be in one of the buffers: */
+void cffdec_decode(struct cffdec *dec, uint32_t *dwords, uint32_t sizedwords);
+
+const struct cffdec_state * cffdec_state(struct cffdec *dec);
+
+/* Real captures point thousands of draws at the same few state IBs and
+ * draw state groups, so once enabled, IBs which are nothing but register
+ * writes are recorded the first time they are seen, and repeats of them
+ * just replay the writes (see ib_repeat()):
+ */
+void cffdec_enable_memo(struct cffdec *dec);
+
+/*
+ * Register database, for the current gpu_id:
+ */
+
+struct rnn * cffdec_rnn(struct cffdec *dec);
+const struct cffdec_enums * cffdec_enums(struct cffdec *dec);
+/* NULL unless it is one of the registers in enum cffdec_reg_kind: */
+const struct cffdec_reg * cffdec_special_reg(struct cffdec *dec,
+		uint32_t regbase);
+
+/*
+ * Buffer map, for gpuaddr <-> hostptr translation:
+ */
+
+void cffdec_add_buffer(struct cffdec *dec, uint64_t gpuaddr, void *hostptr,
+		unsigned int len, int mapped);
+/* drop all of the buffers, freeing the contents of non-mapped ones: */
+void cffdec_reset_buffers(struct cffdec *dec);
+struct cffdec_buffer * cffdec_find_gpuaddr(struct cffdec *dec, uint64_t gpuaddr);
+struct cffdec_buffer * cffdec_find_hostptr(struct cffdec *dec, void *hostptr);
+uint64_t cffdec_gpuaddr(struct cffdec *dec, void *hostptr);
+uint64_t cffdec_gpubaseaddr(struct cffdec *dec, uint64_t gpuaddr);
+void * cffdec_hostptr(struct cffdec *dec, uint64_t gpuaddr);
+unsigned cffdec_hostlen(struct cffdec *dec, uint64_t gpuaddr);
+
+/*
+ * Register state:
+ */
+
+uint32_t cffdec_reg_val(struct cffdec *dec, uint32_t regbase);
+void cffdec_reg_set(struct cffdec *dec, uint32_t regbase, uint32_t val);
+/* set the value without marking the register written, ie. to restore
+ * state from a checkpoint without it showing up as written by the
+ * cmdstream:
+ */
+void cffdec_reg_restore(struct cffdec *dec, uint32_t regbase, uint32_t val);
+/* the whole register file, CFFDEC_MAXREGS entries indexed by regbase: */
+const uint32_t * cffdec_reg_vals(struct cffdec *dec);
+/* written since the start (or last cffdec_clear_written()): */
+int cffdec_reg_written(struct cffdec *dec, uint32_t regbase);
+/* written since the last draw: */
+int cffdec_reg_rewritten(struct cffdec *dec, uint32_t regbase);
+/* lists of the same, sorted by regbase: */
+uint32_t cffdec_written_list(struct cffdec *dec, const uint32_t **regs);
+uint32_t cffdec_rewritten_list(struct cffdec *dec, const uint32_t **regs);
+void cffdec_clear_written(struct cffdec *dec);
+void cffdec_clear_rewritten(struct cffdec *dec);
+
+/*
+ * Register state snapshots:
+ *
+ * Once enabled, the state of the registers is recorded at each draw (and
+ * whenever cffdec_snapshot() is called), so tools can look at the state
+ * of any draw without decoding again from the start.  Snapshots share
+ * unchanged pages of registers, so each one costs roughly the size of
+ * the registers written since the previous one, and comparing two is
+ * proportional to the number of pages which differ.  Unwritten registers
+ * read as zero.
+ */
+
+typedef void (*cffdec_diff_func)(void *data, uint32_t regbase,
+		int awritten, uint32_t aval, int bwritten, uint32_t bval);
+
+void cffdec_enable_snapshots(struct cffdec *dec);
+/* drop all snapshots, ie. at the start of a new file: */
+void cffdec_free_snapshots(struct cffdec *dec);
+/* returns the index of the new snapshot, or -1 if not enabled: */
+int cffdec_snapshot(struct cffdec *dec);
+unsigned cffdec_num_snapshots(struct cffdec *dec);
+/* memory used by snapshots, in bytes: */
+size_t cffdec_snapshot_size(struct cffdec *dec);
+uint32_t cffdec_snapshot_val(struct cffdec *dec, unsigned n, uint32_t regbase);
+int cffdec_snapshot_written(struct cffdec *dec, unsigned n, uint32_t regbase);
+/* calls fxn (if not NULL) for each register which differs between
+ * snapshots a and b, in order, and returns the number of them:
+ */
+unsigned cffdec_snapshot_diff(struct cffdec *dec, unsigned a, unsigned b,
+		cffdec_diff_func fxn, void *data);
+
+/*
+ * Packet header helpers:
+ */
+
+static inline unsigned pm4_calc_odd_parity_bit(unsigned val)
+{
+	return (0x9669 >> (0xf & ((val) ^
+			((val) >> 4) ^ ((val) >> 8) ^ ((val) >> 12) ^
+			((val) >> 16) ^ ((val) >> 20) ^ ((val) >> 24) ^
+			((val) >> 28)))) & 1;
+}
+
+#define pkt_is_type0(pkt) (((pkt) & 0XC0000000) == CP_TYPE0_PKT)
+#define type0_pkt_size(pkt) ((((pkt) >> 16) & 0x3FFF) + 1)
+#define type0_pkt_offset(pkt) ((pkt) & 0x7FFF)
+
+#define pkt_is_type2(pkt) ((pkt) == CP_TYPE2_PKT)
+
+/*
+ * Check both for the type3 opcode and make sure that the reserved bits [1:7]
+ * and 15 are 0
+ */
+
+#define pkt_is_type3(pkt) \
+        ((((pkt) & 0xC0000000) == CP_TYPE3_PKT) && \
+         (((pkt) & 0x80FE) == 0))
+
+#define cp_type3_opcode(pkt) (((pkt) >> 8) & 0xFF)
+#define type3_pkt_size(pkt) ((((pkt) >> 16) & 0x3FFF) + 1)
+
+#define pkt_is_type4(pkt) \
+        ((((pkt) & 0xF0000000) == CP_TYPE4_PKT) && \
+         ((((pkt) >> 27) & 0x1) == \
+         pm4_calc_odd_parity_bit(type4_pkt_offset(pkt))) \
+         && ((((pkt) >> 7) & 0x1) == \
+         pm4_calc_odd_parity_bit(type4_pkt_size(pkt))))
+
+#define type4_pkt_offset(pkt) (((pkt) >> 8) & 0x7FFFF)
+#define type4_pkt_size(pkt) ((pkt) & 0x7F)
+
+#define pkt_is_type7(pkt) \
+        ((((pkt) & 0xF0000000) == CP_TYPE7_PKT) && \
+         (((pkt) & 0x0F000000) == 0) && \
+         ((((pkt) >> 23) & 0x1) == \
+         pm4_calc_odd_parity_bit(cp_type7_opcode(pkt))) \
+         && ((((pkt) >> 15) & 0x1) == \
+         pm4_calc_odd_parity_bit(type7_pkt_size(pkt))))
+
+#define cp_type7_opcode(pkt) (((pkt) >> 16) & 0x7F)
+#define type7_pkt_size(pkt) ((pkt) & 0x3FFF)
+
+#endif /* CFFDEC_H_ */
@@ -36,12 +36,22 @@
 #include <assert.h>
 #include <signal.h>
 #include <errno.h>
+#include <limits.h>
 
 #include "redump.h"
 #include "disasm.h"
 #include "script.h"
 #include "io.h"
+#include "rdindex.h"
+#include "rdfile.h"
 #include "rnnutil.h"
+#include "output.h"
+#include "cffdec.h"
+#include "colfile.h"
+#include "analyze.h"
+#include "batch.h"
+#include "profile.h"
+#include "shaderdb.h"
 
 /* ************************************************************************* */
 /* originally based on kernel recovery dump code: */
@@ -53,12 +63,16 @@ typedef enum {
 	true = 1, false = 0,
 } bool;
 
-static bool needs_wfi = false;
 static bool dump_shaders = false;
+static char *dump_prefix;
 static bool no_color = false;
 static bool summary = false;
 static bool allregs = false;
 static bool dump_textures = false;
+static bool use_index = true;
+static int jobs = 1;
+static int diff_draws[2] = { -1, -1 };
+static bool export = false;
 static int vertices;
 static unsigned gpu_id = 220;
 
@@ -75,14 +89,7 @@ static int is_64b(void)
 	return gpu_id >= 500;
 }
 
-/* note: not sure if CP_SET_DRAW_STATE counts as a complete extra level
- * of IB or if it is restricted to just have register writes:
- */
-static int draws[3];
-static int ib;
-
 static int draw_filter;
-static int draw_count;
 static int current_draw_count;
 
 /* query mode.. to handle symbolic register name queries, we need to
@@ -95,13 +102,39 @@ int nquery;
 
 static char *script;
 
+/* native equivalent of scripts/analyze.lua: */
+static bool analyze;
+
+/* report where the time goes, see profile.h: */
+static bool profile;
+
+/* shaders seen so far in the current file (and the shader database, if
+ * --shader-db), see shaderdb.h:
+ */
+static struct shaderdb *shaders;
+static const char *infile;
+
+/* --expand-shaders, to disassemble every shader load in full: */
+static bool expand_shaders;
+
+/* set while the parent process is decoding only to keep track of state,
+ * with --jobs, in which case nothing is printed:
+ */
+static bool prepass;
+
+/* whether to call the script's hooks (with --jobs, the workers do): */
+static bool scripting(void)
+{
+	return script && !prepass;
+}
+
 static bool quiet(int lvl)
 {
 	if ((draw_filter != -1) && (draw_filter != current_draw_count))
 		return true;
-	if ((lvl >= 3) && (summary || querystrs || script))
+	if ((lvl >= 3) && (summary || querystrs || script || analyze))
 		return true;
-	if ((lvl >= 2) && (querystrs || script))
+	if ((lvl >= 2) && (querystrs || script || analyze))
 		return true;
 	return false;
 }
@@ -109,7 +142,7 @@ static bool quiet(int lvl)
 static void printl(int lvl, const char *fmt, ...)
 {
 	va_list args;
-	if (quiet(lvl))
+	if (prepass || quiet(lvl))
 		return;
 	va_start(args, fmt);
 	vprintf(fmt, args);
@@ -200,78 +233,62 @@ static const char *fmt_name[] = {
 		NAME(FMT_DXT3A_AS_1_1_1_1),
 };
 
-static void dump_commands(uint32_t *dwords, uint32_t sizedwords, int level);
+static void dump_commands(uint32_t *dwords, uint32_t sizedwords);
 static void dump_register_val(uint32_t regbase, uint32_t dword, int level);
 static const char *regname(uint32_t regbase, int color);
 static uint32_t regbase(const char *name);
 
-struct buffer {
-	void *hostptr;
-	unsigned int len;
-	uint64_t gpuaddr;
-};
-
-static struct buffer buffers[512];
-static int nbuffers;
-
-static int buffer_contains_gpuaddr(struct buffer *buf, uint64_t gpuaddr, uint32_t len)
-{
-	return (buf->gpuaddr <= gpuaddr) && (gpuaddr < (buf->gpuaddr + buf->len));
-}
+/* the buffer map, register state and the cmdstream walker are in
+ * libcffdec, which calls back to here to print what it decodes:
+ */
+static struct cffdec *dec;
 
-static int buffer_contains_hostptr(struct buffer *buf, void *hostptr)
+static const struct cffdec_state *walker_state(void)
 {
-	return (buf->hostptr <= hostptr) && (hostptr < (buf->hostptr + buf->len));
+	return cffdec_state(dec);
 }
 
-
 static uint64_t gpuaddr(void *hostptr)
 {
-	int i;
-	for (i = 0; i < nbuffers; i++)
-		if (buffer_contains_hostptr(&buffers[i], hostptr))
-			return buffers[i].gpuaddr + (hostptr - buffers[i].hostptr);
-	return 0;
+	return cffdec_gpuaddr(dec, hostptr);
 }
 
 static uint64_t gpubaseaddr(uint64_t gpuaddr)
 {
-	int i;
-	if (!gpuaddr)
-		return 0;
-	for (i = 0; i < nbuffers; i++)
-		if (buffer_contains_gpuaddr(&buffers[i], gpuaddr, 0))
-			return buffers[i].gpuaddr;
-	return 0;
+	return cffdec_gpubaseaddr(dec, gpuaddr);
 }
 
 static void *hostptr(uint64_t gpuaddr)
 {
-	int i;
-	if (!gpuaddr)
-		return 0;
-	for (i = 0; i < nbuffers; i++)
-		if (buffer_contains_gpuaddr(&buffers[i], gpuaddr, 0))
-			return buffers[i].hostptr + (gpuaddr - buffers[i].gpuaddr);
-	return 0;
+	return cffdec_hostptr(dec, gpuaddr);
 }
 
 static unsigned hostlen(uint64_t gpuaddr)
 {
-	int i;
-	if (!gpuaddr)
-		return 0;
-	for (i = 0; i < nbuffers; i++)
-		if (buffer_contains_gpuaddr(&buffers[i], gpuaddr, 0))
-			return buffers[i].len + buffers[i].gpuaddr - gpuaddr;
-	return 0;
+	return cffdec_hostlen(dec, gpuaddr);
+}
+
+static char *fmt_line_prefix(char *p, void *ptr, int level)
+{
+	if (is_64b()) {
+		p = out_fmt_hex(p, gpuaddr(ptr), 16);
+	} else {
+		p = out_fmt_hex(p, (uint32_t)gpuaddr(ptr), 8);
+	}
+	*(p++) = ':';
+	return out_fmt_str(p, levels[level]);
 }
 
 static void dump_hex(uint32_t *dwords, uint32_t sizedwords, int level)
 {
 	int i, j;
 	int lastzero = 1;
+
+	if (prepass)
+		return;
+
 	for (i = 0; i < sizedwords; i += 8) {
+		char line[128], *p = line;
 		int zero = 1;
 
 		/* always show first row: */
@@ -283,48 +300,51 @@ static void dump_hex(uint32_t *dwords, uint32_t sizedwords, int level)
 				zero = 0;
 
 		if (zero && !lastzero)
-			printf("*\n");
+			out_str("*\n");
 
 		lastzero = zero;
 
 		if (zero)
 			continue;
 
-		if (is_64b()) {
-			printf("%016lx:%s", gpuaddr(&dwords[i]), levels[level]);
-		} else {
-			printf("%08x:%s", (uint32_t)gpuaddr(&dwords[i]), levels[level]);
-		}
-
-		printf("%04x:", i * 4);
+		p = fmt_line_prefix(p, &dwords[i], level);
+		p = out_fmt_hex(p, i * 4, 4);
+		*(p++) = ':';
 
 		for (j = 0; (j < 8) && (i+j < sizedwords); j++) {
-			printf(" %08x", dwords[i+j]);
+			*(p++) = ' ';
+			p = out_fmt_hex(p, dwords[i+j], 8);
 		}
 
-		printf("\n");
+		*(p++) = '\n';
+		out_write(line, p);
 	}
 }
 
 static void dump_float(float *dwords, uint32_t sizedwords, int level)
 {
+	char line[64 + 8 * (OUT_FLOAT_MAX + 1)], *p = line;
 	int i;
+
+	if (prepass)
+		return;
+
 	for (i = 0; i < sizedwords; i++) {
 		if ((i % 8) == 0) {
-			if (is_64b()) {
-				printf("%016lx:%s", gpuaddr(dwords), levels[level]);
-			} else {
-				printf("%08x:%s", (uint32_t)gpuaddr(dwords), levels[level]);
-			}
+			p = fmt_line_prefix(line, dwords, level);
 		} else {
-			printf(" ");
+			*(p++) = ' ';
+		}
+		p = out_fmt_float(p, *(dwords++), 8);
+		if ((i % 8) == 7) {
+			*(p++) = '\n';
+			out_write(line, p);
 		}
-		printf("%8f", *(dwords++));
-		if ((i % 8) == 7)
-			printf("\n");
 	}
-	if (i % 8)
-		printf("\n");
+	if (i % 8) {
+		*(p++) = '\n';
+		out_write(line, p);
+	}
 }
 
 /* I believe the surface format is low bits:
@@ -347,30 +367,32 @@ static void parse_dword_addr(uint32_t dword, uint32_t *gpuaddr,
 #define	REG_CP_TIMESTAMP		 REG_SCRATCH_REG0
 
 
-static uint32_t type0_reg_vals[0xffff + 1];
-static uint8_t type0_reg_rewritten[sizeof(type0_reg_vals)/8];  /* written since last draw */
-static uint8_t type0_reg_written[sizeof(type0_reg_vals)/8];
-static uint32_t lastvals[ARRAY_SIZE(type0_reg_vals)];
+static uint32_t lastvals[CFFDEC_MAXREGS];
 
 static bool reg_rewritten(uint32_t regbase)
 {
-	return !!(type0_reg_rewritten[regbase/8] & (1 << (regbase % 8)));
+	return cffdec_reg_rewritten(dec, regbase);
 }
 
 bool reg_written(uint32_t regbase)
 {
-	return !!(type0_reg_written[regbase/8] & (1 << (regbase % 8)));
+	return cffdec_reg_written(dec, regbase);
 }
 
-static void clear_rewritten(void)
+/* returns the list of registers written (since the start of the file),
+ * sorted by regbase:
+ */
+uint32_t reg_written_list(const uint32_t **regs)
 {
-	memset(type0_reg_rewritten, 0, sizeof(type0_reg_rewritten));
+	return cffdec_written_list(dec, regs);
 }
 
-static void clear_written(void)
+/* returns the list of registers written since the last draw, sorted
+ * by regbase:
+ */
+uint32_t reg_rewritten_list(const uint32_t **regs)
 {
-	memset(type0_reg_written, 0, sizeof(type0_reg_written));
-	clear_rewritten();
+	return cffdec_rewritten_list(dec, regs);
 }
 
 uint32_t reg_lastval(uint32_t regbase)
@@ -385,119 +407,20 @@ static void clear_lastvals(void)
 
 uint32_t reg_val(uint32_t regbase)
 {
-	return type0_reg_vals[regbase];
-}
-
-static void reg_set(uint32_t regbase, uint32_t val)
-{
-	type0_reg_vals[regbase] = val;
-	type0_reg_written[regbase/8] |= (1 << (regbase % 8));
-	type0_reg_rewritten[regbase/8] |= (1 << (regbase % 8));
-}
-
-static struct {
-	uint32_t config;
-	uint32_t address;
-	uint32_t length;
-} vsc_pipe_data[7];
-
-static void reg_vsc_pipe_config(const char *name, uint32_t dword, int level)
-{
-	int idx;
-	sscanf(name, "VSC_PIPE_CONFIG_%x", &idx) ||
-		sscanf(name, "VSC_PIPE[0x%x].CONFIG", &idx) ||
-		sscanf(name, "VSC_PIPE[%d].CONFIG", &idx);
-	vsc_pipe_data[idx].config = dword;
-}
-
-static void reg_vsc_pipe_data_address(const char *name, uint32_t dword, int level)
-{
-	int idx;
-	sscanf(name, "VSC_PIPE_DATA_ADDRESS_%x", &idx) ||
-		sscanf(name, "VSC_PIPE[0x%x].DATA_ADDRESS", &idx) ||
-		sscanf(name, "VSC_PIPE[%d].DATA_ADDRESS", &idx);
-	vsc_pipe_data[idx].address = dword;
-}
-
-static void reg_vsc_pipe_data_length(const char *name, uint32_t dword, int level)
-{
-	int idx;
-	void *buf;
-
-	sscanf(name, "VSC_PIPE_DATA_LENGTH_%x", &idx) ||
-		sscanf(name, "VSC_PIPE[0x%x].DATA_LENGTH", &idx) ||
-		sscanf(name, "VSC_PIPE[%d].DATA_LENGTH", &idx);
-
-	vsc_pipe_data[idx].length = dword;
-
-	if (quiet(3))
-		return;
-
-	/* as this is the last register in the triplet written, we dump
-	 * the pipe data here..
-	 */
-	buf = hostptr(vsc_pipe_data[idx].address);
-	if (buf) {
-		/* not sure how much of this is useful: */
-		dump_hex(buf, min(vsc_pipe_data[idx].length/4, 16), level+1);
-	}
+	return cffdec_reg_val(dec, regbase);
 }
 
-/*
- * A3xx registers:
- */
-
-typedef struct {
-	uint32_t fetchsize  : 7;
-	uint32_t bufstride  : 10;
-	/* warning: after here differs for a4xx */
-#if 1
-	uint32_t pad : 15;
-#else
-	uint32_t switchnext : 1;
-	uint32_t indexcode  : 6;
-	uint32_t steprate   : 8;
-#endif
-} vfd_fetch_state_t;
-static vfd_fetch_state_t vfd_fetch_state[0xf];
-
-static void reg_vfd_fetch_instr_0_x(const char *name, uint32_t dword, int level)
+/* returns the current value of every register, indexed by regbase: */
+uint32_t reg_vals(const uint32_t **vals)
 {
-	int idx;
-
-	/* this is a bit ugly way, but oh well.. */
-	sscanf(name, "VFD_FETCH_INSTR_0_%x", &idx) ||
-		sscanf(name, "VFD_FETCH[0x%x].INSTR_0", &idx) ||
-		sscanf(name, "VFD_FETCH[%d].INSTR_0", &idx);
-
-	vfd_fetch_state[idx] = *(vfd_fetch_state_t *)&dword;
+	*vals = cffdec_reg_vals(dec);
+	return CFFDEC_MAXREGS;
 }
 
-static void reg_vfd_fetch_instr_1_x(const char *name, uint32_t dword, int level)
-{
-	int idx;
-	void *buf;
-
-	/* this is a bit ugly way, but oh well.. */
-	sscanf(name, "VFD_FETCH_INSTR_1_%x", &idx) ||
-		sscanf(name, "VFD_FETCH[0x%x].INSTR_1", &idx) ||
-		sscanf(name, "VFD_FETCH[%d].INSTR_1", &idx);
-
-	if (quiet(3))
-		return;
-
-	buf = hostptr(dword);
-
-	if (buf) {
-		// XXX we probably need to know min/max vtx to know the
-		// right values to dump..
-		uint32_t sizedwords = vfd_fetch_state[idx].fetchsize + 1;
-		dump_float(buf, sizedwords, level+1);
-		dump_hex(buf, sizedwords, level+1);
-	}
-}
+/* --expand-ibs, to decode every IB in full: */
+static bool expand_ibs;
 
-static void reg_dump_scratch(const char *name, uint32_t dword, int level)
+static void reg_dump_scratch(int level)
 {
 	unsigned regbase;
 
@@ -515,7 +438,7 @@ static void reg_dump_scratch(const char *name, uint32_t dword, int level)
 
 static inline uint32_t REG_A5XX_CP_SCRATCH_REG(uint32_t i0) { return 0x00000b78 + 0x1*i0; }
 
-static void reg_dump_scratch5(const char *name, uint32_t dword, int level)
+static void reg_dump_scratch5(int level)
 {
 	if (quiet(3))
 		return;
@@ -545,20 +468,40 @@ static void dump_gpuaddr(uint64_t gpuaddr, int level)
 	dump_gpuaddr_size(gpuaddr, level, 64, 3);
 }
 
-static void reg_dump_gpuaddr(const char *name, uint32_t dword, int level)
+static void reg_vsc_pipe_data_length(int idx, uint32_t dword, int level)
 {
-	dump_gpuaddr(dword, level);
-}
+	void *buf;
 
-uint32_t gpuaddr_lo;
-static void reg_gpuaddr_lo(const char *name, uint32_t dword, int level)
-{
-	gpuaddr_lo = dword;
+	if (quiet(3))
+		return;
+
+	/* as this is the last register in the triplet written, we dump
+	 * the pipe data here..
+	 */
+	buf = hostptr(walker_state()->vsc_pipe[idx].address);
+	if (buf) {
+		/* not sure how much of this is useful: */
+		dump_hex(buf, min(dword/4, 16), level+1);
+	}
 }
 
-static void reg_dump_gpuaddr_hi(const char *name, uint32_t dword, int level)
+static void reg_vfd_fetch_instr_1_x(int idx, uint32_t dword, int level)
 {
-	dump_gpuaddr(gpuaddr_lo | (((uint64_t)dword) << 32), level);
+	void *buf;
+
+	if (quiet(3))
+		return;
+
+	buf = hostptr(dword);
+
+	if (buf) {
+		// XXX we probably need to know min/max vtx to know the
+		// right values to dump..
+		uint32_t fetchsize = walker_state()->vfd_fetch_instr_0[idx] & 0x7f;
+		uint32_t sizedwords = fetchsize + 1;
+		dump_float(buf, sizedwords, level+1);
+		dump_hex(buf, sizedwords, level+1);
+	}
 }
 
 
@@ -566,15 +509,56 @@ static void dump_shader(const char *ext, void *buf, int bufsz)
 {
 	if (dump_shaders) {
 		static int n = 0;
-		char filename[8];
+		char filename[PATH_MAX];
 		int fd;
-		sprintf(filename, "%04d.%s", n++, ext);
+		/* in batch mode, named after the input file: */
+		if (dump_prefix)
+			snprintf(filename, sizeof(filename), "%s-%04d.%s",
+					dump_prefix, n++, ext);
+		else
+			snprintf(filename, sizeof(filename), "%04d.%s", n++, ext);
+		if (prepass)
+			return;
 		fd = open(filename, O_WRONLY| O_TRUNC | O_CREAT, 0644);
 		write(fd, buf, bufsz);
 		close(fd);
 	}
 }
 
+/* disassemble a shader, unless the same shader was already seen in this
+ * file, in which case just refer back to it.  Returns whether the shader
+ * was disassembled (or would have been, in the prepass):
+ */
+static bool disasm_shader(void *buf, uint32_t sizedwords, const char *ext,
+		shaderdb_disasm_t disasm, enum shader_t type, int level)
+{
+	struct shaderdb_entry *seen = NULL;
+	struct profile_timer t;
+
+	if (ext)
+		seen = shaderdb_find(shaders, buf, sizedwords, ext,
+				walker_state()->draw_count);
+
+	if (seen && !expand_shaders) {
+		printl(2, "%ssame as shader @ draw %d\n", levels[level], seen->first);
+		return false;
+	}
+
+	if (prepass)
+		return true;
+
+	profile_start(&t);
+	if (ext && !seen) {
+		shaderdb_disasm(shaders, buf, sizedwords, ext, disasm, type,
+				level, gpu_id, infile, walker_state()->draw_count);
+	} else {
+		disasm(buf, sizedwords, level, type);
+	}
+	profile_stop(&t, PROFILE_DISASM);
+
+	return true;
+}
+
 static void disasm_gpuaddr(const char *name, uint64_t gpuaddr, int level)
 {
 	void *buf;
@@ -590,7 +574,6 @@ static void disasm_gpuaddr(const char *name, uint64_t gpuaddr, int level)
 		const char *ext;
 
 		dump_hex(buf, 64, level+1);
-		disasm_a3xx(buf, sizedwords, level+2, SHADER_FRAGMENT);
 
 		/* this is a bit ugly way, but oh well.. */
 		if (strstr(name, "SP_VS_OBJ")) {
@@ -605,432 +588,101 @@ static void disasm_gpuaddr(const char *name, uint64_t gpuaddr, int level)
 			ext = NULL;
 		}
 
-		if (ext)
+		if (disasm_shader(buf, sizedwords, ext, disasm_a3xx,
+				SHADER_FRAGMENT, level+2) && ext)
 			dump_shader(ext, buf, sizedwords * 4);
 	}
 }
 
-static void reg_disasm_gpuaddr(const char *name, uint32_t dword, int level)
-{
-	disasm_gpuaddr(name, dword, level);
-}
+/* the _LO half of the address for the next _HI register printed, which
+ * in a register summary is the one printed just before it, rather than
+ * the last one written:
+ */
+static uint32_t gpuaddr_lo;
 
-static void reg_disasm_gpuaddr_hi(const char *name, uint32_t dword, int level)
-{
-	disasm_gpuaddr(name, gpuaddr_lo | (((uint64_t)dword) << 32), level);
-}
+/* query mode.. the rnn the query registers were looked up in: */
+static struct rnn *query_rnn;
 
-static void reg_dump_tex_samp_hi(const char *name, uint32_t dword, int level)
+static void init_query(void)
 {
-	reg_dump_gpuaddr_hi(name, dword, level); // XXX TODO
-}
+	int i;
 
-static void reg_dump_tex_const_hi(const char *name, uint32_t dword, int level)
-{
-	reg_dump_gpuaddr_hi(name, dword, level); // XXX TODO
-}
+	if (!querystrs || (query_rnn == cffdec_rnn(dec)))
+		return;
 
-/*
- * Registers with special handling (rnndec_decode() handles rest):
- */
-#define REG(x, fxn) { #x, fxn }
-static struct {
-	const char *regname;
-	void (*fxn)(const char *name, uint32_t dword, int level);
-	uint32_t regbase;
-} reg_a2xx[] = {
-		REG(CP_SCRATCH_REG0, reg_dump_scratch),
-		REG(CP_SCRATCH_REG1, reg_dump_scratch),
-		REG(CP_SCRATCH_REG2, reg_dump_scratch),
-		REG(CP_SCRATCH_REG3, reg_dump_scratch),
-		REG(CP_SCRATCH_REG4, reg_dump_scratch),
-		REG(CP_SCRATCH_REG5, reg_dump_scratch),
-		REG(CP_SCRATCH_REG6, reg_dump_scratch),
-		REG(CP_SCRATCH_REG7, reg_dump_scratch),
-		REG(VSC_PIPE[0].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x1].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x1].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x1].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x2].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x2].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x2].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x3].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x3].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x3].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x4].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x4].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x4].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x5].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x5].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x5].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x6].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x6].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x6].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x7].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x7].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x7].DATA_LENGTH, reg_vsc_pipe_data_length),
-		{NULL},
-}, reg_a3xx[] = {
-		REG(CP_SCRATCH_REG0, reg_dump_scratch),
-		REG(CP_SCRATCH_REG1, reg_dump_scratch),
-		REG(CP_SCRATCH_REG2, reg_dump_scratch),
-		REG(CP_SCRATCH_REG3, reg_dump_scratch),
-		REG(CP_SCRATCH_REG4, reg_dump_scratch),
-		REG(CP_SCRATCH_REG5, reg_dump_scratch),
-		REG(CP_SCRATCH_REG6, reg_dump_scratch),
-		REG(CP_SCRATCH_REG7, reg_dump_scratch),
-		REG(VSC_SIZE_ADDRESS, reg_dump_gpuaddr),
-		REG(VSC_PIPE[0].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x1].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x1].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x1].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x2].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x2].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x2].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x3].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x3].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x3].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x4].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x4].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x4].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x5].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x5].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x5].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x6].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x6].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x6].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VSC_PIPE[0x7].CONFIG, reg_vsc_pipe_config),
-		REG(VSC_PIPE[0x7].DATA_ADDRESS, reg_vsc_pipe_data_address),
-		REG(VSC_PIPE[0x7].DATA_LENGTH, reg_vsc_pipe_data_length),
-		REG(VFD_FETCH[0].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x1].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x1].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x2].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x2].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x3].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x3].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x4].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x4].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x5].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x5].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x6].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x6].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x7].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x7].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x8].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x8].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x9].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x9].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0xa].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0xa].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0xb].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0xb].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0xc].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0xc].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0xd].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0xd].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0xe].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0xe].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0xf].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0xf].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(SP_VS_PVT_MEM_ADDR_REG, reg_dump_gpuaddr),
-		REG(SP_FS_PVT_MEM_ADDR_REG, reg_dump_gpuaddr),
-		REG(SP_VS_OBJ_START_REG, reg_disasm_gpuaddr),
-		REG(SP_FS_OBJ_START_REG, reg_disasm_gpuaddr),
-		REG(TPL1_TP_FS_BORDER_COLOR_BASE_ADDR, reg_dump_gpuaddr),
-		{NULL},
-}, reg_a4xx[] = {
-		REG(CP_SCRATCH[0].REG, reg_dump_scratch),
-		REG(CP_SCRATCH[0x1].REG, reg_dump_scratch),
-		REG(CP_SCRATCH[0x2].REG, reg_dump_scratch),
-		REG(CP_SCRATCH[0x3].REG, reg_dump_scratch),
-		REG(CP_SCRATCH[0x4].REG, reg_dump_scratch),
-		REG(CP_SCRATCH[0x5].REG, reg_dump_scratch),
-		REG(CP_SCRATCH[0x6].REG, reg_dump_scratch),
-		REG(CP_SCRATCH[0x7].REG, reg_dump_scratch),
-		REG(SP_VS_PVT_MEM_ADDR, reg_dump_gpuaddr),
-		REG(SP_FS_PVT_MEM_ADDR, reg_dump_gpuaddr),
-		REG(SP_GS_PVT_MEM_ADDR, reg_dump_gpuaddr),
-		REG(SP_HS_PVT_MEM_ADDR, reg_dump_gpuaddr),
-		REG(SP_DS_PVT_MEM_ADDR, reg_dump_gpuaddr),
-		REG(SP_CS_PVT_MEM_ADDR, reg_dump_gpuaddr),
-		REG(SP_VS_OBJ_START, reg_disasm_gpuaddr),
-		REG(SP_FS_OBJ_START, reg_disasm_gpuaddr),
-		REG(SP_GS_OBJ_START, reg_disasm_gpuaddr),
-		REG(SP_HS_OBJ_START, reg_disasm_gpuaddr),
-		REG(SP_DS_OBJ_START, reg_disasm_gpuaddr),
-		REG(SP_CS_OBJ_START, reg_disasm_gpuaddr),
-		REG(VFD_FETCH[0].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x1].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x1].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x2].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x2].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x3].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x3].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x4].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x4].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x5].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x5].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x6].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x6].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x7].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x7].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x8].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x8].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x9].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x9].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0xa].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0xa].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0xb].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0xb].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0xc].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0xc].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0xd].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0xd].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0xe].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0xe].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0xf].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0xf].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x10].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x10].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x11].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x11].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x12].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x12].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x13].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x13].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x14].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x14].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x15].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x15].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x16].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x16].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x17].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x17].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x18].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x18].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x19].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x19].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x1a].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x1a].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x1b].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x1b].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x1c].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x1c].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x1d].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x1d].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x1e].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x1e].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(VFD_FETCH[0x1f].INSTR_0, reg_vfd_fetch_instr_0_x),
-		REG(VFD_FETCH[0x1f].INSTR_1, reg_vfd_fetch_instr_1_x),
-		REG(TPL1_TP_VS_BORDER_COLOR_BASE_ADDR, reg_dump_gpuaddr),
-		REG(TPL1_TP_HS_BORDER_COLOR_BASE_ADDR, reg_dump_gpuaddr),
-		REG(TPL1_TP_DS_BORDER_COLOR_BASE_ADDR, reg_dump_gpuaddr),
-		REG(TPL1_TP_GS_BORDER_COLOR_BASE_ADDR, reg_dump_gpuaddr),
-		REG(TPL1_TP_FS_BORDER_COLOR_BASE_ADDR, reg_dump_gpuaddr),
-		{NULL},
-}, reg_a5xx[] = {
-		REG(CP_SCRATCH[0x4].REG, reg_dump_scratch5),
-		REG(CP_SCRATCH[0x5].REG, reg_dump_scratch5),
-		REG(CP_SCRATCH[0x6].REG, reg_dump_scratch5),
-		REG(CP_SCRATCH[0x7].REG, reg_dump_scratch5),
-		REG(SP_VS_OBJ_START_LO, reg_gpuaddr_lo),
-		REG(SP_VS_OBJ_START_HI, reg_disasm_gpuaddr_hi),
-		REG(SP_HS_OBJ_START_LO, reg_gpuaddr_lo),
-		REG(SP_HS_OBJ_START_HI, reg_disasm_gpuaddr_hi),
-		REG(SP_DS_OBJ_START_LO, reg_gpuaddr_lo),
-		REG(SP_DS_OBJ_START_HI, reg_disasm_gpuaddr_hi),
-		REG(SP_GS_OBJ_START_LO, reg_gpuaddr_lo),
-		REG(SP_GS_OBJ_START_HI, reg_disasm_gpuaddr_hi),
-		REG(SP_FS_OBJ_START_LO, reg_gpuaddr_lo),
-		REG(SP_FS_OBJ_START_HI, reg_disasm_gpuaddr_hi),
-		REG(SP_CS_OBJ_START_LO, reg_gpuaddr_lo),
-		REG(SP_CS_OBJ_START_HI, reg_disasm_gpuaddr_hi),
-		REG(TPL1_VS_TEX_CONST_LO, reg_gpuaddr_lo),
-		REG(TPL1_VS_TEX_CONST_HI, reg_dump_tex_const_hi),
-		REG(TPL1_VS_TEX_SAMP_LO,  reg_gpuaddr_lo),
-		REG(TPL1_VS_TEX_SAMP_HI,  reg_dump_tex_samp_hi),
-		REG(TPL1_HS_TEX_CONST_LO, reg_gpuaddr_lo),
-		REG(TPL1_HS_TEX_CONST_HI, reg_dump_tex_const_hi),
-		REG(TPL1_HS_TEX_SAMP_LO,  reg_gpuaddr_lo),
-		REG(TPL1_HS_TEX_SAMP_HI,  reg_dump_tex_samp_hi),
-		REG(TPL1_DS_TEX_CONST_LO, reg_gpuaddr_lo),
-		REG(TPL1_DS_TEX_CONST_HI, reg_dump_tex_const_hi),
-		REG(TPL1_DS_TEX_SAMP_LO,  reg_gpuaddr_lo),
-		REG(TPL1_DS_TEX_SAMP_HI,  reg_dump_tex_samp_hi),
-		REG(TPL1_GS_TEX_CONST_LO, reg_gpuaddr_lo),
-		REG(TPL1_GS_TEX_CONST_HI, reg_dump_tex_const_hi),
-		REG(TPL1_GS_TEX_SAMP_LO,  reg_gpuaddr_lo),
-		REG(TPL1_GS_TEX_SAMP_HI,  reg_dump_tex_samp_hi),
-		REG(TPL1_FS_TEX_CONST_LO, reg_gpuaddr_lo),
-		REG(TPL1_FS_TEX_CONST_HI, reg_dump_tex_const_hi),
-		REG(TPL1_FS_TEX_SAMP_LO,  reg_gpuaddr_lo),
-		REG(TPL1_FS_TEX_SAMP_HI,  reg_dump_tex_samp_hi),
-		REG(TPL1_CS_TEX_CONST_LO, reg_gpuaddr_lo),
-		REG(TPL1_CS_TEX_CONST_HI, reg_dump_tex_const_hi),
-		REG(TPL1_CS_TEX_SAMP_LO,  reg_gpuaddr_lo),
-		REG(TPL1_CS_TEX_SAMP_HI,  reg_dump_tex_samp_hi),
-		REG(TPL1_TP_BORDER_COLOR_BASE_ADDR_LO,  reg_gpuaddr_lo),
-		REG(TPL1_TP_BORDER_COLOR_BASE_ADDR_HI,  reg_dump_gpuaddr_hi),
-//		REG(RB_MRT_FLAG_BUFFER[0].ADDR_LO, reg_gpuaddr_lo),
-//		REG(RB_MRT_FLAG_BUFFER[0].ADDR_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_MRT_FLAG_BUFFER[1].ADDR_LO, reg_gpuaddr_lo),
-//		REG(RB_MRT_FLAG_BUFFER[1].ADDR_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_MRT_FLAG_BUFFER[2].ADDR_LO, reg_gpuaddr_lo),
-//		REG(RB_MRT_FLAG_BUFFER[2].ADDR_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_MRT_FLAG_BUFFER[3].ADDR_LO, reg_gpuaddr_lo),
-//		REG(RB_MRT_FLAG_BUFFER[3].ADDR_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_MRT_FLAG_BUFFER[4].ADDR_LO, reg_gpuaddr_lo),
-//		REG(RB_MRT_FLAG_BUFFER[4].ADDR_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_MRT_FLAG_BUFFER[5].ADDR_LO, reg_gpuaddr_lo),
-//		REG(RB_MRT_FLAG_BUFFER[5].ADDR_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_MRT_FLAG_BUFFER[6].ADDR_LO, reg_gpuaddr_lo),
-//		REG(RB_MRT_FLAG_BUFFER[6].ADDR_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_MRT_FLAG_BUFFER[7].ADDR_LO, reg_gpuaddr_lo),
-//		REG(RB_MRT_FLAG_BUFFER[7].ADDR_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_BLIT_FLAG_DST_LO, reg_gpuaddr_lo),
-//		REG(RB_BLIT_FLAG_DST_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_MRT[0].BASE_LO, reg_gpuaddr_lo),
-//		REG(RB_MRT[0].BASE_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_DEPTH_BUFFER_BASE_LO, reg_gpuaddr_lo),
-//		REG(RB_DEPTH_BUFFER_BASE_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_DEPTH_FLAG_BUFFER_BASE_LO, reg_gpuaddr_lo),
-//		REG(RB_DEPTH_FLAG_BUFFER_BASE_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_BLIT_DST_LO, reg_gpuaddr_lo),
-//		REG(RB_BLIT_DST_HI, reg_dump_gpuaddr_hi),
-
-//		REG(RB_2D_SRC_LO, reg_gpuaddr_lo),
-//		REG(RB_2D_SRC_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_2D_SRC_FLAGS_LO, reg_gpuaddr_lo),
-//		REG(RB_2D_SRC_FLAGS_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_2D_DST_LO, reg_gpuaddr_lo),
-//		REG(RB_2D_DST_HI, reg_dump_gpuaddr_hi),
-//		REG(RB_2D_DST_FLAGS_LO, reg_gpuaddr_lo),
-//		REG(RB_2D_DST_FLAGS_HI, reg_dump_gpuaddr_hi),
-
-		{NULL},
-}, *type0_reg;
-
-static bool initialized = false;
-static struct rnn *rnn;
-
-static void init_rnn(const char *gpuname)
-{
-	rnn = rnn_new(no_color);
-
-	rnn_load(rnn, gpuname);
-
-	initialized = true;
-
-	if (querystrs) {
-		int i;
-		queryvals = calloc(nquery, sizeof(queryvals[0]));
+	query_rnn = cffdec_rnn(dec);
 
-		for (i = 0; i < nquery; i++) {
-			int val = strtol(querystrs[i], NULL, 0);
+	free(queryvals);
+	queryvals = calloc(nquery, sizeof(queryvals[0]));
 
-			if (val == 0)
-				val = regbase(querystrs[i]);
+	for (i = 0; i < nquery; i++) {
+		int val = strtol(querystrs[i], NULL, 0);
 
-			queryvals[i] = val;
-			printf("querystr: %s -> 0x%x\n", querystrs[i], queryvals[i]);
-		}
-	}
+		if (val == 0)
+			val = regbase(querystrs[i]);
 
-	for (unsigned idx = 0; type0_reg[idx].regname; idx++) {
-		type0_reg[idx].regbase = regbase(type0_reg[idx].regname);
-		if (!type0_reg[idx].regbase) {
-			printf("invalid register name: %s\n", type0_reg[idx].regname);
-			exit(1);
-		}
+		queryvals[i] = val;
+		printf("querystr: %s -> 0x%x\n", querystrs[i], queryvals[i]);
 	}
 }
 
-static void init_a2xx(void)
+static const char *regname(uint32_t regbase, int color)
 {
-	if (type0_reg == reg_a2xx)
-		return;
-	type0_reg = reg_a2xx;
-	init_rnn("a2xx");
-}
+	struct profile_timer t;
+	const char *name;
 
-static void init_a3xx(void)
-{
-	if (type0_reg == reg_a3xx)
-		return;
-	type0_reg = reg_a3xx;
-	init_rnn("a3xx");
-}
+	profile_start(&t);
+	name = rnn_regname(cffdec_rnn(dec), regbase, color);
+	profile_stop(&t, PROFILE_RNN);
 
-static void init_a4xx(void)
-{
-	if (type0_reg == reg_a4xx)
-		return;
-	type0_reg = reg_a4xx;
-	init_rnn("a4xx");
+	return name;
 }
 
-static void init_a5xx(void)
+static uint32_t regbase(const char *name)
 {
-	if (type0_reg == reg_a5xx)
-		return;
-	type0_reg = reg_a5xx;
-	init_rnn("a5xx");
-}
+	struct profile_timer t;
+	uint32_t regbase;
 
-static void init(void)
-{
-	if (!initialized) {
-		/* default to a2xx so we can still parse older rd files prior to RD_GPU_ID */
-		init_a2xx();
-	}
-}
+	profile_start(&t);
+	regbase = rnn_regbase(cffdec_rnn(dec), name);
+	profile_stop(&t, PROFILE_RNN);
 
-static const char *regname(uint32_t regbase, int color)
-{
-	init();
-	return rnn_regname(rnn, regbase, color);
+	return regbase;
 }
 
-static uint32_t regbase(const char *name)
+static void dump_register_val(uint32_t regbase, uint32_t dword, int level)
 {
-	init();
-	return rnn_regbase(rnn, name);
-}
+	struct rnn *rnn = cffdec_rnn(dec);
+	const struct rnnreg *info;
+	struct profile_timer t;
 
-static int endswith(uint32_t regbase, const char *suffix)
-{
-	const char *name = regname(regbase, 0);
-	const char *s = strstr(name, suffix);
-	if (!s)
-		return 0;
-	return (s - strlen(name) + strlen(suffix)) == name;
-}
+	if (prepass)
+		return;
 
-static void dump_register_val(uint32_t regbase, uint32_t dword, int level)
-{
-	struct rnndecaddrinfo *info = rnn_reginfo(rnn, regbase);
+	profile_start(&t);
+	info = rnn_lookupreg(rnn, regbase);
+	profile_stop(&t, PROFILE_RNN);
 
-	if (info && info->typeinfo) {
+	if (info->name && info->typeinfo) {
 		uint64_t gpuaddr = 0;
-		char *decoded = rnndec_decodeval(rnn->vc, info->typeinfo, dword, info->width);
-		printf("%s%s: %s", levels[level], info->name, decoded);
+		char *decoded;
+
+		profile_start(&t);
+		decoded = rnndec_decodeval(rnn->vc, info->typeinfo, dword, info->width);
+		profile_stop(&t, PROFILE_RNN);
+		out_str(levels[level]);
+		out_str(info->name);
+		out_str(": ");
+		out_str(decoded);
 
 		/* Try and figure out if we are looking at a gpuaddr.. this
 		 * might be useful for other gen's too, but at least a5xx has
-		 * the _HI/_LO suffix we can look for.  Maybe a better approach
-		 * would be some special annotation in the xml..
+		 * the _HI/_LO suffix we can look for.
 		 */
 		if (gpu_id >= 500) {
-			if (endswith(regbase, "_HI") && endswith(regbase-1, "_LO")) {
+			if (info->flags & RNN_REG_ADDR_HI) {
 				gpuaddr = (((uint64_t)dword) << 32) | reg_val(regbase-1);
-			} else if (endswith(regbase, "_LO") && endswith(regbase+1, "_HI")) {
+			} else if (info->flags & RNN_REG_ADDR_LO) {
 				gpuaddr = (((uint64_t)reg_val(regbase+1)) << 32) | dword;
 			}
 		}
@@ -1042,35 +694,73 @@ static void dump_register_val(uint32_t regbase, uint32_t dword, int level)
 					hostlen(gpubaseaddr(gpuaddr)));
 		}
 
-		printf("\n");
+		putchar('\n');
 
 		free(decoded);
-	} else if (info) {
-		printf("%s%s: %08x\n", levels[level], info->name, dword);
-
 	} else {
-		printf("%s<%04x>: %08x\n", levels[level], regbase, dword);
-	}
+		char line[32], *p = line;
 
-	if (info) {
-		free(info->name);
-		free(info);
+		out_str(levels[level]);
+		if (info->name) {
+			out_str(info->name);
+		} else {
+			*(p++) = '<';
+			p = out_fmt_hex(p, regbase, 4);
+			*(p++) = '>';
+		}
+		*(p++) = ':';
+		*(p++) = ' ';
+		p = out_fmt_hex(p, dword, 8);
+		*(p++) = '\n';
+		out_write(line, p);
 	}
 }
 
 static void dump_register(uint32_t regbase, uint32_t dword, int level)
 {
-	init();
+	const struct cffdec_reg *reg;
 
 	if (!quiet(3)) {
 		dump_register_val(regbase, dword, level);
 	}
 
-	for (unsigned idx = 0; type0_reg[idx].regname; idx++) {
-		if (type0_reg[idx].regbase == regbase) {
-			type0_reg[idx].fxn(type0_reg[idx].regname, dword, level);
-			break;
-		}
+	reg = cffdec_special_reg(dec, regbase);
+	if (!reg)
+		return;
+
+	switch (reg->kind) {
+	case CFFDEC_REG_SCRATCH:
+		reg_dump_scratch(level);
+		break;
+	case CFFDEC_REG_SCRATCH5:
+		reg_dump_scratch5(level);
+		break;
+	case CFFDEC_REG_VSC_PIPE_LENGTH:
+		reg_vsc_pipe_data_length(reg->idx, dword, level);
+		break;
+	case CFFDEC_REG_VFD_FETCH_INSTR_1:
+		reg_vfd_fetch_instr_1_x(reg->idx, dword, level);
+		break;
+	case CFFDEC_REG_GPUADDR:
+		dump_gpuaddr(dword, level);
+		break;
+	case CFFDEC_REG_GPUADDR_LO:
+		gpuaddr_lo = dword;
+		break;
+	case CFFDEC_REG_GPUADDR_HI:
+	case CFFDEC_REG_TEX_CONST_HI:   // XXX TODO
+	case CFFDEC_REG_TEX_SAMP_HI:    // XXX TODO
+		dump_gpuaddr(gpuaddr_lo | (((uint64_t)dword) << 32), level);
+		break;
+	case CFFDEC_REG_SHADER:
+		disasm_gpuaddr(reg->name, dword, level);
+		break;
+	case CFFDEC_REG_SHADER_HI:
+		disasm_gpuaddr(reg->name, gpuaddr_lo | (((uint64_t)dword) << 32),
+				level);
+		break;
+	default:
+		break;
 	}
 }
 
@@ -1079,40 +769,33 @@ static bool is_banked_reg(uint32_t regbase)
 	return (0x2000 <= regbase) && (regbase < 0x2400);
 }
 
-static void dump_registers(uint32_t regbase,
-		uint32_t *dwords, uint32_t sizedwords, int level)
+static void dump_write(uint32_t regbase, uint32_t dword, int level)
 {
-	while (sizedwords--) {
-		int last_summary = summary;
-
-		/* access to non-banked registers needs a WFI:
-		 * TODO banked register range for a2xx??
-		 */
-		if (needs_wfi && !is_banked_reg(regbase))
-			printl(2, "NEEDS WFI: %s (%x)\n", regname(regbase, 1), regbase);
+	/* access to non-banked registers needs a WFI:
+	 * TODO banked register range for a2xx??
+	 */
+	if (walker_state()->needs_wfi && !is_banked_reg(regbase))
+		printl(2, "NEEDS WFI: %s (%x)\n", regname(regbase, 1), regbase);
 
-		reg_set(regbase, *dwords);
-		dump_register(regbase, *dwords, level);
-		regbase++;
-		dwords++;
-		summary = last_summary;
-	}
+	dump_register(regbase, dword, level);
 }
 
 static void dump_domain(uint32_t *dwords, uint32_t sizedwords, int level,
 		const char *name)
 {
+	struct rnn *rnn = cffdec_rnn(dec);
 	struct rnndomain *dom;
+	struct profile_timer t;
 	int i;
 
-	init();
+	if (prepass)
+		return;
 
-	dom = rnn_finddomain(rnn->db, name);
+	profile_start(&t);
 
-	if (!dom)
-		return;
+	dom = rnn_finddomain(rnn->db, name);
 
-	for (i = 0; i < sizedwords; i++) {
+	for (i = 0; dom && (i < sizedwords); i++) {
 		struct rnndecaddrinfo *info = rnndec_decodeaddr(rnn->vc, dom, i, 0);
 		char *decoded;
 		if (!(info && info->typeinfo))
@@ -1123,44 +806,41 @@ static void dump_domain(uint32_t *dwords, uint32_t sizedwords, int level,
 		free(info->name);
 		free(info);
 	}
-}
-
 
-static uint32_t bin_x1, bin_x2, bin_y1, bin_y2;
-static unsigned mode;
-static unsigned render_mode;
+	profile_stop(&t, PROFILE_RNN);
+}
 
 static const char *mode_name(unsigned render_mode)
 {
-	return rnn_enumname(rnn, "render_mode_cmd", render_mode);
+	return rnn_enumtab_name(cffdec_enums(dec)->render_mode_cmd, render_mode);
 }
 
 /* well, actually query and script..
  * NOTE: call this before dump_register_summary()
  */
+/* for --export, the draw that the next register summary is for: */
+static const char *query_primtype;
+static uint32_t query_num_indices;
+
 static void do_query(const char *primtype, uint32_t num_indices)
 {
+	const struct cffdec_state *state = walker_state();
 	int i;
 	int n = 0;
 
-	if ((500 <= gpu_id) && (gpu_id < 600)) {
-		uint32_t scissor_tl = reg_val(regbase("GRAS_SC_WINDOW_SCISSOR_TL"));
-		uint32_t scissor_br = reg_val(regbase("GRAS_SC_WINDOW_SCISSOR_BR"));
-
-		bin_x1 = scissor_tl & 0xffff;
-		bin_y1 = scissor_tl >> 16;
-		bin_x2 = scissor_br & 0xffff;
-		bin_y2 = scissor_br >> 16;
-	}
+	query_primtype = primtype;
+	query_num_indices = num_indices;
 
 	for (i = 0; i < nquery; i++) {
 		uint32_t regbase = queryvals[i];
 		if (reg_written(regbase)) {
 			uint32_t lastval = reg_val(regbase);
-			printf("%4d: %s(%u,%u-%u,%u):%u:", draw_count, primtype,
-					bin_x1, bin_y1, bin_x2, bin_y2, num_indices);
+			printf("%4d: %s(%u,%u-%u,%u):%u:", state->draw_count, primtype,
+					state->bin_x1, state->bin_y1,
+					state->bin_x2, state->bin_y2, num_indices);
 			if (gpu_id >= 500)
-				printf("m%d:%s:", render_mode, mode_name(render_mode));
+				printf("m%d:%s:", state->render_mode,
+						mode_name(state->render_mode));
 			printf("\t%08x", lastval);
 			if (lastval != lastvals[regbase]) {
 				printf("!");
@@ -1180,8 +860,15 @@ static void do_query(const char *primtype, uint32_t num_indices)
 	if (n > 1)
 		printf("\n");
 
-	if (num_indices > 0)
-		script_draw(primtype, num_indices);
+	if (num_indices > 0) {
+		if (scripting())
+			script_draw(primtype, num_indices);
+		/* with --jobs, workers' copies of the results are discarded,
+		 * the parent sees every draw:
+		 */
+		if (analyze)
+			analyze_draw(primtype, gpu_id);
+	}
 }
 
 static void cp_im_loadi(uint32_t *dwords, uint32_t sizedwords, int level)
@@ -1207,24 +894,13 @@ static void cp_im_loadi(uint32_t *dwords, uint32_t sizedwords, int level)
 	}
 
 	printf("%s%s shader, start=%04x, size=%04x\n", levels[level], type, start, size);
-	disasm_a2xx(dwords + 2, sizedwords - 2, level+2, disasm_type);
 
-	/* dump raw shader: */
-	if (ext)
+	/* disassemble, and dump raw shader: */
+	if (disasm_shader(dwords + 2, sizedwords - 2, ext, disasm_a2xx,
+			disasm_type, level+2) && ext)
 		dump_shader(ext, dwords + 2, (sizedwords - 2) * 4);
 }
 
-static void cp_wide_reg_write(uint32_t *dwords, uint32_t sizedwords, int level)
-{
-	uint32_t reg = dwords[0] & 0xffff;
-	int i;
-	for (i = 1; i < sizedwords; i++) {
-		dump_register(reg, dwords[i], level+1);
-		reg_set(reg, dwords[i]);
-		reg++;
-	}
-}
-
 enum state_t {
 	TEX_SAMP = 1,
 	TEX_CONST,
@@ -1243,6 +919,30 @@ enum state_t {
 	UNKNOWN_4DWORDS,
 };
 
+/* for script hooks: */
+static const char *state_names[] = {
+	[TEX_SAMP]        = "TEX_SAMP",
+	[TEX_CONST]       = "TEX_CONST",
+	[TEX_MIPADDR]     = "TEX_MIPADDR",
+	[SHADER_PROG]     = "SHADER_PROG",
+	[SHADER_CONST]    = "SHADER_CONST",
+	[SSBO_0]          = "SSBO_0",
+	[SSBO_1]          = "SSBO_1",
+	[SSBO_2]          = "SSBO_2",
+	[UNKNOWN_DWORDS]  = "UNKNOWN_DWORDS",
+	[UNKNOWN_2DWORDS] = "UNKNOWN_2DWORDS",
+	[UNKNOWN_4DWORDS] = "UNKNOWN_4DWORDS",
+};
+
+static const char *stage_names[] = {
+	[SHADER_VERTEX]   = "VERTEX",
+	[SHADER_TCS]      = "TCS",
+	[SHADER_TES]      = "TES",
+	[SHADER_GEOM]     = "GEOM",
+	[SHADER_FRAGMENT] = "FRAGMENT",
+	[SHADER_COMPUTE]  = "COMPUTE",
+};
+
 /* TODO there is probably a clever way to let rnndec parse things so
  * we don't have to care about packet format differences across gens
  */
@@ -1341,7 +1041,7 @@ static void cp_load_state(uint32_t *dwords, uint32_t sizedwords, int level)
 	void *contents = NULL;
 	int i;
 
-	if (quiet(2))
+	if (quiet(2) && !scripting())
 		return;
 
 	if (gpu_id >= 400)
@@ -1358,6 +1058,16 @@ static void cp_load_state(uint32_t *dwords, uint32_t sizedwords, int level)
 		contents = dwords + 2;
 	}
 
+	if (scripting()) {
+		script_state_load(
+				(stage < ARRAY_SIZE(stage_names)) ? stage_names[stage] : NULL,
+				(state < ARRAY_SIZE(state_names)) ? state_names[state] : NULL,
+				dwords[0] & 0xffff, num_unit, ext_src_addr);
+	}
+
+	if (quiet(2))
+		return;
+
 	/* we could either have a ptr to other gpu buffer, or directly have
 	 * contents inline:
 	 */
@@ -1391,11 +1101,9 @@ static void cp_load_state(uint32_t *dwords, uint32_t sizedwords, int level)
 			ext = "fo3";
 		}
 
-		if (contents)
-			disasm_a3xx(contents, num_unit * 2, level+2, 0);
-
-		/* dump raw shader: */
-		if (ext)
+		/* disassemble, and dump raw shader: */
+		if (disasm_shader(contents, num_unit * 2, ext, disasm_a3xx, 0,
+				level+2) && ext)
 			dump_shader(ext, contents, num_unit * 2 * 4);
 
 		break;
@@ -1549,14 +1257,6 @@ static void cp_load_state(uint32_t *dwords, uint32_t sizedwords, int level)
 	}
 }
 
-static void cp_set_bin(uint32_t *dwords, uint32_t sizedwords, int level)
-{
-	bin_x1 = dwords[1] & 0xffff;
-	bin_y1 = dwords[1] >> 16;
-	bin_x2 = dwords[2] & 0xffff;
-	bin_y2 = dwords[2] >> 16;
-}
-
 static void dump_tex_const(uint32_t *dwords, uint32_t sizedwords, uint32_t val, int level)
 {
 	uint32_t w, h, p;
@@ -1675,54 +1375,153 @@ static void cp_set_const(uint32_t *dwords, uint32_t sizedwords, int level)
 
 			/* TODO: not sure what happens w/ payload != 2.. */
 			assert(sizedwords == 3);
-			assert(srcreg < ARRAY_SIZE(type0_reg_vals));
+			assert(srcreg < CFFDEC_MAXREGS);
 
 			/* note: rnn_regname uses a static buf so we can't do
 			 * two regname() calls for one printf..
 			 */
 			printf("%s%s = %08x + ", levels[level], regname(val, 1), dstval);
-			printf("%s (%08x)\n", regname(srcreg, 1), type0_reg_vals[srcreg]);
-
-			dstval += type0_reg_vals[srcreg];
-
-			dump_registers(val, &dstval, 1, level+1);
-		} else {
-			dump_registers(val, dwords+1, sizedwords-1, level+1);
+			printf("%s (%08x)\n", regname(srcreg, 1), reg_val(srcreg));
 		}
+		/* the registers are printed as they are written */
 		break;
 	}
 }
 
-static void dump_register_summary(int level);
+/*
+ * Columnar export (--export), one row per register summary:
+ */
 
-static void cp_event_write(uint32_t *dwords, uint32_t sizedwords, int level)
+enum {
+	EXPORT_SUBMIT,
+	EXPORT_PRIMTYPE,
+	EXPORT_NUM_INDICES,
+	EXPORT_RENDER_MODE,
+	EXPORT_BIN_X1,
+	EXPORT_BIN_Y1,
+	EXPORT_BIN_X2,
+	EXPORT_BIN_Y2,
+};
+
+static struct colfile_writer *export_w;
+static int export_cols[CFFDEC_MAXREGS];   /* column + 1, for each reg */
+static int export_submit;
+
+static void export_start(void)
+{
+	export_w = colfile_writer_new();
+	memset(export_cols, 0, sizeof(export_cols));
+
+	colfile_add_column(export_w, "submit", COLFILE_NOREG, 0);
+	colfile_add_column(export_w, "primtype", COLFILE_NOREG, COLFILE_STRING);
+	colfile_add_column(export_w, "num_indices", COLFILE_NOREG, 0);
+	colfile_add_column(export_w, "render_mode", COLFILE_NOREG, 0);
+	colfile_add_column(export_w, "bin_x1", COLFILE_NOREG, 0);
+	colfile_add_column(export_w, "bin_y1", COLFILE_NOREG, 0);
+	colfile_add_column(export_w, "bin_x2", COLFILE_NOREG, 0);
+	colfile_add_column(export_w, "bin_y2", COLFILE_NOREG, 0);
+}
+
+static void export_row(void)
+{
+	const struct cffdec_state *state = walker_state();
+	const uint32_t *regs;
+	uint32_t i, n;
+
+	if (!export_w)
+		return;
+
+	colfile_set(export_w, EXPORT_SUBMIT, export_submit);
+	colfile_set_string(export_w, EXPORT_PRIMTYPE, query_primtype);
+	colfile_set(export_w, EXPORT_NUM_INDICES, query_num_indices);
+	colfile_set(export_w, EXPORT_RENDER_MODE, state->render_mode);
+	colfile_set(export_w, EXPORT_BIN_X1, state->bin_x1);
+	colfile_set(export_w, EXPORT_BIN_Y1, state->bin_y1);
+	colfile_set(export_w, EXPORT_BIN_X2, state->bin_x2);
+	colfile_set(export_w, EXPORT_BIN_Y2, state->bin_y2);
+
+	/* registers keep their value from the previous row, so only the
+	 * ones written since then need to be updated:
+	 */
+	n = reg_rewritten_list(&regs);
+	for (i = 0; i < n; i++) {
+		uint32_t regbase = regs[i];
+
+		if (!export_cols[regbase]) {
+			const char *name = regname(regbase, 0);
+			char buf[16];
+
+			if (!name) {
+				snprintf(buf, sizeof(buf), "<%04x>", regbase);
+				name = buf;
+			}
+
+			export_cols[regbase] = 1 +
+				colfile_add_column(export_w, name, regbase, 0);
+		}
+
+		colfile_set(export_w, export_cols[regbase] - 1, reg_val(regbase));
+	}
+
+	colfile_end_row(export_w);
+}
+
+static void export_finish(const char *filename)
+{
+	char *path;
+
+	if (!export_w)
+		return;
+
+	path = malloc(strlen(filename) + 6);
+	sprintf(path, "%s.cols", filename);
+	if (colfile_save(export_w, path, gpu_id))
+		fprintf(stderr, "could not write: %s\n", path);
+	free(path);
+
+	colfile_writer_free(export_w);
+	export_w = NULL;
+}
+
+static void cp_event_write(uint32_t *dwords, uint32_t sizedwords, int level)
 {
-	const char *name = rnn_enumname(rnn, "vgt_event_type", dwords[0]);
+	const char *name = rnn_enumtab_name(cffdec_enums(dec)->vgt_event_type,
+			dwords[0]);
 	printl(2, "%sevent %s\n", levels[level], name);
 
+	if (scripting())
+		script_event(dwords[0], name);
+
 	if (name && (gpu_id > 500)) {
 		char eventname[64];
 		snprintf(eventname, sizeof(eventname), "EVENT:%s", name);
-		if (!strcmp(name, "BLIT")) {
+		if (!strcmp(name, "BLIT"))
 			do_query(eventname, 0);
-			dump_register_summary(level);
-		}
 	}
 }
 
 static void dump_register_summary(int level)
 {
-	uint32_t i;
+	const uint32_t *regs = NULL;
+	uint32_t i, n;
 	bool saved_summary = summary;
 	summary = false;
 
+	/* unless we want all registers, only look at the ones which have
+	 * been updated since last draw/blit:
+	 */
+	if (allregs)
+		n = regcnt();
+	else
+		n = reg_rewritten_list(&regs);
+
 	/* dump current state of registers: */
-	printl(2, "%sdraw[%i] register values\n", levels[level], draw_count);
-	for (i = 0; i < regcnt(); i++) {
-		uint32_t regbase = i;
+	printl(2, "%sdraw[%i] register values\n", levels[level],
+			walker_state()->draw_count);
+	for (i = 0; i < n; i++) {
+		uint32_t regbase = regs ? regs[i] : i;
 		uint32_t lastval = reg_val(regbase);
-		/* skip registers that haven't been updated since last draw/blit: */
-		if (!(allregs || reg_rewritten(regbase)))
+		if (regbase >= regcnt())
 			continue;
 		if (!reg_written(regbase))
 			continue;
@@ -1743,9 +1542,10 @@ static void dump_register_summary(int level)
 		}
 	}
 
-	clear_rewritten();
+	export_row();
 
-	draw_count++;
+	if (profile_enabled)
+		profile_totals.draws++;
 	summary = saved_summary;
 }
 
@@ -1754,29 +1554,28 @@ static uint32_t draw_indx_common(uint32_t *dwords, int level)
 	uint32_t prim_type     = dwords[1] & 0x1f;
 	uint32_t source_select = (dwords[1] >> 6) & 0x3;
 	uint32_t num_indices   = dwords[2];
+	const struct cffdec_state *state = walker_state();
 	const char *primtype;
 
-	primtype = rnn_enumname(rnn, "pc_di_primtype", prim_type);
+	primtype = rnn_enumtab_name(cffdec_enums(dec)->pc_di_primtype, prim_type);
 
 	do_query(primtype, num_indices);
 
-	printl(2, "%sdraw:          %d\n", levels[level], draws[ib]);
+	printl(2, "%sdraw:          %d\n", levels[level], state->draws[state->ib]);
 	printl(2, "%sprim_type:     %s (%d)\n", levels[level], primtype,
 			prim_type);
 	printl(2, "%ssource_select: %s (%d)\n", levels[level],
-			rnn_enumname(rnn, "pc_di_src_sel", source_select),
+			rnn_enumtab_name(cffdec_enums(dec)->pc_di_src_sel, source_select),
 			source_select);
 	printl(2, "%snum_indices:   %d\n", levels[level], num_indices);
 
 	vertices += num_indices;
 
-	draws[ib]++;
-
 	return num_indices;
 }
 static void cp_draw_indx(uint32_t *dwords, uint32_t sizedwords, int level)
 {
-	uint32_t num_indices = draw_indx_common(dwords, level);
+	draw_indx_common(dwords, level);
 
 	assert(!is_64b());
 
@@ -1809,12 +1608,6 @@ static void cp_draw_indx(uint32_t *dwords, uint32_t sizedwords, int level)
 			}
 		}
 	}
-
-	/* don't bother dumping registers for the dummy draw_indx's.. */
-	if (num_indices > 0)
-		dump_register_summary(level);
-
-	needs_wfi = true;
 }
 
 static void cp_draw_indx_2(uint32_t *dwords, uint32_t sizedwords, int level)
@@ -1850,10 +1643,6 @@ static void cp_draw_indx_2(uint32_t *dwords, uint32_t sizedwords, int level)
 		printf("\n");
 		dump_hex(ptr, sz / 4, level+1);
 	}
-
-	/* don't bother dumping registers for the dummy draw_indx's.. */
-	if (num_indices > 0)
-		dump_register_summary(level);
 }
 
 static void cp_draw_indx_offset(uint32_t *dwords, uint32_t sizedwords, int level)
@@ -1861,15 +1650,13 @@ static void cp_draw_indx_offset(uint32_t *dwords, uint32_t sizedwords, int level
 	uint32_t num_indices = dwords[2];
 	uint32_t prim_type = dwords[0] & 0x1f;
 
-	do_query(rnn_enumname(rnn, "pc_di_primtype", prim_type), num_indices);
+	do_query(rnn_enumtab_name(cffdec_enums(dec)->pc_di_primtype, prim_type),
+			num_indices);
 
 	if ((gpu_id >= 500) && !quiet(2)) {
-		printf("%smode: %s\n", levels[level], mode_name(render_mode));
+		printf("%smode: %s\n", levels[level],
+				mode_name(walker_state()->render_mode));
 	}
-
-	/* don't bother dumping registers for the dummy draw_indx's.. */
-	if (num_indices > 0)
-		dump_register_summary(level);
 }
 
 static void cp_draw_indx_indirect(uint32_t *dwords, uint32_t sizedwords, int level)
@@ -1877,10 +1664,11 @@ static void cp_draw_indx_indirect(uint32_t *dwords, uint32_t sizedwords, int lev
 	uint32_t prim_type = dwords[0] & 0x1f;
 	uint64_t addr;
 
-	do_query(rnn_enumname(rnn, "pc_di_primtype", prim_type), 0);
+	do_query(rnn_enumtab_name(cffdec_enums(dec)->pc_di_primtype, prim_type), 0);
 
 	if ((gpu_id >= 500) && !quiet(2)) {
-		printf("%smode: %s\n", levels[level], mode_name(render_mode));
+		printf("%smode: %s\n", levels[level],
+				mode_name(walker_state()->render_mode));
 	}
 
 	if (is_64b())
@@ -1894,8 +1682,6 @@ static void cp_draw_indx_indirect(uint32_t *dwords, uint32_t sizedwords, int lev
 	else
 		addr = dwords[3];
 	dump_gpuaddr_size(addr, level, 0x10, 2);
-
-	dump_register_summary(level);
 }
 
 static void cp_draw_indirect(uint32_t *dwords, uint32_t sizedwords, int level)
@@ -1903,22 +1689,20 @@ static void cp_draw_indirect(uint32_t *dwords, uint32_t sizedwords, int level)
 	uint32_t prim_type = dwords[0] & 0x1f;
 	uint64_t addr;
 
-	do_query(rnn_enumname(rnn, "pc_di_primtype", prim_type), 0);
+	do_query(rnn_enumtab_name(cffdec_enums(dec)->pc_di_primtype, prim_type), 0);
 
 	if ((gpu_id >= 500) && !quiet(2)) {
-		printf("%smode: %s\n", levels[level], mode_name(render_mode));
+		printf("%smode: %s\n", levels[level],
+				mode_name(walker_state()->render_mode));
 	}
 
 	addr = (((uint64_t)dwords[2] & 0x1ffff) << 32) | dwords[1];
 	dump_gpuaddr_size(addr, level, 0x10, 2);
-
-	dump_register_summary(level);
 }
 
 static void cp_run_cl(uint32_t *dwords, uint32_t sizedwords, int level)
 {
 	do_query("COMPUTE", 1);
-	dump_register_summary(level);
 }
 
 static void cp_nop(uint32_t *dwords, uint32_t sizedwords, int level)
@@ -1944,57 +1728,6 @@ static void cp_nop(uint32_t *dwords, uint32_t sizedwords, int level)
 	printf("\n");
 }
 
-static void cp_indirect(uint32_t *dwords, uint32_t sizedwords, int level)
-{
-	/* traverse indirect buffers */
-	int i;
-	uint64_t ibaddr;
-	uint32_t ibsize;
-	uint32_t *ptr = NULL;
-
-	if (is_64b()) {
-		/* a5xx+.. high 32b of gpu addr, then size: */
-		ibaddr = dwords[0];
-		ibaddr |= ((uint64_t)dwords[1]) << 32;
-		ibsize = dwords[2];
-	} else {
-		ibaddr = dwords[0];
-		ibsize = dwords[1];
-	}
-
-	if (!quiet(3)) {
-		if (is_64b()) {
-			printf("%sibaddr:%016lx\n", levels[level], ibaddr);
-		} else {
-			printf("%sibaddr:%08x\n", levels[level], (uint32_t)ibaddr);
-		}
-		printf("%sibsize:%08x\n", levels[level], ibsize);
-	} else {
-		level--;
-	}
-
-	/* map gpuaddr back to hostptr: */
-	for (i = 0; i < nbuffers; i++) {
-		if (buffer_contains_gpuaddr(&buffers[i], ibaddr, ibsize)) {
-			ptr = buffers[i].hostptr + (ibaddr - buffers[i].gpuaddr);
-			break;
-		}
-	}
-
-	if (ptr) {
-		ib++;
-		dump_commands(ptr, ibsize, level);
-		ib--;
-	} else {
-		fprintf(stderr, "could not find: %016lx (%d)\n", ibaddr, ibsize);
-	}
-}
-
-static void cp_wfi(uint32_t *dwords, uint32_t sizedwords, int level)
-{
-	needs_wfi = false;
-}
-
 static void cp_mem_write(uint32_t *dwords, uint32_t sizedwords, int level)
 {
 
@@ -2018,9 +1751,8 @@ static void cp_rmw(uint32_t *dwords, uint32_t sizedwords, int level)
 	uint32_t and = dwords[1];
 	uint32_t or  = dwords[2];
 	printl(3, "%srmw (%s & 0x%08x) | 0x%08x)\n", levels[level], regname(val, 1), and, or);
-	if (needs_wfi)
+	if (walker_state()->needs_wfi)
 		printl(2, "NEEDS WFI: rmw (%s & 0x%08x) | 0x%08x)\n", regname(val, 1), and, or);
-	reg_set(val, (reg_val(val) & and) | or);
 }
 
 static void cp_reg_to_mem(uint32_t *dwords, uint32_t sizedwords, int level)
@@ -2034,45 +1766,10 @@ static void cp_reg_to_mem(uint32_t *dwords, uint32_t sizedwords, int level)
 	printl(3, "%sdest: %08x\n", levels[level], mem);
 }
 
-static void cp_set_draw_state(uint32_t *dwords, uint32_t sizedwords, int level)
-{
-	uint32_t i;
-
-	for (i = 0; i < sizedwords; ) {
-		uint32_t count = dwords[i] & 0xffff;
-		uint64_t addr;
-		uint32_t *ptr;
-
-		if (is_64b()) {
-			addr = dwords[i + 1];
-			addr |= ((uint64_t)dwords[i + 2]) << 32;
-			i += 3;
-		} else {
-			addr = dwords[i + 1];
-			i += 2;
-		}
-
-		ptr = hostptr(addr);
-
-		printl(3, "%scount: %d\n", levels[level], count);
-		printl(3, "%saddr: %016llx\n", levels[level], addr);
-
-		if (ptr) {
-			if (!quiet(2))
-				dump_hex(ptr, count, level+1);
-
-			ib++;
-			dump_commands(ptr, count, level+1);
-			ib--;
-		}
-	}
-}
-
 /* execute compute shader */
 static void cp_exec_cs(uint32_t *dwords, uint32_t sizedwords, int level)
 {
 	do_query("compute", 0);
-	dump_register_summary(level);
 }
 
 static void cp_exec_cs_indirect(uint32_t *dwords, uint32_t sizedwords, int level)
@@ -2089,13 +1786,12 @@ static void cp_exec_cs_indirect(uint32_t *dwords, uint32_t sizedwords, int level
 	dump_gpuaddr_size(addr, level, 0x10, 2);
 
 	do_query("compute", 0);
-	dump_register_summary(level);
 }
 
 static void cp_set_render_mode(uint32_t *dwords, uint32_t sizedwords, int level)
 {
 	uint64_t addr;
-	uint32_t *ptr, len;
+	uint32_t len;
 
 	assert(is_64b());
 
@@ -2121,16 +1817,12 @@ static void cp_set_render_mode(uint32_t *dwords, uint32_t sizedwords, int level)
 
 	assert(gpu_id >= 500);
 
-	render_mode = dwords[0];
-
 	if (sizedwords == 1)
 		return;
 
 	addr = dwords[1];
 	addr |= ((uint64_t)dwords[2]) << 32;
 
-	mode = dwords[3];
-
 	printl(3, "%saddr: 0x%016lx\n", levels[level], addr);
 	printl(3, "%slen:  0x%x\n", levels[level], len);
 
@@ -2148,52 +1840,26 @@ static void cp_set_render_mode(uint32_t *dwords, uint32_t sizedwords, int level)
 	printl(3, "%saddr: 0x%016lx\n", levels[level], addr);
 	printl(3, "%slen:  0x%x\n", levels[level], len);
 
-	ptr = hostptr(addr);
-
-	if (ptr) {
-		if (!quiet(2)) {
-			ib++;
-			dump_commands(ptr, len, level+1);
-			ib--;
-			dump_hex(ptr, len, level+1);
-		}
-	}
+	/* the IB itself is decoded by the walker, see dec_ib() */
 }
 
 static void cp_blit(uint32_t *dwords, uint32_t sizedwords, int level)
 {
-	do_query(rnn_enumname(rnn, "cp_blit_cmd", dwords[0]), 0);
-	dump_register_summary(level);
-}
-
-static void cp_context_reg_bunch(uint32_t *dwords, uint32_t sizedwords, int level)
-{
-	int i;
-
-	/* NOTE: seems to write same reg multiple times.. not sure if different parts of
-	 * these are triggered by the FLUSH_SO_n events?? (if that is what they actually
-	 * are?)
-	 */
-	bool saved_summary = summary;
-	summary = false;
-
-	for (i = 0; i < sizedwords; i += 2) {
-		dump_register(dwords[i+0], dwords[i+1], level+1);
-		reg_set(dwords[i+0], dwords[i+1]);
-	}
-
-	summary = saved_summary;
+	do_query(rnn_enumtab_name(cffdec_enums(dec)->cp_blit_cmd, dwords[0]), 0);
 }
 
+/* what is printed for each packet, before the walker handles it (IBs and
+ * register writes are printed as the walker gets to them):
+ */
 #define CP(x, fxn)   [CP_ ## x] = { fxn }
 static const struct {
 	void (*fxn)(uint32_t *dwords, uint32_t sizedwords, int level);
 } type3_op[0xff] = {
 		CP(ME_INIT, NULL),
 		CP(NOP, cp_nop),
-		CP(INDIRECT_BUFFER, cp_indirect),
-		CP(INDIRECT_BUFFER_PFD, cp_indirect),
-		CP(WAIT_FOR_IDLE, cp_wfi),
+		CP(INDIRECT_BUFFER, NULL),
+		CP(INDIRECT_BUFFER_PFD, NULL),
+		CP(WAIT_FOR_IDLE, NULL),
 		CP(WAIT_REG_MEM, NULL),
 		CP(WAIT_REG_EQ, NULL),
 		CP(WAIT_REG_GTE, NULL),
@@ -2228,7 +1894,7 @@ static const struct {
 		CP(INTERRUPT, NULL),
 		CP(IM_STORE, NULL),
 		CP(SET_PROTECTED_MODE, NULL),
-		CP(WIDE_REG_WRITE, cp_wide_reg_write),
+		CP(WIDE_REG_WRITE, NULL),
 
 		/* for a20x */
 		//CP(SET_BIN_BASE_OFFSET, NULL),
@@ -2239,10 +1905,10 @@ static const struct {
 		/* for a3xx */
 		CP(LOAD_STATE, cp_load_state),
 		CP(SET_BIN_DATA, NULL),
-		CP(SET_BIN, cp_set_bin),
+		CP(SET_BIN, NULL),
 
 		/* for a4xx */
-		CP(SET_DRAW_STATE, cp_set_draw_state),
+		CP(SET_DRAW_STATE, NULL),
 		CP(DRAW_INDX_OFFSET, cp_draw_indx_offset),
 		CP(EXEC_CS, cp_exec_cs),
 		CP(EXEC_CS_INDIRECT, cp_exec_cs_indirect),
@@ -2250,171 +1916,242 @@ static const struct {
 		/* for a5xx */
 		CP(SET_RENDER_MODE, cp_set_render_mode),
 		CP(BLIT, cp_blit),
-		CP(CONTEXT_REG_BUNCH, cp_context_reg_bunch),
+		CP(CONTEXT_REG_BUNCH, NULL),
 		CP(DRAW_INDIRECT, cp_draw_indirect),
 		CP(DRAW_INDX_INDIRECT, cp_draw_indx_indirect),
 };
 
 
-static inline uint pm4_calc_odd_parity_bit(uint val)
+/*
+ * Callbacks from the cmdstream walker:
+ */
+
+/* timers for the packets and IBs being decoded, at each level of IB: */
+static struct profile_timer op_timers[CFFDEC_MAXDEPTH];
+static struct profile_timer ib_timers[CFFDEC_MAXDEPTH];
+
+static void dec_packet(struct cffdec *dec, int type, uint32_t opcode,
+		uint32_t *dwords, uint32_t sizedwords, int level)
 {
-	return (0x9669 >> (0xf & ((val) ^
-			((val) >> 4) ^ ((val) >> 8) ^ ((val) >> 12) ^
-			((val) >> 16) ^ ((val) >> 20) ^ ((val) >> 24) ^
-			((val) >> 28)))) & 1;
+	struct rnn *rnn = cffdec_rnn(dec);
+	const char *name;
+
+	if (profile_enabled)
+		profile_totals.packets++;
+
+	current_draw_count = walker_state()->draw_count;
+
+	init_query();
+
+	switch (type) {
+	case 0:
+		printl(3, "t0");
+		printl(3, "%swrite %s%s (%04x)\n", levels[level+1], regname(opcode, 1),
+				(dwords[0] & 0x8000) ? " (same register)" : "", opcode);
+		break;
+	case 4:
+		/* basically the same(ish) as type0 prior to a5xx */
+		printl(3, "t4");
+		printl(3, "%swrite %s (%04x)\n", levels[level+1], regname(opcode, 1),
+				opcode);
+		break;
+	case 2:
+		printl(3, "t2");
+		printl(3, "%snop\n", levels[level+1]);
+		break;
+	case 3:
+	case 7:
+		printl(3, (type == 3) ? "t3" : "t7");
+		name = rnn_enumtab_name(cffdec_enums(dec)->adreno_pm4_type3_packets,
+				opcode);
+		if (!quiet(2)) {
+			printf("\t%sopcode: %s%s%s (%02x) (%d dwords)%s\n", levels[level],
+					rnn->vc->colors->bctarg, name, rnn->vc->colors->reset,
+					opcode, sizedwords,
+					((type == 3) && (dwords[0] & 0x1)) ? " (predicated)" : "");
+			if (name)
+				dump_domain(dwords+1, sizedwords-1, level+2, name);
+		}
+		if (scripting())
+			script_packet(opcode, name, dwords+1, sizedwords-1, level);
+		profile_start(&op_timers[walker_state()->ib]);
+		if (type3_op[opcode].fxn)
+			type3_op[opcode].fxn(dwords+1, sizedwords-1, level+1);
+		break;
+	}
 }
 
-#define pkt_is_type0(pkt) (((pkt) & 0XC0000000) == CP_TYPE0_PKT)
-#define type0_pkt_size(pkt) ((((pkt) >> 16) & 0x3FFF) + 1)
-#define type0_pkt_offset(pkt) ((pkt) & 0x7FFF)
+static void dec_packet_end(struct cffdec *dec, int type, uint32_t opcode,
+		uint32_t *dwords, uint32_t sizedwords, int level)
+{
+	switch (type) {
+	case 0:
+	case 4:
+		if (!quiet(3))
+			dump_hex(dwords, sizedwords, level+1);
+		break;
+	case 3:
+	case 7:
+		profile_stop(&op_timers[walker_state()->ib], PROFILE_OPCODE + opcode);
+		if (!quiet(2))
+			dump_hex(dwords, sizedwords, level+1);
+		break;
+	}
+}
 
-#define pkt_is_type2(pkt) ((pkt) == CP_TYPE2_PKT)
+static void dec_reg_write(struct cffdec *dec, uint32_t regbase, uint32_t val,
+		int level)
+{
+	const struct cffdec_state *state = walker_state();
 
-/*
- * Check both for the type3 opcode and make sure that the reserved bits [1:7]
- * and 15 are 0
- */
+	if (scripting())
+		script_reg_write(regbase, val);
+
+	/* registers written by CP_REG_RMW, or by an IB which is the same as
+	 * one already seen, aren't printed:
+	 */
+	if ((state->type == 0) || (state->type == 4)) {
+		dump_write(regbase, val, level+2);
+	} else if (state->opcode == CP_SET_CONSTANT) {
+		dump_write(regbase, val, level+2);
+	} else if (state->opcode == CP_WIDE_REG_WRITE) {
+		dump_register(regbase, val, level+2);
+	} else if (state->opcode == CP_CONTEXT_REG_BUNCH) {
+		/* NOTE: seems to write same reg multiple times.. not sure if
+		 * different parts of these are triggered by the FLUSH_SO_n
+		 * events?? (if that is what they actually are?)
+		 */
+		bool saved_summary = summary;
+		summary = false;
+		dump_register(regbase, val, level+2);
+		summary = saved_summary;
+	}
+}
+
+static void dec_draw(struct cffdec *dec, const struct cffdec_draw *draw)
+{
+	dump_register_summary(draw->level+1);
+}
 
-#define pkt_is_type3(pkt) \
-        ((((pkt) & 0xC0000000) == CP_TYPE3_PKT) && \
-         (((pkt) & 0x80FE) == 0))
+static int dec_ib(struct cffdec *dec, struct cffdec_ib *ib)
+{
+	switch (ib->opcode) {
+	case CP_INDIRECT_BUFFER:
+	case CP_INDIRECT_BUFFER_PFD:
+		if (!quiet(3)) {
+			if (is_64b()) {
+				printf("%sibaddr:%016lx\n", levels[ib->level], ib->gpuaddr);
+			} else {
+				printf("%sibaddr:%08x\n", levels[ib->level],
+						(uint32_t)ib->gpuaddr);
+			}
+			printf("%sibsize:%08x\n", levels[ib->level], ib->sizedwords);
+		} else {
+			ib->level--;
+		}
+		if (!ib->dwords) {
+			fprintf(stderr, "could not find: %016lx (%d)\n", ib->gpuaddr,
+					ib->sizedwords);
+			return 0;
+		}
+		break;
+	case CP_SET_DRAW_STATE:
+		printl(3, "%scount: %d\n", levels[ib->level], ib->sizedwords);
+		printl(3, "%saddr: %016llx\n", levels[ib->level], ib->gpuaddr);
+		if (!ib->dwords)
+			return 0;
+		if (!quiet(2))
+			dump_hex(ib->dwords, ib->sizedwords, ib->level+1);
+		ib->level++;
+		break;
+	case CP_SET_RENDER_MODE:
+		/* scripts are quiet, but still need to see what is in it, as
+		 * does the --jobs prepass, to keep the state the workers start
+		 * from up to date:
+		 */
+		if (!ib->dwords || (quiet(2) && !script))
+			return 0;
+		ib->level++;
+		break;
+	}
 
-#define cp_type3_opcode(pkt) (((pkt) >> 8) & 0xFF)
-#define type3_pkt_size(pkt) ((((pkt) >> 16) & 0x3FFF) + 1)
+	if (scripting())
+		script_ib_enter(ib->gpuaddr, ib->sizedwords, ib->level);
 
-#define pkt_is_type4(pkt) \
-        ((((pkt) & 0xF0000000) == CP_TYPE4_PKT) && \
-         ((((pkt) >> 27) & 0x1) == \
-         pm4_calc_odd_parity_bit(type4_pkt_offset(pkt))) \
-         && ((((pkt) >> 7) & 0x1) == \
-         pm4_calc_odd_parity_bit(type4_pkt_size(pkt))))
+	profile_start(&ib_timers[walker_state()->ib]);
 
-#define type4_pkt_offset(pkt) (((pkt) >> 8) & 0x7FFFF)
-#define type4_pkt_size(pkt) ((pkt) & 0x7F)
+	return 1;
+}
 
-#define pkt_is_type7(pkt) \
-        ((((pkt) & 0xF0000000) == CP_TYPE7_PKT) && \
-         (((pkt) & 0x0F000000) == 0) && \
-         ((((pkt) >> 23) & 0x1) == \
-         pm4_calc_odd_parity_bit(cp_type7_opcode(pkt))) \
-         && ((((pkt) >> 15) & 0x1) == \
-         pm4_calc_odd_parity_bit(type7_pkt_size(pkt))))
+static void dec_ib_end(struct cffdec *dec, struct cffdec_ib *ib)
+{
+	profile_stop(&ib_timers[walker_state()->ib],
+			PROFILE_LEVEL + min(ib->level, PROFILE_MAX_LEVELS - 1));
 
-#define cp_type7_opcode(pkt) (((pkt) >> 16) & 0x7F)
-#define type7_pkt_size(pkt) ((pkt) & 0x3FFF)
+	if (scripting())
+		script_ib_exit(ib->gpuaddr, ib->sizedwords, ib->level);
 
+	if ((ib->opcode == CP_SET_RENDER_MODE) && !quiet(2))
+		dump_hex(ib->dwords, ib->sizedwords, ib->level);
+}
 
-static void dump_commands(uint32_t *dwords, uint32_t sizedwords, int level)
+static int dec_ib_repeat(struct cffdec *dec, struct cffdec_ib *ib, int draw,
+		int packets)
 {
-	int dwords_left = sizedwords;
-	uint32_t count = 0; /* dword count including packet header */
-	uint32_t val;
+	/* scripts see every register write, so need the full decode: */
+	if (scripting())
+		return 0;
 
-	if (!dwords) {
-		printf("NULL cmd buffer!\n");
-		return;
-	}
+	/* referring back to it only makes sense if it was printed: */
+	if (!quiet(2) && (draw_filter != -1) && (draw_filter != draw))
+		return 0;
 
-	draws[ib] = 0;
+	/* with --summary, an IB of only register writes prints nothing: */
+	printl((packets || walker_state()->needs_wfi) ? 2 : 3,
+			"%ssame as IB @ draw %d\n", levels[ib->level], draw);
 
-	while (dwords_left > 0) {
+	return 1;
+}
 
-		current_draw_count = draw_count;
+static void dec_error(struct cffdec *dec, enum cffdec_error error,
+		uint32_t *dwords, int dwords_left)
+{
+	switch (error) {
+	case CFFDEC_BAD_PACKET:
+		if (profile_enabled)
+			profile_totals.packets++;
+		current_draw_count = walker_state()->draw_count;
+		printf("bad type! %08x\n", dwords[0]);
+		break;
+	case CFFDEC_OVERRUN:
+		printf("**** this ain't right!! dwords_left=%d\n", dwords_left);
+		break;
+	}
+}
 
-		/* hack, this looks like a -1 underflow, in some versions
-		 * when it tries to write zero registers via pkt0
-		 */
-//		if ((dwords[0] >> 16) == 0xffff)
-//			goto skip;
-
-		if (pkt_is_type0(dwords[0])) {
-			printl(3, "t0");
-			count = type0_pkt_size(dwords[0]) + 1;
-			val = type0_pkt_offset(dwords[0]);
-			printl(3, "%swrite %s%s (%04x)\n", levels[level+1], regname(val, 1),
-					(dwords[0] & 0x8000) ? " (same register)" : "", val);
-			dump_registers(val, dwords+1, count-1, level+2);
-			if (!quiet(3))
-				dump_hex(dwords, count, level+1);
-		} else if (pkt_is_type4(dwords[0])) {
-			/* basically the same(ish) as type0 prior to a5xx */
-			printl(3, "t4");
-			count = type4_pkt_size(dwords[0]) + 1;
-			val = type4_pkt_offset(dwords[0]);
-			printl(3, "%swrite %s (%04x)\n", levels[level+1], regname(val, 1), val);
-			dump_registers(val, dwords+1, count-1, level+2);
-			if (!quiet(3))
-				dump_hex(dwords, count, level+1);
-#if 0
-		} else if (pkt_is_type1(dwords[0])) {
-			printl(3, "t1");
-			count = 3;
-			val = dwords[0] & 0xfff;
-			printl(3, "%swrite %s\n", levels[level+1], regname(val, 1));
-			dump_registers(val, dwords+1, 1, level+2);
-			val = (dwords[0] >> 12) & 0xfff;
-			printl(3, "%swrite %s\n", levels[level+1], regname(val, 1));
-			dump_registers(val, dwords+2, 1, level+2);
-			if (!quiet(3))
-				dump_hex(dwords, count, level+1);
-		} else if (pkt_is_type2(dwords[0])) {
-			printl(3, "t2");
-			printf("%sNOP\n", levels[level+1]);
-			count = 1;
-			if (!quiet(3))
-				dump_hex(dwords, count, level+1);
-#endif
-		} else if (pkt_is_type3(dwords[0])) {
-			printl(3, "t3");
-			count = type3_pkt_size(dwords[0]) + 1;
-			val = cp_type3_opcode(dwords[0]);
-			init();
-			if (!quiet(2)) {
-				const char *name;
-				name = rnn_enumname(rnn, "adreno_pm4_type3_packets", val);
-				printf("\t%sopcode: %s%s%s (%02x) (%d dwords)%s\n", levels[level],
-						rnn->vc->colors->bctarg, name, rnn->vc->colors->reset,
-						val, count, (dwords[0] & 0x1) ? " (predicated)" : "");
-				if (name)
-					dump_domain(dwords+1, count-1, level+2, name);
-			}
-			if (type3_op[val].fxn)
-				type3_op[val].fxn(dwords+1, count-1, level+1);
-			if (!quiet(2))
-				dump_hex(dwords, count, level+1);
-		} else if (pkt_is_type7(dwords[0])) {
-			printl(3, "t7");
-			count = type7_pkt_size(dwords[0]) + 1;
-			val = cp_type7_opcode(dwords[0]);
-			init();
-			if (!quiet(2)) {
-				const char *name;
-				name = rnn_enumname(rnn, "adreno_pm4_type3_packets", val);
-				printf("\t%sopcode: %s%s%s (%02x) (%d dwords)\n", levels[level],
-						rnn->vc->colors->bctarg, name, rnn->vc->colors->reset,
-						val, count);
-				if (name)
-					dump_domain(dwords+1, count-1, level+2, name);
-			}
-			if (type3_op[val].fxn)
-				type3_op[val].fxn(dwords+1, count-1, level+1);
-			if (!quiet(2))
-				dump_hex(dwords, count, level+1);
-		} else if (pkt_is_type2(dwords[0])) {
-			printl(3, "t2");
-			printl(3, "%snop\n", levels[level+1]);
-		} else {
-			printf("bad type! %08x\n", dwords[0]);
-			return;
-		}
+static const struct cffdec_funcs funcs = {
+		.packet = dec_packet,
+		.packet_end = dec_packet_end,
+		.reg_write = dec_reg_write,
+		.draw = dec_draw,
+		.ib = dec_ib,
+		.ib_end = dec_ib_end,
+		.ib_repeat = dec_ib_repeat,
+		.error = dec_error,
+};
 
-		dwords += count;
-		dwords_left -= count;
+static void dump_commands(uint32_t *dwords, uint32_t sizedwords)
+{
+	struct profile_timer t;
 
+	if (!dwords) {
+		printf("NULL cmd buffer!\n");
+		return;
 	}
 
-	if (dwords_left < 0)
-		printf("**** this ain't right!! dwords_left=%d\n", dwords_left);
+	profile_start(&t);
+	cffdec_decode(dec, dwords, sizedwords);
+	profile_stop(&t, PROFILE_LEVEL);
 }
 
 static int handle_file(const char *filename, int start, int end, int draw);
@@ -2436,7 +2173,34 @@ static void print_usage(const char *name)
 	printf("    --frame N         - decode specified frame number\n");
 	printf("    --draw N          - decode specified draw number\n");
 	printf("    --textures        - dump texture contents (if possible)\n");
+	printf("    --no-index        - don't use or create FILE.idx index to seek to the\n");
+	printf("                        requested frame\n");
 	printf("    --script FILE     - run specified lua script to analyze state at draws\n");
+	printf("    --analyze         - compare equivalent captures from different gpus\n");
+	printf("                        (grouped by directory), listing register values\n");
+	printf("                        which match between the same set of draws\n");
+	printf("    --profile         - report the time spent in each part of the decoder\n");
+	printf("                        (and per packet type) to stderr\n");
+	printf("    --expand-ibs      - decode every IB in full, rather than referring back\n");
+	printf("                        to the first time a repeated state IB was seen\n");
+	printf("    --expand-shaders  - disassemble (and dump) every shader load, rather\n");
+	printf("                        than referring back to the first time it was seen\n");
+	printf("    --shader-db DIR   - add each new shader to the shader database in DIR\n");
+	printf("                        (binary, disassembly, stats and where first seen)\n");
+	printf("    --shader-query H  - print the database entry and disassembly of shaders\n");
+	printf("                        whose hash starts with H (or list all, for \"all\"),\n");
+	printf("                        requires --shader-db\n");
+	printf("    --jobs/-j N       - decode with N worker processes (0 for one per cpu),\n");
+	printf("                        output is the same as decoding serially\n");
+	printf("    --output FILE     - write decoded output to FILE rather than stdout\n");
+	printf("                        (implies no pager)\n");
+	printf("    --batch           - decode each FILE to FILE-cffdump.txt, with --jobs\n");
+	printf("                        files at a time, skipping files whose output is\n");
+	printf("                        up to date\n");
+	printf("    --export          - write the state at each draw to FILE.cols, for\n");
+	printf("                        querying with cffquery\n");
+	printf("    --diff A,B        - at the end of each file, show the registers which\n");
+	printf("                        differ between draw[A] and draw[B]\n");
 	printf("    --query/-q REG    - query mode, dump only specified query registers on\n");
 	printf("                        each draw; multiple --query/-q args can be given to\n");
 	printf("                        dump multiple registers; register can be specified\n");
@@ -2449,7 +2213,9 @@ static pid_t pager_pid;
 
 static void pager_death(int n)
 {
-	exit(0);
+	/* with --jobs, workers are children too: */
+	if (waitpid(pager_pid, NULL, WNOHANG) == pager_pid)
+		exit(0);
 }
 
 static void pager_open(void)
@@ -2506,11 +2272,46 @@ static int pager_close(void)
 	}
 }
 
+static const char *opname(unsigned opcode)
+{
+	if (!dec)
+		return NULL;
+	return rnn_enumtab_name(cffdec_enums(dec)->adreno_pm4_type3_packets,
+			opcode);
+}
+
+struct batch_args {
+	int start, end, draw;
+};
+
+static int handle_batch_file(const char *filename, void *data)
+{
+	struct batch_args *args = data;
+	int ret;
+
+	if (profile)
+		profile_enable();
+
+	dump_prefix = batch_name(filename);
+
+	ret = handle_file(filename, args->start, args->end, args->draw);
+	script_finish();
+
+	if (profile) {
+		fprintf(stderr, "profile for %s:\n", filename);
+		profile_report(stderr, opname);
+	}
+
+	return ret;
+}
+
 int main(int argc, char **argv)
 {
 	int ret, n = 1;
 	int start = 0, end = 0x7ffffff, draw = -1;
 	int interactive = isatty(STDOUT_FILENO);
+	const char *output = NULL, *shader_db = NULL, *shader_query = NULL;
+	bool batch = false;
 
 	no_color = !interactive;
 
@@ -2585,6 +2386,12 @@ int main(int argc, char **argv)
 			continue;
 		}
 
+		if (!strcmp(argv[n], "--no-index")) {
+			n++;
+			use_index = false;
+			continue;
+		}
+
 		if (!strcmp(argv[n], "--script")) {
 			n++;
 			script = argv[n];
@@ -2596,6 +2403,89 @@ int main(int argc, char **argv)
 			continue;
 		}
 
+		if (!strcmp(argv[n], "--analyze")) {
+			n++;
+			analyze = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--profile")) {
+			n++;
+			profile = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--expand-ibs")) {
+			n++;
+			expand_ibs = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--expand-shaders")) {
+			n++;
+			expand_shaders = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--shader-db")) {
+			n++;
+			shader_db = argv[n];
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--shader-query")) {
+			n++;
+			shader_query = argv[n];
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--jobs") ||
+				!strcmp(argv[n], "-j")) {
+			n++;
+			jobs = atoi(argv[n]);
+			if (jobs <= 0)
+				jobs = sysconf(_SC_NPROCESSORS_ONLN);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--batch")) {
+			n++;
+			batch = true;
+			interactive = 0;
+			no_color = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--output")) {
+			n++;
+			output = argv[n];
+			interactive = 0;
+			no_color = true;
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--export")) {
+			n++;
+			export = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--diff")) {
+			n++;
+			if ((n >= argc) || (sscanf(argv[n], "%d,%d",
+					&diff_draws[0], &diff_draws[1]) != 2) ||
+					(diff_draws[0] < 0) || (diff_draws[1] < 0)) {
+				fprintf(stderr, "--diff expects A,B draw numbers\n");
+				return 1;
+			}
+			n++;
+			continue;
+		}
+
 		if (!strcmp(argv[n], "--query") ||
 				!strcmp(argv[n], "-q")) {
 			n++;
@@ -2616,18 +2506,76 @@ int main(int argc, char **argv)
 		break;
 	}
 
+	if (shader_query) {
+		if (!shader_db) {
+			fprintf(stderr, "--shader-query needs --shader-db\n");
+			return 1;
+		}
+		return (shaderdb_query(shader_db, shader_query) > 0) ? 0 : 1;
+	}
+
+	shaders = shaderdb_new(shader_db);
+	if (!shaders)
+		return 1;
+
+	if (batch) {
+		struct batch_args args = { start, end, draw };
+		char *options = batch_options(argv, n);
+		int njobs = jobs;
+
+		if (output) {
+			fprintf(stderr, "--output cannot be used with --batch\n");
+			return 1;
+		}
+
+		if (analyze) {
+			fprintf(stderr, "--analyze cannot be used with --batch\n");
+			return 1;
+		}
+
+		/* each file is decoded serially, by its own worker: */
+		jobs = 1;
+
+		/* parse the register databases once, rather than in every
+		 * worker:
+		 */
+		rnn_preload();
+
+		ret = batch_run("cffdump", options, &argv[n], argc - n, njobs,
+				handle_batch_file, &args);
+		free(options);
+
+		return ret ? 1 : 0;
+	}
+
 	if (interactive) {
 		pager_open();
 	}
 
-	rnn = rnn_new(no_color);
+	if (out_init(output)) {
+		fprintf(stderr, "could not open output: %s\n", output);
+		return 1;
+	}
+
+	if (profile)
+		profile_enable();
 
 	while (n < argc) {
+		/* like in batch mode, report each file on its own: */
+		if (profile)
+			profile_reset();
+
 		ret = handle_file(argv[n], start, end, draw);
 		if (ret) {
 			fprintf(stderr, "error reading: %s\n", argv[n]);
 			fprintf(stderr, "continuing..\n");
 		}
+
+		if (profile) {
+			fprintf(stderr, "profile for %s:\n", argv[n]);
+			profile_report(stderr, opname);
+		}
+
 		n++;
 	}
 
@@ -2638,6 +2586,9 @@ int main(int argc, char **argv)
 
 	script_finish();
 
+	if (analyze)
+		analyze_finish(no_color);
+
 	if (interactive) {
 		pager_close();
 	}
@@ -2653,21 +2604,371 @@ static void parse_addr(uint32_t *buf, int sz, unsigned int *len, uint64_t *gpuad
 		*gpuaddr |= ((uint64_t)(buf[2])) << 32;
 }
 
+static void set_gpu_id(unsigned id)
+{
+	gpu_id = id;
+	cffdec_set_gpu_id(dec, gpu_id);
+	printl(2, "gpu_id: %d\n", gpu_id);
+	init_query();
+}
+
+/* shadow of register state at last index checkpoint, to compute deltas: */
+static uint32_t ckpt_vals[CFFDEC_MAXREGS];
+static uint8_t ckpt_written[CFFDEC_MAXREGS / 8];
+
+static void index_submit(struct rd_index *idx, uint64_t group_offset,
+		uint32_t group_submit, uint64_t cmd_offset, uint32_t submit,
+		bool has_state)
+{
+	bool keyframe = (submit % RD_INDEX_KEYFRAME_INTERVAL) == 0;
+	const uint32_t *regs = NULL;
+	uint32_t i, n = 0;
+
+	if (keyframe)
+		memset(ckpt_written, 0, sizeof(ckpt_written));
+
+	if (has_state)
+		n = reg_written_list(&regs);
+
+	for (i = 0; i < n; i++) {
+		uint32_t regbase = regs[i];
+		uint32_t val = reg_val(regbase);
+		bool seen = !!(ckpt_written[regbase/8] & (1 << (regbase % 8)));
+
+		if (seen && (ckpt_vals[regbase] == val))
+			continue;
+
+		rd_index_add_reg(idx, regbase, val);
+		ckpt_vals[regbase] = val;
+		ckpt_written[regbase/8] |= (1 << (regbase % 8));
+	}
+
+	rd_index_add_submit(idx, group_offset, group_submit, cmd_offset,
+			has_state, keyframe);
+}
+
+/* sections which a seek through the index can skip, everything else is
+ * recorded in the index so it can still be read:
+ */
+static bool is_buffer_section(enum rd_sect_type type)
+{
+	return (type == RD_GPUADDR) || (type == RD_BUFFER_CONTENTS) ||
+			(type == RD_CMDSTREAM_ADDR);
+}
+
+static void restore_reg(uint32_t regbase, uint32_t val, void *data)
+{
+	cffdec_reg_restore(dec, regbase, val);
+}
+
+static void print_reg_diff(void *data, uint32_t regbase,
+		int awritten, uint32_t aval, int bwritten, uint32_t bval)
+{
+	const char *name = regname(regbase, 1);
+
+	if (name)
+		printf("\t%-40s ", name);
+	else
+		printf("\t<%04x>%34s ", regbase, "");
+	if (awritten)
+		printf("%08x", aval);
+	else
+		printf("--------");
+	printf(" -> ");
+	if (bwritten)
+		printf("%08x\n", bval);
+	else
+		printf("--------\n");
+}
+
+/* compare the register state at two draws (--diff): */
+static void dump_draw_diff(void)
+{
+	unsigned a = diff_draws[0], b = diff_draws[1];
+	unsigned n = cffdec_num_snapshots(dec);
+
+	printf("############################################################\n");
+	if ((a >= n) || (b >= n)) {
+		printf("diff draw[%u] draw[%u]: only %u draws\n", a, b, n);
+		return;
+	}
+
+	printf("diff draw[%u] draw[%u]:\n", a, b);
+	n = cffdec_snapshot_diff(dec, a, b, print_reg_diff, NULL);
+	printf("%u registers differ\n", n);
+}
+
+static void reset_buffers(void)
+{
+	cffdec_reset_buffers(dec);
+}
+
+/*
+ * Parallel decode (--jobs N):
+ *
+ * Much of the output state is global, so rather than threads the
+ * submits are split into batches, each decoded by a forked worker
+ * process.  The parent does a prepass over the file, decoding every
+ * submit to keep the register/buffer/draw state up to date but skipping
+ * the expensive part (formatting the output).  At the start of each
+ * batch it forks a worker, which starts with an exact copy of the
+ * decoder state at that point, decodes the batch with output to a
+ * temporary file, and exits.  The parent stitches the workers' output
+ * back together in order, so the result is the same as a serial run.
+ *
+ * Scripts with a reduce() hook run in the workers too, each worker
+ * passing the result of its part of the cmdstream back to the parent
+ * through another temporary file, see script.h.
+ */
+
+struct worker {
+	pid_t pid;
+	FILE *out;
+	FILE *results;            /* script results, if any */
+	FILE *prof;               /* --profile counters, if any */
+	int submit;
+};
+
+static struct {
+	struct worker *workers;   /* ring of in-flight workers, oldest first */
+	unsigned first, count;
+	int batch;                /* # of submits per worker */
+	int out_fd;               /* real stdout, once workers are started */
+	bool worker;              /* in worker process */
+	int batch_end;            /* in worker, first submit of next batch */
+	FILE *results;            /* in worker, for script results */
+	FILE *prof;               /* in worker, for --profile counters */
+} par;
+
+static void par_copy(int fd)
+{
+	char buf[0x10000];
+	ssize_t n;
+
+	lseek(fd, 0, SEEK_SET);
+	while ((n = read(fd, buf, sizeof(buf))) != 0) {
+		char *ptr = buf;
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		while (n > 0) {
+			ssize_t ret = write(par.out_fd, ptr, n);
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				return;
+			}
+			ptr += ret;
+			n -= ret;
+		}
+	}
+}
+
+/* wait for the oldest worker, and pass its output through: */
+static void par_reap(void)
+{
+	struct worker *w = &par.workers[par.first];
+	int status;
+
+	while (waitpid(w->pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			status = -1;
+			break;
+		}
+	}
+
+	par_copy(fileno(w->out));
+	fclose(w->out);
+
+	if (w->results) {
+		script_collect(w->results);
+		fclose(w->results);
+	}
+
+	if (w->prof) {
+		profile_merge(w->prof);
+		fclose(w->prof);
+	}
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		fprintf(stderr, "worker for submit %d failed\n", w->submit);
+
+	par.first = (par.first + 1) % jobs;
+	par.count--;
+}
+
+static void par_init(struct rd_index *idx, int start, int end)
+{
+	memset(&par, 0, sizeof(par));
+	par.workers = calloc(jobs, sizeof(*par.workers));
+	par.out_fd = -1;
+	par.batch_end = -1;
+
+	/* aim for a few batches per worker, to even out the load: */
+	par.batch = 64;
+	if (idx) {
+		int n = min(end + 1, (int)idx->nsubmits) - start;
+		par.batch = max(1, n / (jobs * 4));
+	}
+}
+
+/* called at the start of each submit, in both the parent and workers.
+ * Returns true if the caller is a new worker.
+ */
+static bool par_submit(struct io *io, int submit, int start, int end)
+{
+	struct worker *w;
+	FILE *out, *results = NULL, *prof = NULL;
+	pid_t pid;
+
+	/* end of this worker's batch: */
+	if (par.worker) {
+		if (submit == par.batch_end) {
+			script_end_worker(par.results);
+			profile_save(par.prof);
+			fflush(stdout);
+			_exit(0);
+		}
+		return false;
+	}
+
+	if ((submit < start) || (submit > end) || ((submit - start) % par.batch))
+		return false;
+
+	fflush(stdout);
+
+	/* from now on, the workers write the output, and anything printed
+	 * by the parent is discarded:
+	 */
+	if (par.out_fd < 0) {
+		int null = open("/dev/null", O_WRONLY);
+		par.out_fd = dup(STDOUT_FILENO);
+		dup2(null, STDOUT_FILENO);
+		close(null);
+		prepass = true;
+		/* the workers' counters are merged as they finish: */
+		profile_pause(1);
+	}
+
+	if (par.count == jobs)
+		par_reap();
+
+	out = tmpfile();
+	if (script)
+		results = tmpfile();
+	if (profile)
+		prof = tmpfile();
+	if (!out || (script && !results) || (profile && !prof)) {
+		fprintf(stderr, "could not create temporary file: %m\n");
+		exit(-1);
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		fprintf(stderr, "could not fork worker: %m\n");
+		exit(-1);
+	}
+
+	if (pid == 0) {
+		dup2(fileno(out), STDOUT_FILENO);
+		fclose(out);
+		io_fork_child(io);
+		prepass = false;
+		par.worker = true;
+		par.results = results;
+		par.prof = prof;
+		profile_reset();
+		profile_pause(0);
+		/* the last worker carries on to the end of the file: */
+		if (submit + par.batch <= end)
+			par.batch_end = submit + par.batch;
+		return true;
+	}
+
+	w = &par.workers[(par.first + par.count) % jobs];
+	w->pid = pid;
+	w->out = out;
+	w->results = results;
+	w->prof = prof;
+	w->submit = submit;
+	par.count++;
+
+	return false;
+}
+
+/* called at the end of the file.  Workers exit, and the parent waits for
+ * the remaining workers and restores stdout:
+ */
+static void par_finish(void)
+{
+	if (par.worker) {
+		script_end_worker(par.results);
+		profile_save(par.prof);
+		fflush(stdout);
+		_exit(0);
+	}
+
+	fflush(stdout);
+
+	while (par.count)
+		par_reap();
+
+	profile_pause(0);
+
+	if (par.out_fd >= 0) {
+		dup2(par.out_fd, STDOUT_FILENO);
+		close(par.out_fd);
+	}
+
+	free(par.workers);
+	memset(&par, 0, sizeof(par));
+	prepass = false;
+
+	script_reduce();
+}
+
 static int handle_file(const char *filename, int start, int end, int draw)
 {
 	enum rd_sect_type type = RD_NONE;
-	void *buf = NULL;
+	void *buf = NULL, *mapped;
+	struct rd_file rd;
 	struct io *io;
-	int submit = 0, got_gpu_id = 0;
-	int sz, i, ret = 0;
-	bool needs_reset;
+	struct rd_index *idx = NULL, *newidx = NULL;
+	struct rd_index_submit *seek = NULL;
+	uint64_t offset, group_offset = 0, bufaddr = 0;
+	unsigned int buflen = 0;
+	int submit = 0, group_submit = 0, got_gpu_id = 0;
+	int sz, ret = 0;
+	bool needs_reset = false;
+	/* whether all submits so far have been decoded, ie. whether the
+	 * current register state is valid for an index checkpoint:
+	 */
+	bool full_state = true;
 
 	draw_filter = draw;
-	draw_count = 0;
+
+	infile = filename;
+	shaderdb_reset(shaders);
+
+	if (!dec) {
+		dec = cffdec_new(gpu_id, &funcs, NULL);
+		cffdec_set_color(dec, !no_color);
+		if (!expand_ibs)
+			cffdec_enable_memo(dec);
+	}
+
+	if (diff_draws[0] >= 0) {
+		cffdec_enable_snapshots(dec);
+		cffdec_free_snapshots(dec);
+	}
 
 	printf("Reading %s...\n", filename);
 
 	script_start_cmdstream(filename);
+	if (analyze)
+		analyze_start_cmdstream(filename);
 
 	if (!strcmp(filename, "-"))
 		io = io_openfd(0);
@@ -2679,7 +2980,7 @@ static int handle_file(const char *filename, int start, int end, int draw)
 		return -1;
 	}
 
-	clear_written();
+	cffdec_reset(dec);
 	clear_lastvals();
 
 	if (check_extension(filename, ".txt")) {
@@ -2718,47 +3019,125 @@ static int handle_file(const char *filename, int start, int end, int draw)
 
 		} while (1);
 
-		init_a3xx();
+		/* decoded as a3xx, without changing gpu_id: */
+		cffdec_set_gpu_id(dec, 320);
 
 		printf("############################################################\n");
 		printf("cmdstream: %d dwords\n", sizedwords);
-		dump_commands(buf, sizedwords, 0);
+		dump_commands(buf, sizedwords);
 		printf("############################################################\n");
 		printf("vertices: %d\n", vertices);
 
 		return 0;
 	}
 
-	while (true) {
-		uint32_t arr[2];
+	if (rd_file_init(&rd, io)) {
+		io_close(io);
+		return -1;
+	}
 
-		ret = io_readn(io, arr, 8);
-		if (ret <= 0)
-			goto end;
+	/* started once nothing can return early, as only the end of the
+	 * function saves and frees it:
+	 */
+	if (export && strcmp(filename, "-"))
+		export_start();
+
+	if (use_index && strcmp(filename, "-")) {
+		idx = rd_index_load(filename);
+		if (!idx) {
+			newidx = rd_index_create(filename);
+		} else if ((start > 0) && (start < idx->nsubmits)) {
+			seek = &idx->submits[start];
+		}
+	}
 
-		while ((arr[0] == 0xffffffff) && (arr[1] == 0xffffffff)) {
-			ret = io_readn(io, arr, 8);
-			if (ret <= 0)
+	if (jobs > 1) {
+		if (script && !script_reduce_enabled()) {
+			fprintf(stderr, "--jobs is not supported with --script, "
+					"unless the script has a reduce() hook\n");
+		} else if (!io_can_fork(io)) {
+			fprintf(stderr, "--jobs is not supported for streamed input\n");
+		} else {
+			par_init(idx, start, end);
+		}
+	}
+
+	while (true) {
+		struct profile_timer t;
+
+		/* with an index, we know there are no more submits of interest,
+		 * so just read the remaining sections that aren't buffers, which
+		 * would be printed in a serial run:
+		 */
+		if (idx && (submit > end)) {
+			struct rd_index_section *s =
+					rd_index_next_section(idx, rd_offset(&rd));
+			if (!s || rd_seek(&rd, s->offset)) {
+				ret = 0;
 				goto end;
+			}
 		}
 
-		type = arr[0];
-		sz = arr[1];
+		profile_start(&t);
 
-		if (sz < 0) {
-			ret = -1;
+		/* nothing in the cmdstream is anywhere near this big: */
+		ret = rd_next_section_max(&rd, INT32_MAX);
+		if (ret <= 0)
 			goto end;
+
+		/* when seeking, the sections that aren't buffers (test name,
+		 * cmdline, gpu_id, etc) are still read, so they get printed as
+		 * in a serial run, then skip to the buffers the submit needs,
+		 * with the register state from the index's checkpoint.  If any
+		 * of that fails, fall back to reading from where we are:
+		 */
+		if (seek && is_buffer_section(rd.type)) {
+			struct rd_index_section *s =
+					rd_index_next_section(idx, rd.offset);
+			if (s && (s->offset < seek->group_offset)) {
+				if (!rd_seek(&rd, s->offset)) {
+					submit = s->submit;
+					profile_stop(&t, PROFILE_IO);
+					continue;
+				}
+			} else if (!rd_index_get_state(idx, start, restore_reg, NULL) &&
+					!rd_seek(&rd, seek->group_offset)) {
+				submit = seek->group_submit;
+				seek = NULL;
+				profile_stop(&t, PROFILE_IO);
+				continue;
+			}
+			seek = NULL;
 		}
 
+		offset = rd.offset;
+		type = rd.type;
+		sz = rd.size;
+
+		if (newidx && !is_buffer_section(type))
+			rd_index_add_section(newidx, offset, submit);
+
 		free(buf);
+		buf = NULL;
 
-		needs_wfi = false;
+		/* if the file is mmap'd, buffer contents can be used in-place
+		 * rather than copied:
+		 */
+		mapped = NULL;
+		if (type == RD_BUFFER_CONTENTS)
+			mapped = rd_map_payload(&rd);
+
+		if (!mapped) {
+			buf = malloc(sz + 1);
+			((char *)buf)[sz] = '\0';
+			ret = rd_read_payload(&rd, buf);
+			if (ret < 0)
+				goto end;
+		}
 
-		buf = malloc(sz + 1);
-		((char *)buf)[sz] = '\0';
-		ret = io_readn(io, buf, sz);
-		if (ret < 0)
-			goto end;
+		profile_stop(&t, PROFILE_IO);
+		if (profile_enabled)
+			profile_totals.bytes += sz;
 
 		switch(type) {
 		case RD_TEST:
@@ -2775,47 +3154,50 @@ static int handle_file(const char *filename, int start, int end, int draw)
 			break;
 		case RD_GPUADDR:
 			if (needs_reset) {
-				for (i = 0; i < nbuffers; i++) {
-					free(buffers[i].hostptr);
-					buffers[i].hostptr = NULL;
-				}
-				nbuffers = 0;
+				reset_buffers();
 				needs_reset = false;
+				group_offset = offset;
+				group_submit = submit;
 			}
-			parse_addr(buf, sz, &buffers[nbuffers].len, &buffers[nbuffers].gpuaddr);
+			parse_addr(buf, sz, &buflen, &bufaddr);
 			break;
 		case RD_BUFFER_CONTENTS:
-			buffers[nbuffers].hostptr = buf;
-			nbuffers++;
-			assert(nbuffers < ARRAY_SIZE(buffers));
-			buf = NULL;
+			if (mapped) {
+				cffdec_add_buffer(dec, bufaddr, mapped, buflen, true);
+			} else {
+				cffdec_add_buffer(dec, bufaddr, buf, buflen, false);
+				buf = NULL;
+			}
 			break;
 		case RD_CMDSTREAM_ADDR:
+			if (par.workers) {
+				/* only the parent builds the index: */
+				if (par_submit(io, submit, start, end))
+					newidx = NULL;
+			}
+			if (newidx) {
+				index_submit(newidx, group_offset, group_submit, offset,
+						submit, full_state);
+			}
 			if ((start <= submit) && (submit <= end)) {
 				unsigned int sizedwords;
 				uint64_t gpuaddr;
 				parse_addr(buf, sz, &sizedwords, &gpuaddr);
 				printl(2, "############################################################\n");
 				printl(2, "cmdstream: %d dwords\n", sizedwords);
-				dump_commands(hostptr(gpuaddr), sizedwords, 0);
+				export_submit = submit;
+				dump_commands(hostptr(gpuaddr), sizedwords);
 				printl(2, "############################################################\n");
 				printl(2, "vertices: %d\n", vertices);
+			} else {
+				full_state = false;
 			}
 			needs_reset = true;
 			submit++;
 			break;
 		case RD_GPU_ID:
 			if (!got_gpu_id) {
-				gpu_id = *((unsigned int *)buf);
-				printl(2, "gpu_id: %d\n", gpu_id);
-				if (gpu_id >= 500)
-					init_a5xx();
-				else if (gpu_id >= 400)
-					init_a4xx();
-				else if (gpu_id >= 300)
-					init_a3xx();
-				else
-					init_a2xx();
+				set_gpu_id(*((unsigned int *)buf));
 				got_gpu_id = 1;
 			}
 			break;
@@ -2825,12 +3207,38 @@ static int handle_file(const char *filename, int start, int end, int draw)
 	}
 
 end:
-	script_end_cmdstream();
+	/* with --jobs, the workers end the cmdstream, see par_finish(): */
+	if (!par.workers)
+		script_end_cmdstream();
+	if (analyze)
+		analyze_end_cmdstream();
+
+	/* buffers may point into the mmap'd file, so drop them before
+	 * it goes away:
+	 */
+	reset_buffers();
+
+	/* only save the index if we made it all the way through the file,
+	 * decoding every submit, otherwise the checkpoints are incomplete:
+	 */
+	if (newidx && (ret == 0) && full_state)
+		rd_index_save(newidx, got_gpu_id ? gpu_id : 0);
+	rd_index_free(newidx);
+	rd_index_free(idx);
 
 	io_close(io);
 
 	if (ret < 0) {
 		printf("corrupt file\n");
 	}
+
+	if (par.workers)
+		par_finish();
+
+	if (diff_draws[0] >= 0)
+		dump_draw_diff();
+
+	export_finish(filename);
+
 	return 0;
 }
@@ -0,0 +1,324 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+/* Query the per-draw state files written by cffdump --export, ie:
+ *
+ *    cffquery --where 'RB_BLEND_CNTL&0xff!=0' --where 'primtype=DI_PT_TRILIST' \
+ *        --show RB_RENDER_CONTROL0 a.rd b.rd
+ *
+ * shows the draws (in any of the files) matching all of the --where
+ * expressions, without decoding the .rd files again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "colfile.h"
+
+enum op {
+	OP_EQ,
+	OP_NE,
+	OP_LT,
+	OP_LE,
+	OP_GT,
+	OP_GE,
+};
+
+struct cond {
+	char *name;
+	uint32_t mask;
+	enum op op;
+	const char *str;
+	uint32_t val;
+	int col;         /* column in the current file */
+};
+
+static struct cond *conds;
+static int nconds;
+
+static char **shows;
+static int *show_cols;
+static int nshows;
+
+static void print_usage(const char *name)
+{
+	printf("Usage: %s [OPTIONS]... FILE...\n", name);
+	printf("    --where/-w EXPR   - only show draws where EXPR is true, multiple\n");
+	printf("                        --where/-w args must all be true.  EXPR is\n");
+	printf("                        COLUMN[&MASK]OP VALUE, where OP is one of\n");
+	printf("                        =, !=, <, <=, >, >=\n");
+	printf("    --show/-s COLUMN  - show the value of COLUMN for each draw\n");
+	printf("    --count/-c        - only show the number of matching draws\n");
+	printf("    --columns         - list the columns of each file\n");
+	printf("    --help            - show this message\n");
+	printf("\n");
+	printf("FILE is either a .rd file exported with cffdump --export, or the\n");
+	printf("FILE.rd.cols it exported.  Register columns are named by register\n");
+	printf("name, or can be given as a numeric offset.\n");
+}
+
+static int parse_cond(struct cond *c, const char *expr)
+{
+	static const struct {
+		const char *str;
+		enum op op;
+	} ops[] = {
+		/* longest first: */
+		{ "!=", OP_NE }, { "<=", OP_LE }, { ">=", OP_GE },
+		{ "=", OP_EQ }, { "<", OP_LT }, { ">", OP_GT },
+	};
+	size_t len = strcspn(expr, "!<>=");
+	char *mask;
+	unsigned i;
+
+	for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+		if (!strncmp(expr + len, ops[i].str, strlen(ops[i].str)))
+			break;
+
+	if (!len || (i == sizeof(ops) / sizeof(ops[0])))
+		return -1;
+
+	c->op = ops[i].op;
+	c->str = expr + len + strlen(ops[i].str);
+	c->val = strtoul(c->str, NULL, 0);
+	c->name = strndup(expr, len);
+	c->mask = ~0;
+
+	mask = strchr(c->name, '&');
+	if (mask) {
+		*mask = '\0';
+		c->mask = strtoul(mask + 1, NULL, 0);
+	}
+
+	return 0;
+}
+
+/* find column by name, or by numeric register offset: */
+static int find_col(struct colfile *f, const char *name)
+{
+	char *end;
+	unsigned long regbase;
+	int col = colfile_find(f, name);
+
+	if (col >= 0)
+		return col;
+
+	regbase = strtoul(name, &end, 0);
+	if ((end != name) && !*end)
+		return colfile_find_reg(f, regbase);
+
+	return -1;
+}
+
+static int compare(enum op op, int64_t a, int64_t b)
+{
+	switch (op) {
+	case OP_EQ: return a == b;
+	case OP_NE: return a != b;
+	case OP_LT: return a < b;
+	case OP_LE: return a <= b;
+	case OP_GT: return a > b;
+	case OP_GE: return a >= b;
+	}
+	return 0;
+}
+
+static int match(struct colfile *f, uint32_t row)
+{
+	int i;
+
+	for (i = 0; i < nconds; i++) {
+		struct cond *c = &conds[i];
+
+		/* draws before a register is written never match: */
+		if ((c->col < 0) || !colfile_has_val(f, c->col, row))
+			return 0;
+
+		if (colfile_is_string(f, c->col)) {
+			int cmp = strcmp(colfile_string(f, c->col, row), c->str);
+			if (!compare(c->op, cmp, 0))
+				return 0;
+		} else {
+			uint32_t val = colfile_val(f, c->col, row) & c->mask;
+			if (!compare(c->op, val, c->val))
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+static void print_val(struct colfile *f, int col, uint32_t row)
+{
+	if ((col < 0) || !colfile_has_val(f, col, row))
+		printf("-");
+	else if (colfile_is_string(f, col))
+		printf("%s", colfile_string(f, col, row));
+	else if (colfile_regbase(f, col) != COLFILE_NOREG)
+		printf("%08x", colfile_val(f, col, row));
+	else
+		printf("%u", colfile_val(f, col, row));
+}
+
+static int handle_file(const char *filename, int count, int columns)
+{
+	struct colfile *f;
+	uint32_t row, nrows, nmatch = 0;
+	int i, submit, primtype;
+	size_t len = strlen(filename);
+	char *path;
+
+	path = malloc(len + 6);
+	strcpy(path, filename);
+	if ((len < 5) || strcmp(filename + len - 5, ".cols"))
+		strcat(path, ".cols");
+
+	f = colfile_open(path);
+	if (!f) {
+		fprintf(stderr, "could not open: %s\n", path);
+		free(path);
+		return -1;
+	}
+	free(path);
+
+	if (columns) {
+		for (i = 0; i < colfile_ncols(f); i++) {
+			printf("%s: %s", filename, colfile_name(f, i));
+			if (colfile_regbase(f, i) != COLFILE_NOREG)
+				printf(" (%04x)", colfile_regbase(f, i));
+			printf("\n");
+		}
+		colfile_close(f);
+		return 0;
+	}
+
+	for (i = 0; i < nconds; i++)
+		conds[i].col = find_col(f, conds[i].name);
+	for (i = 0; i < nshows; i++)
+		show_cols[i] = find_col(f, shows[i]);
+
+	submit = colfile_find(f, "submit");
+	primtype = colfile_find(f, "primtype");
+
+	nrows = colfile_nrows(f);
+	for (row = 0; row < nrows; row++) {
+		if (!match(f, row))
+			continue;
+
+		nmatch++;
+
+		if (count)
+			continue;
+
+		printf("%s: draw[%u] submit=", filename, row);
+		print_val(f, submit, row);
+		printf(" ");
+		print_val(f, primtype, row);
+		for (i = 0; i < nshows; i++) {
+			printf(" %s=", shows[i]);
+			print_val(f, show_cols[i], row);
+		}
+		printf("\n");
+	}
+
+	if (count)
+		printf("%s: %u of %u draws\n", filename, nmatch, nrows);
+
+	colfile_close(f);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int n = 1, ret = 0, count = 0, columns = 0;
+
+	while (n < argc) {
+		if (!strcmp(argv[n], "--where") ||
+				!strcmp(argv[n], "-w")) {
+			n++;
+			if (n >= argc)
+				break;
+			conds = realloc(conds, (nconds + 1) * sizeof(*conds));
+			if (parse_cond(&conds[nconds], argv[n])) {
+				fprintf(stderr, "invalid expression: %s\n", argv[n]);
+				return 1;
+			}
+			nconds++;
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--show") ||
+				!strcmp(argv[n], "-s")) {
+			n++;
+			if (n >= argc)
+				break;
+			shows = realloc(shows, (nshows + 1) * sizeof(*shows));
+			show_cols = realloc(show_cols, (nshows + 1) * sizeof(*show_cols));
+			shows[nshows++] = argv[n];
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--count") ||
+				!strcmp(argv[n], "-c")) {
+			n++;
+			count = 1;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--columns")) {
+			n++;
+			columns = 1;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--help")) {
+			print_usage(argv[0]);
+			return 0;
+		}
+
+		break;
+	}
+
+	if (n >= argc) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	while (n < argc) {
+		if (handle_file(argv[n], count, columns))
+			ret = 1;
+		n++;
+	}
+
+	return ret;
+}
@@ -0,0 +1,547 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "colfile.h"
+
+#define COLFILE_MAGIC   0x4c4f4346   /* "FCOL" */
+#define COLFILE_VERSION 1
+
+/* on disk layout is the header, the column table, the string table,
+ * and then the dictionary and data of each column, each 8 byte aligned:
+ */
+struct colfile_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t gpu_id;
+	uint32_t nrows;
+	uint32_t ncols;
+	uint32_t strtab_size;
+	uint64_t strtab_offset;
+};
+
+struct colfile_column {
+	uint32_t name;           /* offset in string table */
+	uint32_t regbase;        /* or COLFILE_NOREG */
+	uint32_t flags;
+	uint32_t first_row;      /* no value for rows before this */
+	uint32_t width;          /* 1 or 2 for dictionary indices, or 4 */
+	uint32_t ndict;
+	uint64_t dict_offset;    /* uint32_t dict[ndict] */
+	uint64_t data_offset;    /* (nrows - first_row) values of width bytes */
+};
+
+/*
+ * Writer:
+ */
+
+struct wcol {
+	uint32_t name, regbase, flags, first_row;
+	uint32_t cur;            /* value for the current row */
+	uint32_t *vals;
+	uint32_t nvals, maxvals;
+};
+
+struct colfile_writer {
+	uint32_t nrows;
+
+	struct wcol *cols;
+	unsigned ncols, maxcols;
+
+	char *strtab;
+	uint32_t strtab_size, strtab_max;
+
+	/* string values, so each distinct one is only stored once.  There
+	 * are only a handful (primtype names, etc) so a list is fine:
+	 */
+	uint32_t *strs;
+	unsigned nstrs, maxstrs;
+};
+
+static void * grow(void *ptr, unsigned *max, unsigned n, size_t sz)
+{
+	if (n < *max)
+		return ptr;
+	*max = (*max) ? 2 * (*max) : 64;
+	while (*max <= n)
+		*max *= 2;
+	ptr = realloc(ptr, *max * sz);
+	assert(ptr);
+	return ptr;
+}
+
+static uint32_t add_string(struct colfile_writer *w, const char *str)
+{
+	uint32_t off = w->strtab_size, len = strlen(str) + 1;
+
+	while (w->strtab_size + len > w->strtab_max) {
+		w->strtab_max = w->strtab_max ? 2 * w->strtab_max : 4096;
+		w->strtab = realloc(w->strtab, w->strtab_max);
+		assert(w->strtab);
+	}
+
+	memcpy(w->strtab + off, str, len);
+	w->strtab_size += len;
+
+	return off;
+}
+
+struct colfile_writer * colfile_writer_new(void)
+{
+	struct colfile_writer *w = calloc(1, sizeof(*w));
+	assert(w);
+	add_string(w, "");
+	return w;
+}
+
+void colfile_writer_free(struct colfile_writer *w)
+{
+	unsigned i;
+
+	if (!w)
+		return;
+
+	for (i = 0; i < w->ncols; i++)
+		free(w->cols[i].vals);
+	free(w->cols);
+	free(w->strtab);
+	free(w->strs);
+	free(w);
+}
+
+int colfile_add_column(struct colfile_writer *w, const char *name,
+		uint32_t regbase, uint32_t flags)
+{
+	struct wcol *col;
+
+	w->cols = grow(w->cols, &w->maxcols, w->ncols, sizeof(*w->cols));
+
+	col = &w->cols[w->ncols];
+	memset(col, 0, sizeof(*col));
+	col->name = add_string(w, name);
+	col->regbase = regbase;
+	col->flags = flags;
+	col->first_row = w->nrows;
+
+	return w->ncols++;
+}
+
+void colfile_set(struct colfile_writer *w, int col, uint32_t val)
+{
+	w->cols[col].cur = val;
+}
+
+void colfile_set_string(struct colfile_writer *w, int col, const char *str)
+{
+	unsigned i;
+
+	if (!str)
+		str = "";
+
+	for (i = 0; i < w->nstrs; i++) {
+		if (!strcmp(w->strtab + w->strs[i], str)) {
+			w->cols[col].cur = w->strs[i];
+			return;
+		}
+	}
+
+	w->strs = grow(w->strs, &w->maxstrs, w->nstrs, sizeof(*w->strs));
+	w->strs[w->nstrs++] = w->cols[col].cur = add_string(w, str);
+}
+
+void colfile_end_row(struct colfile_writer *w)
+{
+	unsigned i;
+
+	for (i = 0; i < w->ncols; i++) {
+		struct wcol *col = &w->cols[i];
+		col->vals = grow(col->vals, &col->maxvals, col->nvals, sizeof(uint32_t));
+		col->vals[col->nvals++] = col->cur;
+	}
+
+	w->nrows++;
+}
+
+static int write_at(FILE *f, uint64_t offset, const void *buf, size_t sz)
+{
+	if (!sz)
+		return 0;
+	if (fseek(f, offset, SEEK_SET))
+		return -1;
+	return (fwrite(buf, sz, 1, f) == 1) ? 0 : -1;
+}
+
+static uint64_t align8(uint64_t offset)
+{
+	return (offset + 7) & ~7ull;
+}
+
+static uint32_t hash(uint32_t val)
+{
+	val ^= val >> 16;
+	val *= 0x7feb352d;
+	val ^= val >> 15;
+	return val;
+}
+
+/* build the dictionary of distinct values, returns the number of them,
+ * or zero if there are too many for 16 bit indices to be worth it.  The
+ * indices are written to idx:
+ */
+static uint32_t build_dict(const uint32_t *vals, uint32_t n,
+		uint32_t *dict, uint32_t *idx)
+{
+	uint32_t limit = (n / 2 < 0x10000) ? n / 2 : 0x10000;
+	uint32_t size = 16, mask, ndict = 0, i;
+	int32_t *table;
+
+	while (size < 2 * limit)
+		size *= 2;
+	mask = size - 1;
+
+	table = malloc(size * sizeof(*table));
+	assert(table);
+	memset(table, 0xff, size * sizeof(*table));
+
+	for (i = 0; i < n; i++) {
+		uint32_t h = hash(vals[i]) & mask;
+
+		while ((table[h] >= 0) && (dict[table[h]] != vals[i]))
+			h = (h + 1) & mask;
+
+		if (table[h] < 0) {
+			if (ndict == limit) {
+				ndict = 0;
+				break;
+			}
+			table[h] = ndict;
+			dict[ndict++] = vals[i];
+		}
+
+		idx[i] = table[h];
+	}
+
+	free(table);
+
+	return ndict;
+}
+
+int colfile_save(struct colfile_writer *w, const char *filename,
+		uint32_t gpu_id)
+{
+	struct colfile_header hdr = {
+			.magic = COLFILE_MAGIC,
+			.version = COLFILE_VERSION,
+			.gpu_id = gpu_id,
+			.nrows = w->nrows,
+			.ncols = w->ncols,
+			.strtab_size = w->strtab_size,
+	};
+	struct colfile_column *cols;
+	uint32_t *dict = NULL, *idx = NULL;
+	void *data = NULL;
+	uint64_t offset;
+	char *tmppath;
+	unsigned i;
+	FILE *f;
+	int ret = -1;
+
+	if (asprintf(&tmppath, "%s.tmp", filename) < 0)
+		return -1;
+
+	f = fopen(tmppath, "w");
+	if (!f) {
+		free(tmppath);
+		return -1;
+	}
+
+	cols = calloc(w->ncols + 1, sizeof(*cols));
+	dict = malloc((w->nrows + 1) * sizeof(*dict));
+	idx = malloc((w->nrows + 1) * sizeof(*idx));
+	data = malloc((w->nrows + 1) * sizeof(uint32_t));
+	assert(cols && dict && idx && data);
+
+	offset = sizeof(hdr) + w->ncols * sizeof(*cols);
+	hdr.strtab_offset = offset;
+	if (write_at(f, offset, w->strtab, w->strtab_size))
+		goto out;
+	offset = align8(offset + w->strtab_size);
+
+	for (i = 0; i < w->ncols; i++) {
+		struct wcol *wc = &w->cols[i];
+		struct colfile_column *col = &cols[i];
+		uint32_t n = wc->nvals, j;
+
+		col->name = wc->name;
+		col->regbase = wc->regbase;
+		col->flags = wc->flags;
+		col->first_row = wc->first_row;
+		col->ndict = build_dict(wc->vals, n, dict, idx);
+
+		if (!col->ndict) {
+			col->width = 4;
+			memcpy(data, wc->vals, n * 4);
+		} else if (col->ndict <= 0x100) {
+			col->width = 1;
+			for (j = 0; j < n; j++)
+				((uint8_t *)data)[j] = idx[j];
+		} else {
+			col->width = 2;
+			for (j = 0; j < n; j++)
+				((uint16_t *)data)[j] = idx[j];
+		}
+
+		col->dict_offset = offset;
+		if (write_at(f, offset, dict, col->ndict * sizeof(*dict)))
+			goto out;
+		offset = align8(offset + col->ndict * sizeof(*dict));
+
+		col->data_offset = offset;
+		if (write_at(f, offset, data, n * col->width))
+			goto out;
+		offset = align8(offset + n * col->width);
+	}
+
+	if (write_at(f, sizeof(hdr), cols, w->ncols * sizeof(*cols)) ||
+			write_at(f, 0, &hdr, sizeof(hdr)))
+		goto out;
+
+	ret = 0;
+
+out:
+	if (fclose(f))
+		ret = -1;
+	if (!ret)
+		ret = rename(tmppath, filename);
+	if (ret)
+		unlink(tmppath);
+
+	free(tmppath);
+	free(cols);
+	free(dict);
+	free(idx);
+	free(data);
+
+	return ret;
+}
+
+/*
+ * Reader:
+ */
+
+struct colfile {
+	void *map;
+	size_t size;
+	const struct colfile_header *hdr;
+	const struct colfile_column *cols;
+	const char *strtab;
+};
+
+static int valid_range(struct colfile *f, uint64_t offset, uint64_t sz)
+{
+	return (offset <= f->size) && (sz <= (f->size - offset));
+}
+
+struct colfile * colfile_open(const char *filename)
+{
+	struct colfile *f;
+	struct stat st;
+	uint32_t i;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) || (st.st_size < sizeof(struct colfile_header))) {
+		close(fd);
+		return NULL;
+	}
+
+	f = calloc(1, sizeof(*f));
+	f->size = st.st_size;
+	f->map = mmap(NULL, f->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (f->map == MAP_FAILED) {
+		free(f);
+		return NULL;
+	}
+
+	f->hdr = f->map;
+	f->cols = (const void *)(f->hdr + 1);
+	f->strtab = (const char *)f->map + f->hdr->strtab_offset;
+
+	if ((f->hdr->magic != COLFILE_MAGIC) ||
+			(f->hdr->version != COLFILE_VERSION) ||
+			!valid_range(f, sizeof(*f->hdr),
+					(uint64_t)f->hdr->ncols * sizeof(*f->cols)) ||
+			!valid_range(f, f->hdr->strtab_offset, f->hdr->strtab_size) ||
+			!f->hdr->strtab_size ||
+			f->strtab[f->hdr->strtab_size - 1])
+		goto fail;
+
+	for (i = 0; i < f->hdr->ncols; i++) {
+		const struct colfile_column *col = &f->cols[i];
+
+		if ((col->name >= f->hdr->strtab_size) ||
+				(col->first_row > f->hdr->nrows) ||
+				!((col->width == 4) ||
+					((col->width == 1) && (col->ndict <= 0x100)) ||
+					((col->width == 2) && (col->ndict <= 0x10000))) ||
+				((col->width == 4) && col->ndict) ||
+				!valid_range(f, col->dict_offset,
+						(uint64_t)col->ndict * 4) ||
+				!valid_range(f, col->data_offset, (uint64_t)col->width *
+						(f->hdr->nrows - col->first_row)))
+			goto fail;
+	}
+
+	return f;
+
+fail:
+	colfile_close(f);
+	return NULL;
+}
+
+void colfile_close(struct colfile *f)
+{
+	if (!f)
+		return;
+	munmap(f->map, f->size);
+	free(f);
+}
+
+uint32_t colfile_gpu_id(struct colfile *f)
+{
+	return f->hdr->gpu_id;
+}
+
+uint32_t colfile_nrows(struct colfile *f)
+{
+	return f->hdr->nrows;
+}
+
+uint32_t colfile_ncols(struct colfile *f)
+{
+	return f->hdr->ncols;
+}
+
+int colfile_find(struct colfile *f, const char *name)
+{
+	uint32_t i;
+
+	for (i = 0; i < f->hdr->ncols; i++)
+		if (!strcmp(f->strtab + f->cols[i].name, name))
+			return i;
+
+	return -1;
+}
+
+int colfile_find_reg(struct colfile *f, uint32_t regbase)
+{
+	uint32_t i;
+
+	for (i = 0; i < f->hdr->ncols; i++)
+		if (f->cols[i].regbase == regbase)
+			return i;
+
+	return -1;
+}
+
+const char * colfile_name(struct colfile *f, int col)
+{
+	return f->strtab + f->cols[col].name;
+}
+
+uint32_t colfile_regbase(struct colfile *f, int col)
+{
+	return f->cols[col].regbase;
+}
+
+int colfile_is_string(struct colfile *f, int col)
+{
+	return !!(f->cols[col].flags & COLFILE_STRING);
+}
+
+int colfile_has_val(struct colfile *f, int col, uint32_t row)
+{
+	return (f->cols[col].first_row <= row) && (row < f->hdr->nrows);
+}
+
+uint32_t colfile_val(struct colfile *f, int col, uint32_t row)
+{
+	const struct colfile_column *c = &f->cols[col];
+	const uint8_t *data = (const uint8_t *)f->map + c->data_offset;
+	const uint32_t *dict = (const void *)((const uint8_t *)f->map + c->dict_offset);
+	uint32_t i;
+
+	if (!colfile_has_val(f, col, row))
+		return 0;
+
+	row -= c->first_row;
+
+	switch (c->width) {
+	case 1:
+		i = data[row];
+		break;
+	case 2:
+		i = ((const uint16_t *)data)[row];
+		break;
+	default:
+		return ((const uint32_t *)data)[row];
+	}
+
+	/* a corrupt index reads as zero rather than off the end: */
+	return (i < c->ndict) ? dict[i] : 0;
+}
+
+const char * colfile_string(struct colfile *f, int col, uint32_t row)
+{
+	uint32_t off;
+
+	if (!colfile_has_val(f, col, row))
+		return NULL;
+
+	off = colfile_val(f, col, row);
+	if (off >= f->hdr->strtab_size)
+		return NULL;
+
+	return f->strtab + off;
+}
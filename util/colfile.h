@@ -0,0 +1,109 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#ifndef COLFILE_H_
+#define COLFILE_H_
+
+#include <stdint.h>
+
+/* Columnar per-draw state file (foo.rd.cols), written by cffdump --export,
+ * so that questions about the state at each draw can be answered by
+ * cffquery (or a script) without decoding the .rd file again.
+ *
+ * There is one row per draw/blit/dispatch (in the same order as the
+ * "draw[N]" of cffdump's output), and a column for each register which
+ * was written plus a few columns about the draw itself (primtype,
+ * num_indices, etc).  Register columns hold the register value at each
+ * draw, and are unwritten for the rows before the register was first
+ * written.
+ *
+ * Each column is stored as an array of values, or (if it has few
+ * enough distinct values, which is the common case for registers) as
+ * an array of 8 or 16 bit indices into a dictionary of values.  The
+ * file is mmap'd for reading, so any cell can be read in constant time
+ * without reading the rest of the file.
+ */
+
+#define COLFILE_STRING 0x1   /* values are strings (ie. primtype) */
+#define COLFILE_NOREG  0xffffffff
+
+/*
+ * Writer:
+ */
+
+struct colfile_writer;
+
+struct colfile_writer * colfile_writer_new(void);
+void colfile_writer_free(struct colfile_writer *w);
+
+/* add a column, returns the column index.  A column has no value for
+ * the rows before it was added:
+ */
+int colfile_add_column(struct colfile_writer *w, const char *name,
+		uint32_t regbase, uint32_t flags);
+
+/* set the value of a column for the current row, columns keep their
+ * value from the previous row unless set:
+ */
+void colfile_set(struct colfile_writer *w, int col, uint32_t val);
+void colfile_set_string(struct colfile_writer *w, int col, const char *str);
+
+/* finish the current row and start the next one: */
+void colfile_end_row(struct colfile_writer *w);
+
+/* returns zero on success: */
+int colfile_save(struct colfile_writer *w, const char *filename,
+		uint32_t gpu_id);
+
+/*
+ * Reader:
+ */
+
+struct colfile;
+
+struct colfile * colfile_open(const char *filename);
+void colfile_close(struct colfile *f);
+
+uint32_t colfile_gpu_id(struct colfile *f);
+uint32_t colfile_nrows(struct colfile *f);
+uint32_t colfile_ncols(struct colfile *f);
+
+/* returns the column index, or -1 if there is no such column: */
+int colfile_find(struct colfile *f, const char *name);
+int colfile_find_reg(struct colfile *f, uint32_t regbase);
+const char * colfile_name(struct colfile *f, int col);
+uint32_t colfile_regbase(struct colfile *f, int col);
+int colfile_is_string(struct colfile *f, int col);
+
+/* whether the column has a value for the row: */
+int colfile_has_val(struct colfile *f, int col, uint32_t row);
+/* returns zero (or NULL) if there is no value: */
+uint32_t colfile_val(struct colfile *f, int col, uint32_t row);
+const char * colfile_string(struct colfile *f, int col, uint32_t row);
+
+#endif /* COLFILE_H_ */
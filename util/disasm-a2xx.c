@@ -52,6 +52,7 @@ static const char *levels[] = {
 };
 
 enum debug_t debug;
+FILE *disasm_out;
 
 /*
  * ALU instructions:
@@ -67,30 +68,30 @@ static void print_srcreg(uint32_t num, uint32_t type,
 		uint32_t swiz, uint32_t negate, uint32_t abs)
 {
 	if (negate)
-		printf("-");
+		fprintf(disasm_out, "-");
 	if (abs)
-		printf("|");
-	printf("%c%u", type ? 'R' : 'C', num);
+		fprintf(disasm_out, "|");
+	fprintf(disasm_out, "%c%u", type ? 'R' : 'C', num);
 	if (swiz) {
 		int i;
-		printf(".");
+		fprintf(disasm_out, ".");
 		for (i = 0; i < 4; i++) {
-			printf("%c", chan_names[(swiz + i) & 0x3]);
+			fprintf(disasm_out, "%c", chan_names[(swiz + i) & 0x3]);
 			swiz >>= 2;
 		}
 	}
 	if (abs)
-		printf("|");
+		fprintf(disasm_out, "|");
 }
 
 static void print_dstreg(uint32_t num, uint32_t mask, uint32_t dst_exp)
 {
-	printf("%s%u", dst_exp ? "export" : "R", num);
+	fprintf(disasm_out, "%s%u", dst_exp ? "export" : "R", num);
 	if (mask != 0xf) {
 		int i;
-		printf(".");
+		fprintf(disasm_out, ".");
 		for (i = 0; i < 4; i++) {
-			printf("%c", (mask & 0x1) ? chan_names[i] : '_');
+			fprintf(disasm_out, "%c", (mask & 0x1) ? chan_names[i] : '_');
 			mask >>= 1;
 		}
 	}
@@ -118,7 +119,7 @@ static void print_export_comment(uint32_t num, enum shader_t type)
 	 * up the name of the varying..
 	 */
 	if (name) {
-		printf("\t; %s", name);
+		fprintf(disasm_out, "\t; %s", name);
 	}
 }
 
@@ -216,71 +217,71 @@ static int disasm_alu(uint32_t *dwords, uint32_t alu_off,
 {
 	instr_alu_t *alu = (instr_alu_t *)dwords;
 
-	printf("%s", levels[level]);
+	fprintf(disasm_out, "%s", levels[level]);
 	if (debug & PRINT_RAW) {
-		printf("%02x: %08x %08x %08x\t", alu_off,
+		fprintf(disasm_out, "%02x: %08x %08x %08x\t", alu_off,
 				dwords[0], dwords[1], dwords[2]);
 	}
 
-	printf("   %sALU:\t", sync ? "(S)" : "   ");
+	fprintf(disasm_out, "   %sALU:\t", sync ? "(S)" : "   ");
 
-	printf("%s", vector_instructions[alu->vector_opc].name);
+	fprintf(disasm_out, "%s", vector_instructions[alu->vector_opc].name);
 
 	if (alu->pred_select & 0x2) {
 		/* seems to work similar to conditional execution in ARM instruction
 		 * set, so let's use a similar syntax for now:
 		 */
-		printf((alu->pred_select & 0x1) ? "EQ" : "NE");
+		fprintf(disasm_out, (alu->pred_select & 0x1) ? "EQ" : "NE");
 	}
 
-	printf("\t");
+	fprintf(disasm_out, "\t");
 
 	print_dstreg(alu->vector_dest, alu->vector_write_mask, alu->export_data);
-	printf(" = ");
+	fprintf(disasm_out, " = ");
 	if (vector_instructions[alu->vector_opc].num_srcs == 3) {
 		print_srcreg(alu->src3_reg, alu->src3_sel, alu->src3_swiz,
 				alu->src3_reg_negate, alu->src3_reg_abs);
-		printf(", ");
+		fprintf(disasm_out, ", ");
 	}
 	print_srcreg(alu->src1_reg, alu->src1_sel, alu->src1_swiz,
 			alu->src1_reg_negate, alu->src1_reg_abs);
 	if (vector_instructions[alu->vector_opc].num_srcs > 1) {
-		printf(", ");
+		fprintf(disasm_out, ", ");
 		print_srcreg(alu->src2_reg, alu->src2_sel, alu->src2_swiz,
 				alu->src2_reg_negate, alu->src2_reg_abs);
 	}
 
 	if (alu->vector_clamp)
-		printf(" CLAMP");
+		fprintf(disasm_out, " CLAMP");
 
 	if (alu->export_data)
 		print_export_comment(alu->vector_dest, type);
 
-	printf("\n");
+	fprintf(disasm_out, "\n");
 
 	if (alu->scalar_write_mask || !alu->vector_write_mask) {
 		/* 2nd optional scalar op: */
 
-		printf("%s", levels[level]);
+		fprintf(disasm_out, "%s", levels[level]);
 		if (debug & PRINT_RAW)
-			printf("                          \t");
+			fprintf(disasm_out, "                          \t");
 
 		if (scalar_instructions[alu->scalar_opc].name) {
-			printf("\t    \t%s\t", scalar_instructions[alu->scalar_opc].name);
+			fprintf(disasm_out, "\t    \t%s\t", scalar_instructions[alu->scalar_opc].name);
 		} else {
-			printf("\t    \tOP(%u)\t", alu->scalar_opc);
+			fprintf(disasm_out, "\t    \tOP(%u)\t", alu->scalar_opc);
 		}
 
 		print_dstreg(alu->scalar_dest, alu->scalar_write_mask, alu->export_data);
-		printf(" = ");
+		fprintf(disasm_out, " = ");
 		print_srcreg(alu->src3_reg, alu->src3_sel, alu->src3_swiz,
 				alu->src3_reg_negate, alu->src3_reg_abs);
 		// TODO ADD/MUL must have another src?!?
 		if (alu->scalar_clamp)
-			printf(" CLAMP");
+			fprintf(disasm_out, " CLAMP");
 		if (alu->export_data)
 			print_export_comment(alu->scalar_dest, type);
-		printf("\n");
+		fprintf(disasm_out, "\n");
 	}
 
 	return 0;
@@ -315,9 +316,9 @@ struct {
 static void print_fetch_dst(uint32_t dst_reg, uint32_t dst_swiz)
 {
 	int i;
-	printf("\tR%u.", dst_reg);
+	fprintf(disasm_out, "\tR%u.", dst_reg);
 	for (i = 0; i < 4; i++) {
-		printf("%c", chan_names[dst_swiz & 0x7]);
+		fprintf(disasm_out, "%c", chan_names[dst_swiz & 0x7]);
 		dst_swiz >>= 3;
 	}
 }
@@ -330,31 +331,31 @@ static void print_fetch_vtx(instr_fetch_t *fetch)
 		/* seems to work similar to conditional execution in ARM instruction
 		 * set, so let's use a similar syntax for now:
 		 */
-		printf(vtx->pred_condition ? "EQ" : "NE");
+		fprintf(disasm_out, vtx->pred_condition ? "EQ" : "NE");
 	}
 
 	print_fetch_dst(vtx->dst_reg, vtx->dst_swiz);
-	printf(" = R%u.", vtx->src_reg);
-	printf("%c", chan_names[vtx->src_swiz & 0x3]);
+	fprintf(disasm_out, " = R%u.", vtx->src_reg);
+	fprintf(disasm_out, "%c", chan_names[vtx->src_swiz & 0x3]);
 	if (fetch_types[vtx->format].name) {
-		printf(" %s", fetch_types[vtx->format].name);
+		fprintf(disasm_out, " %s", fetch_types[vtx->format].name);
 	} else  {
-		printf(" TYPE(0x%x)", vtx->format);
+		fprintf(disasm_out, " TYPE(0x%x)", vtx->format);
 	}
-	printf(" %s", vtx->format_comp_all ? "SIGNED" : "UNSIGNED");
+	fprintf(disasm_out, " %s", vtx->format_comp_all ? "SIGNED" : "UNSIGNED");
 	if (!vtx->num_format_all)
-		printf(" NORMALIZED");
-	printf(" STRIDE(%u)", vtx->stride);
+		fprintf(disasm_out, " NORMALIZED");
+	fprintf(disasm_out, " STRIDE(%u)", vtx->stride);
 	if (vtx->offset)
-		printf(" OFFSET(%u)", vtx->offset);
-	printf(" CONST(%u, %u)", vtx->const_index, vtx->const_index_sel);
+		fprintf(disasm_out, " OFFSET(%u)", vtx->offset);
+	fprintf(disasm_out, " CONST(%u, %u)", vtx->const_index, vtx->const_index_sel);
 	if (0) {
 		// XXX
-		printf(" src_reg_am=%u", vtx->src_reg_am);
-		printf(" dst_reg_am=%u", vtx->dst_reg_am);
-		printf(" num_format_all=%u", vtx->num_format_all);
-		printf(" signed_rf_mode_all=%u", vtx->signed_rf_mode_all);
-		printf(" exp_adjust_all=%u", vtx->exp_adjust_all);
+		fprintf(disasm_out, " src_reg_am=%u", vtx->src_reg_am);
+		fprintf(disasm_out, " dst_reg_am=%u", vtx->dst_reg_am);
+		fprintf(disasm_out, " num_format_all=%u", vtx->num_format_all);
+		fprintf(disasm_out, " signed_rf_mode_all=%u", vtx->signed_rf_mode_all);
+		fprintf(disasm_out, " exp_adjust_all=%u", vtx->exp_adjust_all);
 	}
 }
 
@@ -393,46 +394,46 @@ static void print_fetch_tex(instr_fetch_t *fetch)
 		/* seems to work similar to conditional execution in ARM instruction
 		 * set, so let's use a similar syntax for now:
 		 */
-		printf(tex->pred_condition ? "EQ" : "NE");
+		fprintf(disasm_out, tex->pred_condition ? "EQ" : "NE");
 	}
 
 	print_fetch_dst(tex->dst_reg, tex->dst_swiz);
-	printf(" = R%u.", tex->src_reg);
+	fprintf(disasm_out, " = R%u.", tex->src_reg);
 	for (i = 0; i < 3; i++) {
-		printf("%c", chan_names[src_swiz & 0x3]);
+		fprintf(disasm_out, "%c", chan_names[src_swiz & 0x3]);
 		src_swiz >>= 2;
 	}
-	printf(" CONST(%u)", tex->const_idx);
+	fprintf(disasm_out, " CONST(%u)", tex->const_idx);
 	if (tex->fetch_valid_only)
-		printf(" VALID_ONLY");
+		fprintf(disasm_out, " VALID_ONLY");
 	if (tex->tx_coord_denorm)
-		printf(" DENORM");
+		fprintf(disasm_out, " DENORM");
 	if (tex->mag_filter != TEX_FILTER_USE_FETCH_CONST)
-		printf(" MAG(%s)", filter[tex->mag_filter]);
+		fprintf(disasm_out, " MAG(%s)", filter[tex->mag_filter]);
 	if (tex->min_filter != TEX_FILTER_USE_FETCH_CONST)
-		printf(" MIN(%s)", filter[tex->min_filter]);
+		fprintf(disasm_out, " MIN(%s)", filter[tex->min_filter]);
 	if (tex->mip_filter != TEX_FILTER_USE_FETCH_CONST)
-		printf(" MIP(%s)", filter[tex->mip_filter]);
+		fprintf(disasm_out, " MIP(%s)", filter[tex->mip_filter]);
 	if (tex->aniso_filter != ANISO_FILTER_USE_FETCH_CONST)
-		printf(" ANISO(%s)", aniso_filter[tex->aniso_filter]);
+		fprintf(disasm_out, " ANISO(%s)", aniso_filter[tex->aniso_filter]);
 	if (tex->arbitrary_filter != ARBITRARY_FILTER_USE_FETCH_CONST)
-		printf(" ARBITRARY(%s)", arbitrary_filter[tex->arbitrary_filter]);
+		fprintf(disasm_out, " ARBITRARY(%s)", arbitrary_filter[tex->arbitrary_filter]);
 	if (tex->vol_mag_filter != TEX_FILTER_USE_FETCH_CONST)
-		printf(" VOL_MAG(%s)", filter[tex->vol_mag_filter]);
+		fprintf(disasm_out, " VOL_MAG(%s)", filter[tex->vol_mag_filter]);
 	if (tex->vol_min_filter != TEX_FILTER_USE_FETCH_CONST)
-		printf(" VOL_MIN(%s)", filter[tex->vol_min_filter]);
+		fprintf(disasm_out, " VOL_MIN(%s)", filter[tex->vol_min_filter]);
 	if (!tex->use_comp_lod) {
-		printf(" LOD(%u)", tex->use_comp_lod);
-		printf(" LOD_BIAS(%u)", tex->lod_bias);
+		fprintf(disasm_out, " LOD(%u)", tex->use_comp_lod);
+		fprintf(disasm_out, " LOD_BIAS(%u)", tex->lod_bias);
 	}
 	if (tex->use_reg_lod) {
-		printf(" REG_LOD(%u)", tex->use_reg_lod);
+		fprintf(disasm_out, " REG_LOD(%u)", tex->use_reg_lod);
 	}
 	if (tex->use_reg_gradients)
-		printf(" USE_REG_GRADIENTS");
-	printf(" LOCATION(%s)", sample_loc[tex->sample_location]);
+		fprintf(disasm_out, " USE_REG_GRADIENTS");
+	fprintf(disasm_out, " LOCATION(%s)", sample_loc[tex->sample_location]);
 	if (tex->offset_x || tex->offset_y || tex->offset_z)
-		printf(" OFFSET(%u,%u,%u)", tex->offset_x, tex->offset_y, tex->offset_z);
+		fprintf(disasm_out, " OFFSET(%u,%u,%u)", tex->offset_x, tex->offset_y, tex->offset_z);
 }
 
 struct {
@@ -457,16 +458,16 @@ static int disasm_fetch(uint32_t *dwords, uint32_t alu_off, int level, int sync)
 {
 	instr_fetch_t *fetch = (instr_fetch_t *)dwords;
 
-	printf("%s", levels[level]);
+	fprintf(disasm_out, "%s", levels[level]);
 	if (debug & PRINT_RAW) {
-		printf("%02x: %08x %08x %08x\t", alu_off,
+		fprintf(disasm_out, "%02x: %08x %08x %08x\t", alu_off,
 				dwords[0], dwords[1], dwords[2]);
 	}
 
-	printf("   %sFETCH:\t", sync ? "(S)" : "   ");
-	printf("%s", fetch_instructions[fetch->opc].name);
+	fprintf(disasm_out, "   %sFETCH:\t", sync ? "(S)" : "   ");
+	fprintf(disasm_out, "%s", fetch_instructions[fetch->opc].name);
 	fetch_instructions[fetch->opc].fxn(fetch);
-	printf("\n");
+	fprintf(disasm_out, "\n");
 
 	return 0;
 }
@@ -503,37 +504,37 @@ static void print_cf_nop(instr_cf_t *cf)
 
 static void print_cf_exec(instr_cf_t *cf)
 {
-	printf(" ADDR(0x%x) CNT(0x%x)", cf->exec.address, cf->exec.count);
+	fprintf(disasm_out, " ADDR(0x%x) CNT(0x%x)", cf->exec.address, cf->exec.count);
 	if (cf->exec.yeild)
-		printf(" YIELD");
+		fprintf(disasm_out, " YIELD");
 	if (cf->exec.vc)
-		printf(" VC(0x%x)", cf->exec.vc);
+		fprintf(disasm_out, " VC(0x%x)", cf->exec.vc);
 	if (cf->exec.bool_addr)
-		printf(" BOOL_ADDR(0x%x)", cf->exec.bool_addr);
+		fprintf(disasm_out, " BOOL_ADDR(0x%x)", cf->exec.bool_addr);
 	if (cf->exec.address_mode == ABSOLUTE_ADDR)
-		printf(" ABSOLUTE_ADDR");
+		fprintf(disasm_out, " ABSOLUTE_ADDR");
 	if (cf_cond_exec(cf))
-		printf(" COND(%d)", cf->exec.condition);
+		fprintf(disasm_out, " COND(%d)", cf->exec.condition);
 }
 
 static void print_cf_loop(instr_cf_t *cf)
 {
-	printf(" ADDR(0x%x) LOOP_ID(%d)", cf->loop.address, cf->loop.loop_id);
+	fprintf(disasm_out, " ADDR(0x%x) LOOP_ID(%d)", cf->loop.address, cf->loop.loop_id);
 	if (cf->loop.address_mode == ABSOLUTE_ADDR)
-		printf(" ABSOLUTE_ADDR");
+		fprintf(disasm_out, " ABSOLUTE_ADDR");
 }
 
 static void print_cf_jmp_call(instr_cf_t *cf)
 {
-	printf(" ADDR(0x%x) DIR(%d)", cf->jmp_call.address, cf->jmp_call.direction);
+	fprintf(disasm_out, " ADDR(0x%x) DIR(%d)", cf->jmp_call.address, cf->jmp_call.direction);
 	if (cf->jmp_call.force_call)
-		printf(" FORCE_CALL");
+		fprintf(disasm_out, " FORCE_CALL");
 	if (cf->jmp_call.predicated_jmp)
-		printf(" COND(%d)", cf->jmp_call.condition);
+		fprintf(disasm_out, " COND(%d)", cf->jmp_call.condition);
 	if (cf->jmp_call.bool_addr)
-		printf(" BOOL_ADDR(0x%x)", cf->jmp_call.bool_addr);
+		fprintf(disasm_out, " BOOL_ADDR(0x%x)", cf->jmp_call.bool_addr);
 	if (cf->jmp_call.address_mode == ABSOLUTE_ADDR)
-		printf(" ABSOLUTE_ADDR");
+		fprintf(disasm_out, " ABSOLUTE_ADDR");
 }
 
 static void print_cf_alloc(instr_cf_t *cf)
@@ -544,11 +545,11 @@ static void print_cf_alloc(instr_cf_t *cf)
 			[SQ_PARAMETER_PIXEL] = "PARAM/PIXEL",
 			[SQ_MEMORY] = "MEMORY",
 	};
-	printf(" %s SIZE(0x%x)", bufname[cf->alloc.buffer_select], cf->alloc.size);
+	fprintf(disasm_out, " %s SIZE(0x%x)", bufname[cf->alloc.buffer_select], cf->alloc.size);
 	if (cf->alloc.no_serial)
-		printf(" NO_SERIAL");
+		fprintf(disasm_out, " NO_SERIAL");
 	if (cf->alloc.alloc_mode) // ???
-		printf(" ALLOC_MODE");
+		fprintf(disasm_out, " ALLOC_MODE");
 }
 
 struct {
@@ -577,15 +578,15 @@ struct {
 
 static void print_cf(instr_cf_t *cf, int level)
 {
-	printf("%s", levels[level]);
+	fprintf(disasm_out, "%s", levels[level]);
 	if (debug & PRINT_RAW) {
 		uint16_t *words = (uint16_t *)cf;
-		printf("    %04x %04x %04x            \t",
+		fprintf(disasm_out, "    %04x %04x %04x            \t",
 				words[0], words[1], words[2]);
 	}
-	printf("%s", cf_instructions[cf->opc].name);
+	fprintf(disasm_out, "%s", cf_instructions[cf->opc].name);
 	cf_instructions[cf->opc].fxn(cf);
-	printf("\n");
+	fprintf(disasm_out, "\n");
 }
 
 /*
@@ -600,6 +601,11 @@ int disasm_a2xx(uint32_t *dwords, int sizedwords, int level, enum shader_t type)
 	instr_cf_t *cfs = (instr_cf_t *)dwords;
 	int idx, max_idx;
 
+	if (!disasm_out)
+		disasm_out = stdout;
+
+	memset(&disasm_stats, 0, sizeof(disasm_stats));
+
 	for (idx = 0; ; idx++) {
 		instr_cf_t *cf = &cfs[idx];
 		if (cf_exec(cf)) {
@@ -625,6 +631,7 @@ int disasm_a2xx(uint32_t *dwords, int sizedwords, int level, enum shader_t type)
 				}
 				sequence >>= 2;
 			}
+			disasm_stats.instrs += cf->exec.count;
 		}
 	}
 
@@ -635,3 +642,8 @@ void disasm_set_debug(enum debug_t d)
 {
 	debug = d;
 }
+
+void disasm_set_output(FILE *f)
+{
+	disasm_out = f;
+}
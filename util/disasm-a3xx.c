@@ -32,6 +32,7 @@
 #include "instr-a3xx.h"
 
 extern enum debug_t debug;
+extern FILE *disasm_out;
 
 static const char *levels[] = {
 		"",
@@ -52,6 +53,8 @@ static const char *levels[] = {
 		"x",
 };
 
+struct shader_stats disasm_stats;
+
 static const char *component = "xyzw";
 
 static const char *type[] = {
@@ -74,33 +77,33 @@ static void print_reg(reg_t reg, bool full, bool r, bool c, bool im,
 	// by libllvm-a3xx for easy diffing..
 
 	if (abs && neg)
-		printf("(absneg)");
+		fprintf(disasm_out, "(absneg)");
 	else if (neg)
-		printf("(neg)");
+		fprintf(disasm_out, "(neg)");
 	else if (abs)
-		printf("(abs)");
+		fprintf(disasm_out, "(abs)");
 
 	if (r)
-		printf("(r)");
+		fprintf(disasm_out, "(r)");
 
 	if (im) {
-		printf("%d", reg.iim_val);
+		fprintf(disasm_out, "%d", reg.iim_val);
 	} else if (addr_rel) {
 		/* I would just use %+d but trying to make it diff'able with
 		 * libllvm-a3xx...
 		 */
 		if (reg.iim_val < 0)
-			printf("%s%c<a0.x - %d>", full ? "" : "h", type, -reg.iim_val);
+			fprintf(disasm_out, "%s%c<a0.x - %d>", full ? "" : "h", type, -reg.iim_val);
 		else if (reg.iim_val > 0)
-			printf("%s%c<a0.x + %d>", full ? "" : "h", type, reg.iim_val);
+			fprintf(disasm_out, "%s%c<a0.x + %d>", full ? "" : "h", type, reg.iim_val);
 		else
-			printf("%s%c<a0.x>", full ? "" : "h", type);
+			fprintf(disasm_out, "%s%c<a0.x>", full ? "" : "h", type);
 	} else if ((reg.num == REG_A0) && !c) {
-		printf("a0.%c", component[reg.comp]);
+		fprintf(disasm_out, "a0.%c", component[reg.comp]);
 	} else if ((reg.num == REG_P0) && !c) {
-		printf("p0.%c", component[reg.comp]);
+		fprintf(disasm_out, "p0.%c", component[reg.comp]);
 	} else {
-		printf("%s%c%d.%c", full ? "" : "h", type, reg.num & 0x3f, component[reg.comp]);
+		fprintf(disasm_out, "%s%c%d.%c", full ? "" : "h", type, reg.num & 0x3f, component[reg.comp]);
 	}
 }
 
@@ -168,9 +171,9 @@ static void print_regs(regmask_t *regmask, bool full)
 	{
 		if (first != MAX_REG) {
 			if (first == last) {
-				printf(" %d", first);
+				fprintf(disasm_out, " %d", first);
 			} else {
-				printf(" %d-%d", first, last);
+				fprintf(disasm_out, " %d-%d", first, last);
 			}
 		}
 	}
@@ -191,36 +194,48 @@ static void print_regs(regmask_t *regmask, bool full)
 
 	print_sequence();
 
-	printf(" (cnt=%d, max=%d)", cnt, max);
+	fprintf(disasm_out, " (cnt=%d, max=%d)", cnt, max);
 }
 
 static void print_reg_stats(int level)
 {
-	printf("%sRegister Stats:\n", levels[level]);
-	printf("%s- used (half):", levels[level]);
+	fprintf(disasm_out, "%sRegister Stats:\n", levels[level]);
+	fprintf(disasm_out, "%s- used (half):", levels[level]);
 	print_regs(&regs.used, false);
-	printf("\n");
-	printf("%s- used (full):", levels[level]);
+	fprintf(disasm_out, "\n");
+	fprintf(disasm_out, "%s- used (full):", levels[level]);
 	print_regs(&regs.used, true);
-	printf("\n");
-	printf("%s- input (half):", levels[level]);
+	fprintf(disasm_out, "\n");
+	fprintf(disasm_out, "%s- input (half):", levels[level]);
 	print_regs(&regs.rbw, false);
-	printf("\n");
-	printf("%s- input (full):", levels[level]);
+	fprintf(disasm_out, "\n");
+	fprintf(disasm_out, "%s- input (full):", levels[level]);
 	print_regs(&regs.rbw, true);
-	printf("\n");
-	printf("%s- const (half):", levels[level]);
+	fprintf(disasm_out, "\n");
+	fprintf(disasm_out, "%s- const (half):", levels[level]);
 	print_regs(&regs.cnst, false);
-	printf("\n");
-	printf("%s- const (full):", levels[level]);
+	fprintf(disasm_out, "\n");
+	fprintf(disasm_out, "%s- const (full):", levels[level]);
 	print_regs(&regs.cnst, true);
-	printf("\n");
-	printf("%s- output (half):", levels[level]);
+	fprintf(disasm_out, "\n");
+	fprintf(disasm_out, "%s- output (half):", levels[level]);
 	print_regs(&regs.war, false);
-	printf("  (estimated)\n");
-	printf("%s- output (full):", levels[level]);
+	fprintf(disasm_out, "  (estimated)\n");
+	fprintf(disasm_out, "%s- output (full):", levels[level]);
 	print_regs(&regs.war, true);
-	printf("  (estimated)\n");
+	fprintf(disasm_out, "  (estimated)\n");
+}
+
+/* highest register used plus one, in vec4 units: */
+static unsigned regs_count(regmask_t *regmask, bool full)
+{
+	int num;
+
+	for (num = MAX_REG - 1; num >= 0; num--)
+		if (regmask_get(regmask, num, full))
+			return (num / 4) + 1;
+
+	return 0;
 }
 
 /* we have to process the dst register after src to avoid tripping up
@@ -332,21 +347,21 @@ static void print_instr_cat0(instr_t *instr)
 
 	switch (cat0->opc) {
 	case OPC_KILL:
-		printf(" %sp0.%c", cat0->inv ? "!" : "",
+		fprintf(disasm_out, " %sp0.%c", cat0->inv ? "!" : "",
 				component[cat0->comp]);
 		break;
 	case OPC_BR:
-		printf(" %sp0.%c, #%d", cat0->inv ? "!" : "",
+		fprintf(disasm_out, " %sp0.%c, #%d", cat0->inv ? "!" : "",
 				component[cat0->comp], cat0->a5xx.immed);
 		break;
 	case OPC_JUMP:
 	case OPC_CALL:
-		printf(" #%d", cat0->a5xx.immed);
+		fprintf(disasm_out, " #%d", cat0->a5xx.immed);
 		break;
 	}
 
 	if ((debug & PRINT_VERBOSE) && (cat0->dummy2|cat0->dummy3|cat0->dummy4))
-		printf("\t{0: %x,%x,%x}", cat0->dummy2, cat0->dummy3, cat0->dummy4);
+		fprintf(disasm_out, "\t{0: %x,%x,%x}", cat0->dummy2, cat0->dummy3, cat0->dummy4);
 }
 
 static void print_instr_cat1(instr_t *instr)
@@ -354,56 +369,56 @@ static void print_instr_cat1(instr_t *instr)
 	instr_cat1_t *cat1 = &instr->cat1;
 
 	if (cat1->ul)
-		printf("(ul)");
+		fprintf(disasm_out, "(ul)");
 
 	if (cat1->src_type == cat1->dst_type) {
 		if ((cat1->src_type == TYPE_S16) && (((reg_t)cat1->dst).num == REG_A0)) {
 			/* special case (nmemonic?): */
-			printf("mova.%s%s", type[cat1->src_type], type[cat1->dst_type]);
+			fprintf(disasm_out, "mova.%s%s", type[cat1->src_type], type[cat1->dst_type]);
 		} else {
-			printf("mov.%s%s", type[cat1->src_type], type[cat1->dst_type]);
+			fprintf(disasm_out, "mov.%s%s", type[cat1->src_type], type[cat1->dst_type]);
 		}
 	} else {
-		printf("cov.%s%s", type[cat1->src_type], type[cat1->dst_type]);
+		fprintf(disasm_out, "cov.%s%s", type[cat1->src_type], type[cat1->dst_type]);
 	}
 
-	printf(" ");
+	fprintf(disasm_out, " ");
 
 	if (cat1->even)
-		printf("(even)");
+		fprintf(disasm_out, "(even)");
 
 	if (cat1->pos_inf)
-		printf("(pos_infinity)");
+		fprintf(disasm_out, "(pos_infinity)");
 
 	print_reg_dst((reg_t)(cat1->dst), type_size(cat1->dst_type) == 32,
 			cat1->dst_rel);
 
-	printf(", ");
+	fprintf(disasm_out, ", ");
 
 	/* ugg, have to special case this.. vs print_reg().. */
 	if (cat1->src_im) {
 		if (type_float(cat1->src_type))
-			printf("(%f)", cat1->fim_val);
+			fprintf(disasm_out, "(%f)", cat1->fim_val);
 		else
-			printf("%d", cat1->iim_val);
+			fprintf(disasm_out, "%d", cat1->iim_val);
 	} else if (cat1->src_rel && !cat1->src_c) {
 		/* I would just use %+d but trying to make it diff'able with
 		 * libllvm-a3xx...
 		 */
 		char type = cat1->src_rel_c ? 'c' : 'r';
 		if (cat1->off < 0)
-			printf("%c<a0.x - %d>", type, -cat1->off);
+			fprintf(disasm_out, "%c<a0.x - %d>", type, -cat1->off);
 		else if (cat1->off > 0)
-			printf("%c<a0.x + %d>", type, cat1->off);
+			fprintf(disasm_out, "%c<a0.x + %d>", type, cat1->off);
 		else
-			printf("%c<a0.x>", type);
+			fprintf(disasm_out, "%c<a0.x>", type);
 	} else {
 		print_reg_src((reg_t)(cat1->src), type_size(cat1->src_type) == 32,
 				cat1->src_r, cat1->src_c, cat1->src_im, false, false, false);
 	}
 
 	if ((debug & PRINT_VERBOSE) && (cat1->must_be_0))
-		printf("\t{1: %x}", cat1->must_be_0);
+		fprintf(disasm_out, "\t{1: %x}", cat1->must_be_0);
 }
 
 static void print_instr_cat2(instr_t *instr)
@@ -426,15 +441,15 @@ static void print_instr_cat2(instr_t *instr)
 	case OPC_CMPV_F:
 	case OPC_CMPV_U:
 	case OPC_CMPV_S:
-		printf(".%s", cond[cat2->cond]);
+		fprintf(disasm_out, ".%s", cond[cat2->cond]);
 		break;
 	}
 
-	printf(" ");
+	fprintf(disasm_out, " ");
 	if (cat2->ei)
-		printf("(ei)");
+		fprintf(disasm_out, "(ei)");
 	print_reg_dst((reg_t)(cat2->dst), cat2->full ^ cat2->dst_half, false);
-	printf(", ");
+	fprintf(disasm_out, ", ");
 
 	if (cat2->c1.src1_c) {
 		print_reg_src((reg_t)(cat2->c1.src1), cat2->full, cat2->src1_r,
@@ -468,7 +483,7 @@ static void print_instr_cat2(instr_t *instr)
 		/* these only have one src reg */
 		break;
 	default:
-		printf(", ");
+		fprintf(disasm_out, ", ");
 		if (cat2->c2.src2_c) {
 			print_reg_src((reg_t)(cat2->c2.src2), cat2->full, cat2->src2_r,
 					cat2->c2.src2_c, cat2->src2_im, cat2->src2_neg,
@@ -505,9 +520,9 @@ static void print_instr_cat3(instr_t *instr)
 		break;
 	}
 
-	printf(" ");
+	fprintf(disasm_out, " ");
 	print_reg_dst((reg_t)(cat3->dst), full ^ cat3->dst_half, false);
-	printf(", ");
+	fprintf(disasm_out, ", ");
 	if (cat3->c1.src1_c) {
 		print_reg_src((reg_t)(cat3->c1.src1), full,
 				cat3->src1_r, cat3->c1.src1_c, false, cat3->src1_neg,
@@ -521,11 +536,11 @@ static void print_instr_cat3(instr_t *instr)
 				cat3->src1_r, false, false, cat3->src1_neg,
 				false, false);
 	}
-	printf(", ");
+	fprintf(disasm_out, ", ");
 	print_reg_src((reg_t)cat3->src2, full,
 			cat3->src2_r, cat3->src2_c, false, cat3->src2_neg,
 			false, false);
-	printf(", ");
+	fprintf(disasm_out, ", ");
 	if (cat3->c2.src3_c) {
 		print_reg_src((reg_t)(cat3->c2.src3), full,
 				cat3->src3_r, cat3->c2.src3_c, false, cat3->src3_neg,
@@ -545,9 +560,9 @@ static void print_instr_cat4(instr_t *instr)
 {
 	instr_cat4_t *cat4 = &instr->cat4;
 
-	printf(" ");
+	fprintf(disasm_out, " ");
 	print_reg_dst((reg_t)(cat4->dst), cat4->full ^ cat4->dst_half, false);
-	printf(", ");
+	fprintf(disasm_out, ", ");
 
 	if (cat4->c.src_c) {
 		print_reg_src((reg_t)(cat4->c.src), cat4->full,
@@ -564,7 +579,7 @@ static void print_instr_cat4(instr_t *instr)
 	}
 
 	if ((debug & PRINT_VERBOSE) && (cat4->dummy1|cat4->dummy2))
-		printf("\t{4: %x,%x}", cat4->dummy1, cat4->dummy2);
+		fprintf(disasm_out, "\t{4: %x,%x}", cat4->dummy1, cat4->dummy2);
 }
 
 static void print_instr_cat5(instr_t *instr)
@@ -604,64 +619,64 @@ static void print_instr_cat5(instr_t *instr)
 	instr_cat5_t *cat5 = &instr->cat5;
 	int i;
 
-	if (cat5->is_3d)   printf(".3d");
-	if (cat5->is_a)    printf(".a");
-	if (cat5->is_o)    printf(".o");
-	if (cat5->is_p)    printf(".p");
-	if (cat5->is_s)    printf(".s");
-	if (cat5->is_s2en) printf(".s2en");
+	if (cat5->is_3d)   fprintf(disasm_out, ".3d");
+	if (cat5->is_a)    fprintf(disasm_out, ".a");
+	if (cat5->is_o)    fprintf(disasm_out, ".o");
+	if (cat5->is_p)    fprintf(disasm_out, ".p");
+	if (cat5->is_s)    fprintf(disasm_out, ".s");
+	if (cat5->is_s2en) fprintf(disasm_out, ".s2en");
 
-	printf(" ");
+	fprintf(disasm_out, " ");
 
 	switch (cat5->opc) {
 	case OPC_DSXPP_1:
 	case OPC_DSYPP_1:
 		break;
 	default:
-		printf("(%s)", type[cat5->type]);
+		fprintf(disasm_out, "(%s)", type[cat5->type]);
 		break;
 	}
 
-	printf("(");
+	fprintf(disasm_out, "(");
 	for (i = 0; i < 4; i++)
 		if (cat5->wrmask & (1 << i))
-			printf("%c", "xyzw"[i]);
-	printf(")");
+			fprintf(disasm_out, "%c", "xyzw"[i]);
+	fprintf(disasm_out, ")");
 
 	print_reg_dst((reg_t)(cat5->dst), type_size(cat5->type) == 32, false);
 
 	if (info[cat5->opc].src1) {
-		printf(", ");
+		fprintf(disasm_out, ", ");
 		print_reg_src((reg_t)(cat5->src1), cat5->full, false, false, false,
 				false, false, false);
 	}
 
 	if (cat5->is_s2en) {
-		printf(", ");
+		fprintf(disasm_out, ", ");
 		print_reg_src((reg_t)(cat5->s2en.src2), cat5->full, false, false, false,
 				false, false, false);
-		printf(", ");
+		fprintf(disasm_out, ", ");
 		print_reg_src((reg_t)(cat5->s2en.src3), false, false, false, false,
 				false, false, false);
 	} else {
 		if (cat5->is_o || info[cat5->opc].src2) {
-			printf(", ");
+			fprintf(disasm_out, ", ");
 			print_reg_src((reg_t)(cat5->norm.src2), cat5->full,
 					false, false, false, false, false, false);
 		}
 		if (info[cat5->opc].samp)
-			printf(", s#%d", cat5->norm.samp);
+			fprintf(disasm_out, ", s#%d", cat5->norm.samp);
 		if (info[cat5->opc].tex)
-			printf(", t#%d", cat5->norm.tex);
+			fprintf(disasm_out, ", t#%d", cat5->norm.tex);
 	}
 
 	if (debug & PRINT_VERBOSE) {
 		if (cat5->is_s2en) {
 			if ((debug & PRINT_VERBOSE) && (cat5->s2en.dummy1|cat5->s2en.dummy2|cat5->dummy2))
-				printf("\t{5: %x,%x,%x}", cat5->s2en.dummy1, cat5->s2en.dummy2, cat5->dummy2);
+				fprintf(disasm_out, "\t{5: %x,%x,%x}", cat5->s2en.dummy1, cat5->s2en.dummy2, cat5->dummy2);
 		} else {
 			if ((debug & PRINT_VERBOSE) && (cat5->norm.dummy1|cat5->dummy2))
-				printf("\t{5: %x,%x}", cat5->norm.dummy1, cat5->dummy2);
+				fprintf(disasm_out, "\t{5: %x,%x}", cat5->norm.dummy1, cat5->dummy2);
 		}
 	}
 }
@@ -712,20 +727,20 @@ static void print_instr_cat6(instr_t *instr)
 	case OPC_PREFETCH:
 		break;
 	case OPC_RESINFO:
-		printf(".%dd", cat6->ldgb.d + 1);
+		fprintf(disasm_out, ".%dd", cat6->ldgb.d + 1);
 		break;
 	case OPC_LDGB:
-		printf(".%s", cat6->ldgb.typed ? "typed" : "untyped");
-		printf(".%dd", cat6->ldgb.d + 1);
-		printf(".%s", type[cat6->type]);
-		printf(".%d", cat6->ldgb.type_size + 1);
+		fprintf(disasm_out, ".%s", cat6->ldgb.typed ? "typed" : "untyped");
+		fprintf(disasm_out, ".%dd", cat6->ldgb.d + 1);
+		fprintf(disasm_out, ".%s", type[cat6->type]);
+		fprintf(disasm_out, ".%d", cat6->ldgb.type_size + 1);
 		break;
 	case OPC_STGB:
 	case OPC_STIB:
-		printf(".%s", cat6->stgb.typed ? "typed" : "untyped");
-		printf(".%dd", cat6->stgb.d + 1);
-		printf(".%s", type[cat6->type]);
-		printf(".%d", cat6->stgb.type_size + 1);
+		fprintf(disasm_out, ".%s", cat6->stgb.typed ? "typed" : "untyped");
+		fprintf(disasm_out, ".%dd", cat6->stgb.d + 1);
+		fprintf(disasm_out, ".%s", type[cat6->type]);
+		fprintf(disasm_out, ".%d", cat6->stgb.type_size + 1);
 		break;
 	case OPC_ATOMIC_ADD:
 	case OPC_ATOMIC_SUB:
@@ -739,18 +754,18 @@ static void print_instr_cat6(instr_t *instr)
 	case OPC_ATOMIC_OR:
 	case OPC_ATOMIC_XOR:
 		ss = cat6->g ? 'g' : 'l';
-		printf(".%s", cat6->ldgb.typed ? "typed" : "untyped");
-		printf(".%dd", cat6->ldgb.d + 1);
-		printf(".%s", type[cat6->type]);
-		printf(".%d", cat6->ldgb.type_size + 1);
-		printf(".%c", ss);
+		fprintf(disasm_out, ".%s", cat6->ldgb.typed ? "typed" : "untyped");
+		fprintf(disasm_out, ".%dd", cat6->ldgb.d + 1);
+		fprintf(disasm_out, ".%s", type[cat6->type]);
+		fprintf(disasm_out, ".%d", cat6->ldgb.type_size + 1);
+		fprintf(disasm_out, ".%c", ss);
 		break;
 	default:
 		dst.im = cat6->g && !cat6->dst_off;
-		printf(".%s", type[cat6->type]);
+		fprintf(disasm_out, ".%s", type[cat6->type]);
 		break;
 	}
-	printf(" ");
+	fprintf(disasm_out, " ");
 
 	switch (cat6->opc) {
 	case OPC_STG:
@@ -809,15 +824,15 @@ static void print_instr_cat6(instr_t *instr)
 		src3.im  = cat6->stgb.src3_im;
 		src3.full = true;
 
-		printf("g[%u], ", cat6->stgb.dst_ssbo);
+		fprintf(disasm_out, "g[%u], ", cat6->stgb.dst_ssbo);
 		print_src(&src1);
-		printf(", ");
+		fprintf(disasm_out, ", ");
 		print_src(&src2);
-		printf(", ");
+		fprintf(disasm_out, ", ");
 		print_src(&src3);
 
 		if (debug & PRINT_VERBOSE)
-			printf(" (pad0=%x, pad3=%x)", cat6->stgb.pad0, cat6->stgb.pad3);
+			fprintf(disasm_out, " (pad0=%x, pad3=%x)", cat6->stgb.pad0, cat6->stgb.pad3);
 
 		return;
 	}
@@ -831,7 +846,7 @@ static void print_instr_cat6(instr_t *instr)
 		dst.reg  = (reg_t)(cat6->ldgb.dst);
 
 		print_src(&dst);
-		printf(", ");
+		fprintf(disasm_out, ", ");
 		if (ss == 'g') {
 			struct reginfo src3;
 			memset(&src3, 0, sizeof(src3));
@@ -846,25 +861,25 @@ static void print_instr_cat6(instr_t *instr)
 			 * a simple dword offset..  src3 appears to be
 			 * uvec2(offset * 4, 0).  Not sure the point of that.
 			 */
-			printf("g[%u], ", cat6->ldgb.src_ssbo);
+			fprintf(disasm_out, "g[%u], ", cat6->ldgb.src_ssbo);
 			print_src(&src1);  /* value */
-			printf(", ");
+			fprintf(disasm_out, ", ");
 			print_src(&src2);  /* offset/coords */
-			printf(", ");
+			fprintf(disasm_out, ", ");
 			print_src(&src3);  /* 64b byte offset.. */
 
 			if (debug & PRINT_VERBOSE) {
-				printf(" (pad0=%x, pad3=%x, mustbe0=%x)", cat6->ldgb.pad0,
+				fprintf(disasm_out, " (pad0=%x, pad3=%x, mustbe0=%x)", cat6->ldgb.pad0,
 						cat6->ldgb.pad3, cat6->ldgb.mustbe0);
 			}
 		} else { /* ss == 'l' */
-			printf("l[");
+			fprintf(disasm_out, "l[");
 			print_src(&src1);  /* simple byte offset */
-			printf("], ");
+			fprintf(disasm_out, "], ");
 			print_src(&src2);  /* value */
 
 			if (debug & PRINT_VERBOSE) {
-				printf(" (src3=%x, pad0=%x, pad3=%x, mustbe0=%x)",
+				fprintf(disasm_out, " (src3=%x, pad0=%x, pad3=%x, mustbe0=%x)",
 						cat6->ldgb.src3, cat6->ldgb.pad0,
 						cat6->ldgb.pad3, cat6->ldgb.mustbe0);
 			}
@@ -875,8 +890,8 @@ static void print_instr_cat6(instr_t *instr)
 		dst.reg  = (reg_t)(cat6->ldgb.dst);
 
 		print_src(&dst);
-		printf(", ");
-		printf("g[%u]", cat6->ldgb.src_ssbo);
+		fprintf(disasm_out, ", ");
+		fprintf(disasm_out, "g[%u]", cat6->ldgb.src_ssbo);
 
 		return;
 	} else if (cat6->opc == OPC_LDGB) {
@@ -888,14 +903,14 @@ static void print_instr_cat6(instr_t *instr)
 		dst.reg  = (reg_t)(cat6->ldgb.dst);
 
 		print_src(&dst);
-		printf(", ");
-		printf("g[%u], ", cat6->ldgb.src_ssbo);
+		fprintf(disasm_out, ", ");
+		fprintf(disasm_out, "g[%u], ", cat6->ldgb.src_ssbo);
 		print_src(&src1);
-		printf(", ");
+		fprintf(disasm_out, ", ");
 		print_src(&src2);
 
 		if (debug & PRINT_VERBOSE)
-			printf(" (pad0=%x, pad3=%x, mustbe0=%x)", cat6->ldgb.pad0, cat6->ldgb.pad3, cat6->ldgb.mustbe0);
+			fprintf(disasm_out, " (pad0=%x, pad3=%x, mustbe0=%x)", cat6->ldgb.pad0, cat6->ldgb.pad3, cat6->ldgb.mustbe0);
 
 		return;
 	}
@@ -922,37 +937,37 @@ static void print_instr_cat6(instr_t *instr)
 
 	if (!nodst) {
 		if (sd)
-			printf("%c[", sd);
+			fprintf(disasm_out, "%c[", sd);
 		/* note: dst might actually be a src (ie. address to store to) */
 		print_src(&dst);
 		if (dstoff)
-			printf("%+d", dstoff);
+			fprintf(disasm_out, "%+d", dstoff);
 		if (sd)
-			printf("]");
-		printf(", ");
+			fprintf(disasm_out, "]");
+		fprintf(disasm_out, ", ");
 	}
 
 	if (ss)
-		printf("%c[", ss);
+		fprintf(disasm_out, "%c[", ss);
 
 	/* can have a larger than normal immed, so hack: */
 	if (src1.im) {
-		printf("%u", src1.reg.dummy13);
+		fprintf(disasm_out, "%u", src1.reg.dummy13);
 	} else {
 		print_src(&src1);
 	}
 
 	if (src1off)
-		printf("%+d", src1off);
+		fprintf(disasm_out, "%+d", src1off);
 	if (ss)
-		printf("]");
+		fprintf(disasm_out, "]");
 
 	switch (cat6->opc) {
 	case OPC_RESINFO:
 	case OPC_RESFMT:
 		break;
 	default:
-		printf(", ");
+		fprintf(disasm_out, ", ");
 		print_src(&src2);
 		break;
 	}
@@ -963,15 +978,15 @@ static void print_instr_cat7(instr_t *instr)
 	instr_cat7_t *cat7 = &instr->cat7;
 
 	if (cat7->g)
-		printf(".g");
+		fprintf(disasm_out, ".g");
 	if (cat7->l)
-		printf(".l");
+		fprintf(disasm_out, ".l");
 
 	if (cat7->opc == OPC_FENCE) {
 		if (cat7->r)
-			printf(".r");
+			fprintf(disasm_out, ".r");
 		if (cat7->w)
-			printf(".w");
+			fprintf(disasm_out, ".w");
 	}
 }
 
@@ -1155,15 +1170,15 @@ static bool print_instr(uint32_t *dwords, int level, int n)
 	uint32_t opc = instr_opc(instr);
 	const char *name;
 
-	printf("%s%04d[%08xx_%08xx] ", levels[level], n, dwords[1], dwords[0]);
+	fprintf(disasm_out, "%s%04d[%08xx_%08xx] ", levels[level], n, dwords[1], dwords[0]);
 
 #if 0
 	/* print unknown bits: */
 	if (debug & PRINT_RAW)
-		printf("[%08xx_%08xx] ", dwords[1] & 0x001ff800, dwords[0] & 0x00000000);
+		fprintf(disasm_out, "[%08xx_%08xx] ", dwords[1] & 0x001ff800, dwords[0] & 0x00000000);
 
 	if (debug & PRINT_VERBOSE)
-		printf("%d,%02d ", instr->opc_cat, opc);
+		fprintf(disasm_out, "%d,%02d ", instr->opc_cat, opc);
 #endif
 
 	/* NOTE: order flags are printed is a bit fugly.. but for now I
@@ -1172,30 +1187,30 @@ static bool print_instr(uint32_t *dwords, int level, int n)
 	 */
 
 	if (instr->sync)
-		printf("(sy)");
+		fprintf(disasm_out, "(sy)");
 	if (instr->ss && ((instr->opc_cat <= 4) || (instr->opc_cat == 7)))
-		printf("(ss)");
+		fprintf(disasm_out, "(ss)");
 	if (instr->jmp_tgt)
-		printf("(jp)");
+		fprintf(disasm_out, "(jp)");
 	if (instr->repeat && (instr->opc_cat <= 4)) {
-		printf("(rpt%d)", instr->repeat);
+		fprintf(disasm_out, "(rpt%d)", instr->repeat);
 		repeat = instr->repeat;
 	} else {
 		repeat = 0;
 	}
 	if (instr->ul && ((2 <= instr->opc_cat) && (instr->opc_cat <= 4)))
-		printf("(ul)");
+		fprintf(disasm_out, "(ul)");
 
 	name = GETINFO(instr)->name;
 
 	if (name) {
-		printf("%s", name);
+		fprintf(disasm_out, "%s", name);
 		GETINFO(instr)->print(instr);
 	} else {
-		printf("unknown(%d,%d)", instr->opc_cat, opc);
+		fprintf(disasm_out, "unknown(%d,%d)", instr->opc_cat, opc);
 	}
 
-	printf("\n");
+	fprintf(disasm_out, "\n");
 
 	process_reg_dst();
 
@@ -1203,16 +1218,16 @@ static bool print_instr(uint32_t *dwords, int level, int n)
 		int i;
 		for (i = 0; i < instr->repeat; i++) {
 			repeatidx = i + 1;
-			printf("%s%04d[                   ] ", levels[level], n);
+			fprintf(disasm_out, "%s%04d[                   ] ", levels[level], n);
 
 			if (name) {
-				printf("%s", name);
+				fprintf(disasm_out, "%s", name);
 				GETINFO(instr)->print(instr);
 			} else {
-				printf("unknown(%d,%d)", instr->opc_cat, opc);
+				fprintf(disasm_out, "unknown(%d,%d)", instr->opc_cat, opc);
 			}
 
-			printf("\n");
+			fprintf(disasm_out, "\n");
 		}
 		repeatidx = 0;
 	}
@@ -1227,6 +1242,9 @@ int disasm_a3xx(uint32_t *dwords, int sizedwords, int level, enum shader_t type)
 
 //	assert((sizedwords % 2) == 0);
 
+	if (!disasm_out)
+		disasm_out = stdout;
+
 	memset(&regs, 0, sizeof(regs));
 
 	for (i = 0; i < sizedwords && !end; i += 2)
@@ -1234,5 +1252,13 @@ int disasm_a3xx(uint32_t *dwords, int sizedwords, int level, enum shader_t type)
 
 	print_reg_stats(level);
 
+	disasm_stats.instrs = i / 2;
+	disasm_stats.fullregs = regs_count(&regs.used, true);
+	disasm_stats.halfregs = regs_count(&regs.used, false);
+	/* half consts count too, a shader may only use those: */
+	disasm_stats.consts = regs_count(&regs.cnst, true);
+	if (regs_count(&regs.cnst, false) > disasm_stats.consts)
+		disasm_stats.consts = regs_count(&regs.cnst, false);
+
 	return 0;
 }
@@ -24,6 +24,8 @@
 #ifndef DISASM_H_
 #define DISASM_H_
 
+#include <stdio.h>
+
 enum shader_t {
 	SHADER_VERTEX,
 	SHADER_TCS,
@@ -40,8 +42,22 @@ enum debug_t {
 	EXPAND_REPEAT  = 0x4,
 };
 
+/* stats about the last shader disassembled, where the register and
+ * const counts are the highest one used plus one, in vec4 units (a3xx+
+ * only):
+ */
+struct shader_stats {
+	unsigned instrs;
+	unsigned fullregs, halfregs;
+	unsigned consts;
+};
+
+extern struct shader_stats disasm_stats;
+
 int disasm_a2xx(uint32_t *dwords, int sizedwords, int level, enum shader_t type);
 int disasm_a3xx(uint32_t *dwords, int sizedwords, int level, enum shader_t type);
 void disasm_set_debug(enum debug_t debug);
+/* where the disassemblers print to, NULL for stdout (the default): */
+void disasm_set_output(FILE *f);
 
 #endif /* DISASM_H_ */
@@ -0,0 +1,414 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+/* Write side of the io API.  This is kept separate from io.c so that
+ * libwrap does not need to link against libarchive.
+ *
+ * Writes are accumulated into frame sized buffers, which are handed
+ * off to a background thread to be (optionally) compressed and written
+ * out, so that the traced process is not stalled waiting on storage.
+ * Compressed output uses the chunked gzip container described in io.h,
+ * so it can be read back (and seeked) by io_open().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#include "io.h"
+
+#define NBUFS 4
+
+struct io_wbuf {
+	uint8_t *data;
+	uint32_t size;
+};
+
+struct io_writer {
+	int fd;
+	int level;
+	uint32_t frame_size;
+
+	/* buffer currently being filled by the caller: */
+	struct io_wbuf *cur;
+
+	/* ring of buffers handed off to the writer thread, which consumes
+	 * from head while the caller produces at tail.  Buffers not in the
+	 * ring (other than cur) are in the free list:
+	 */
+	struct io_wbuf *ring[NBUFS];
+	unsigned head, tail;
+	struct io_wbuf *freelist[NBUFS];
+	unsigned nfree;
+
+	/* scratch space for compressed frames, only used by writer thread: */
+	uint8_t *cbuf;
+	uint32_t cbufsize;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t thread;
+	int shutdown;
+	int error;                /* first error, as -errno */
+};
+
+static void put_le32(uint8_t *p, uint32_t val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+}
+
+static int write_all(int fd, const void *buf, uint32_t sz)
+{
+	const uint8_t *cbuf = buf;
+	while (sz > 0) {
+		ssize_t ret = write(fd, cbuf, sz);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		cbuf += ret;
+		sz -= ret;
+	}
+	return 0;
+}
+
+/* compress buf into a gzip member with frame header, returns the
+ * size of the member or zero on error:
+ */
+static uint32_t compress_frame(struct io_writer *w, const uint8_t *buf, uint32_t sz)
+{
+	uint8_t *frame = w->cbuf;
+	z_stream z = {0};
+	uint32_t csize;
+	int ret;
+
+	/* raw deflate, we write the gzip header/trailer ourself: */
+	if (deflateInit2(&z, w->level, Z_DEFLATED, -MAX_WBITS, 8,
+			Z_DEFAULT_STRATEGY) != Z_OK)
+		return 0;
+
+	z.next_in   = (uint8_t *)buf;
+	z.avail_in  = sz;
+	z.next_out  = frame + IO_FRAME_HDRLEN;
+	z.avail_out = w->cbufsize - IO_FRAME_HDRLEN - 8;
+
+	ret = deflate(&z, Z_FINISH);
+	deflateEnd(&z);
+
+	if (ret != Z_STREAM_END)
+		return 0;
+
+	csize = IO_FRAME_HDRLEN + z.total_out + 8;
+
+	frame[0]  = 0x1f;
+	frame[1]  = 0x8b;
+	frame[2]  = 8;           /* CM = deflate */
+	frame[3]  = 0x04;        /* FLG = FEXTRA */
+	put_le32(&frame[4], 0);  /* MTIME */
+	frame[8]  = (w->level == 1) ? 4 : (w->level == 9) ? 2 : 0;  /* XFL */
+	frame[9]  = 3;           /* OS = unix */
+	frame[10] = 12;          /* XLEN */
+	frame[11] = 0;
+	frame[12] = IO_FRAME_SI1;
+	frame[13] = IO_FRAME_SI2;
+	frame[14] = 8;           /* LEN */
+	frame[15] = 0;
+	put_le32(&frame[16], csize);
+	put_le32(&frame[20], sz);
+
+	put_le32(&frame[csize - 8], crc32(crc32(0, NULL, 0), buf, sz));
+	put_le32(&frame[csize - 4], sz);
+
+	return csize;
+}
+
+static int write_buf(struct io_writer *w, struct io_wbuf *b)
+{
+	uint32_t csize;
+
+	if (!w->level)
+		return write_all(w->fd, b->data, b->size);
+
+	csize = compress_frame(w, b->data, b->size);
+	if (!csize)
+		return -EIO;
+
+	return write_all(w->fd, w->cbuf, csize);
+}
+
+static void * writer_thread(void *arg)
+{
+	struct io_writer *w = arg;
+
+	pthread_mutex_lock(&w->lock);
+	while (1) {
+		struct io_wbuf *b;
+		int ret;
+
+		while ((w->head == w->tail) && !w->shutdown)
+			pthread_cond_wait(&w->cond, &w->lock);
+
+		if (w->head == w->tail)
+			break;
+
+		b = w->ring[w->head % NBUFS];
+
+		pthread_mutex_unlock(&w->lock);
+		ret = write_buf(w, b);
+		pthread_mutex_lock(&w->lock);
+
+		if (ret && !w->error)
+			w->error = ret;
+
+		b->size = 0;
+		w->freelist[w->nfree++] = b;
+		w->head++;
+		pthread_cond_broadcast(&w->cond);
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return NULL;
+}
+
+/* hand off the current buffer to the writer thread and get a new one: */
+static int submit_buf(struct io_writer *w)
+{
+	int error;
+
+	pthread_mutex_lock(&w->lock);
+	if (w->cur->size) {
+		while (!w->nfree)
+			pthread_cond_wait(&w->cond, &w->lock);
+		w->ring[w->tail++ % NBUFS] = w->cur;
+		w->cur = w->freelist[--w->nfree];
+		pthread_cond_broadcast(&w->cond);
+	}
+	error = w->error;
+	pthread_mutex_unlock(&w->lock);
+
+	return error;
+}
+
+static void writer_free(struct io_writer *w)
+{
+	unsigned i;
+
+	for (i = 0; i < w->nfree; i++) {
+		free(w->freelist[i]->data);
+		free(w->freelist[i]);
+	}
+	if (w->cur) {
+		free(w->cur->data);
+		free(w->cur);
+	}
+	free(w->cbuf);
+	free(w);
+}
+
+struct io_writer * io_wopenfd(int fd, int level, uint32_t frame_size)
+{
+	struct io_writer *w = calloc(1, sizeof(*w));
+	unsigned i;
+
+	if (!w)
+		return NULL;
+
+	if (!frame_size)
+		frame_size = IO_FRAME_SIZE;
+
+	w->fd = fd;
+	w->level = level;
+	w->frame_size = frame_size;
+
+	for (i = 0; i < NBUFS + 1; i++) {
+		struct io_wbuf *b = calloc(1, sizeof(*b));
+		if (b)
+			b->data = malloc(frame_size);
+		if (!b || !b->data) {
+			free(b);
+			writer_free(w);
+			return NULL;
+		}
+		if (i == 0)
+			w->cur = b;
+		else
+			w->freelist[w->nfree++] = b;
+	}
+
+	if (level) {
+		w->cbufsize = IO_FRAME_HDRLEN + compressBound(frame_size) + 8;
+		w->cbuf = malloc(w->cbufsize);
+		if (!w->cbuf) {
+			writer_free(w);
+			return NULL;
+		}
+	}
+
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->cond, NULL);
+
+	if (pthread_create(&w->thread, NULL, writer_thread, w)) {
+		pthread_mutex_destroy(&w->lock);
+		pthread_cond_destroy(&w->cond);
+		writer_free(w);
+		return NULL;
+	}
+
+	return w;
+}
+
+struct io_writer * io_wopen(const char *filename, int level, uint32_t frame_size)
+{
+	struct io_writer *w;
+	int fd;
+
+	fd = open(filename, O_WRONLY | O_TRUNC | O_CREAT, 0644);
+	if (fd < 0)
+		return NULL;
+
+	w = io_wopenfd(fd, level, frame_size);
+	if (!w)
+		close(fd);
+
+	return w;
+}
+
+int io_write(struct io_writer *w, const void *buf, int nbytes)
+{
+	const uint8_t *cbuf = buf;
+	int ret = nbytes;
+
+	while (nbytes > 0) {
+		uint32_t n = w->frame_size - w->cur->size;
+
+		if (n > nbytes)
+			n = nbytes;
+
+		memcpy(w->cur->data + w->cur->size, cbuf, n);
+		w->cur->size += n;
+		cbuf += n;
+		nbytes -= n;
+
+		if (w->cur->size == w->frame_size) {
+			int error = submit_buf(w);
+			if (error)
+				return error;
+		}
+	}
+
+	return ret;
+}
+
+int io_wflush(struct io_writer *w, int sync)
+{
+	int error;
+
+	submit_buf(w);
+
+	pthread_mutex_lock(&w->lock);
+	while (w->head != w->tail)
+		pthread_cond_wait(&w->cond, &w->lock);
+	error = w->error;
+	pthread_mutex_unlock(&w->lock);
+
+	if (!error && sync && fsync(w->fd))
+		error = -errno;
+
+	return error;
+}
+
+int io_wflush_crash(struct io_writer *w)
+{
+	struct timespec ts;
+	int error = 0;
+
+	/* if we crashed in the writer thread, or with the lock held, there
+	 * is nothing which can be done:
+	 */
+	if (pthread_equal(pthread_self(), w->thread))
+		return -EDEADLK;
+	if (pthread_mutex_trylock(&w->lock))
+		return -EBUSY;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += 5;
+
+	if (w->cur->size) {
+		while (!w->nfree && !error)
+			error = pthread_cond_timedwait(&w->cond, &w->lock, &ts);
+		if (!error) {
+			w->ring[w->tail++ % NBUFS] = w->cur;
+			w->cur = w->freelist[--w->nfree];
+			pthread_cond_broadcast(&w->cond);
+		}
+	}
+
+	while ((w->head != w->tail) && !error)
+		error = pthread_cond_timedwait(&w->cond, &w->lock, &ts);
+
+	error = error ? -error : w->error;
+	pthread_mutex_unlock(&w->lock);
+
+	return error;
+}
+
+int io_wclose(struct io_writer *w)
+{
+	int error;
+
+	submit_buf(w);
+
+	pthread_mutex_lock(&w->lock);
+	w->shutdown = 1;
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+
+	pthread_join(w->thread, NULL);
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->cond);
+
+	error = w->error;
+
+	if (close(w->fd) && !error)
+		error = -errno;
+
+	writer_free(w);
+
+	return error;
+}
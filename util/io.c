@@ -26,20 +26,64 @@
  *    Rob Clark <robclark@freedesktop.org>
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <zlib.h>
 #include <archive.h>
 #include <archive_entry.h>
 
 #include "io.h"
 
+struct io_frame {
+	uint64_t coffset, offset;
+	uint32_t csize, size;
+	enum {
+		FRAME_IDLE,
+		FRAME_QUEUED,   /* waiting for a worker thread */
+		FRAME_BUSY,     /* being decompressed */
+		FRAME_READY,
+	} state;
+	uint8_t *data;       /* NULL if READY but decompression failed */
+};
+
+/* state for chunked gzip files: */
+struct io_chunks {
+	uint8_t *map;
+	size_t mapsize;
+
+	struct io_frame *frames;
+	unsigned nframes;
+	unsigned cur;        /* frame containing current offset */
+	unsigned window;     /* # of frames to decompress ahead of cur */
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t *threads;
+	unsigned nthreads;
+	int shutdown;
+};
+
 struct io {
 	struct archive *a;
 	struct archive_entry *entry;
-	unsigned offset;
+
+	/* for uncompressed input, the whole file is mmap'd and reads are
+	 * served directly out of the mapping, and a is NULL:
+	 */
+	uint8_t *map;
+	size_t size;
+
+	/* for chunked gzip input, size is the total uncompressed size: */
+	struct io_chunks *chunks;
+
+	uint64_t offset;
 };
 
 static void io_error(struct io *io)
@@ -84,11 +128,395 @@ static struct io * io_new(void)
 	return io;
 }
 
-struct io * io_open(const char *filename)
+/*
+ * Chunked gzip:
+ */
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* parse the frame header at ptr, returns non-zero if it isn't one: */
+static int parse_frame_header(const uint8_t *ptr, size_t len,
+		uint32_t *csize, uint32_t *usize)
 {
-	struct io *io = io_new();
+	if (len < IO_FRAME_HDRLEN)
+		return -1;
+	if ((ptr[0] != 0x1f) || (ptr[1] != 0x8b) || (ptr[2] != 8) ||
+			!(ptr[3] & 0x04) ||                       /* FEXTRA */
+			(ptr[12] != IO_FRAME_SI1) || (ptr[13] != IO_FRAME_SI2) ||
+			(ptr[14] != 8) || (ptr[15] != 0))
+		return -1;
+	*csize = get_le32(&ptr[16]);
+	*usize = get_le32(&ptr[20]);
+	if ((*csize < IO_FRAME_HDRLEN) || (*csize > len))
+		return -1;
+	return 0;
+}
+
+/* decompress the frame, leaving frame->data NULL on error: */
+static int decompress_frame(struct io_chunks *chunks, struct io_frame *frame)
+{
+	z_stream z = {0};
+	uint8_t *data;
 	int ret;
 
+	data = malloc(frame->size);
+	if (!data) {
+		fprintf(stderr, "out of memory for frame at %llu\n",
+				(unsigned long long)frame->coffset);
+		return -1;
+	}
+
+	/* 16 + MAX_WBITS to have zlib handle the gzip header/trailer: */
+	if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) {
+		free(data);
+		return -1;
+	}
+
+	z.next_in   = chunks->map + frame->coffset;
+	z.avail_in  = frame->csize;
+	z.next_out  = data;
+	z.avail_out = frame->size;
+
+	ret = inflate(&z, Z_FINISH);
+	inflateEnd(&z);
+
+	if ((ret != Z_STREAM_END) || (z.total_out != frame->size)) {
+		fprintf(stderr, "corrupt frame at %llu\n",
+				(unsigned long long)frame->coffset);
+		free(data);
+		return -1;
+	}
+
+	frame->data = data;
+
+	return 0;
+}
+
+static unsigned frame_window_end(struct io_chunks *chunks, unsigned n)
+{
+	unsigned end = n + chunks->window + 1;
+	if (end > chunks->nframes)
+		end = chunks->nframes;
+	return end;
+}
+
+static int frame_in_window(struct io_chunks *chunks, unsigned i)
+{
+	return (chunks->cur <= i) && (i < frame_window_end(chunks, chunks->cur));
+}
+
+static void * chunks_worker(void *arg)
+{
+	struct io_chunks *chunks = arg;
+
+	pthread_mutex_lock(&chunks->lock);
+	while (!chunks->shutdown) {
+		struct io_frame *frame = NULL;
+		unsigned i;
+
+		/* pick the queued frame closest to the read position: */
+		for (i = chunks->cur; i < frame_window_end(chunks, chunks->cur); i++) {
+			if (chunks->frames[i].state == FRAME_QUEUED) {
+				frame = &chunks->frames[i];
+				break;
+			}
+		}
+
+		if (!frame) {
+			pthread_cond_wait(&chunks->cond, &chunks->lock);
+			continue;
+		}
+
+		frame->state = FRAME_BUSY;
+		pthread_mutex_unlock(&chunks->lock);
+
+		decompress_frame(chunks, frame);
+
+		pthread_mutex_lock(&chunks->lock);
+
+		/* the reader may have moved on while we were at it, in which
+		 * case chunks_get() already dropped the window this frame was
+		 * in, and nobody else would free it:
+		 */
+		if (!frame_in_window(chunks, frame - chunks->frames)) {
+			free(frame->data);
+			frame->data = NULL;
+			frame->state = FRAME_IDLE;
+		} else {
+			frame->state = FRAME_READY;
+		}
+		pthread_cond_broadcast(&chunks->cond);
+	}
+	pthread_mutex_unlock(&chunks->lock);
+
+	return NULL;
+}
+
+/* make frame n the current frame, and return it once it is decompressed: */
+static struct io_frame * chunks_get(struct io_chunks *chunks, unsigned n)
+{
+	struct io_frame *frame = &chunks->frames[n];
+	unsigned i;
+
+	pthread_mutex_lock(&chunks->lock);
+
+	/* drop frames from the old window which are not in the new one: */
+	for (i = chunks->cur; i < frame_window_end(chunks, chunks->cur); i++) {
+		struct io_frame *f = &chunks->frames[i];
+		if ((n <= i) && (i < frame_window_end(chunks, n)))
+			continue;
+		if (f->state == FRAME_READY) {
+			free(f->data);
+			f->data = NULL;
+			f->state = FRAME_IDLE;
+		} else if (f->state == FRAME_QUEUED) {
+			f->state = FRAME_IDLE;
+		}
+	}
+
+	chunks->cur = n;
+
+	/* and queue up readahead: */
+	for (i = n + 1; (i < frame_window_end(chunks, n)) && chunks->nthreads; i++)
+		if (chunks->frames[i].state == FRAME_IDLE)
+			chunks->frames[i].state = FRAME_QUEUED;
+	pthread_cond_broadcast(&chunks->cond);
+
+	if ((frame->state == FRAME_IDLE) || (frame->state == FRAME_QUEUED)) {
+		/* nobody got to it yet, so do it ourself: */
+		frame->state = FRAME_BUSY;
+		pthread_mutex_unlock(&chunks->lock);
+		decompress_frame(chunks, frame);
+		pthread_mutex_lock(&chunks->lock);
+		frame->state = FRAME_READY;
+	}
+
+	while (frame->state != FRAME_READY)
+		pthread_cond_wait(&chunks->cond, &chunks->lock);
+
+	pthread_mutex_unlock(&chunks->lock);
+
+	return frame;
+}
+
+static void chunks_free(struct io_chunks *chunks)
+{
+	unsigned i;
+
+	pthread_mutex_lock(&chunks->lock);
+	chunks->shutdown = 1;
+	pthread_cond_broadcast(&chunks->cond);
+	pthread_mutex_unlock(&chunks->lock);
+
+	for (i = 0; i < chunks->nthreads; i++)
+		pthread_join(chunks->threads[i], NULL);
+
+	for (i = 0; i < chunks->nframes; i++)
+		free(chunks->frames[i].data);
+
+	pthread_mutex_destroy(&chunks->lock);
+	pthread_cond_destroy(&chunks->cond);
+	munmap(chunks->map, chunks->mapsize);
+	free(chunks->threads);
+	free(chunks->frames);
+	free(chunks);
+}
+
+static struct io * io_chunked(void *map, size_t mapsize)
+{
+	struct io_chunks *chunks;
+	struct io *io;
+	uint64_t coffset = 0, offset = 0;
+	unsigned maxframes = 0;
+	long ncpu;
+
+	chunks = calloc(1, sizeof(*chunks));
+	if (!chunks)
+		return NULL;
+
+	chunks->map = map;
+	chunks->mapsize = mapsize;
+
+	/* build the frame table: */
+	while (coffset < mapsize) {
+		struct io_frame *frame;
+		uint32_t csize, usize;
+
+		if (parse_frame_header(chunks->map + coffset, mapsize - coffset,
+				&csize, &usize))
+			goto fail;
+
+		if (chunks->nframes >= maxframes) {
+			struct io_frame *frames;
+
+			maxframes = maxframes ? (maxframes * 2) : 1024;
+			frames = realloc(chunks->frames,
+					maxframes * sizeof(chunks->frames[0]));
+			if (!frames)
+				goto fail;
+			chunks->frames = frames;
+		}
+
+		frame = &chunks->frames[chunks->nframes++];
+		memset(frame, 0, sizeof(*frame));
+		frame->coffset = coffset;
+		frame->csize   = csize;
+		frame->offset  = offset;
+		frame->size    = usize;
+
+		coffset += csize;
+		offset  += usize;
+	}
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu > 1) {
+		chunks->threads = calloc(ncpu, sizeof(chunks->threads[0]));
+		if (!chunks->threads)
+			goto fail;
+	}
+
+	io = calloc(1, sizeof(*io));
+	if (!io)
+		goto fail;
+
+	io->chunks = chunks;
+	io->size = offset;
+
+	pthread_mutex_init(&chunks->lock, NULL);
+	pthread_cond_init(&chunks->cond, NULL);
+
+	if (ncpu > 1) {
+		unsigned i;
+
+		for (i = 0; i < ncpu; i++) {
+			if (pthread_create(&chunks->threads[i], NULL,
+					chunks_worker, chunks))
+				break;
+			chunks->nthreads++;
+		}
+		chunks->window = 2 * chunks->nthreads;
+	}
+
+	return io;
+
+fail:
+	free(chunks->threads);
+	free(chunks->frames);
+	free(chunks);
+	return NULL;
+}
+
+/* find the frame containing offset: */
+static unsigned chunks_find(struct io_chunks *chunks, uint64_t offset)
+{
+	unsigned lo = 0, hi = chunks->nframes;
+
+	/* common case, sequential reads: */
+	if ((chunks->frames[chunks->cur].offset <= offset) &&
+			(offset < (chunks->frames[chunks->cur].offset +
+					chunks->frames[chunks->cur].size)))
+		return chunks->cur;
+
+	while ((hi - lo) > 1) {
+		unsigned mid = (lo + hi) / 2;
+		if (chunks->frames[mid].offset <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static int chunks_readn(struct io *io, void *buf, int nbytes)
+{
+	struct io_chunks *chunks = io->chunks;
+	uint8_t *ptr = buf;
+	int ret = 0;
+
+	while ((nbytes > 0) && (io->offset < io->size)) {
+		unsigned n = chunks_find(chunks, io->offset);
+		struct io_frame *frame = &chunks->frames[n];
+		uint32_t off, len;
+
+		if ((n != chunks->cur) || (frame->state != FRAME_READY))
+			frame = chunks_get(chunks, n);
+		if (!frame->data)
+			return ret ? ret : -1;
+
+		off = io->offset - frame->offset;
+		len = frame->size - off;
+		if (len > nbytes)
+			len = nbytes;
+
+		memcpy(ptr, frame->data + off, len);
+
+		ptr += len;
+		nbytes -= len;
+		ret += len;
+		io->offset += len;
+	}
+
+	return ret;
+}
+
+/* If fd is a regular (non-gzip) file, mmap the whole thing.  Otherwise
+ * return NULL and let the caller fall back to libarchive.
+ */
+static struct io * io_mmap(int fd)
+{
+	struct io *io;
+	struct stat st;
+	uint8_t magic[2];
+	void *map;
+
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode) || (st.st_size <= 0))
+		return NULL;
+
+	if (pread(fd, magic, sizeof(magic), 0) != sizeof(magic))
+		return NULL;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	/* gzip'd, needs to go through libarchive unless it is chunked: */
+	if ((magic[0] == 0x1f) && (magic[1] == 0x8b)) {
+		io = io_chunked(map, st.st_size);
+		if (!io)
+			munmap(map, st.st_size);
+		return io;
+	}
+
+	io = calloc(1, sizeof(*io));
+	if (!io) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+
+	io->map = map;
+	io->size = st.st_size;
+
+	return io;
+}
+
+struct io * io_open(const char *filename)
+{
+	struct io *io;
+	int ret, fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd >= 0) {
+		io = io_mmap(fd);
+		close(fd);
+		if (io)
+			return io;
+	}
+
+	io = io_new();
 	if (!io)
 		return NULL;
 
@@ -109,9 +537,14 @@ struct io * io_open(const char *filename)
 
 struct io * io_openfd(int fd)
 {
-	struct io *io = io_new();
+	struct io *io;
 	int ret;
 
+	io = io_mmap(fd);
+	if (io)
+		return io;
+
+	io = io_new();
 	if (!io)
 		return NULL;
 
@@ -132,20 +565,110 @@ struct io * io_openfd(int fd)
 
 void io_close(struct io *io)
 {
-	archive_read_free(io->a);
+	if (io->map)
+		munmap(io->map, io->size);
+	if (io->chunks)
+		chunks_free(io->chunks);
+	if (io->a)
+		archive_read_free(io->a);
 	free(io);
 }
 
-unsigned io_offset(struct io *io)
+int io_can_fork(struct io *io)
+{
+	/* streamed input shares the file offset with the parent: */
+	return io->map || io->chunks;
+}
+
+void io_fork_child(struct io *io)
+{
+	struct io_chunks *chunks = io->chunks;
+	unsigned i;
+
+	if (!chunks)
+		return;
+
+	/* the decompression threads did not survive the fork, and may have
+	 * been holding the lock, so start over without them:
+	 */
+	pthread_mutex_init(&chunks->lock, NULL);
+	pthread_cond_init(&chunks->cond, NULL);
+	free(chunks->threads);
+	chunks->threads = NULL;
+	chunks->nthreads = 0;
+
+	for (i = 0; i < chunks->nframes; i++) {
+		struct io_frame *frame = &chunks->frames[i];
+		if ((frame->state == FRAME_QUEUED) || (frame->state == FRAME_BUSY)) {
+			free(frame->data);
+			frame->data = NULL;
+			frame->state = FRAME_IDLE;
+		}
+	}
+}
+
+uint64_t io_offset(struct io *io)
 {
 	return io->offset;
 }
 
+void * io_map(struct io *io, int nbytes)
+{
+	void *ptr;
+
+	if (!io->map || (nbytes < 0) || (nbytes > (io->size - io->offset)))
+		return NULL;
+
+	ptr = io->map + io->offset;
+	io->offset += nbytes;
+
+	return ptr;
+}
+
+int io_seek(struct io *io, uint64_t offset)
+{
+	if (io->map || io->chunks) {
+		if (offset > io->size)
+			return -1;
+		io->offset = offset;
+		return 0;
+	}
+
+	/* libarchive can only go forward, so skip by reading: */
+	if (offset < io->offset)
+		return -1;
+
+	while (io->offset < offset) {
+		char buf[4096];
+		int n = sizeof(buf);
+		if ((offset - io->offset) < n)
+			n = offset - io->offset;
+		if (io_readn(io, buf, n) != n)
+			return -1;
+	}
+
+	return 0;
+}
+
 #include <assert.h>
 int io_readn(struct io *io, void *buf, int nbytes)
 {
 	char *ptr = buf;
 	int ret = 0;
+
+	if (io->chunks)
+		return chunks_readn(io, buf, nbytes);
+
+	if (io->map) {
+		if (nbytes <= 0)
+			return 0;
+		if (nbytes > (io->size - io->offset))
+			nbytes = io->size - io->offset;
+		memcpy(buf, io->map + io->offset, nbytes);
+		io->offset += nbytes;
+		return nbytes;
+	}
+
 	while (nbytes > 0) {
 		int n = archive_read_data(io->a, ptr, nbytes);
 		if (n < 0) {
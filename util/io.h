@@ -29,18 +29,103 @@
 #ifndef IO_H_
 #define IO_H_
 
+#include <stdint.h>
+
 /* Simple API to abstract reading from file which might be compressed.
- * Maybe someday I'll add writing..
+ * (See below for writing.)
+ *
+ * Uncompressed files are mmap'd rather than read through libarchive,
+ * in which case io_map() can be used to get at the file contents
+ * without copying.
+ *
+ * Chunked gzip files (see below) are also mmap'd, and support seeking
+ * in both directions, with frames decompressed in parallel ahead of
+ * the current read position.
+ */
+
+/* Chunked gzip container:
+ *
+ * The file is a sequence of independently compressed gzip members
+ * (frames), so it is still a valid .gz file that zcat/libarchive can
+ * read, but each member header has an extra field with a subfield
+ * identifying it as a frame:
+ *
+ *    SI1='F', SI2='D', LEN=8
+ *    uint32_t csize    - total size of the gzip member, including
+ *                        header and trailer
+ *    uint32_t usize    - uncompressed size of the frame
+ *
+ * which lets the reader build the table of frames just by hopping
+ * from header to header, without decompressing anything.
  */
+#define IO_FRAME_SI1     'F'
+#define IO_FRAME_SI2     'D'
+#define IO_FRAME_HDRLEN  (10 + 2 + 4 + 8)  /* gzip hdr + XLEN + subfield */
+#define IO_FRAME_SIZE    (1024 * 1024)     /* default uncompressed frame size */
 
 struct io;
 
 struct io * io_open(const char *filename);
 struct io * io_openfd(int fd);
 void io_close(struct io *io);
-unsigned io_offset(struct io *io);
+uint64_t io_offset(struct io *io);
+/* Returns the number of bytes read, which is short only at the end of
+ * the file, or negative on error (ie. corrupt compressed data):
+ */
 int io_readn(struct io *io, void *buf, int nbytes);
 
+/* Seek to the specified offset.  Uncompressed and chunked gzip files
+ * can seek both ways, other compressed files (and pipes) only forward,
+ * which is done by reading and discarding.  Returns zero on success.
+ */
+int io_seek(struct io *io, uint64_t offset);
+
+/* Returns a pointer to the next nbytes of the file and advances past
+ * them, or NULL if the file is not mmap'd (or is too short), in which
+ * case the caller should fall back to io_readn().  The pointer remains
+ * valid until io_close().
+ */
+void * io_map(struct io *io, int nbytes);
+
+/* Whether the io can continue to be used, independently, by both the
+ * parent and child after fork().  If so, the child must call
+ * io_fork_child() before using it.
+ */
+int io_can_fork(struct io *io);
+void io_fork_child(struct io *io);
+
+/* Writing (io-write.c):
+ *
+ * Writes are batched into frame_size buffers (zero for the default,
+ * IO_FRAME_SIZE), which are compressed and written out by a background
+ * thread.  The level is the zlib compression level, from 1 (fastest)
+ * to 9 (smallest), or zero to write uncompressed.  Compressed output is
+ * written in the chunked gzip container format.
+ *
+ * Errors are returned as -errno.  Since the actual writing happens in
+ * the background, an error may only be returned by a later call than
+ * the io_write() which caused it.
+ */
+#define IO_LEVEL_NONE     0
+#define IO_LEVEL_FAST     1
+#define IO_LEVEL_DEFAULT  6
+
+struct io_writer;
+
+struct io_writer * io_wopen(const char *filename, int level, uint32_t frame_size);
+struct io_writer * io_wopenfd(int fd, int level, uint32_t frame_size);
+int io_write(struct io_writer *w, const void *buf, int nbytes);
+/* wait for everything written so far to reach the file, and fsync()
+ * it if sync is set.  Returns zero on success:
+ */
+int io_wflush(struct io_writer *w, int sync);
+/* like io_wflush(), but for use from a fatal signal handler: gives up
+ * instead of waiting forever if the writer is stuck (ie. the crash was
+ * in the writer thread, or with its lock held):
+ */
+int io_wflush_crash(struct io_writer *w);
+int io_wclose(struct io_writer *w);
+
 
 static inline int
 check_extension(const char *path, const char *ext)
@@ -0,0 +1,106 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "output.h"
+
+int out_init(const char *filename)
+{
+	if (filename && !freopen(filename, "w", stdout))
+		return -1;
+
+	/* leave the default line buffering for interactive output: */
+	if (!isatty(STDOUT_FILENO))
+		setvbuf(stdout, NULL, _IOFBF, OUT_BUFSIZE);
+
+	return 0;
+}
+
+char *out_fmt_float(char *p, float f, int width)
+{
+	union {
+		float f;
+		uint32_t u;
+	} u = { .f = f };
+	uint32_t exp = (u.u >> 23) & 0xff;
+	uint64_t mant = u.u & 0x7fffff;
+	uint64_t scaled, ipart;
+	char tmp[32], *t = tmp + sizeof(tmp);
+	int shift, i, n;
+
+	/* inf/nan, or too big to scale to 64b fixed point: */
+	if ((exp == 0xff) || (exp > 150 + 20))
+		return p + sprintf(p, "%*f", width, f);
+
+	if (exp)
+		mant |= 0x800000;
+	else
+		exp = 1;
+
+	/* value is mant * 2^shift, convert exactly to fixed point with six
+	 * fractional digits, rounding ties to even like printf does:
+	 */
+	shift = (int)exp - 150;
+	if (shift >= 0) {
+		scaled = (mant << shift) * 1000000;
+	} else if (-shift >= 64) {
+		scaled = 0;
+	} else {
+		uint64_t prod = mant * 1000000;
+		uint64_t rem  = prod & ((1ull << -shift) - 1);
+		uint64_t half = 1ull << (-shift - 1);
+		scaled = prod >> -shift;
+		if ((rem > half) || ((rem == half) && (scaled & 1)))
+			scaled++;
+	}
+
+	ipart = scaled / 1000000;
+	scaled %= 1000000;
+
+	for (i = 0; i < 6; i++) {
+		*(--t) = '0' + (scaled % 10);
+		scaled /= 10;
+	}
+	*(--t) = '.';
+	do {
+		*(--t) = '0' + (ipart % 10);
+		ipart /= 10;
+	} while (ipart);
+	if (u.u & 0x80000000)
+		*(--t) = '-';
+
+	n = tmp + sizeof(tmp) - t;
+	for (i = n; i < width; i++)
+		*(p++) = ' ';
+	memcpy(p, t, n);
+
+	return p + n;
+}
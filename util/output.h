@@ -0,0 +1,93 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Helpers for the hot print paths in cffdump/pgmdump (hexdumps, float
+ * dumps, register values).  Everything still goes to stdout, so it
+ * stays ordered with respect to plain printf()s, the disassemblers and
+ * lua scripts.  But rather than going through printf's format parsing
+ * once per dword, the hot paths format a whole line by hand into a
+ * local buffer and hand it to stdio with a single fwrite().
+ */
+
+/* stdout buffer size, when not writing to a tty: */
+#define OUT_BUFSIZE    (1 << 20)
+
+/* worst case length of out_fmt_float() output, excluding padding: */
+#define OUT_FLOAT_MAX  64
+
+/* Set up stdout for bulk output.  If filename is non-NULL, stdout is
+ * redirected to the file.  Must be called before anything is written
+ * to stdout.
+ */
+int out_init(const char *filename);
+
+/* equivalent to sprintf(p, "%*f", width, f), returns end of string: */
+char *out_fmt_float(char *p, float f, int width);
+
+/* equivalent to sprintf(p, "%0*lx", digits, val), returns end of string: */
+static inline char *out_fmt_hex(char *p, uint64_t val, int digits)
+{
+	static const char hex[] = "0123456789abcdef";
+	int i;
+
+	while ((digits < 16) && (val >> (4 * digits)))
+		digits++;
+
+	for (i = digits - 1; i >= 0; i--) {
+		p[i] = hex[val & 0xf];
+		val >>= 4;
+	}
+
+	return p + digits;
+}
+
+static inline char *out_fmt_str(char *p, const char *s)
+{
+	size_t n = strlen(s);
+	memcpy(p, s, n);
+	return p + n;
+}
+
+static inline void out_write(const char *buf, const char *end)
+{
+	fwrite(buf, 1, end - buf, stdout);
+}
+
+static inline void out_str(const char *s)
+{
+	fputs(s, stdout);
+}
+
+#endif /* OUTPUT_H_ */
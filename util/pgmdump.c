@@ -33,6 +33,10 @@
 #include "redump.h"
 #include "disasm.h"
 #include "io.h"
+#include "rdfile.h"
+#include "output.h"
+#include "batch.h"
+#include "shaderdb.h"
 
 struct pgm_header {
 	uint32_t size;
@@ -244,8 +248,16 @@ struct state {
 const char *infile;
 static int full_dump = 1;
 static int dump_shaders = 0;
+static int raw_program = 0;
 static int gpu_id;
 
+/* shaders seen so far in the current file (and the shader database, if
+ * --shader-db), see shaderdb.h:
+ */
+static struct shaderdb *shaders;
+static int expand_shaders = 0;
+static int program;               /* index of current program in file */
+
 char *find_sect_end(char *buf, int sz)
 {
 	uint8_t *ptr = (uint8_t *)buf;
@@ -284,29 +296,33 @@ static void dump_hex(char *buf, int sz)
 {
 	uint8_t *ptr = (uint8_t *)buf;
 	uint8_t *end = ptr + sz;
+	char line[8 * 9 + 1], *p = line;
 	int i = 0;
 
 	while (ptr < end) {
 		uint32_t d = 0;
 
-		printf((i % 8) ? " " : "\t");
+		*(p++) = (i % 8) ? ' ' : '\t';
 
 		d |= *(ptr++) <<  0;
 		d |= *(ptr++) <<  8;
 		d |= *(ptr++) << 16;
 		d |= *(ptr++) << 24;
 
-		printf("%08x", d);
+		p = out_fmt_hex(p, d, 8);
 
 		if ((i % 8) == 7) {
-			printf("\n");
+			*(p++) = '\n';
+			out_write(line, p);
+			p = line;
 		}
 
 		i++;
 	}
 
 	if (i % 8) {
-		printf("\n");
+		*(p++) = '\n';
+		out_write(line, p);
 	}
 }
 
@@ -314,29 +330,33 @@ static void dump_float(char *buf, int sz)
 {
 	uint8_t *ptr = (uint8_t *)buf;
 	uint8_t *end = ptr + sz - 3;
+	char line[8 * (OUT_FLOAT_MAX + 1) + 1], *p = line;
 	int i = 0;
 
 	while (ptr < end) {
 		uint32_t d = 0;
 
-		printf((i % 8) ? " " : "\t");
+		*(p++) = (i % 8) ? ' ' : '\t';
 
 		d |= *(ptr++) <<  0;
 		d |= *(ptr++) <<  8;
 		d |= *(ptr++) << 16;
 		d |= *(ptr++) << 24;
 
-		printf("%8f", d2f(d));
+		p = out_fmt_float(p, d2f(d), 8);
 
 		if ((i % 8) == 7) {
-			printf("\n");
+			*(p++) = '\n';
+			out_write(line, p);
+			p = line;
 		}
 
 		i++;
 	}
 
 	if (i % 8) {
-		printf("\n");
+		*(p++) = '\n';
+		out_write(line, p);
 	}
 }
 
@@ -377,6 +397,7 @@ static void dump_hex_ascii(char *buf, int sz)
 	uint8_t *ptr = (uint8_t *)buf;
 	uint8_t *end = ptr + sz;
 	uint8_t *ascii = ptr;
+	char line[4 * 9 + 16 + 4], *p = line;
 	int i = 0;
 
 	printf("-----------------------------------------------\n");
@@ -385,38 +406,42 @@ static void dump_hex_ascii(char *buf, int sz)
 	while (ptr < end) {
 		uint32_t d = 0;
 
-		printf((i % 4) ? " " : "\t");
+		*(p++) = (i % 4) ? ' ' : '\t';
 
 		d |= *(ptr++) <<  0;
 		d |= *(ptr++) <<  8;
 		d |= *(ptr++) << 16;
 		d |= *(ptr++) << 24;
 
-		printf("%08x", d);
+		p = out_fmt_hex(p, d, 8);
 
 		if ((i % 4) == 3) {
 			int j;
-			printf("\t|");
+			*(p++) = '\t';
+			*(p++) = '|';
 			for (j = 0; j < 16; j++) {
 				uint8_t c = *(ascii++);
 				c ^= 0xff;
-				printf("%c", (isascii(c) && !iscntrl(c)) ? c : '.');
+				*(p++) = (isascii(c) && !iscntrl(c)) ? c : '.';
 			}
-			printf("|\n");
+			*(p++) = '|';
+			*(p++) = '\n';
+			out_write(line, p);
+			p = line;
 		}
 
 		i++;
 	}
 
 	if (i % 8) {
-		int j;
-		printf("\t|");
+		out_write(line, p);
+		out_str("\t|");
 		while (ascii < end) {
 			uint8_t c = *(ascii++);
 			c ^= 0xff;
-			printf("%c", (isascii(c) && !iscntrl(c)) ? c : '.');
+			putchar((isascii(c) && !iscntrl(c)) ? c : '.');
 		}
-		printf("|\n");
+		out_str("|\n");
 	}
 }
 
@@ -555,6 +580,32 @@ static void dump_raw_shader(uint32_t *dwords, uint32_t sizedwords, int n, char *
 	write(fd, dwords, sizedwords * 4);
 }
 
+/* disassemble a shader, unless the same shader was already in an earlier
+ * program in this file, in which case just refer back to it.  Returns
+ * whether the shader was disassembled:
+ */
+static int disasm_shader(shaderdb_disasm_t disasm, uint32_t *dwords,
+		uint32_t sizedwords, int level, enum shader_t type, const char *ext)
+{
+	struct shaderdb_entry *seen;
+
+	seen = shaderdb_find(shaders, dwords, sizedwords, ext, program);
+	if (seen && !expand_shaders) {
+		printf("%.*ssame as shader in program %d\n", level, "\t\t\t\t",
+				seen->first);
+		return 0;
+	}
+
+	if (!seen) {
+		shaderdb_disasm(shaders, dwords, sizedwords, ext, disasm, type,
+				level, gpu_id, infile, program);
+	} else {
+		disasm(dwords, sizedwords, level, type);
+	}
+
+	return 1;
+}
+
 static void dump_shaders_a2xx(struct state *state)
 {
 	int i, sect_size;
@@ -591,8 +642,9 @@ static void dump_shaders_a2xx(struct state *state)
 		} else {
 			dump_short_summary(state, vs_hdr->unknown1 - 1, constants);
 		}
-		disasm_a2xx((uint32_t *)(ptr + 32), (sect_size - 32) / 4, level+1, SHADER_VERTEX);
-		dump_raw_shader((uint32_t *)(ptr + 32), (sect_size - 32) / 4, i, "vo");
+		if (disasm_shader(disasm_a2xx, (uint32_t *)(ptr + 32),
+				(sect_size - 32) / 4, level+1, SHADER_VERTEX, "vo"))
+			dump_raw_shader((uint32_t *)(ptr + 32), (sect_size - 32) / 4, i, "vo");
 		free(ptr);
 
 		for (j = 0; j < vs_hdr->unknown9; j++) {
@@ -642,8 +694,9 @@ static void dump_shaders_a2xx(struct state *state)
 		} else {
 			dump_short_summary(state, fs_hdr->unknown1 - 1, constants);
 		}
-		disasm_a2xx((uint32_t *)(ptr + 32), (sect_size - 32) / 4, level+1, SHADER_FRAGMENT);
-		dump_raw_shader((uint32_t *)(ptr + 32), (sect_size - 32) / 4, i, "fo");
+		if (disasm_shader(disasm_a2xx, (uint32_t *)(ptr + 32),
+				(sect_size - 32) / 4, level+1, SHADER_FRAGMENT, "fo"))
+			dump_raw_shader((uint32_t *)(ptr + 32), (sect_size - 32) / 4, i, "fo");
 		free(ptr);
 
 		for (j = 0; j < fs_hdr->unknown1 - 1; j++) {
@@ -732,8 +785,9 @@ printf("hdr_size=%d\n", hdr_size);
 			instrs_size -= 32;
 		}
 
-		disasm_a3xx((uint32_t *)instrs, instrs_size / 4, level+1, SHADER_VERTEX);
-		dump_raw_shader((uint32_t *)instrs, instrs_size / 4, i, "vo3");
+		if (disasm_shader(disasm_a3xx, (uint32_t *)instrs, instrs_size / 4,
+				level+1, SHADER_VERTEX, "vo3"))
+			dump_raw_shader((uint32_t *)instrs, instrs_size / 4, i, "vo3");
 		free(vs_hdr);
 	}
 
@@ -811,8 +865,9 @@ printf("hdr_size=%d\n", hdr_size);
 				instrs_size -= 32;
 			}
 		}
-		disasm_a3xx((uint32_t *)instrs, instrs_size / 4, level+1, SHADER_FRAGMENT);
-		dump_raw_shader((uint32_t *)instrs, instrs_size / 4, i, "fo3");
+		if (disasm_shader(disasm_a3xx, (uint32_t *)instrs, instrs_size / 4,
+				level+1, SHADER_FRAGMENT, "fo3"))
+			dump_raw_shader((uint32_t *)instrs, instrs_size / 4, i, "fo3");
 		free(fs_hdr);
 	}
 }
@@ -1035,66 +1090,17 @@ void dump_program(struct state *state)
 		free (state->uniformblocks[i].members);
 }
 
-int main(int argc, char **argv)
+static int handle_file(const char *filename)
 {
 	enum rd_sect_type type = RD_NONE;
-	enum debug_t debug = 0;
 	void *buf = NULL;
-	int sz, i;
+	int sz;
+	struct rd_file rd;
 	struct io *io;
-	int raw_program = 0;
 
-	/* lame argument parsing: */
-
-	while (1) {
-		if ((argc > 1) && !strcmp(argv[1], "--verbose")) {
-			debug |= PRINT_RAW | PRINT_VERBOSE;
-			argv++;
-			argc--;
-			continue;
-		}
-		if ((argc > 1) && !strcmp(argv[1], "--expand")) {
-			debug |= EXPAND_REPEAT;
-			argv++;
-			argc--;
-			continue;
-		}
-		if ((argc > 1) && !strcmp(argv[1], "--short")) {
-			/* only short dump, original shader, symbol table, and disassembly */
-			full_dump = 0;
-			argv++;
-			argc--;
-			continue;
-		}
-		if ((argc > 1) && !strcmp(argv[1], "--dump-shaders")) {
-			dump_shaders = 1;
-			argv++;
-			argc--;
-			continue;
-		}
-		if ((argc > 1) && !strcmp(argv[1], "--raw")) {
-			raw_program = 1;
-			argv++;
-			argc--;
-			continue;
-		}
-		if ((argc > 1) && !strcmp(argv[1], "--gpu300")) {
-			gpu_id = 320;
-			argv++;
-			argc--;
-			continue;
-		}
-		break;
-	}
-
-	if (argc != 2) {
-		fprintf(stderr, "usage: pgmdump [--verbose] [--short] [--dump-shaders] testlog.rd\n");
-		return -1;
-	}
-
-	disasm_set_debug(debug);
-
-	infile = argv[1];
+	infile = filename;
+	program = 0;
+	shaderdb_reset(shaders);
 
 	io = io_open(infile);
 	if (!io) {
@@ -1127,24 +1133,30 @@ int main(int argc, char **argv)
 
 	/* figure out what sort of input we are dealing with: */
 	if (!(check_extension(infile, ".rd") || check_extension(infile, ".rd.gz"))) {
-		int (*disasm)(uint32_t *dwords, int sizedwords, int level, enum shader_t type);
+		shaderdb_disasm_t disasm;
 		enum shader_t shader = 0;
+		const char *ext;
 		int ret;
 		if (check_extension(infile, ".vo")) {
 			disasm = disasm_a2xx;
 			shader = SHADER_VERTEX;
+			ext = "vo";
 		} else if (check_extension(infile, ".fo")) {
 			disasm = disasm_a2xx;
 			shader = SHADER_FRAGMENT;
+			ext = "fo";
 		} else if (check_extension(infile, ".vo3")) {
 			disasm = disasm_a3xx;
 			shader = SHADER_VERTEX;
+			ext = "vo3";
 		} else if (check_extension(infile, ".fo3")) {
 			disasm = disasm_a3xx;
 			shader = SHADER_FRAGMENT;
+			ext = "fo3";
 		} else if (check_extension(infile, ".co3")) {
 			disasm = disasm_a3xx;
 			shader = SHADER_COMPUTE;
+			ext = "co3";
 		} else {
 			fprintf(stderr, "invalid input file: %s\n", infile);
 			return -1;
@@ -1155,17 +1167,27 @@ int main(int argc, char **argv)
 			fprintf(stderr, "error: %m");
 			return -1;
 		}
-		return disasm(buf, ret/4, 0, shader);
+		disasm_shader(disasm, buf, ret/4, 0, shader, ext);
+		return 0;
+	}
+
+	if (rd_file_init(&rd, io)) {
+		fprintf(stderr, "invalid input file: %s\n", infile);
+		return -1;
 	}
 
-	while ((io_readn(io, &type, sizeof(type)) > 0) && (io_readn(io, &sz, 4) > 0)) {
+	while (rd_next_section_max(&rd, INT32_MAX) > 0) {
+		type = rd.type;
+		sz = rd.size;
+
 		free(buf);
 
 		/* note: allow hex dumps to go a bit past the end of the buffer..
 		 * might see some garbage, but better than missing the last few bytes..
 		 */
 		buf = calloc(1, sz + 3);
-		io_readn(io, buf, sz);
+		if (rd_read_payload(&rd, buf))
+			break;
 
 		switch(type) {
 		case RD_TEST:
@@ -1187,6 +1209,7 @@ int main(int argc, char **argv)
 			printf("program:\n");
 			dump_program(&state);
 			printf("############################################################\n");
+			program++;
 			break;
 		}
 		case RD_GPU_ID:
@@ -1201,3 +1224,137 @@ int main(int argc, char **argv)
 	return 0;
 }
 
+
+static int handle_batch_file(const char *filename, void *data)
+{
+	return handle_file(filename);
+}
+
+int main(int argc, char **argv)
+{
+	enum debug_t debug = 0;
+	const char *output = NULL, *shader_db = NULL, *shader_query = NULL;
+	char **args = argv;
+	int batch = 0, jobs = 1;
+
+	/* lame argument parsing: */
+
+	while (1) {
+		if ((argc > 1) && !strcmp(argv[1], "--verbose")) {
+			debug |= PRINT_RAW | PRINT_VERBOSE;
+			argv++;
+			argc--;
+			continue;
+		}
+		if ((argc > 1) && !strcmp(argv[1], "--expand")) {
+			debug |= EXPAND_REPEAT;
+			argv++;
+			argc--;
+			continue;
+		}
+		if ((argc > 1) && !strcmp(argv[1], "--short")) {
+			/* only short dump, original shader, symbol table, and disassembly */
+			full_dump = 0;
+			argv++;
+			argc--;
+			continue;
+		}
+		if ((argc > 1) && !strcmp(argv[1], "--dump-shaders")) {
+			dump_shaders = 1;
+			argv++;
+			argc--;
+			continue;
+		}
+		if ((argc > 1) && !strcmp(argv[1], "--raw")) {
+			raw_program = 1;
+			argv++;
+			argc--;
+			continue;
+		}
+		if ((argc > 2) && !strcmp(argv[1], "--output")) {
+			output = argv[2];
+			argv += 2;
+			argc -= 2;
+			continue;
+		}
+		if ((argc > 1) && !strcmp(argv[1], "--batch")) {
+			batch = 1;
+			argv++;
+			argc--;
+			continue;
+		}
+		if ((argc > 2) && (!strcmp(argv[1], "--jobs") || !strcmp(argv[1], "-j"))) {
+			jobs = atoi(argv[2]);
+			if (jobs <= 0)
+				jobs = sysconf(_SC_NPROCESSORS_ONLN);
+			argv += 2;
+			argc -= 2;
+			continue;
+		}
+		if ((argc > 1) && !strcmp(argv[1], "--expand-shaders")) {
+			expand_shaders = 1;
+			argv++;
+			argc--;
+			continue;
+		}
+		if ((argc > 2) && !strcmp(argv[1], "--shader-db")) {
+			shader_db = argv[2];
+			argv += 2;
+			argc -= 2;
+			continue;
+		}
+		if ((argc > 2) && !strcmp(argv[1], "--shader-query")) {
+			shader_query = argv[2];
+			argv += 2;
+			argc -= 2;
+			continue;
+		}
+		if ((argc > 1) && !strcmp(argv[1], "--gpu300")) {
+			gpu_id = 320;
+			argv++;
+			argc--;
+			continue;
+		}
+		break;
+	}
+
+	disasm_set_debug(debug);
+
+	if (shader_query) {
+		if (!shader_db) {
+			fprintf(stderr, "--shader-query needs --shader-db\n");
+			return -1;
+		}
+		return (shaderdb_query(shader_db, shader_query) > 0) ? 0 : -1;
+	}
+
+	shaders = shaderdb_new(shader_db);
+	if (!shaders)
+		return -1;
+
+	if (batch && (argc > 1) && !output) {
+		char *options = batch_options(args, argv + 1 - args);
+		int ret;
+
+		ret = batch_run("pgmdump", options, &argv[1], argc - 1, jobs,
+				handle_batch_file, NULL);
+		free(options);
+
+		return ret ? 1 : 0;
+	}
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: pgmdump [--verbose] [--short] [--dump-shaders] [--expand-shaders]\n");
+		fprintf(stderr, "               [--shader-db DIR] [--output FILE] testlog.rd\n");
+		fprintf(stderr, "       pgmdump [options] --batch [--jobs N] testlog.rd...\n");
+		fprintf(stderr, "       pgmdump --shader-db DIR --shader-query HASH|all\n");
+		return -1;
+	}
+
+	if (out_init(output)) {
+		fprintf(stderr, "could not open output: %s\n", output);
+		return -1;
+	}
+
+	return handle_file(argv[1]);
+}
@@ -0,0 +1,217 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "profile.h"
+
+struct counter {
+	uint64_t calls, wall;
+};
+
+int profile_enabled;
+struct profile_totals profile_totals;
+
+static int requested;
+static struct counter counters[PROFILE_NUM_COUNTERS];
+
+/* start of the reported period: */
+static struct {
+	uint64_t wall, cpu;
+	uint64_t children;   /* cpu time of the workers which already exited */
+} total;
+
+static uint64_t now(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/* cpu time of the (waited for) child processes, ie. --jobs workers: */
+static uint64_t children_cpu(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_CHILDREN, &ru))
+		return 0;
+
+	return ((uint64_t)ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000 +
+			((uint64_t)ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000;
+}
+
+static void start_total(void)
+{
+	total.wall = now(CLOCK_MONOTONIC);
+	total.cpu = now(CLOCK_PROCESS_CPUTIME_ID);
+	total.children = children_cpu();
+}
+
+void profile_enable(void)
+{
+	requested = profile_enabled = 1;
+	start_total();
+}
+
+void profile_reset(void)
+{
+	memset(counters, 0, sizeof(counters));
+	memset(&profile_totals, 0, sizeof(profile_totals));
+	start_total();
+}
+
+void profile_pause(int pause)
+{
+	profile_enabled = requested && !pause;
+}
+
+void _profile_start(struct profile_timer *t)
+{
+	t->wall = now(CLOCK_MONOTONIC);
+}
+
+void _profile_stop(struct profile_timer *t, unsigned counter)
+{
+	struct counter *c = &counters[counter];
+
+	c->calls++;
+	c->wall += now(CLOCK_MONOTONIC) - t->wall;
+}
+
+void profile_save(FILE *f)
+{
+	if (!requested)
+		return;
+	fwrite(counters, sizeof(counters), 1, f);
+	fwrite(&profile_totals, sizeof(profile_totals), 1, f);
+	fflush(f);
+}
+
+void profile_merge(FILE *f)
+{
+	struct counter c[PROFILE_NUM_COUNTERS];
+	struct profile_totals t;
+	unsigned i;
+
+	if (!requested)
+		return;
+
+	rewind(f);
+	if ((fread(c, sizeof(c), 1, f) != 1) || (fread(&t, sizeof(t), 1, f) != 1))
+		return;
+
+	for (i = 0; i < PROFILE_NUM_COUNTERS; i++) {
+		counters[i].calls += c[i].calls;
+		counters[i].wall += c[i].wall;
+	}
+
+	profile_totals.bytes += t.bytes;
+	profile_totals.packets += t.packets;
+	profile_totals.draws += t.draws;
+}
+
+static int cmp_wall(const void *a, const void *b)
+{
+	const struct counter *ca = &counters[*(const unsigned *)a];
+	const struct counter *cb = &counters[*(const unsigned *)b];
+
+	if (ca->wall != cb->wall)
+		return (ca->wall < cb->wall) ? 1 : -1;
+	return *(const unsigned *)a - *(const unsigned *)b;
+}
+
+static double per_sec(uint64_t n, double secs)
+{
+	return (secs > 0) ? n / secs : 0;
+}
+
+void profile_report(FILE *f, const char *(*opname)(unsigned opcode))
+{
+	unsigned order[PROFILE_NUM_COUNTERS], i, n = 0;
+	double wall, cpu;
+
+	if (!requested)
+		return;
+
+	wall = (now(CLOCK_MONOTONIC) - total.wall) / 1e9;
+	cpu = (now(CLOCK_PROCESS_CPUTIME_ID) - total.cpu) / 1e9;
+
+	/* with --jobs, add the workers, but only the ones since the start,
+	 * not ie. those of the previous files:
+	 */
+	cpu += (children_cpu() - total.children) / 1e9;
+
+	fprintf(f, "profile: %.3fs wall, %.3fs cpu\n", wall, cpu);
+	fprintf(f, "  %.1f MB (%.1f MB/s), %"PRIu64" packets (%.0f/s), "
+			"%"PRIu64" draws (%.0f/s)\n",
+			profile_totals.bytes / 1e6,
+			per_sec(profile_totals.bytes, wall) / 1e6,
+			profile_totals.packets, per_sec(profile_totals.packets, wall),
+			profile_totals.draws, per_sec(profile_totals.draws, wall));
+
+	for (i = 0; i < PROFILE_NUM_COUNTERS; i++)
+		if (counters[i].calls)
+			order[n++] = i;
+
+	qsort(order, n, sizeof(order[0]), cmp_wall);
+
+	fprintf(f, "  %12s %12s  %s\n", "calls", "wall ms", "name");
+	for (i = 0; i < n; i++) {
+		struct counter *c = &counters[order[i]];
+		const char *name = NULL;
+		char buf[32];
+
+		if (order[i] < PROFILE_LEVEL) {
+			name = opname ? opname(order[i] - PROFILE_OPCODE) : NULL;
+			if (!name) {
+				snprintf(buf, sizeof(buf), "opcode %02x",
+						order[i] - PROFILE_OPCODE);
+				name = buf;
+			}
+		} else if (order[i] < PROFILE_RNN) {
+			snprintf(buf, sizeof(buf), "dump_commands level %u",
+					order[i] - PROFILE_LEVEL);
+			name = buf;
+		} else if (order[i] == PROFILE_RNN) {
+			name = "rnn lookups";
+		} else if (order[i] == PROFILE_DISASM) {
+			name = "disassembly";
+		} else if (order[i] == PROFILE_IO) {
+			name = "i/o";
+		} else if (order[i] == PROFILE_SCRIPT) {
+			name = "script callbacks";
+		}
+
+		fprintf(f, "  %12"PRIu64" %12.3f  %s\n", c->calls,
+				c->wall / 1e6, name);
+	}
+}
@@ -0,0 +1,115 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Decoder profiling, for cffdump --profile.  Each counter accumulates
+ * the number of calls and the (wall) time spent in a section of the
+ * decoder, ie:
+ *
+ *    struct profile_timer t;
+ *
+ *    profile_start(&t);
+ *    disasm_a3xx(...);
+ *    profile_stop(&t, PROFILE_DISASM);
+ *
+ * Times are inclusive, ie. the CP_INDIRECT_BUFFER handler includes the
+ * time spent in the packets of the IB.  With --jobs, the counters are
+ * summed over the workers, so can add up to more than the total wall
+ * time.  The timers are hit for every packet, so they only read the
+ * (cheap) monotonic clock, cpu time is only reported for the total.
+ * When profiling is not enabled, start/stop only check a flag.
+ */
+
+#define PROFILE_MAX_LEVELS 16
+
+enum profile_counter {
+	PROFILE_OPCODE = 0,                  /* + opcode, type3/type7 handlers */
+	PROFILE_LEVEL  = 0x100,              /* + level, dump_commands() */
+	PROFILE_RNN    = PROFILE_LEVEL + PROFILE_MAX_LEVELS,
+	PROFILE_DISASM,
+	PROFILE_IO,
+	PROFILE_SCRIPT,
+	PROFILE_NUM_COUNTERS,
+};
+
+struct profile_timer {
+	uint64_t wall;        /* ns, zero if not started */
+};
+
+/* totals for the throughput numbers, updated by the decoder: */
+struct profile_totals {
+	uint64_t bytes, packets, draws;
+};
+
+extern int profile_enabled;
+extern struct profile_totals profile_totals;
+
+/* start profiling, the report covers the time from here (or from
+ * profile_reset()) on:
+ */
+void profile_enable(void);
+
+/* start counting from zero, ie. in a forked worker, which would otherwise
+ * pass back the counters it inherited from its parent:
+ */
+void profile_reset(void);
+
+/* stop counting for a while, ie. while the parent does a prepass with
+ * --jobs, in which case the workers do the real work:
+ */
+void profile_pause(int pause);
+
+void _profile_start(struct profile_timer *t);
+void _profile_stop(struct profile_timer *t, unsigned counter);
+
+static inline void profile_start(struct profile_timer *t)
+{
+	t->wall = 0;
+	if (profile_enabled)
+		_profile_start(t);
+}
+
+static inline void profile_stop(struct profile_timer *t, unsigned counter)
+{
+	if (profile_enabled && t->wall)
+		_profile_stop(t, counter);
+}
+
+/* pass a worker process's counters to the parent, through a file: */
+void profile_save(FILE *f);
+void profile_merge(FILE *f);
+
+/* print the report, opname gives the name of an opcode (or NULL): */
+void profile_report(FILE *f, const char *(*opname)(unsigned opcode));
+
+#endif /* PROFILE_H_ */
@@ -0,0 +1,266 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "rdfile.h"
+
+int rd_file_init(struct rd_file *rd, struct io *io)
+{
+	struct rd_file_header hdr;
+	int ret;
+
+	memset(rd, 0, sizeof(*rd));
+	rd->io = io;
+	rd->version = 1;
+	rd->align = 4;
+
+	/* v1 files have no header, so whatever we read is the start of
+	 * the first section:
+	 */
+	ret = io_readn(io, rd->pending, 8);
+	if (ret < 0)
+		return -1;
+	if (ret != 8)
+		return 0;
+
+	if (rd->pending[0] != RD_FILE_MAGIC) {
+		rd->has_pending = 1;
+		return 0;
+	}
+
+	hdr.magic = rd->pending[0];
+	hdr.version = rd->pending[1];
+
+	if (io_readn(io, &hdr.align, sizeof(hdr) - 8) != sizeof(hdr) - 8)
+		return -1;
+
+	if ((hdr.version != RD_FILE_VERSION) || (hdr.align < 8) ||
+			(hdr.align & (hdr.align - 1))) {
+		fprintf(stderr, "unsupported rd file: version %u, align %u\n",
+				hdr.version, hdr.align);
+		return -1;
+	}
+
+	rd->version = hdr.version;
+	rd->align = hdr.align;
+	rd->flags = hdr.flags;
+
+	return 0;
+}
+
+uint64_t rd_offset(struct rd_file *rd)
+{
+	uint64_t offset = io_offset(rd->io);
+	if (rd->has_pending)
+		offset -= 8;
+	if (rd->payload_pending)
+		offset += rd->size;
+	return offset;
+}
+
+int rd_seek(struct rd_file *rd, uint64_t offset)
+{
+	rd->has_pending = 0;
+	rd->payload_pending = 0;
+	return io_seek(rd->io, offset);
+}
+
+static int skip_payload(struct rd_file *rd)
+{
+	if (!rd->payload_pending)
+		return 0;
+	rd->payload_pending = 0;
+	return io_seek(rd->io, io_offset(rd->io) + rd->size);
+}
+
+/* read the next 8 bytes, returns 1 on success, 0 at the end of the
+ * file, or -1 on error:
+ */
+static int read_v1(struct rd_file *rd, uint32_t *arr)
+{
+	int ret = io_readn(rd->io, arr, 8);
+	if (ret < 0)
+		return -1;
+	return ret == 8;
+}
+
+static int next_section_v1(struct rd_file *rd)
+{
+	uint32_t arr[2];
+	int ret;
+
+	rd->offset = rd_offset(rd);
+
+	if (rd->has_pending) {
+		memcpy(arr, rd->pending, sizeof(arr));
+		rd->has_pending = 0;
+	} else if ((ret = read_v1(rd, arr)) <= 0) {
+		return ret;
+	}
+
+	while ((arr[0] == 0xffffffff) && (arr[1] == 0xffffffff))
+		if ((ret = read_v1(rd, arr)) <= 0)
+			return ret;
+
+	/* v1 sizes are 32b signed: */
+	if ((int32_t)arr[1] < 0)
+		return -1;
+
+	rd->type = arr[0];
+	rd->size = arr[1];
+	rd->payload_pending = 1;
+
+	return 1;
+}
+
+static int next_section_v2(struct rd_file *rd)
+{
+	struct rd_section_header hdr;
+	uint64_t pos = io_offset(rd->io);
+	uint64_t offset = rd_section_offset(pos, rd->align);
+	int ret;
+
+	/* the file can end right after the previous section's payload, but
+	 * running out in the padding before the next header means it was
+	 * truncated.  A failed seek leaves mmap'd files where they were, and
+	 * streamed ones as far as they got:
+	 */
+	if (io_seek(rd->io, offset)) {
+		char c;
+		if ((io_offset(rd->io) == pos) && (io_readn(rd->io, &c, 1) == 0))
+			return 0;
+		return -1;
+	}
+
+	rd->offset = offset;
+
+	ret = io_readn(rd->io, &hdr, sizeof(hdr));
+	if (ret == 0)
+		return 0;
+	if (ret != sizeof(hdr))
+		return -1;
+
+	if ((hdr.magic != RD_SECT_MAGIC) ||
+			(hdr.hdr_checksum != rd_checksum(&hdr,
+					offsetof(struct rd_section_header, hdr_checksum))))
+		return -1;
+
+	rd->type = hdr.type;
+	rd->size = hdr.size;
+	rd->checksum = hdr.checksum;
+	rd->payload_pending = 1;
+
+	return 1;
+}
+
+int rd_next_section(struct rd_file *rd)
+{
+	if (skip_payload(rd))
+		return -1;
+
+	if (rd->version == 1)
+		return next_section_v1(rd);
+
+	return next_section_v2(rd);
+}
+
+int rd_next_section_max(struct rd_file *rd, uint64_t max)
+{
+	int ret;
+
+	while (((ret = rd_next_section(rd)) > 0) && (rd->size > max)) {
+		if (!rd->warned_size) {
+			fprintf(stderr, "skipping oversized section (type %u, %"PRIu64
+					" bytes) at offset %"PRIu64"\n", rd->type, rd->size,
+					rd->offset);
+			rd->warned_size = 1;
+		}
+	}
+
+	return ret;
+}
+
+static int check_payload(struct rd_file *rd, const void *buf)
+{
+	if (!(rd->flags & RD_FILE_CHECKSUM))
+		return 0;
+	if (rd_checksum(buf, rd->size) != rd->checksum) {
+		fprintf(stderr, "checksum mismatch in section at offset %"PRIu64"\n",
+				rd->offset);
+		return -1;
+	}
+	return 0;
+}
+
+int rd_read_payload(struct rd_file *rd, void *buf)
+{
+	uint8_t *p = buf;
+	uint64_t size = rd->size;
+
+	if (!rd->payload_pending)
+		return -1;
+
+	rd->payload_pending = 0;
+
+	/* io_readn() takes an int size: */
+	while (size > 0) {
+		int n = (size > 0x40000000) ? 0x40000000 : size;
+		if (io_readn(rd->io, p, n) != n)
+			return -1;
+		p += n;
+		size -= n;
+	}
+
+	return check_payload(rd, buf);
+}
+
+void * rd_map_payload(struct rd_file *rd)
+{
+	void *ptr;
+
+	if (!rd->payload_pending || (rd->size > INT32_MAX))
+		return NULL;
+
+	ptr = io_map(rd->io, rd->size);
+	if (!ptr)
+		return NULL;
+
+	rd->payload_pending = 0;
+
+	if (check_payload(rd, ptr))
+		return NULL;
+
+	return ptr;
+}
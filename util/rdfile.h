@@ -0,0 +1,206 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#ifndef RDFILE_H_
+#define RDFILE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <zlib.h>
+
+#include "redump.h"
+#include "io.h"
+
+/* Reader for .rd files, which handles both the original (v1) and v2
+ * formats (see redump.h).  Usage looks like:
+ *
+ *    rd_file_init(&rd, io);
+ *    while ((ret = rd_next_section(&rd)) > 0) {
+ *       ... rd.type and rd.size describe the section, and payload
+ *       ... can be read with rd_read_payload() or rd_map_payload(),
+ *       ... or is skipped if neither is called
+ *    }
+ *
+ * where ret < 0 indicates a corrupt or truncated file.
+ */
+
+struct rd_file {
+	struct io *io;
+	unsigned version;
+	uint32_t align;
+	uint32_t flags;
+
+	/* current section: */
+	uint32_t type;
+	uint64_t size;
+	uint64_t offset;      /* file offset of section header */
+
+	/* private: */
+	uint32_t checksum;
+	int payload_pending;  /* payload of current section not consumed */
+	int has_pending;      /* v1: first 8 bytes consumed probing for hdr */
+	int warned_size;      /* already warned about an oversized section */
+	uint32_t pending[2];
+};
+
+/* read the file header (if any), returns non-zero if the file has a
+ * header that we don't understand:
+ */
+int rd_file_init(struct rd_file *rd, struct io *io);
+
+/* returns the offset that the next section will be read from, which
+ * can later be passed to rd_seek():
+ */
+uint64_t rd_offset(struct rd_file *rd);
+int rd_seek(struct rd_file *rd, uint64_t offset);
+
+/* advance to next section, returns 1 on success, 0 at end of file, or
+ * -1 if the file is corrupt:
+ */
+int rd_next_section(struct rd_file *rd);
+
+/* like rd_next_section(), but skips sections whose payload is bigger
+ * than max (warning about the first one), for callers which read the
+ * payload into a buffer of that size:
+ */
+int rd_next_section_max(struct rd_file *rd, uint64_t max);
+
+/* read the current section's payload (rd->size bytes) into buf, returns
+ * zero on success, or -1 if truncated or the checksum does not match:
+ */
+int rd_read_payload(struct rd_file *rd, void *buf);
+
+/* returns pointer to current section's payload within the mmap'd file,
+ * or NULL if the file is not mmap'd (in which case rd_read_payload()
+ * should be used instead) or the payload is invalid:
+ */
+void * rd_map_payload(struct rd_file *rd);
+
+/* crc32 of buf, for the v2 section checksums: */
+static inline uint32_t rd_checksum(const void *buf, uint64_t size)
+{
+	const uint8_t *p = buf;
+	uint32_t crc = crc32(0, NULL, 0);
+
+	/* crc32() takes a 32b length: */
+	while (size > 0) {
+		uInt n = (size > 0x40000000) ? 0x40000000 : size;
+		crc = crc32(crc, p, n);
+		p += n;
+		size -= n;
+	}
+
+	return crc;
+}
+
+/* Writing, for libwrap and rdgen.  This is all inline, so that libwrap
+ * does not need to link against the reader (and libarchive).  offset
+ * is the size of the file written so far, which is needed to align v2
+ * sections, and is updated as it is written.  These return zero on
+ * success or -errno (see io_write()):
+ */
+static inline int rd_file_write(struct io_writer *io, uint64_t *offset,
+		const void *buf, uint64_t sz)
+{
+	const uint8_t *cbuf = buf;
+
+	/* io_write() takes an int size: */
+	while (sz > 0) {
+		int n = (sz > 0x40000000) ? 0x40000000 : sz;
+		int ret = io_write(io, cbuf, n);
+		if (ret < 0)
+			return ret;
+		cbuf += n;
+		sz -= n;
+		*offset += n;
+	}
+
+	return 0;
+}
+
+/* the file header, which v1 files don't have: */
+static inline int rd_file_write_header(struct io_writer *io, uint64_t *offset,
+		unsigned version)
+{
+	struct rd_file_header hdr = {
+			.magic   = RD_FILE_MAGIC,
+			.version = RD_FILE_VERSION,
+			.align   = RD_FILE_ALIGN,
+			.flags   = RD_FILE_CHECKSUM,
+	};
+
+	if (version == 1)
+		return 0;
+
+	return rd_file_write(io, offset, &hdr, sizeof(hdr));
+}
+
+/* returns -EFBIG, without writing anything, if the section is too big
+ * for a v1 file:
+ */
+static inline int rd_file_write_section(struct io_writer *io, uint64_t *offset,
+		unsigned version, enum rd_sect_type type, const void *buf, uint64_t sz)
+{
+	int ret;
+
+	if (version == 1) {
+		static const uint32_t zero = 0;
+		uint32_t hdr[4] = { ~0, ~0, type, ALIGN(sz, 4) };
+
+		if (sz > INT32_MAX)
+			return -EFBIG;
+
+		if ((ret = rd_file_write(io, offset, hdr, sizeof(hdr))) ||
+				(ret = rd_file_write(io, offset, buf, sz)))
+			return ret;
+
+		return rd_file_write(io, offset, &zero, ALIGN(sz, 4) - sz);
+	} else {
+		static const uint8_t zero[RD_FILE_ALIGN];
+		struct rd_section_header hdr = {
+				.magic    = RD_SECT_MAGIC,
+				.type     = type,
+				.size     = sz,
+				.checksum = rd_checksum(buf, sz),
+		};
+
+		hdr.hdr_checksum = rd_checksum(&hdr,
+				offsetof(struct rd_section_header, hdr_checksum));
+
+		/* pad so that payload is aligned: */
+		if ((ret = rd_file_write(io, offset, zero,
+				rd_section_offset(*offset, RD_FILE_ALIGN) - *offset)) ||
+				(ret = rd_file_write(io, offset, &hdr, sizeof(hdr))))
+			return ret;
+
+		return rd_file_write(io, offset, buf, sz);
+	}
+}
+
+#endif /* RDFILE_H_ */
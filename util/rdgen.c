@@ -0,0 +1,730 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+/* Generate a synthetic .rd file, for benchmarking and stress testing the
+ * tools without a device (or a capture which can't be shared).  The
+ * cmdstream is made of the same packets the blob driver uses, so it
+ * decodes like a real trace: register writes (type0, or type4 on a5xx),
+ * draws, CP_LOAD_STATE of constants and IBs, with the register values,
+ * constants and buffer contents coming from a seeded PRNG so the same
+ * options always give the same file.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "redump.h"
+#include "io.h"
+#include "rdfile.h"
+#include "cffdec.h"
+#include "instr-a3xx.h"
+
+/* a few registers per generation, which are written between draws: */
+static const uint32_t a2xx_regs[] = {
+		0x2000,   /* RB_SURFACE_INFO */
+		0x200e,   /* PA_SC_SCREEN_SCISSOR_TL */
+		0x2080,   /* PA_SC_WINDOW_OFFSET */
+		0x2104,   /* RB_COLOR_MASK */
+		0x2201,   /* RB_BLEND_CONTROL */
+		0x2204,   /* PA_CL_CLIP_CNTL */
+		0x2205,   /* PA_SU_SC_MODE_CNTL */
+		0x2206,   /* PA_CL_VTE_CNTL */
+		0x2208,   /* RB_MODECONTROL */
+};
+
+static const uint32_t a3xx_regs[] = {
+		0x2040,   /* GRAS_CL_CLIP_CNTL */
+		0x2070,   /* GRAS_SU_MODE_CONTROL */
+		0x2079,   /* GRAS_SC_WINDOW_SCISSOR_TL */
+		0x207a,   /* GRAS_SC_WINDOW_SCISSOR_BR */
+		0x2100,   /* RB_DEPTH_CONTROL */
+		0x2104,   /* RB_STENCIL_CONTROL */
+		0x21ec,   /* PC_PRIM_VTX_CNTL */
+		0x2240,   /* VFD_CONTROL_0 */
+		0x22c4,   /* SP_VS_CTRL_REG0 */
+		0x22e0,   /* SP_FS_CTRL_REG0 */
+};
+
+static const uint32_t a4xx_regs[] = {
+		0x2000,   /* GRAS_CL_CLIP_CNTL */
+		0x2078,   /* GRAS_SU_MODE_CONTROL */
+		0x209c,   /* GRAS_SC_WINDOW_SCISSOR_BR */
+		0x209d,   /* GRAS_SC_WINDOW_SCISSOR_TL */
+		0x20f8,   /* RB_ALPHA_CONTROL */
+		0x2101,   /* RB_DEPTH_CONTROL */
+		0x2106,   /* RB_STENCIL_CONTROL */
+		0x21c4,   /* PC_PRIM_VTX_CNTL */
+		0x2200,   /* VFD_CONTROL_0 */
+		0x22c4,   /* SP_VS_CTRL_REG0 */
+		0x22e8,   /* SP_FS_CTRL_REG0 */
+};
+
+static const uint32_t a5xx_regs[] = {
+		0x0cc6,   /* RB_MODE_CNTL */
+		0xe000,   /* GRAS_CL_CNTL */
+		0xe090,   /* GRAS_SU_CNTL */
+		0xe0ea,   /* GRAS_SC_WINDOW_SCISSOR_TL */
+		0xe0eb,   /* GRAS_SC_WINDOW_SCISSOR_BR */
+		0xe141,   /* RB_RENDER_CNTL */
+		0xe144,   /* RB_RENDER_CONTROL0 */
+		0xe1a8,   /* RB_ALPHA_CONTROL */
+		0xe1a9,   /* RB_BLEND_CNTL */
+		0xe1b1,   /* RB_DEPTH_CNTL */
+		0xe1c0,   /* RB_STENCIL_CONTROL */
+		0xe385,   /* PC_PRIM_VTX_CNTL */
+		0xe388,   /* PC_RASTER_CNTL */
+		0xe400,   /* VFD_CONTROL_0 */
+		0xe590,   /* SP_VS_CTRL_REG0 */
+		0xe5c0,   /* SP_FS_CTRL_REG0 */
+};
+
+/* the bin setup written in the CP_SET_RENDER_MODE IB (a5xx), which the
+ * draws don't write, so like in a real trace it carries over from one
+ * submit to the next when it doesn't change:
+ */
+static const uint32_t a5xx_bin_regs[] = {
+		0x0bc2,   /* VSC_BIN_SIZE */
+		0xe140,   /* RB_CNTL */
+		0xe211,   /* RB_RESOLVE_CNTL_1 */
+		0xe212,   /* RB_RESOLVE_CNTL_2 */
+};
+
+static unsigned gen;
+static const uint32_t *regs;
+static unsigned nregs;
+static uint32_t *state;
+
+static int ndraws = 10;
+static int depth = 1;
+static int nbufs = 4;
+static int bufsize = 4096;
+static int rate = 25;         /* % chance of each bit of state changing */
+static bool indirect;         /* CP_LOAD_STATE from a buffer */
+static bool render_mode;      /* CP_SET_RENDER_MODE at the start of IB1 */
+static bool first_submit = true;
+
+/* data buffers, re-emitted with each submit: */
+static uint32_t **bufs;
+static uint64_t *bufaddrs;
+
+/* made up shader programs (a3xx+), a few per stage which the draws pick
+ * from, so that like in a real trace the same programs show up again
+ * and again.  They are all in one buffer (also re-emitted with each
+ * submit), for indirect CP_LOAD_STATE:
+ */
+static int nshaders;
+static struct shader {
+	uint32_t num_unit, sizedwords;
+	uint32_t offset;          /* in shaderbuf */
+} *shaders[2];                /* vertex, fragment */
+static uint32_t *shaderbuf;
+static uint32_t shaderbufsize;
+static uint64_t shaderaddr;
+
+/* ************************************************************************* */
+/* output: */
+
+static struct io_writer *io;
+static uint64_t offset;
+static int rd_version = RD_FILE_VERSION;
+
+static void check_write(int ret)
+{
+	if (ret) {
+		fprintf(stderr, "error writing output: %s\n", strerror(-ret));
+		exit(-1);
+	}
+}
+
+static void write_section(enum rd_sect_type type, const void *buf, uint64_t sz)
+{
+	check_write(rd_file_write_section(io, &offset, rd_version, type, buf, sz));
+}
+
+/* RD_GPUADDR and RD_CMDSTREAM_ADDR, upper 32b of gpuaddr after size: */
+static void write_addr(enum rd_sect_type type, uint64_t gpuaddr, uint32_t size)
+{
+	uint32_t sect[3] = { gpuaddr, size, gpuaddr >> 32 };
+	write_section(type, sect, sizeof(sect));
+}
+
+static void write_buffer(uint64_t gpuaddr, const void *buf, uint32_t size)
+{
+	write_addr(RD_GPUADDR, gpuaddr, size);
+	write_section(RD_BUFFER_CONTENTS, buf, size);
+}
+
+/* ************************************************************************* */
+/* xorshift64*, so the output doesn't depend on the libc: */
+
+static uint64_t seed = 1;
+
+static uint32_t rnd(void)
+{
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+	return (seed * 0x2545f4914f6cdd1dull) >> 32;
+}
+
+static bool chance(int percent)
+{
+	return (rnd() % 100) < percent;
+}
+
+/* ************************************************************************* */
+/* cmdstream: */
+
+struct ib {
+	uint32_t *dwords;
+	uint32_t sizedwords, max;
+	uint64_t gpuaddr;
+};
+
+/* IBs of the current submit, written out along with it.  At most one
+ * per draw, plus the cmdstream, IB1 and the render mode IB:
+ */
+static struct ib *ibs;
+static unsigned nibs;
+static uint64_t next_gpuaddr;
+
+static uint64_t alloc_gpuaddr(uint32_t size)
+{
+	uint64_t gpuaddr = next_gpuaddr;
+	next_gpuaddr = ALIGN(next_gpuaddr + size, 0x1000);
+	return gpuaddr;
+}
+
+static struct ib * new_ib(void)
+{
+	assert(nibs < ndraws + 3);
+	ibs[nibs].sizedwords = 0;
+	return &ibs[nibs++];
+}
+
+static void out(struct ib *ib, uint32_t dword)
+{
+	if (ib->sizedwords == ib->max) {
+		ib->max = max(256, ib->max * 2);
+		ib->dwords = realloc(ib->dwords, ib->max * sizeof(uint32_t));
+	}
+	ib->dwords[ib->sizedwords++] = dword;
+}
+
+static void out_pkt(struct ib *ib, uint8_t opcode, uint32_t cnt)
+{
+	if (gen >= 5) {
+		out(ib, CP_TYPE7_PKT | cnt |
+				(pm4_calc_odd_parity_bit(cnt) << 15) |
+				((opcode & 0x7f) << 16) |
+				(pm4_calc_odd_parity_bit(opcode) << 23));
+	} else {
+		out(ib, CP_TYPE3_PKT | ((cnt - 1) << 16) | ((opcode & 0xff) << 8));
+	}
+}
+
+static void out_reg(struct ib *ib, uint32_t reg, uint32_t val)
+{
+	if (gen >= 5) {
+		out(ib, CP_TYPE4_PKT | 1 |
+				(pm4_calc_odd_parity_bit(1) << 7) |
+				((reg & 0x3ffff) << 8) |
+				(pm4_calc_odd_parity_bit(reg) << 27));
+	} else {
+		out(ib, CP_TYPE0_PKT | (reg & 0x7fff));
+	}
+	out(ib, val);
+}
+
+/* finish the IB, and call it from parent: */
+static void out_ib(struct ib *parent, struct ib *ib)
+{
+	ib->gpuaddr = alloc_gpuaddr(ib->sizedwords * 4);
+
+	if (gen >= 5) {
+		out_pkt(parent, CP_INDIRECT_BUFFER, 3);
+		out(parent, ib->gpuaddr);
+		out(parent, ib->gpuaddr >> 32);
+		out(parent, ib->sizedwords);
+	} else {
+		out_pkt(parent, CP_INDIRECT_BUFFER_PFD, 2);
+		out(parent, ib->gpuaddr);
+		out(parent, ib->sizedwords);
+	}
+}
+
+/* CP_LOAD_STATE header for vertex or fragment shader constants or
+ * program, from src, or followed by ndwords of inline data if src is
+ * zero:
+ */
+static void out_load_state(struct ib *ib, bool frag, bool shader,
+		uint32_t num_unit, uint32_t ndwords, uint64_t src)
+{
+	if (gen >= 4) {
+		out_pkt(ib, CP_LOAD_STATE4, ((gen >= 5) ? 3 : 2) + (src ? 0 : ndwords));
+		out(ib, CP_LOAD_STATE4_0_STATE_SRC(src ? SS4_INDIRECT : SS4_DIRECT) |
+				CP_LOAD_STATE4_0_STATE_BLOCK(frag ? SB4_FS_SHADER : SB4_VS_SHADER) |
+				CP_LOAD_STATE4_0_NUM_UNIT(num_unit));
+		out(ib, CP_LOAD_STATE4_1_STATE_TYPE(shader ? ST4_SHADER : ST4_CONSTANTS) |
+				CP_LOAD_STATE4_1_EXT_SRC_ADDR(src));
+		if (gen >= 5)
+			out(ib, CP_LOAD_STATE4_2_EXT_SRC_ADDR_HI(src >> 32));
+	} else {
+		out_pkt(ib, CP_LOAD_STATE, 2 + (src ? 0 : ndwords));
+		out(ib, CP_LOAD_STATE_0_STATE_SRC(src ? SS_INDIRECT : SS_DIRECT) |
+				CP_LOAD_STATE_0_STATE_BLOCK(frag ? SB_FRAG_SHADER : SB_VERT_SHADER) |
+				CP_LOAD_STATE_0_NUM_UNIT(num_unit));
+		out(ib, CP_LOAD_STATE_1_STATE_TYPE(shader ? ST_SHADER : ST_CONSTANTS) |
+				CP_LOAD_STATE_1_EXT_SRC_ADDR(src));
+	}
+}
+
+/* vertex shader constants, inline or from one of the data buffers: */
+static void out_consts(struct ib *ib)
+{
+	uint32_t num_unit = 1 + (rnd() % 8);
+	uint32_t ndwords = num_unit * ((gen >= 4) ? 4 : 2);
+	uint64_t src = 0;
+	unsigned i;
+
+	if (indirect && nbufs && (bufsize >= ndwords * 4)) {
+		unsigned n = rnd() % nbufs;
+		src = bufaddrs[n] + 4 * (rnd() % (bufsize / 4 - ndwords + 1));
+	}
+
+	out_load_state(ib, false, false, num_unit, ndwords, src);
+
+	if (!src)
+		for (i = 0; i < ndwords; i++)
+			out(ib, rnd());
+}
+
+/* one of the vertex or fragment shader programs, inline or from the
+ * shader buffer:
+ */
+static void out_shader(struct ib *ib, bool frag)
+{
+	struct shader *shader = &shaders[frag][rnd() % nshaders];
+	uint64_t src = indirect ? (shaderaddr + shader->offset) : 0;
+	unsigned i;
+
+	out_load_state(ib, frag, true, shader->num_unit,
+			shader->sizedwords, src);
+
+	if (!src)
+		for (i = 0; i < shader->sizedwords; i++)
+			out(ib, shaderbuf[shader->offset / 4 + i]);
+}
+
+static void out_draw(struct ib *ib)
+{
+	uint32_t num_indices = 3 * (1 + (rnd() % 100));
+
+	if (gen >= 5) {
+		/* prim_type and source_select in the same place as
+		 * CP_DRAW_INDX_1:
+		 */
+		out_pkt(ib, CP_DRAW_INDX_OFFSET, 3);
+		out(ib, CP_DRAW_INDX_1_PRIM_TYPE(DI_PT_TRILIST) |
+				CP_DRAW_INDX_1_SOURCE_SELECT(DI_SRC_SEL_AUTO_INDEX));
+		out(ib, 1);             /* num_instances */
+		out(ib, num_indices);
+	} else {
+		out_pkt(ib, CP_DRAW_INDX, 3);
+		out(ib, CP_DRAW_INDX_0_VIZ_QUERY(0));
+		out(ib, CP_DRAW_INDX_1_PRIM_TYPE(DI_PT_TRILIST) |
+				CP_DRAW_INDX_1_SOURCE_SELECT(DI_SRC_SEL_AUTO_INDEX) |
+				CP_DRAW_INDX_1_VIS_CULL(IGNORE_VISIBILITY));
+		out(ib, CP_DRAW_INDX_2_NUM_INDICES(num_indices));
+	}
+}
+
+/* CP_SET_RENDER_MODE, with an IB setting up the bin, everything on the
+ * first submit, otherwise some random subset of it.  There's no
+ * preemption buffer, so the first address is zero:
+ */
+static void out_render_mode(struct ib *parent)
+{
+	struct ib *ib = new_ib();
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(a5xx_bin_regs); i++)
+		if (first_submit || chance(rate))
+			out_reg(ib, a5xx_bin_regs[i], rnd());
+
+	ib->gpuaddr = alloc_gpuaddr(ib->sizedwords * 4);
+
+	out_pkt(parent, CP_SET_RENDER_MODE, 8);
+	out(parent, 1);                 /* mode */
+	out(parent, 0);                 /* preemption buffer */
+	out(parent, 0);
+	out(parent, 0);
+	out(parent, 0);
+	out(parent, ib->sizedwords);
+	out(parent, ib->gpuaddr);
+	out(parent, ib->gpuaddr >> 32);
+}
+
+/* the state for a draw, everything on the first draw of the submit (as
+ * if the context was restored), otherwise some random subset of it:
+ */
+static void out_state(struct ib *ib, bool all)
+{
+	unsigned i;
+
+	for (i = 0; i < nregs; i++) {
+		if (all || chance(rate)) {
+			state[i] = rnd();
+			out_reg(ib, regs[i], state[i]);
+		}
+	}
+
+	/* a3xx+ only, a2xx loads shaders/consts differently: */
+	if (gen < 3)
+		return;
+
+	if (all || chance(rate))
+		out_consts(ib);
+
+	if (nshaders && (all || chance(rate))) {
+		out_shader(ib, false);
+		out_shader(ib, true);
+	}
+}
+
+/* just movs between random registers, and an end: */
+static void generate_shaders(void)
+{
+	unsigned i, j, n;
+
+	for (i = 0; i < 2; i++) {
+		shaders[i] = calloc(nshaders, sizeof(struct shader));
+		for (j = 0; j < nshaders; j++) {
+			struct shader *shader = &shaders[i][j];
+			/* num_unit is in groups of 4 (or 16 on a4xx+) instructions: */
+			unsigned ninstrs;
+
+			shader->num_unit = 1 + (rnd() % 4);
+			ninstrs = shader->num_unit * ((gen >= 4) ? 16 : 4);
+			shader->sizedwords = ninstrs * 2;
+			shader->offset = shaderbufsize;
+
+			shaderbufsize += shader->sizedwords * 4;
+			shaderbuf = realloc(shaderbuf, shaderbufsize);
+
+			for (n = 0; n < ninstrs; n++) {
+				instr_t *instr = (instr_t *)&shaderbuf[shader->offset / 4 + 2 * n];
+
+				memset(instr, 0, sizeof(*instr));
+
+				if (n == (ninstrs - 1)) {
+					instr->cat0.opc = OPC_END;
+					instr->cat0.opc_cat = 0;
+				} else {
+					instr->cat1.src = rnd() % 64;
+					instr->cat1.dst = rnd() % 64;
+					instr->cat1.src_type = TYPE_F32;
+					instr->cat1.dst_type = TYPE_F32;
+					instr->cat1.opc_cat = 1;
+				}
+			}
+		}
+	}
+}
+
+/* depth is the number of levels of IB below the submitted cmdstream,
+ * the draws are in the IB1 (or the cmdstream for zero), and with two
+ * levels each draw's state is in its own IB2, like the blob's state
+ * groups:
+ */
+static void generate_submit(void)
+{
+	struct ib *cmd, *draws;
+	unsigned i;
+
+	nibs = 0;
+	next_gpuaddr = (gen >= 5) ? 0x100000000ull : 0x10000000;
+
+	for (i = 0; i < nbufs; i++) {
+		bufaddrs[i] = alloc_gpuaddr(bufsize);
+		if (chance(rate)) {
+			unsigned j;
+			for (j = 0; j < bufsize / 4; j++)
+				bufs[i][j] = rnd();
+		}
+	}
+
+	if (nshaders && indirect)
+		shaderaddr = alloc_gpuaddr(shaderbufsize);
+
+	cmd = new_ib();
+	draws = (depth > 0) ? new_ib() : cmd;
+
+	if (render_mode)
+		out_render_mode(draws);
+
+	for (i = 0; i < ndraws; i++) {
+		if (depth > 1) {
+			struct ib *ib2 = new_ib();
+			out_state(ib2, i == 0);
+			out_ib(draws, ib2);
+		} else {
+			out_state(draws, i == 0);
+		}
+		out_draw(draws);
+	}
+
+	if (depth > 0)
+		out_ib(cmd, draws);
+
+	cmd->gpuaddr = alloc_gpuaddr(cmd->sizedwords * 4);
+
+	for (i = 0; i < nbufs; i++)
+		write_buffer(bufaddrs[i], bufs[i], bufsize);
+	if (nshaders && indirect)
+		write_buffer(shaderaddr, shaderbuf, shaderbufsize);
+	for (i = 0; i < nibs; i++)
+		write_buffer(ibs[i].gpuaddr, ibs[i].dwords, ibs[i].sizedwords * 4);
+
+	write_addr(RD_CMDSTREAM_ADDR, cmd->gpuaddr, cmd->sizedwords);
+
+	first_submit = false;
+}
+
+static void print_usage(const char *name)
+{
+	printf("Usage: %s [OPTIONS]... OUTFILE\n", name);
+	printf("    --gpu-id N        - gpu id, a2xx..a5xx (default 530)\n");
+	printf("    --submits N       - number of submits (default 100)\n");
+	printf("    --draws N         - draws per submit (default %d)\n", ndraws);
+	printf("    --depth N         - levels of IB below the cmdstream, 0..2\n");
+	printf("                        (default %d)\n", depth);
+	printf("    --buffers N       - data buffers per submit (default %d)\n", nbufs);
+	printf("    --buffer-size N   - size of each data buffer (default %d)\n", bufsize);
+	printf("    --state-rate N    - %% chance of each register, the constants and\n");
+	printf("                        each buffer changing between draws/submits\n");
+	printf("                        (default %d)\n", rate);
+	printf("    --shaders N       - number of different vertex and fragment shader\n");
+	printf("                        programs, a3xx+ (default 0)\n");
+	printf("    --load-state MODE - inline or indirect (from a data buffer)\n");
+	printf("                        CP_LOAD_STATE (default inline)\n");
+	printf("    --render-mode     - start IB1 with a CP_SET_RENDER_MODE, a5xx\n");
+	printf("    --seed N          - PRNG seed (default 1)\n");
+	printf("    --rd-version N    - .rd file format version, 1 or 2 (default %d)\n",
+			RD_FILE_VERSION);
+	printf("    --level N         - compression level, 0..9 (default %d for .gz\n",
+			IO_LEVEL_DEFAULT);
+	printf("                        output, otherwise 0)\n");
+	printf("    --help            - show this message\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned gpu_id = 530;
+	int nsubmits = 100, level = -1;
+	int n = 1, i, ret;
+	char buf[256];
+
+	while (n < argc) {
+		if (!strcmp(argv[n], "--gpu-id")) {
+			n++;
+			gpu_id = strtoul(argv[n], NULL, 0);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--submits")) {
+			n++;
+			nsubmits = atoi(argv[n]);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--draws")) {
+			n++;
+			ndraws = atoi(argv[n]);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--depth")) {
+			n++;
+			depth = atoi(argv[n]);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--buffers")) {
+			n++;
+			nbufs = atoi(argv[n]);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--buffer-size")) {
+			n++;
+			bufsize = ALIGN(strtoul(argv[n], NULL, 0), 4);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--state-rate")) {
+			n++;
+			rate = atoi(argv[n]);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--shaders")) {
+			n++;
+			nshaders = atoi(argv[n]);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--load-state")) {
+			n++;
+			if ((n >= argc) || (strcmp(argv[n], "inline") &&
+					strcmp(argv[n], "indirect"))) {
+				fprintf(stderr, "--load-state expects inline or indirect\n");
+				return -1;
+			}
+			indirect = !strcmp(argv[n], "indirect");
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--render-mode")) {
+			n++;
+			render_mode = true;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--seed")) {
+			n++;
+			seed = strtoull(argv[n], NULL, 0);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--rd-version")) {
+			n++;
+			rd_version = atoi(argv[n]);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--level")) {
+			n++;
+			level = atoi(argv[n]);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--help")) {
+			print_usage(argv[0]);
+			return 0;
+		}
+
+		break;
+	}
+
+	gen = gpu_id / 100;
+
+	if (((argc - n) != 1) || (gen < 2) || (gen > 5) || (nsubmits < 0) ||
+			(ndraws < 1) || (depth < 0) || (depth > 2) || (nbufs < 0) ||
+			(bufsize < 0) || (nshaders < 0) || (rate < 0) || (rate > 100) ||
+			(rd_version < 1) || (rd_version > 2) || (level > 9) ||
+			(render_mode && (gen < 5))) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	switch (gen) {
+	case 2: regs = a2xx_regs; nregs = ARRAY_SIZE(a2xx_regs); break;
+	case 3: regs = a3xx_regs; nregs = ARRAY_SIZE(a3xx_regs); break;
+	case 4: regs = a4xx_regs; nregs = ARRAY_SIZE(a4xx_regs); break;
+	case 5: regs = a5xx_regs; nregs = ARRAY_SIZE(a5xx_regs); break;
+	}
+
+	/* xorshift gets stuck on zero: */
+	if (!seed)
+		seed = 1;
+
+	if (level < 0)
+		level = check_extension(argv[n], ".gz") ? IO_LEVEL_DEFAULT : IO_LEVEL_NONE;
+
+	io = io_wopen(argv[n], level, 0);
+	if (!io) {
+		fprintf(stderr, "could not open: %s\n", argv[n]);
+		return -1;
+	}
+
+	check_write(rd_file_write_header(io, &offset, rd_version));
+
+	ibs = calloc(ndraws + 3, sizeof(*ibs));
+	state = calloc(nregs, sizeof(*state));
+	bufs = calloc(nbufs, sizeof(*bufs));
+	bufaddrs = calloc(nbufs, sizeof(*bufaddrs));
+	for (i = 0; i < nbufs; i++) {
+		unsigned j;
+		bufs[i] = malloc(bufsize);
+		for (j = 0; j < bufsize / 4; j++)
+			bufs[i][j] = rnd();
+	}
+
+	if (gen < 3)
+		nshaders = 0;
+	if (nshaders)
+		generate_shaders();
+
+	snprintf(buf, sizeof(buf), "rdgen: gpu_id=%u, %d submits, %d draws, "
+			"depth %d, %d x %d byte buffers, %d shaders, %d%% state "
+			"changes, %s CP_LOAD_STATE%s", gpu_id, nsubmits, ndraws, depth,
+			nbufs, bufsize, nshaders, rate,
+			indirect ? "indirect" : "inline",
+			render_mode ? ", CP_SET_RENDER_MODE" : "");
+	write_section(RD_TEST, buf, strlen(buf) + 1);
+	write_section(RD_GPU_ID, &gpu_id, sizeof(gpu_id));
+
+	for (i = 0; i < nsubmits; i++)
+		generate_submit();
+
+	ret = io_wclose(io);
+	if (ret) {
+		fprintf(stderr, "error writing: %s: %s\n", argv[n], strerror(-ret));
+		return -1;
+	}
+
+	return 0;
+}
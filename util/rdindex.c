@@ -0,0 +1,448 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <zlib.h>
+
+#include "rdindex.h"
+
+#define RD_INDEX_MAGIC   0x58494452   /* "RDIX" */
+#define RD_INDEX_VERSION 3
+
+struct rd_index_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t file_size;
+	uint64_t file_mtime;     /* in ns */
+	uint32_t gpu_id;
+	uint32_t nsubmits;
+	uint64_t table_offset;   /* submit table, followed by section table */
+	uint32_t nsections;
+	uint32_t file_crc;       /* crc32 of the start of the file */
+};
+
+static char * index_path(const char *filename, const char *ext)
+{
+	char *path = malloc(strlen(filename) + strlen(ext) + 1);
+	if (path) {
+		strcpy(path, filename);
+		strcat(path, ext);
+	}
+	return path;
+}
+
+/* identify the version of the .rd file by its size and mtime, and (for
+ * filesystems with coarse timestamps, where a file rewritten in place
+ * can keep both) a crc of the start of the file:
+ */
+static int file_stamp(const char *filename, uint64_t *size, uint64_t *mtime,
+		uint32_t *crc)
+{
+	unsigned char buf[4096];
+	struct stat st;
+	ssize_t n;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return -1;
+	}
+
+	n = pread(fd, buf, sizeof(buf), 0);
+	close(fd);
+	if (n < 0)
+		return -1;
+
+	*size = st.st_size;
+	*mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	*crc = crc32(0, buf, n);
+
+	return 0;
+}
+
+static int full_pread(int fd, void *buf, size_t sz, uint64_t offset)
+{
+	char *ptr = buf;
+	while (sz > 0) {
+		ssize_t n = pread(fd, ptr, sz, offset);
+		if (n <= 0)
+			return -1;
+		ptr += n;
+		sz -= n;
+		offset += n;
+	}
+	return 0;
+}
+
+static int full_write(int fd, const void *buf, size_t sz)
+{
+	const char *ptr = buf;
+	while (sz > 0) {
+		ssize_t n = write(fd, ptr, sz);
+		if (n <= 0)
+			return -1;
+		ptr += n;
+		sz -= n;
+	}
+	return 0;
+}
+
+struct rd_index * rd_index_load(const char *filename)
+{
+	struct rd_index_header hdr;
+	struct rd_index *idx;
+	struct stat st;
+	uint64_t size, mtime;
+	uint32_t i, crc;
+	char *path;
+	int fd;
+
+	if (file_stamp(filename, &size, &mtime, &crc))
+		return NULL;
+
+	path = index_path(filename, ".idx");
+	if (!path)
+		return NULL;
+
+	fd = open(path, O_RDONLY);
+	free(path);
+	if (fd < 0)
+		return NULL;
+
+	/* the submit and section tables are at the end, after the
+	 * checkpoints, so they must exactly fill the rest of the file:
+	 */
+	if (fstat(fd, &st) ||
+			full_pread(fd, &hdr, sizeof(hdr), 0) ||
+			(hdr.magic != RD_INDEX_MAGIC) ||
+			(hdr.version != RD_INDEX_VERSION) ||
+			(hdr.file_size != size) ||
+			(hdr.file_mtime != mtime) ||
+			(hdr.file_crc != crc) ||
+			(hdr.table_offset < sizeof(hdr)) ||
+			(hdr.table_offset > st.st_size) ||
+			((st.st_size - hdr.table_offset) !=
+				((uint64_t)hdr.nsubmits * sizeof(idx->submits[0]) +
+				 (uint64_t)hdr.nsections * sizeof(idx->sections[0])))) {
+		close(fd);
+		return NULL;
+	}
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx) {
+		close(fd);
+		return NULL;
+	}
+
+	idx->fd = fd;
+	idx->gpu_id = hdr.gpu_id;
+	idx->nsubmits = hdr.nsubmits;
+	idx->nsections = hdr.nsections;
+	idx->submits = calloc(hdr.nsubmits + 1, sizeof(idx->submits[0]));
+	idx->sections = calloc(hdr.nsections + 1, sizeof(idx->sections[0]));
+
+	if (!idx->submits || !idx->sections ||
+			full_pread(fd, idx->submits,
+				hdr.nsubmits * sizeof(idx->submits[0]),
+				hdr.table_offset) ||
+			full_pread(fd, idx->sections,
+				hdr.nsections * sizeof(idx->sections[0]),
+				hdr.table_offset +
+				hdr.nsubmits * sizeof(idx->submits[0])))
+		goto fail;
+
+	for (i = 0; i < hdr.nsubmits; i++) {
+		struct rd_index_submit *s = &idx->submits[i];
+
+		if ((s->group_offset > size) || (s->cmd_offset > size) ||
+				(s->group_submit > i))
+			goto fail;
+
+		if ((s->flags & RD_INDEX_HAS_STATE) &&
+				((s->state_offset < sizeof(hdr)) ||
+				 (s->state_offset + (uint64_t)s->nregs * 2 * sizeof(uint32_t) >
+					hdr.table_offset)))
+			goto fail;
+	}
+
+	/* sections are looked up by offset, so must be in file order: */
+	for (i = 0; i < hdr.nsections; i++) {
+		struct rd_index_section *s = &idx->sections[i];
+
+		if ((s->offset > size) || (s->submit > hdr.nsubmits) ||
+				((i > 0) && (s->offset <= idx->sections[i - 1].offset)))
+			goto fail;
+	}
+
+	return idx;
+
+fail:
+	rd_index_free(idx);
+	return NULL;
+}
+
+struct rd_index * rd_index_create(const char *filename)
+{
+	struct rd_index_header hdr = {0};
+	struct rd_index *idx;
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return NULL;
+
+	idx->fd = -1;
+
+	if (file_stamp(filename, &idx->file_size, &idx->file_mtime,
+			&idx->file_crc))
+		goto fail;
+
+	idx->path = index_path(filename, ".idx");
+	idx->tmppath = index_path(filename, ".idx.tmp");
+	if (!idx->path || !idx->tmppath)
+		goto fail;
+
+	idx->fd = open(idx->tmppath, O_WRONLY | O_TRUNC | O_CREAT, 0644);
+	if (idx->fd < 0)
+		goto fail;
+
+	/* header is written for real once we know the table location: */
+	if (full_write(idx->fd, &hdr, sizeof(hdr)))
+		goto fail;
+
+	idx->offset = sizeof(hdr);
+
+	return idx;
+
+fail:
+	rd_index_free(idx);
+	return NULL;
+}
+
+void rd_index_add_reg(struct rd_index *idx, uint32_t regbase, uint32_t val)
+{
+	if ((idx->nregs + 1) >= idx->maxregs) {
+		idx->maxregs = idx->maxregs ? (idx->maxregs * 2) : 1024;
+		idx->regs = realloc(idx->regs, idx->maxregs * 2 * sizeof(uint32_t));
+	}
+	idx->regs[(idx->nregs * 2) + 0] = regbase;
+	idx->regs[(idx->nregs * 2) + 1] = val;
+	idx->nregs++;
+}
+
+void rd_index_add_submit(struct rd_index *idx, uint64_t group_offset,
+		uint32_t group_submit, uint64_t cmd_offset, int has_state,
+		int keyframe)
+{
+	struct rd_index_submit *s;
+
+	if (idx->nsubmits >= idx->maxsubmits) {
+		idx->maxsubmits = idx->maxsubmits ? (idx->maxsubmits * 2) : 1024;
+		idx->submits = realloc(idx->submits,
+				idx->maxsubmits * sizeof(idx->submits[0]));
+	}
+
+	s = &idx->submits[idx->nsubmits++];
+	memset(s, 0, sizeof(*s));
+
+	s->group_offset = group_offset;
+	s->group_submit = group_submit;
+	s->cmd_offset   = cmd_offset;
+
+	if (has_state && (idx->fd >= 0)) {
+		size_t sz = idx->nregs * 2 * sizeof(uint32_t);
+		if (!full_write(idx->fd, idx->regs, sz)) {
+			s->flags = RD_INDEX_HAS_STATE;
+			if (keyframe)
+				s->flags |= RD_INDEX_KEYFRAME;
+			s->state_offset = idx->offset;
+			s->nregs = idx->nregs;
+			idx->offset += sz;
+		}
+	}
+
+	idx->nregs = 0;
+}
+
+void rd_index_add_section(struct rd_index *idx, uint64_t offset,
+		uint32_t submit)
+{
+	struct rd_index_section *s;
+
+	if (!idx->tmppath)
+		return;
+
+	if (idx->nsections >= idx->maxsections) {
+		uint32_t max = idx->maxsections ? (idx->maxsections * 2) : 64;
+		s = realloc(idx->sections, max * sizeof(idx->sections[0]));
+		if (!s) {
+			/* an index missing sections would change the output
+			 * when seeking, so don't save it at all:
+			 */
+			unlink(idx->tmppath);
+			free(idx->tmppath);
+			idx->tmppath = NULL;
+			return;
+		}
+		idx->sections = s;
+		idx->maxsections = max;
+	}
+
+	s = &idx->sections[idx->nsections++];
+	memset(s, 0, sizeof(*s));
+
+	s->offset = offset;
+	s->submit = submit;
+}
+
+struct rd_index_section * rd_index_next_section(struct rd_index *idx,
+		uint64_t offset)
+{
+	uint32_t lo = 0, hi = idx->nsections;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (idx->sections[mid].offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return (lo < idx->nsections) ? &idx->sections[lo] : NULL;
+}
+
+int rd_index_get_state(struct rd_index *idx, uint32_t submit,
+		void (*fxn)(uint32_t regbase, uint32_t val, void *data), void *data)
+{
+	uint32_t i, first = submit;
+	uint64_t n = 0;
+	uint32_t *regs, *ptr;
+
+	if (submit >= idx->nsubmits)
+		return -1;
+
+	/* find the nearest preceding keyframe: */
+	while (!(idx->submits[first].flags & RD_INDEX_KEYFRAME)) {
+		if (!(idx->submits[first].flags & RD_INDEX_HAS_STATE) || (first == 0))
+			return -1;
+		first--;
+	}
+
+	for (i = first; i <= submit; i++)
+		n += idx->submits[i].nregs;
+
+	/* read all of the deltas before applying any of them, so a partial
+	 * checkpoint is never applied:
+	 */
+	regs = malloc(n * 2 * sizeof(uint32_t) + 1);
+	if (!regs)
+		return -1;
+
+	for (i = first, ptr = regs; i <= submit; i++) {
+		struct rd_index_submit *s = &idx->submits[i];
+
+		if (full_pread(idx->fd, ptr, s->nregs * 2 * sizeof(uint32_t),
+				s->state_offset)) {
+			free(regs);
+			return -1;
+		}
+		ptr += s->nregs * 2;
+	}
+
+	for (i = 0; i < n; i++)
+		fxn(regs[(i * 2) + 0], regs[(i * 2) + 1], data);
+
+	free(regs);
+
+	return 0;
+}
+
+int rd_index_save(struct rd_index *idx, uint32_t gpu_id)
+{
+	struct rd_index_header hdr = {
+			.magic        = RD_INDEX_MAGIC,
+			.version      = RD_INDEX_VERSION,
+			.file_size    = idx->file_size,
+			.file_mtime   = idx->file_mtime,
+			.gpu_id       = gpu_id,
+			.nsubmits     = idx->nsubmits,
+			.table_offset = idx->offset,
+			.nsections    = idx->nsections,
+			.file_crc     = idx->file_crc,
+	};
+	int ret;
+
+	if (!idx->tmppath)
+		return -1;
+
+	ret = full_write(idx->fd, idx->submits,
+			idx->nsubmits * sizeof(idx->submits[0]));
+	if (!ret)
+		ret = full_write(idx->fd, idx->sections,
+				idx->nsections * sizeof(idx->sections[0]));
+	if (!ret && (pwrite(idx->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)))
+		ret = -1;
+
+	close(idx->fd);
+	idx->fd = -1;
+
+	if (!ret)
+		ret = rename(idx->tmppath, idx->path);
+	if (ret)
+		unlink(idx->tmppath);
+
+	free(idx->tmppath);
+	idx->tmppath = NULL;
+
+	return ret;
+}
+
+void rd_index_free(struct rd_index *idx)
+{
+	if (!idx)
+		return;
+	if (idx->fd >= 0)
+		close(idx->fd);
+	if (idx->tmppath)
+		unlink(idx->tmppath);
+	free(idx->path);
+	free(idx->tmppath);
+	free(idx->submits);
+	free(idx->sections);
+	free(idx->regs);
+	free(idx);
+}
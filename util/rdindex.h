@@ -0,0 +1,138 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#ifndef RDINDEX_H_
+#define RDINDEX_H_
+
+#include <stdint.h>
+
+/* Sidecar index (foo.rd.idx) for a .rd file, which lets the decoder seek
+ * directly to a submit (RD_CMDSTREAM_ADDR) rather than reading every
+ * section from the start of the file.
+ *
+ * For each submit, the index records the file offset of the first
+ * section of the group of RD_GPUADDR/RD_BUFFER_CONTENTS sections it
+ * needs, and optionally a checkpoint of the register state at the
+ * start of the submit.  Checkpoints are stored as deltas against the
+ * previous submit, with a full keyframe every
+ * RD_INDEX_KEYFRAME_INTERVAL submits.
+ *
+ * Checkpoints are only recorded when every preceding submit has been
+ * decoded, since otherwise the decoder's register state is incomplete.
+ *
+ * The offsets of the other sections (cmdline, test name, shaders, etc)
+ * are recorded too, so that a decoder which seeks past them can still
+ * read them and produce the same output as reading the whole file.
+ *
+ * The index is tied to the size, mtime and a crc of the start of the .rd
+ * file, and is ignored if any of them has changed.
+ */
+
+#define RD_INDEX_KEYFRAME_INTERVAL 64
+
+struct rd_index_submit {
+	uint64_t group_offset;   /* offset of first section submit depends on */
+	uint32_t group_submit;   /* index of first submit at/after group_offset */
+	uint32_t flags;
+#define RD_INDEX_HAS_STATE  0x1  /* register state checkpoint is present */
+#define RD_INDEX_KEYFRAME   0x2  /* checkpoint is full state, not delta */
+	uint64_t cmd_offset;     /* offset of the RD_CMDSTREAM_ADDR section */
+	uint64_t state_offset;   /* offset of checkpoint within index file */
+	uint32_t nregs;          /* number of reg/val pairs in checkpoint */
+	uint32_t pad;
+};
+
+struct rd_index_section {
+	uint64_t offset;         /* offset of the section */
+	uint32_t submit;         /* number of submits preceding it */
+	uint32_t pad;
+};
+
+struct rd_index {
+	uint32_t gpu_id;
+	uint32_t nsubmits;
+	struct rd_index_submit *submits;
+	uint32_t nsections;
+	struct rd_index_section *sections;
+
+	/* private: */
+	int fd;
+	char *path, *tmppath;
+	uint64_t file_size, file_mtime;
+	uint32_t file_crc;
+	uint32_t *regs;          /* pending checkpoint being built */
+	uint32_t nregs, maxregs;
+	uint64_t offset;
+	uint32_t maxsubmits, maxsections;
+};
+
+/* load the index for the specified .rd file, returns NULL if there is
+ * no index or it is stale or corrupt:
+ */
+struct rd_index * rd_index_load(const char *filename);
+
+/* start building a new index for the specified .rd file, returns NULL
+ * if the index file cannot be created:
+ */
+struct rd_index * rd_index_create(const char *filename);
+
+/* call to add a register to the checkpoint for the next submit: */
+void rd_index_add_reg(struct rd_index *idx, uint32_t regbase, uint32_t val);
+
+/* add next submit (and any registers added since the previous submit
+ * as its checkpoint, if has_state is set):
+ */
+void rd_index_add_submit(struct rd_index *idx, uint64_t group_offset,
+		uint32_t group_submit, uint64_t cmd_offset, int has_state,
+		int keyframe);
+
+/* add a section other than RD_GPUADDR/RD_BUFFER_CONTENTS/RD_CMDSTREAM_ADDR,
+ * at the specified offset, following the specified number of submits:
+ */
+void rd_index_add_section(struct rd_index *idx, uint64_t offset,
+		uint32_t submit);
+
+/* returns the first such section at or after the specified offset, or
+ * NULL if there is none:
+ */
+struct rd_index_section * rd_index_next_section(struct rd_index *idx,
+		uint64_t offset);
+
+/* reconstruct register state at the start of the specified submit, by
+ * calling fxn for each register.  Returns non-zero if there is no
+ * checkpoint for the submit, or it cannot be read, in which case fxn
+ * is not called at all.
+ */
+int rd_index_get_state(struct rd_index *idx, uint32_t submit,
+		void (*fxn)(uint32_t regbase, uint32_t val, void *data), void *data);
+
+/* finish writing (if idx was created) and free the index: */
+int rd_index_save(struct rd_index *idx, uint32_t gpu_id);
+void rd_index_free(struct rd_index *idx);
+
+#endif /* RDINDEX_H_ */
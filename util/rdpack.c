@@ -0,0 +1,122 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+/* Convert a .rd file (plain or gzip'd) into the chunked gzip container
+ * described in io.h, which can be read by zcat et al, but also allows
+ * the tools to seek and decompress in parallel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "io.h"
+
+static void print_usage(const char *name)
+{
+	printf("Usage: %s [OPTIONS]... INFILE OUTFILE\n", name);
+	printf("    --frame-size N    - uncompressed size of each frame (default %d)\n",
+			IO_FRAME_SIZE);
+	printf("    --level N         - compression level, 1..9 (default %d)\n",
+			IO_LEVEL_DEFAULT);
+	printf("    --help            - show this message\n");
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t frame_size = IO_FRAME_SIZE;
+	int level = IO_LEVEL_DEFAULT;
+	int n = 1, ret, err;
+	struct io *io;
+	struct io_writer *out;
+	uint8_t *buf;
+
+	while (n < argc) {
+		if (!strcmp(argv[n], "--frame-size")) {
+			n++;
+			frame_size = strtoul(argv[n], NULL, 0);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--level")) {
+			n++;
+			level = atoi(argv[n]);
+			n++;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--help")) {
+			print_usage(argv[0]);
+			return 0;
+		}
+
+		break;
+	}
+
+	if (((argc - n) != 2) || !frame_size || (level < 1) || (level > 9)) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	io = io_open(argv[n]);
+	if (!io) {
+		fprintf(stderr, "could not open: %s\n", argv[n]);
+		return -1;
+	}
+
+	out = io_wopen(argv[n + 1], level, frame_size);
+	if (!out) {
+		fprintf(stderr, "could not open: %s\n", argv[n + 1]);
+		return -1;
+	}
+
+	buf = malloc(frame_size);
+
+	while ((ret = io_readn(io, buf, frame_size)) > 0) {
+		err = io_write(out, buf, ret);
+		if (err < 0) {
+			fprintf(stderr, "error writing: %s: %s\n", argv[n + 1],
+					strerror(-err));
+			return -1;
+		}
+	}
+
+	free(buf);
+	io_close(io);
+
+	err = io_wclose(out);
+	if (err) {
+		fprintf(stderr, "error writing: %s: %s\n", argv[n + 1],
+				strerror(-err));
+		return -1;
+	}
+
+	return (ret < 0) ? -1 : 0;
+}
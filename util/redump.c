@@ -31,6 +31,8 @@
 #include <string.h>
 
 #include "redump.h"
+#include "io.h"
+#include "rdfile.h"
 
 static const uint32_t patterns[] = {
 		/* these should be ordered by most inclusive pattern, ie. most 'f's */
@@ -124,7 +126,8 @@ struct param {
 };
 
 struct context {
-	int       fd;
+	struct io *io;
+	struct rd_file rd;
 	uint32_t *buf;           /* current row buffer */
 	int       sz;            /* current row buffer size */
 	uint32_t  gpuaddrs[32];
@@ -146,9 +149,14 @@ static void handle_gpuaddr(struct context *ctx)
 {
 	uint32_t gpuaddr = ctx->buf[0];
 	printf("<font color=\"#%06x\"><b>%08x</b></font><br>",
-			gpuaddr_colors[ctx->ngpuaddrs], gpuaddr);
+			gpuaddr_colors[ctx->ngpuaddrs % ARRAY_SIZE(gpuaddr_colors)],
+			gpuaddr);
 	printf("(len: %x)", ctx->buf[1]);
-	ctx->gpuaddrs[ctx->ngpuaddrs++] = gpuaddr;
+	/* newer traces have far more buffers than there are colors, only
+	 * the first few are highlighted:
+	 */
+	if (ctx->ngpuaddrs < ARRAY_SIZE(gpuaddr_colors))
+		ctx->gpuaddrs[ctx->ngpuaddrs++] = gpuaddr;
 }
 
 static int find_gpuaddr(struct context *ctx, uint32_t dword)
@@ -441,11 +449,15 @@ int main(int argc, char **argv)
 
 	for (i = 1; i < argc; i++) {
 		struct context *ctx = &ctxts[nctxts++];
-		ctx->fd = open(argv[i], O_RDONLY);
-		if (ctx->fd < 0) {
+		ctx->io = io_open(argv[i]);
+		if (!ctx->io) {
 			fprintf(stderr, "could not open: %s\n", argv[i]);
 			return -1;
 		}
+		if (rd_file_init(&ctx->rd, ctx->io)) {
+			fprintf(stderr, "invalid input file: %s\n", argv[i]);
+			return -1;
+		}
 	}
 
 	printf("<html><body><table border=\"1\">\n");
@@ -460,8 +472,10 @@ int main(int argc, char **argv)
 			free(ctx->buf);
 			ctx->buf = NULL;
 
-			if ((read(ctx->fd, &type, sizeof(type)) > 0) &&
-					(read(ctx->fd, &ctx->sz, 4) > 0)) {
+			if (rd_next_section_max(&ctx->rd, INT32_MAX) > 0) {
+				type = ctx->rd.type;
+				ctx->sz = ctx->rd.size;
+
 				if (row_type == RD_NONE)
 					row_type = type;
 
@@ -471,7 +485,7 @@ int main(int argc, char **argv)
 					 * same size..
 					 */
 					ctx->buf = calloc(1, ctx->sz + 1 + 20);
-					read(ctx->fd, ctx->buf, ctx->sz);
+					rd_read_payload(&ctx->rd, ctx->buf);
 					((char *)ctx->buf)[ctx->sz] = '\0';
 				} else {
 					fprintf(stderr, "unexpected type '%d', expected '%d'\n", type, row_type);
@@ -486,6 +500,15 @@ int main(int argc, char **argv)
 			break;
 		}
 
+		/* skip sections which are not shown, ie. buffer contents in
+		 * newer traces:
+		 */
+		if ((row_type >= ARRAY_SIZE(sect_handlers)) ||
+				!sect_handlers[row_type]) {
+			n = 1;
+			continue;
+		}
+
 		printf("<tr><th>%s</th>", sect_names[row_type]);
 
 		for (i = 0, n = 0; i < nctxts; i++) {
@@ -503,6 +526,9 @@ int main(int argc, char **argv)
 	} while(n > 0);
 	printf("</table></body></html>\n");
 
+	for (i = 0; i < nctxts; i++)
+		io_close(ctxts[i].io);
+
 	return 0;
 }
 
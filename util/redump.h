@@ -24,6 +24,8 @@
 #ifndef REDUMP_H_
 #define REDUMP_H_
 
+#include <stdint.h>
+
 enum rd_sect_type {
 	RD_NONE,
 	RD_TEST,       /* ascii text */
@@ -55,9 +57,55 @@ enum rd_param_type {
 	RD_PARAM_BLIT_Y2,      /* BLIT_Y + BLIT_WIDTH */
 };
 
+/* .rd file format:
+ *
+ * Version 1 (the original format) is just a sequence of sections, each
+ * of which is written as:
+ *
+ *    uint32_t 0xffffffff, 0xffffffff   (optional, to help resync)
+ *    uint32_t type
+ *    uint32_t size    (payload size, padded to multiple of 4)
+ *    payload
+ *
+ * Version 2 files start with a struct rd_file_header, followed by
+ * sections written as a struct rd_section_header and payload.  The
+ * section header is placed so that the payload which immediately
+ * follows it is aligned to the alignment given in the file header,
+ * so that (for example) buffer contents can be used directly from an
+ * mmap'd file, with zero padding before the header as needed.  See
+ * rd_section_offset().
+ */
+#define RD_FILE_MAGIC     0x44524446   /* "FDRD" */
+#define RD_SECT_MAGIC     0x54434553   /* "SECT" */
+#define RD_FILE_VERSION   2
+#define RD_FILE_ALIGN     64           /* default payload alignment */
+
+struct rd_file_header {
+	uint32_t magic;        /* RD_FILE_MAGIC */
+	uint32_t version;      /* RD_FILE_VERSION */
+	uint32_t align;        /* payload alignment, power of two >= 8 */
+	uint32_t flags;
+#define RD_FILE_CHECKSUM  0x1  /* sections have payload checksums */
+};
+
+struct rd_section_header {
+	uint32_t magic;        /* RD_SECT_MAGIC */
+	uint32_t type;         /* enum rd_sect_type */
+	uint64_t size;         /* payload size (not including padding) */
+	uint32_t checksum;     /* crc32 of payload, if RD_FILE_CHECKSUM */
+	uint32_t hdr_checksum; /* crc32 of the preceding fields */
+};
+
+/* offset of the next section header, given the current end of file: */
+static inline uint64_t rd_section_offset(uint64_t pos, uint32_t align)
+{
+	uint64_t hdrsz = sizeof(struct rd_section_header);
+	return ((pos + hdrsz + align - 1) & ~(uint64_t)(align - 1)) - hdrsz;
+}
+
 void rd_start(const char *name, const char *fmt, ...) __attribute__((weak));
 void rd_end(void) __attribute__((weak));
-void rd_write_section(enum rd_sect_type type, const void *buf, int sz) __attribute__((weak));
+void rd_write_section(enum rd_sect_type type, const void *buf, uint64_t sz) __attribute__((weak));
 
 /* for code that should run with and without libwrap, use the following
  * macros which check if the fxns are present before calling
@@ -0,0 +1,897 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "rnncache.h"
+#include "batch.h"
+
+#define RNN_CACHE_MAGIC   0x434e4e52   /* "RNNC" */
+#define RNN_CACHE_VERSION 2
+
+/*
+ * The file starts with a header:
+ *
+ *    magic, version, crc and size of the tool binary, variant,
+ *    RNN_PATH, cwd, nfiles, and for each file: path, size, mtime
+ *
+ * followed by the number of enums, bitsets and spectypes, then those,
+ * and then the domains (count first), with everything they contain
+ * written depth first.  Integers are native endian, and strings are a
+ * u32 length (~0 for NULL) followed by the string and its terminating
+ * NUL, so they can be used in place in the mmap'd file.  A typeinfo
+ * refers to its enum/bitset/spectype by index in the db, since those
+ * are shared.
+ *
+ * The layout of the structs written depends on the envytools headers
+ * the tool was built with, hence the tool binary in the header.
+ */
+
+#define NOSTR 0xffffffff
+
+/*
+ * Writing:
+ */
+
+struct wbuf {
+	struct rnndeccontext *vc;
+	struct rnndb *db;
+	char *data;
+	size_t len, size;
+	int err;
+};
+
+static void put(struct wbuf *b, const void *ptr, size_t n)
+{
+	if (b->err)
+		return;
+
+	if ((b->len + n) > b->size) {
+		size_t size = 2 * b->size + n + 0x10000;
+		char *data = realloc(b->data, size);
+		if (!data) {
+			b->err = 1;
+			return;
+		}
+		b->data = data;
+		b->size = size;
+	}
+
+	memcpy(b->data + b->len, ptr, n);
+	b->len += n;
+}
+
+static void put32(struct wbuf *b, uint32_t val)
+{
+	put(b, &val, sizeof(val));
+}
+
+static void put64(struct wbuf *b, uint64_t val)
+{
+	put(b, &val, sizeof(val));
+}
+
+static void putstr(struct wbuf *b, const char *str)
+{
+	if (!str) {
+		put32(b, NOSTR);
+		return;
+	}
+	put32(b, strlen(str));
+	put(b, str, strlen(str) + 1);
+}
+
+/* for counts of things that are only known once they are written: */
+static size_t putcount(struct wbuf *b)
+{
+	size_t pos = b->len;
+	put32(b, 0);
+	return pos;
+}
+
+static void patchcount(struct wbuf *b, size_t pos, uint32_t count)
+{
+	if (!b->err)
+		memcpy(b->data + pos, &count, sizeof(count));
+}
+
+static uint32_t enumidx(struct wbuf *b, struct rnnenum *en)
+{
+	int i;
+
+	if (!en)
+		return NOSTR;
+	for (i = 0; i < b->db->enumsnum; i++)
+		if (b->db->enums[i] == en)
+			return i;
+
+	/* not one of the db's, so can't be referred to: */
+	b->err = 1;
+	return NOSTR;
+}
+
+static uint32_t bitsetidx(struct wbuf *b, struct rnnbitset *bs)
+{
+	int i;
+
+	if (!bs)
+		return NOSTR;
+	for (i = 0; i < b->db->bitsetsnum; i++)
+		if (b->db->bitsets[i] == bs)
+			return i;
+
+	b->err = 1;
+	return NOSTR;
+}
+
+static uint32_t spectypeidx(struct wbuf *b, struct rnnspectype *st)
+{
+	int i;
+
+	if (!st)
+		return NOSTR;
+	for (i = 0; i < b->db->spectypesnum; i++)
+		if (b->db->spectypes[i] == st)
+			return i;
+
+	b->err = 1;
+	return NOSTR;
+}
+
+/* the entries which don't apply to the variant are left out, so nothing
+ * needs the varinfo to decode, but it is kept for anything which looks
+ * at the strings:
+ */
+static void write_varinfo(struct wbuf *b, struct rnnvarinfo *vi)
+{
+	putstr(b, vi->prefixstr);
+	putstr(b, vi->varsetstr);
+	putstr(b, vi->variantsstr);
+	put32(b, vi->dead);
+}
+
+static void write_vals(struct wbuf *b, struct rnnvalue **vals, int valsnum)
+{
+	size_t pos = putcount(b);
+	uint32_t i, n = 0;
+
+	for (i = 0; i < valsnum; i++) {
+		struct rnnvalue *val = vals[i];
+
+		if (!rnndec_varmatch(b->vc, &val->varinfo))
+			continue;
+
+		putstr(b, val->name);
+		putstr(b, val->fullname);
+		put64(b, val->value);
+		put32(b, val->valvalid);
+		/* still used by rnn_enumname(): */
+		write_varinfo(b, &val->varinfo);
+		n++;
+	}
+
+	patchcount(b, pos, n);
+}
+
+static void write_typeinfo(struct wbuf *b, struct rnntypeinfo *ti);
+
+static void write_bitfields(struct wbuf *b, struct rnnbitfield **bitfields,
+		int bitfieldsnum)
+{
+	size_t pos = putcount(b);
+	uint32_t i, n = 0;
+
+	for (i = 0; i < bitfieldsnum; i++) {
+		struct rnnbitfield *bf = bitfields[i];
+
+		if (!rnndec_varmatch(b->vc, &bf->varinfo))
+			continue;
+
+		putstr(b, bf->name);
+		putstr(b, bf->fullname);
+		put32(b, bf->low);
+		put32(b, bf->high);
+		put64(b, bf->mask);
+		write_varinfo(b, &bf->varinfo);
+		write_typeinfo(b, &bf->typeinfo);
+		n++;
+	}
+
+	patchcount(b, pos, n);
+}
+
+static void write_typeinfo(struct wbuf *b, struct rnntypeinfo *ti)
+{
+	putstr(b, ti->name);
+	put32(b, ti->type);
+	put32(b, enumidx(b, ti->eenum));
+	put32(b, bitsetidx(b, ti->ebitset));
+	put32(b, spectypeidx(b, ti->spectype));
+	write_vals(b, ti->vals, ti->valsnum);
+	write_bitfields(b, ti->bitfields, ti->bitfieldsnum);
+	put32(b, ti->shr);
+	put64(b, ti->min);
+	put64(b, ti->max);
+	put64(b, ti->align);
+	put64(b, ti->radix);
+	put32(b, ti->addvariant);
+	put32(b, ti->minvalid);
+	put32(b, ti->maxvalid);
+	put32(b, ti->alignvalid);
+	put32(b, ti->radixvalid);
+}
+
+static void write_delems(struct wbuf *b, struct rnndelem **elems, int elemsnum)
+{
+	size_t pos = putcount(b);
+	uint32_t i, n = 0;
+
+	for (i = 0; i < elemsnum; i++) {
+		struct rnndelem *elem = elems[i];
+		int j;
+
+		if (!rnndec_varmatch(b->vc, &elem->varinfo))
+			continue;
+
+		put32(b, elem->type);
+		putstr(b, elem->name);
+		putstr(b, elem->fullname);
+		put32(b, elem->width);
+		put32(b, elem->access);
+		put64(b, elem->offset);
+		/* arrays with explicit offsets, rather than a stride: */
+		put32(b, elem->offsetsnum);
+		for (j = 0; j < elem->offsetsnum; j++)
+			put64(b, elem->offsets[j]);
+		put64(b, elem->length);
+		put64(b, elem->stride);
+		write_varinfo(b, &elem->varinfo);
+		write_typeinfo(b, &elem->typeinfo);
+		write_delems(b, elem->subelems, elem->subelemsnum);
+		n++;
+	}
+
+	patchcount(b, pos, n);
+}
+
+static void write_db(struct wbuf *b)
+{
+	struct rnndb *db = b->db;
+	int i;
+
+	put32(b, db->enumsnum);
+	put32(b, db->bitsetsnum);
+	put32(b, db->spectypesnum);
+
+	for (i = 0; i < db->enumsnum; i++) {
+		struct rnnenum *en = db->enums[i];
+		putstr(b, en->name);
+		putstr(b, en->fullname);
+		put32(b, en->bare);
+		put32(b, en->isinline);
+		write_varinfo(b, &en->varinfo);
+		write_vals(b, en->vals, en->valsnum);
+	}
+
+	for (i = 0; i < db->bitsetsnum; i++) {
+		struct rnnbitset *bs = db->bitsets[i];
+		putstr(b, bs->name);
+		putstr(b, bs->fullname);
+		put32(b, bs->bare);
+		put32(b, bs->isinline);
+		write_varinfo(b, &bs->varinfo);
+		write_bitfields(b, bs->bitfields, bs->bitfieldsnum);
+	}
+
+	for (i = 0; i < db->spectypesnum; i++) {
+		struct rnnspectype *st = db->spectypes[i];
+		putstr(b, st->name);
+		write_typeinfo(b, &st->typeinfo);
+	}
+
+	put32(b, db->domainsnum);
+
+	for (i = 0; i < db->domainsnum; i++) {
+		struct rnndomain *dom = db->domains[i];
+		putstr(b, dom->name);
+		putstr(b, dom->fullname);
+		put32(b, dom->bare);
+		put32(b, dom->width);
+		put64(b, dom->size);
+		put32(b, dom->sizevalid);
+		write_varinfo(b, &dom->varinfo);
+		write_delems(b, dom->subelems, dom->subelemsnum);
+	}
+}
+
+/*
+ * Reading, into structs allocated from an arena, so that a cache file
+ * which turns out to be truncated or corrupt can be thrown away without
+ * leaking what was built from it so far:
+ */
+
+struct chunk {
+	struct chunk *next;
+	size_t used, size;
+	char data[];
+};
+
+struct rbuf {
+	const char *ptr, *end;
+	struct chunk *chunks;
+	int err;
+};
+
+static void * zalloc(struct rbuf *r, size_t n)
+{
+	struct chunk *c = r->chunks;
+	void *ptr;
+
+	n = (n + 7) & ~(size_t)7;
+
+	if (!c || ((c->used + n) > c->size)) {
+		size_t size = (n > 0x10000) ? n : 0x10000;
+		c = calloc(1, sizeof(*c) + size);
+		if (!c) {
+			r->err = 1;
+			return NULL;
+		}
+		c->size = size;
+		c->next = r->chunks;
+		r->chunks = c;
+	}
+
+	ptr = c->data + c->used;
+	c->used += n;
+
+	return ptr;
+}
+
+static void get(struct rbuf *r, void *ptr, size_t n)
+{
+	if (r->err || ((size_t)(r->end - r->ptr) < n)) {
+		r->err = 1;
+		memset(ptr, 0, n);
+		return;
+	}
+	memcpy(ptr, r->ptr, n);
+	r->ptr += n;
+}
+
+static uint32_t get32(struct rbuf *r)
+{
+	uint32_t val;
+	get(r, &val, sizeof(val));
+	return val;
+}
+
+static uint64_t get64(struct rbuf *r)
+{
+	uint64_t val;
+	get(r, &val, sizeof(val));
+	return val;
+}
+
+static char * getstr(struct rbuf *r)
+{
+	uint32_t len = get32(r);
+	char *str;
+
+	if (r->err || (len == NOSTR))
+		return NULL;
+
+	if (((size_t)(r->end - r->ptr) <= len) || r->ptr[len]) {
+		r->err = 1;
+		return NULL;
+	}
+
+	str = (char *)r->ptr;
+	r->ptr += len + 1;
+
+	return str;
+}
+
+/* every object takes at least four bytes, which bounds any count: */
+static uint32_t getcount(struct rbuf *r)
+{
+	uint32_t n = get32(r);
+	if (n > (size_t)(r->end - r->ptr) / 4) {
+		r->err = 1;
+		return 0;
+	}
+	return n;
+}
+
+/* allocate an array of n pointers to (zeroed) objects of size sz: */
+static void * getobjs(struct rbuf *r, uint32_t n, size_t sz)
+{
+	void **objs = zalloc(r, n * sizeof(objs[0]));
+	uint32_t i;
+
+	for (i = 0; objs && (i < n); i++)
+		objs[i] = zalloc(r, sz);
+
+	return r->err ? NULL : objs;
+}
+
+static void read_varinfo(struct rbuf *r, struct rnnvarinfo *vi)
+{
+	vi->prefixstr = getstr(r);
+	vi->varsetstr = getstr(r);
+	vi->variantsstr = getstr(r);
+	vi->dead = get32(r);
+}
+
+static void read_vals(struct rbuf *r, struct rnnvalue ***pvals, int *pnum,
+		int *pmax)
+{
+	uint32_t i, n = getcount(r);
+	struct rnnvalue **vals = getobjs(r, n, sizeof(**vals));
+
+	for (i = 0; !r->err && (i < n); i++) {
+		struct rnnvalue *val = vals[i];
+		val->name = getstr(r);
+		val->fullname = getstr(r);
+		val->value = get64(r);
+		val->valvalid = get32(r);
+		read_varinfo(r, &val->varinfo);
+	}
+
+	*pvals = vals;
+	*pnum = *pmax = r->err ? 0 : n;
+}
+
+static void read_typeinfo(struct rbuf *r, struct rnndb *db,
+		struct rnntypeinfo *ti);
+
+static void read_bitfields(struct rbuf *r, struct rnndb *db,
+		struct rnnbitfield ***pbitfields, int *pnum, int *pmax)
+{
+	uint32_t i, n = getcount(r);
+	struct rnnbitfield **bitfields = getobjs(r, n, sizeof(**bitfields));
+
+	for (i = 0; !r->err && (i < n); i++) {
+		struct rnnbitfield *bf = bitfields[i];
+		bf->name = getstr(r);
+		bf->fullname = getstr(r);
+		bf->low = get32(r);
+		bf->high = get32(r);
+		bf->mask = get64(r);
+		read_varinfo(r, &bf->varinfo);
+		read_typeinfo(r, db, &bf->typeinfo);
+	}
+
+	*pbitfields = bitfields;
+	*pnum = *pmax = r->err ? 0 : n;
+}
+
+static void read_typeinfo(struct rbuf *r, struct rnndb *db,
+		struct rnntypeinfo *ti)
+{
+	uint32_t idx;
+
+	ti->name = getstr(r);
+	ti->type = get32(r);
+
+	idx = get32(r);
+	if (idx < db->enumsnum)
+		ti->eenum = db->enums[idx];
+	else if (idx != NOSTR)
+		r->err = 1;
+
+	idx = get32(r);
+	if (idx < db->bitsetsnum)
+		ti->ebitset = db->bitsets[idx];
+	else if (idx != NOSTR)
+		r->err = 1;
+
+	idx = get32(r);
+	if (idx < db->spectypesnum)
+		ti->spectype = db->spectypes[idx];
+	else if (idx != NOSTR)
+		r->err = 1;
+
+	read_vals(r, &ti->vals, &ti->valsnum, &ti->valsmax);
+	read_bitfields(r, db, &ti->bitfields, &ti->bitfieldsnum,
+			&ti->bitfieldsmax);
+	ti->shr = get32(r);
+	ti->min = get64(r);
+	ti->max = get64(r);
+	ti->align = get64(r);
+	ti->radix = get64(r);
+	ti->addvariant = get32(r);
+	ti->minvalid = get32(r);
+	ti->maxvalid = get32(r);
+	ti->alignvalid = get32(r);
+	ti->radixvalid = get32(r);
+}
+
+static void read_delems(struct rbuf *r, struct rnndb *db,
+		struct rnndelem ***pelems, int *pnum, int *pmax)
+{
+	uint32_t i, n = getcount(r);
+	struct rnndelem **elems = getobjs(r, n, sizeof(**elems));
+
+	for (i = 0; !r->err && (i < n); i++) {
+		struct rnndelem *elem = elems[i];
+		uint32_t j, noffsets;
+
+		elem->type = get32(r);
+		elem->name = getstr(r);
+		elem->fullname = getstr(r);
+		elem->width = get32(r);
+		elem->access = get32(r);
+		elem->offset = get64(r);
+		noffsets = getcount(r);
+		elem->offsets = zalloc(r, noffsets * sizeof(elem->offsets[0]));
+		for (j = 0; !r->err && (j < noffsets); j++)
+			elem->offsets[j] = get64(r);
+		elem->offsetsnum = elem->offsetsmax = r->err ? 0 : noffsets;
+		elem->length = get64(r);
+		elem->stride = get64(r);
+		read_varinfo(r, &elem->varinfo);
+		read_typeinfo(r, db, &elem->typeinfo);
+		read_delems(r, db, &elem->subelems, &elem->subelemsnum,
+				&elem->subelemsmax);
+	}
+
+	*pelems = elems;
+	*pnum = *pmax = r->err ? 0 : n;
+}
+
+static void read_db(struct rbuf *r, struct rnndb *db)
+{
+	uint32_t i, n;
+
+	n = getcount(r);
+	db->enums = getobjs(r, n, sizeof(**db->enums));
+	db->enumsnum = db->enumsmax = r->err ? 0 : n;
+
+	n = getcount(r);
+	db->bitsets = getobjs(r, n, sizeof(**db->bitsets));
+	db->bitsetsnum = db->bitsetsmax = r->err ? 0 : n;
+
+	n = getcount(r);
+	db->spectypes = getobjs(r, n, sizeof(**db->spectypes));
+	db->spectypesnum = db->spectypesmax = r->err ? 0 : n;
+
+	for (i = 0; !r->err && (i < db->enumsnum); i++) {
+		struct rnnenum *en = db->enums[i];
+		en->name = getstr(r);
+		en->fullname = getstr(r);
+		en->bare = get32(r);
+		en->isinline = get32(r);
+		en->prepared = 1;
+		read_varinfo(r, &en->varinfo);
+		read_vals(r, &en->vals, &en->valsnum, &en->valsmax);
+	}
+
+	for (i = 0; !r->err && (i < db->bitsetsnum); i++) {
+		struct rnnbitset *bs = db->bitsets[i];
+		bs->name = getstr(r);
+		bs->fullname = getstr(r);
+		bs->bare = get32(r);
+		bs->isinline = get32(r);
+		bs->prepared = 1;
+		read_varinfo(r, &bs->varinfo);
+		read_bitfields(r, db, &bs->bitfields, &bs->bitfieldsnum,
+				&bs->bitfieldsmax);
+	}
+
+	for (i = 0; !r->err && (i < db->spectypesnum); i++) {
+		struct rnnspectype *st = db->spectypes[i];
+		st->name = getstr(r);
+		read_typeinfo(r, db, &st->typeinfo);
+	}
+
+	n = getcount(r);
+	db->domains = getobjs(r, n, sizeof(**db->domains));
+	db->domainsnum = db->domainsmax = r->err ? 0 : n;
+
+	for (i = 0; !r->err && (i < db->domainsnum); i++) {
+		struct rnndomain *dom = db->domains[i];
+		dom->name = getstr(r);
+		dom->fullname = getstr(r);
+		dom->bare = get32(r);
+		dom->width = get32(r);
+		dom->size = get64(r);
+		dom->sizevalid = get32(r);
+		dom->prepared = 1;
+		read_varinfo(r, &dom->varinfo);
+		read_delems(r, db, &dom->subelems, &dom->subelemsnum,
+				&dom->subelemsmax);
+	}
+}
+
+/*
+ * Cache files:
+ */
+
+static char * cache_dir(void)
+{
+	const char *dir = getenv("XDG_CACHE_HOME");
+	char *path;
+	int ret;
+
+	if (dir && dir[0])
+		ret = asprintf(&path, "%s/freedreno", dir);
+	else if ((dir = getenv("HOME")))
+		ret = asprintf(&path, "%s/.cache/freedreno", dir);
+	else
+		return NULL;
+
+	return (ret < 0) ? NULL : path;
+}
+
+static char * cache_path(const char *file, const char *variant)
+{
+	char *dir, *name, *path, *p;
+	int ret;
+
+	dir = cache_dir();
+	if (!dir)
+		return NULL;
+
+	name = strdup(file);
+	if (!name) {
+		free(dir);
+		return NULL;
+	}
+	for (p = name; *p; p++)
+		if (*p == '/')
+			*p = '_';
+
+	ret = asprintf(&path, "%s/%s.%s.rnnc", dir, name, variant);
+	free(name);
+	free(dir);
+
+	return (ret < 0) ? NULL : path;
+}
+
+static const char * rnn_path(void)
+{
+	const char *path = getenv("RNN_PATH");
+	return path ? path : "";
+}
+
+struct rnndb * rnn_cache_load(const char *file, const char *variant)
+{
+	struct rbuf r = {0};
+	struct rnndb *db = NULL;
+	struct stat st;
+	char *path, *cwd, *str;
+	void *map = MAP_FAILED;
+	uint32_t i, n, exe_crc;
+	uint64_t exe_size;
+	int fd;
+
+	if (batch_crc("/proc/self/exe", &exe_crc, &exe_size))
+		return NULL;
+
+	path = cache_path(file, variant);
+	if (!path)
+		return NULL;
+
+	fd = open(path, O_RDONLY);
+	free(path);
+	if (fd < 0)
+		return NULL;
+
+	if (!fstat(fd, &st) && (st.st_size > 0))
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	r.ptr = map;
+	r.end = r.ptr + st.st_size;
+
+	if ((get32(&r) != RNN_CACHE_MAGIC) || (get32(&r) != RNN_CACHE_VERSION) ||
+			(get32(&r) != exe_crc) || (get64(&r) != exe_size))
+		goto fail;
+
+	str = getstr(&r);
+	if (!str || strcmp(str, variant))
+		goto fail;
+
+	str = getstr(&r);
+	if (!str || strcmp(str, rnn_path()))
+		goto fail;
+
+	/* if any of the xml files were found relative to the cwd: */
+	str = getstr(&r);
+	if (!str)
+		goto fail;
+	if (str[0]) {
+		cwd = getcwd(NULL, 0);
+		if (!cwd || strcmp(str, cwd)) {
+			free(cwd);
+			goto fail;
+		}
+		free(cwd);
+	}
+
+	db = zalloc(&r, sizeof(*db));
+	n = getcount(&r);
+	db->files = zalloc(&r, n * sizeof(db->files[0]));
+	if (r.err)
+		goto fail;
+	db->filesnum = db->filesmax = n;
+
+	for (i = 0; i < n; i++) {
+		uint64_t size, mtime;
+		struct stat xst;
+
+		db->files[i] = getstr(&r);
+		size = get64(&r);
+		mtime = get64(&r);
+
+		if (r.err || !db->files[i] || stat(db->files[i], &xst) ||
+				(xst.st_size != size) || (xst.st_mtime != mtime))
+			goto fail;
+	}
+
+	read_db(&r, db);
+	if (r.err || (r.ptr != r.end))
+		goto fail;
+
+	/* the strings point into the map, so it stays around as long as
+	 * the db (and the arena), ie. for good:
+	 */
+	return db;
+
+fail:
+	while (r.chunks) {
+		struct chunk *c = r.chunks;
+		r.chunks = c->next;
+		free(c);
+	}
+	munmap(map, st.st_size);
+	return NULL;
+}
+
+static int write_all(int fd, const char *buf, size_t n)
+{
+	while (n > 0) {
+		ssize_t ret = write(fd, buf, n);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += ret;
+		n -= ret;
+	}
+	return 0;
+}
+
+int rnn_cache_save(struct rnndeccontext *vc, const char *file,
+		const char *variant)
+{
+	struct wbuf b = {
+			.vc = vc,
+			.db = vc->db,
+	};
+	struct rnndb *db = vc->db;
+	char *dir, *path = NULL, *tmppath = NULL, *cwd = NULL;
+	uint32_t exe_crc;
+	uint64_t exe_size;
+	int i, fd, ret = -1;
+
+	if (batch_crc("/proc/self/exe", &exe_crc, &exe_size))
+		return -1;
+
+	put32(&b, RNN_CACHE_MAGIC);
+	put32(&b, RNN_CACHE_VERSION);
+	put32(&b, exe_crc);
+	put64(&b, exe_size);
+	putstr(&b, variant);
+	putstr(&b, rnn_path());
+
+	for (i = 0; i < db->filesnum; i++) {
+		if (db->files[i][0] != '/') {
+			cwd = getcwd(NULL, 0);
+			if (!cwd)
+				goto out;
+			break;
+		}
+	}
+	putstr(&b, cwd ? cwd : "");
+
+	put32(&b, db->filesnum);
+	for (i = 0; i < db->filesnum; i++) {
+		struct stat st;
+
+		if (stat(db->files[i], &st))
+			goto out;
+
+		putstr(&b, db->files[i]);
+		put64(&b, st.st_size);
+		put64(&b, st.st_mtime);
+	}
+
+	write_db(&b);
+	if (b.err)
+		goto out;
+
+	dir = cache_dir();
+	if (!dir)
+		goto out;
+
+	/* the parent of $XDG_CACHE_HOME/freedreno may not exist yet: */
+	if (mkdir(dir, 0755) && (errno == ENOENT)) {
+		char *parent = strdup(dir);
+		if (parent) {
+			*strrchr(parent, '/') = '\0';
+			mkdir(parent, 0755);
+			free(parent);
+		}
+		mkdir(dir, 0755);
+	}
+	free(dir);
+
+	path = cache_path(file, variant);
+	if (!path || (asprintf(&tmppath, "%s.XXXXXX", path) < 0)) {
+		tmppath = NULL;
+		goto out;
+	}
+
+	/* written under a temporary name, so that concurrent runs never see
+	 * a partial file:
+	 */
+	fd = mkstemp(tmppath);
+	if (fd < 0)
+		goto out;
+
+	fchmod(fd, 0644);
+	ret = write_all(fd, b.data, b.len);
+	if (close(fd))
+		ret = -1;
+	if (!ret)
+		ret = rename(tmppath, path);
+	if (ret)
+		unlink(tmppath);
+
+out:
+	free(tmppath);
+	free(path);
+	free(cwd);
+	free(b.data);
+
+	return ret;
+}
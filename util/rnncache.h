@@ -0,0 +1,63 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#ifndef RNNCACHE_H_
+#define RNNCACHE_H_
+
+#include "rnn.h"
+#include "rnndec.h"
+
+/* On-disk cache of compiled register databases.
+ *
+ * Parsing the xml (and everything it includes) is most of the startup
+ * time of the decoders, so once a database has been parsed a compiled
+ * form of it is saved in $XDG_CACHE_HOME/freedreno (or ~/.cache/freedreno),
+ * which later runs mmap and turn straight back into a struct rnndb.
+ *
+ * The compiled form is for a single variant (ie. "chip"), leaving out
+ * everything that does not apply to it, so the result has no variant
+ * info and needs no further preparation.  It records the size and mtime
+ * of every xml file the database was parsed from (and the RNN_PATH they
+ * were found with), and the crc of the tool binary, since the layout
+ * depends on the envytools it was built with, and is ignored if any of
+ * them has changed.
+ */
+
+/* returns NULL if there is no up to date compiled database for the
+ * specified file and variant:
+ */
+struct rnndb * rnn_cache_load(const char *file, const char *variant);
+
+/* save the compiled form of the database parsed (and prepared) from
+ * file, where vc is a decode context for the database with the variant
+ * already set:
+ */
+int rnn_cache_save(struct rnndeccontext *vc, const char *file,
+		const char *variant);
+
+#endif /* RNNCACHE_H_ */
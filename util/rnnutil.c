@@ -33,6 +33,7 @@
 #include <assert.h>
 
 #include "rnnutil.h"
+#include "rnncache.h"
 
 static struct rnndomain *finddom(struct rnn *rnn, uint32_t regbase)
 {
@@ -41,19 +42,24 @@ static struct rnndomain *finddom(struct rnn *rnn, uint32_t regbase)
 	return rnn->dom[1];
 }
 
+static void freereg(struct rnn *rnn, struct rnnreg *reg)
+{
+	if (reg->name_nocolor != reg->name)
+		free(reg->name_nocolor);
+	free(reg->name);
+	memset(reg, 0, sizeof(*reg));
+}
+
+/* the db and decode contexts are only created by rnn_load(), so until
+ * then there is nothing to look anything up in:
+ */
 void _rnn_init(struct rnn *rnn, int nocolor)
 {
 	rnn_init();
 
-	rnn->db = rnn_newdb();
-	rnn->vc_nocolor = rnndec_newcontext(rnn->db);
-	rnn->vc_nocolor->colors = &envy_null_colors;
-	if (nocolor) {
-		rnn->vc = rnn->vc_nocolor;
-	} else {
-		rnn->vc = rnndec_newcontext(rnn->db);
-		rnn->vc->colors = &envy_def_colors;
-	}
+	memset(rnn, 0, sizeof(*rnn));
+	rnn->nocolor = nocolor;
+	rnn->regs = calloc(RNN_MAXREGS, sizeof(rnn->regs[0]));
 }
 
 struct rnn *rnn_new(int nocolor)
@@ -68,11 +74,72 @@ struct rnn *rnn_new(int nocolor)
 	return rnn;
 }
 
+/* Parsing the xml is by far the most expensive part of starting up, so
+ * each database is only parsed once per process, and shared by every
+ * rnn loaded for that generation (and by forked processes, see
+ * rnn_preload()).  And once parsed, it is saved in compiled form for
+ * later runs, see rnncache.h.  The database is not modified by
+ * decoding, the per-generation state lives in the decode context.
+ */
+static struct rnndbent {
+	const char *file, *variant;
+	struct rnndb *db;
+	struct rnndeccontext *vc;   /* for compiling, with variant set */
+} *dbs;
+static unsigned ndbs;
+
+static struct rnndb *getdb(const char *file, const char *variant)
+{
+	struct rnndbent *ent;
+	unsigned i;
+
+	for (i = 0; i < ndbs; i++)
+		if (!strcmp(dbs[i].file, file) && !strcmp(dbs[i].variant, variant))
+			return dbs[i].db;
+
+	ent = realloc(dbs, (ndbs + 1) * sizeof(dbs[0]));
+	assert(ent);
+	dbs = ent;
+	ent = &dbs[ndbs++];
+
+	ent->file = file;
+	ent->variant = variant;
+	ent->vc = NULL;
+	ent->db = rnn_cache_load(file, variant);
+	if (ent->db)
+		return ent->db;
+
+	ent->db = rnn_newdb();
+	rnn_parsefile(ent->db, (char *)file);
+	rnn_prepdb(ent->db);
+
+	if (!ent->db->estatus) {
+		ent->vc = rnndec_newcontext(ent->db);
+		rnndec_varadd(ent->vc, "chip", variant);
+		rnn_cache_save(ent->vc, file, variant);
+	}
+
+	return ent->db;
+}
+
 static void init(struct rnn *rnn, char *file, char *domain)
 {
-	/* prepare rnn stuff for lookup */
-	rnn_parsefile(rnn->db, file);
-	rnn_prepdb(rnn->db);
+	/* an rnn is only loaded once, the decode contexts hold the "chip"
+	 * variant:
+	 */
+	assert(!rnn->db);
+
+	rnn->db = getdb(file, domain);
+
+	rnn->vc_nocolor = rnndec_newcontext(rnn->db);
+	rnn->vc_nocolor->colors = &envy_null_colors;
+	if (rnn->nocolor) {
+		rnn->vc = rnn->vc_nocolor;
+	} else {
+		rnn->vc = rnndec_newcontext(rnn->db);
+		rnn->vc->colors = &envy_def_colors;
+	}
+
 	rnn->dom[0] = rnn_finddomain(rnn->db, domain);
 	if ((strcmp(domain, "A2XX") == 0) || (strcmp(domain, "A3XX") == 0)) {
 		rnn->dom[1] = rnn_finddomain(rnn->db, "AXXX");
@@ -102,9 +169,23 @@ void rnn_load(struct rnn *rnn, const char *gpuname)
 	}
 }
 
+void rnn_preload(void)
+{
+	rnn_init();
+	getdb("adreno/a2xx.xml", "A2XX");
+	getdb("adreno/a3xx.xml", "A3XX");
+	getdb("adreno/a4xx.xml", "A4XX");
+	getdb("adreno/a5xx.xml", "A5XX");
+}
+
 uint32_t rnn_regbase(struct rnn *rnn, const char *name)
 {
-	uint32_t regbase = rnndec_decodereg(rnn->vc_nocolor, rnn->dom[0], name);
+	uint32_t regbase;
+
+	if (!rnn->db)
+		return 0;
+
+	regbase = rnndec_decodereg(rnn->vc_nocolor, rnn->dom[0], name);
 	if (!regbase)
 		regbase = rnndec_decodereg(rnn->vc_nocolor, rnn->dom[1], name);
 	return regbase;
@@ -112,59 +193,322 @@ uint32_t rnn_regbase(struct rnn *rnn, const char *name)
 
 const char *rnn_regname(struct rnn *rnn, uint32_t regbase, int color)
 {
-	static char buf[128];
+	const struct rnnreg *reg = rnn_lookupreg(rnn, regbase);
+	return color ? reg->name : reg->name_nocolor;
+}
+
+struct rnndecaddrinfo *rnn_reginfo(struct rnn *rnn, uint32_t regbase)
+{
+	if (!rnn->db)
+		return NULL;
+	return rnndec_decodeaddr(rnn->vc, finddom(rnn, regbase), regbase, 0);
+}
+
+static void decodereg(struct rnn *rnn, struct rnnreg *reg, uint32_t regbase)
+{
 	struct rnndecaddrinfo *info;
+	struct rnndomain *dom;
+
+	if (reg->flags & RNN_REG_DECODED)
+		return;
+
+	/* nothing is known before rnn_load(): */
+	if (!rnn->db) {
+		reg->flags |= RNN_REG_DECODED;
+		return;
+	}
 
-	info = rnndec_decodeaddr(color ? rnn->vc : rnn->vc_nocolor,
-			finddom(rnn, regbase), regbase, 0);
+	dom = finddom(rnn, regbase);
+	info = rnndec_decodeaddr(rnn->vc, dom, regbase, 0);
 	if (info) {
-		strcpy(buf, info->name);
-		free(info->name);
+		reg->name = info->name;
+		reg->typeinfo = info->typeinfo;
+		reg->width = info->width;
 		free(info);
-		return buf;
+
+		if (rnn->vc == rnn->vc_nocolor) {
+			reg->name_nocolor = reg->name;
+		} else {
+			info = rnndec_decodeaddr(rnn->vc_nocolor, dom, regbase, 0);
+			reg->name_nocolor = info->name;
+			free(info);
+		}
 	}
-	return NULL;
+
+	reg->flags |= RNN_REG_DECODED;
 }
 
-struct rnndecaddrinfo *rnn_reginfo(struct rnn *rnn, uint32_t regbase)
+static int endswith(const char *name, const char *suffix)
 {
-	return rnndec_decodeaddr(rnn->vc, finddom(rnn, regbase), regbase, 0);
+	const char *s;
+	if (!name)
+		return 0;
+	s = strstr(name, suffix);
+	if (!s)
+		return 0;
+	return (s - strlen(name) + strlen(suffix)) == name;
+}
+
+const struct rnnreg *rnn_lookupreg(struct rnn *rnn, uint32_t regbase)
+{
+	struct rnnreg *reg;
+
+	if (regbase >= RNN_MAXREGS) {
+		/* not cached, just decode into scratch entry: */
+		freereg(rnn, &rnn->scratch);
+		decodereg(rnn, &rnn->scratch, regbase);
+		return &rnn->scratch;
+	}
+
+	reg = &rnn->regs[regbase];
+	if (reg->flags & RNN_REG_DONE)
+		return reg;
+
+	decodereg(rnn, reg, regbase);
+
+	/* Try and figure out if this is half of a 64b gpuaddr, based on
+	 * the _LO/_HI naming convention.  Maybe a better approach would
+	 * be some special annotation in the xml..
+	 */
+	if (endswith(reg->name_nocolor, "_HI") && (regbase > 0)) {
+		struct rnnreg *lo = &rnn->regs[regbase - 1];
+		decodereg(rnn, lo, regbase - 1);
+		if (endswith(lo->name_nocolor, "_LO"))
+			reg->flags |= RNN_REG_ADDR_HI;
+	} else if (endswith(reg->name_nocolor, "_LO") && (regbase + 1 < RNN_MAXREGS)) {
+		struct rnnreg *hi = &rnn->regs[regbase + 1];
+		decodereg(rnn, hi, regbase + 1);
+		if (endswith(hi->name_nocolor, "_HI"))
+			reg->flags |= RNN_REG_ADDR_LO;
+	}
+
+	reg->flags |= RNN_REG_DONE;
+
+	return reg;
+}
+
+static int enumval_matches(struct rnn *rnn, struct rnnvalue *val)
+{
+	const char *variant = val->varinfo.variantsstr;
+	if (!val->valvalid)
+		return 0;
+	if (variant && !strstr(variant, rnn->variant))
+		return 0;
+	return 1;
 }
 
 const char *rnn_enumname(struct rnn *rnn, const char *name, uint32_t val)
 {
-	struct rnndeccontext *ctx = rnn->vc;
-	struct rnnenum *en = rnn_findenum(ctx->db, name);
+	struct rnnenum *en = rnn->db ? rnn_findenum(rnn->db, name) : NULL;
 	if (en) {
 		int i;
 		for (i = 0; i < en->valsnum; i++)
-			if (en->vals[i]->valvalid && en->vals[i]->value == val) {
-				const char *variant = en->vals[i]->varinfo.variantsstr;
-				if (variant && !strstr(variant, rnn->variant))
-					continue;
+			if (enumval_matches(rnn, en->vals[i]) && en->vals[i]->value == val)
 				return en->vals[i]->name;
-			}
 	}
 	return NULL;
 }
 
-static struct rnndelem *regelem(struct rnndomain *domain, const char *name)
+struct rnnenumtab *rnn_enumtab(struct rnn *rnn, const char *name)
 {
+	struct rnnenum *en = rnn->db ? rnn_findenum(rnn->db, name) : NULL;
+	struct rnnenumtab *tab = calloc(1, sizeof(*tab));
 	int i;
-	for (i = 0; i < domain->subelemsnum; i++) {
-		struct rnndelem *elem = domain->subelems[i];
-		if (!strcmp(elem->name, name))
-			return elem;
+
+	tab->rnn = rnn;
+	tab->name = name;
+
+	if (!en)
+		return tab;
+
+	for (i = 0; i < en->valsnum; i++) {
+		struct rnnvalue *val = en->vals[i];
+		if (!enumval_matches(rnn, val))
+			continue;
+		if (val->value >= RNN_MAXENUMVALS)
+			tab->nvals = RNN_MAXENUMVALS;
+		else if (val->value >= tab->nvals)
+			tab->nvals = val->value + 1;
 	}
-	return NULL;
+
+	tab->vals = calloc(tab->nvals, sizeof(tab->vals[0]));
+
+	/* first match wins, same as rnn_enumname(): */
+	for (i = 0; i < en->valsnum; i++) {
+		struct rnnvalue *val = en->vals[i];
+		if (enumval_matches(rnn, val) && (val->value < tab->nvals) &&
+				!tab->vals[val->value])
+			tab->vals[val->value] = val->name;
+	}
+
+	return tab;
+}
+
+void rnn_enumtab_free(struct rnnenumtab *tab)
+{
+	if (!tab)
+		return;
+	free(tab->vals);
+	free(tab);
+}
+
+/*
+ * Name lookups:
+ *
+ * Scripts look up registers and bitfields by name at every draw, so
+ * rather than a strcmp() over every element of the domain, the names
+ * are hashed.  Entries are keyed by the scope (the array of elements
+ * or bitfields that is searched) and name.  The first time a scope is
+ * searched all of its names are added, along with an entry with NULL
+ * name to mark the scope as done.
+ */
+
+struct rnnname {
+	const void *scope;
+	const char *name;
+	void *ptr;
+};
+
+struct rnnnametab {
+	struct rnnname *names;
+	uint32_t size, count;
+};
+
+static uint32_t hashname(const void *scope, const char *name)
+{
+	uint32_t hash = 2166136261u ^ (uint32_t)((uintptr_t)scope >> 3);
+
+	/* FNV-1a: */
+	if (name)
+		while (*name)
+			hash = (hash ^ (uint8_t)*name++) * 16777619u;
+
+	return hash;
+}
+
+static struct rnnname *findname(struct rnnnametab *tab,
+		const void *scope, const char *name)
+{
+	uint32_t i, mask = tab->size - 1;
+
+	for (i = hashname(scope, name) & mask; ; i = (i + 1) & mask) {
+		struct rnnname *n = &tab->names[i];
+		if (!n->scope)
+			return n;
+		if ((n->scope == scope) && ((n->name == name) ||
+				(n->name && name && !strcmp(n->name, name))))
+			return n;
+	}
+}
+
+static void addname(struct rnnnametab *tab,
+		const void *scope, const char *name, void *ptr)
+{
+	struct rnnname *n;
+
+	if (2 * (tab->count + 1) > tab->size) {
+		struct rnnnametab old = *tab;
+		uint32_t i;
+
+		tab->size = tab->size ? 2 * tab->size : 256;
+		tab->names = calloc(tab->size, sizeof(tab->names[0]));
+		assert(tab->names);
+
+		for (i = 0; i < old.size; i++)
+			if (old.names[i].scope)
+				*findname(tab, old.names[i].scope, old.names[i].name) =
+						old.names[i];
+
+		free(old.names);
+	}
+
+	/* first match wins, same as a linear search: */
+	n = findname(tab, scope, name);
+	if (n->scope)
+		return;
+
+	n->scope = scope;
+	n->name = name;
+	n->ptr = ptr;
+	tab->count++;
+}
+
+static struct rnndelem *lookupelem(struct rnn *rnn,
+		struct rnndelem **elems, int elemsnum, const char *name)
+{
+	struct rnnnametab *tab;
+	int i;
+
+	if (!elems || !name)
+		return NULL;
+
+	if (!rnn->names)
+		rnn->names = calloc(1, sizeof(*rnn->names));
+	tab = rnn->names;
+
+	if (!tab->size || !findname(tab, elems, NULL)->scope) {
+		for (i = 0; i < elemsnum; i++)
+			if (elems[i]->name)
+				addname(tab, elems, elems[i]->name, elems[i]);
+		addname(tab, elems, NULL, NULL);
+	}
+
+	return findname(tab, elems, name)->ptr;
 }
 
 struct rnndelem *rnn_regelem(struct rnn *rnn, const char *name)
 {
-	struct rnndelem *elem = regelem(rnn->dom[0], name);
-	if (elem)
-		return elem;
-	return regelem(rnn->dom[1], name);
+	struct rnndelem *elem = NULL;
+	if (rnn->dom[0])
+		elem = lookupelem(rnn, rnn->dom[0]->subelems,
+				rnn->dom[0]->subelemsnum, name);
+	if (!elem && rnn->dom[1])
+		elem = lookupelem(rnn, rnn->dom[1]->subelems,
+				rnn->dom[1]->subelemsnum, name);
+	return elem;
+}
+
+struct rnndelem *rnn_subelem(struct rnn *rnn, struct rnndelem *elem,
+		const char *name)
+{
+	return lookupelem(rnn, elem->subelems, elem->subelemsnum, name);
+}
+
+struct rnnbitfield *rnn_bitfield(struct rnn *rnn, struct rnntypeinfo *info,
+		const char *name)
+{
+	struct rnnbitfield **bitfields;
+	struct rnnnametab *tab;
+	int i, bitfieldsnum;
+
+	switch (info->type) {
+	case RNN_TTYPE_BITSET:
+		bitfields = info->ebitset->bitfields;
+		bitfieldsnum = info->ebitset->bitfieldsnum;
+		break;
+	case RNN_TTYPE_INLINE_BITSET:
+		bitfields = info->bitfields;
+		bitfieldsnum = info->bitfieldsnum;
+		break;
+	default:
+		return NULL;
+	}
+
+	if (!bitfields || !name)
+		return NULL;
+
+	if (!rnn->names)
+		rnn->names = calloc(1, sizeof(*rnn->names));
+	tab = rnn->names;
+
+	if (!tab->size || !findname(tab, bitfields, NULL)->scope) {
+		for (i = 0; i < bitfieldsnum; i++)
+			if (bitfields[i]->name)
+				addname(tab, bitfields, bitfields[i]->name, bitfields[i]);
+		addname(tab, bitfields, NULL, NULL);
+	}
+
+	return findname(tab, bitfields, name)->ptr;
 }
 
 enum rnnttype rnn_decodelem(struct rnn *rnn, struct rnntypeinfo *info,
@@ -36,11 +36,45 @@
 #include "rnn.h"
 #include "rnndec.h"
 
+/* Decoded register address, cached per regbase so that decoding a
+ * register write doesn't need to search the db or allocate anything.
+ * Name is NULL if the register is unknown.
+ */
+struct rnnreg {
+	char *name;               /* with colors, unless nocolor */
+	char *name_nocolor;
+	struct rnntypeinfo *typeinfo;
+	int width;
+	uint32_t flags;
+#define RNN_REG_ADDR_LO   0x1   /* FOO_LO, followed by FOO_HI */
+#define RNN_REG_ADDR_HI   0x2   /* FOO_HI, preceded by FOO_LO */
+#define RNN_REG_DECODED   0x4   /* private */
+#define RNN_REG_DONE      0x8   /* private */
+};
+
+#define RNN_MAXREGS 0x10000
+
+/* Enum flattened into an array indexed by value (for the current
+ * variant), for enums that are looked up often, see rnn_enumtab().
+ */
+struct rnnenumtab {
+	struct rnn *rnn;
+	const char *name;
+	const char **vals;
+	uint32_t nvals;
+};
+
+#define RNN_MAXENUMVALS 0x10000
+
 struct rnn {
 	struct rnndb *db;
 	struct rnndeccontext *vc, *vc_nocolor;
 	struct rnndomain *dom[2];
 	const char *variant;
+	struct rnnreg *regs;      /* RNN_MAXREGS entries, filled on demand */
+	struct rnnreg scratch;    /* for regbase >= RNN_MAXREGS */
+	struct rnnnametab *names; /* hashed element/bitfield names */
+	int nocolor;
 };
 
 union rnndecval {
@@ -51,13 +85,42 @@ union rnndecval {
 
 void _rnn_init(struct rnn *rnn, int nocolor);
 struct rnn *rnn_new(int nocolor);
+/* load the database for the gpu, once per rnn: */
 void rnn_load(struct rnn *rnn, const char *gpuname);
+/* parse the databases for every generation up front, ie. before forking
+ * workers which would otherwise each parse them:
+ */
+void rnn_preload(void);
 uint32_t rnn_regbase(struct rnn *rnn, const char *name);
 const char *rnn_regname(struct rnn *rnn, uint32_t regbase, int color);
 struct rnndecaddrinfo *rnn_reginfo(struct rnn *rnn, uint32_t regbase);
+const struct rnnreg *rnn_lookupreg(struct rnn *rnn, uint32_t regbase);
 const char *rnn_enumname(struct rnn *rnn, const char *name, uint32_t val);
+struct rnnenumtab *rnn_enumtab(struct rnn *rnn, const char *name);
+void rnn_enumtab_free(struct rnnenumtab *tab);
 
+static inline const char *
+rnn_enumtab_name(struct rnnenumtab *tab, uint32_t val)
+{
+	if (!tab)
+		return NULL;
+	if (val < tab->nvals)
+		return tab->vals[val];
+	if (tab->nvals < RNN_MAXENUMVALS)
+		return NULL;
+	/* values too big to fit in the table: */
+	return rnn_enumname(tab->rnn, tab->name, val);
+}
+
+/* Lookups of elements and bitfields by name, which hash the names
+ * of a domain/array/bitset the first time it is searched:
+ */
 struct rnndelem *rnn_regelem(struct rnn *rnn, const char *name);
+struct rnndelem *rnn_subelem(struct rnn *rnn, struct rnndelem *elem,
+		const char *name);
+struct rnnbitfield *rnn_bitfield(struct rnn *rnn, struct rnntypeinfo *info,
+		const char *name);
+
 enum rnnttype rnn_decodelem(struct rnn *rnn, struct rnntypeinfo *info,
 		uint32_t regval, union rnndecval *val);
 
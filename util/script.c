@@ -38,9 +38,19 @@
 
 #include "script.h"
 #include "rnnutil.h"
+#include "colfile.h"
+#include "profile.h"
 
 static lua_State *L;
 
+/* script defines a reduce() hook: */
+static int has_reduce;
+
+/* which of the finer grained hooks the script defines: */
+static struct {
+	int packet, reg_write, ib_enter, ib_exit, event, state_load;
+} hooks;
+
 #if 0
 #define DBG(fmt, ...) \
 		do { printf(" ** %s:%d ** "fmt "\n", \
@@ -52,6 +62,9 @@ static lua_State *L;
 uint32_t reg_written(uint32_t regbase);
 uint32_t reg_lastval(uint32_t regbase);
 uint32_t reg_val(uint32_t regbase);
+uint32_t reg_written_list(const uint32_t **regs);
+uint32_t reg_rewritten_list(const uint32_t **regs);
+uint32_t reg_vals(const uint32_t **vals);
 
 
 /* does not return */
@@ -61,6 +74,19 @@ static void error(const char *fmt)
 	exit(1);
 }
 
+/* call one of the script's functions, which is already on the stack
+ * along with its arguments:
+ */
+static void call(lua_State *L, int nargs, int nresults)
+{
+	struct profile_timer t;
+
+	profile_start(&t);
+	if (lua_pcall(L, nargs, nresults, 0) != 0)
+		error("error running function `f': %s\n");
+	profile_stop(&t, PROFILE_SCRIPT);
+}
+
 /* Expose rnn decode to script environment as "rnn" library:
  */
 
@@ -144,18 +170,14 @@ static int l_rnn_struct_meta_index(lua_State *L)
 {
 	struct rnndoff *rnndoff = lua_touserdata(L, 1);
 	const char *name = lua_tostring(L, 2);
-	struct rnndelem *elem = rnndoff->elem;
-	int i;
+	struct rnndelem *subelem;
 
-	for (i = 0; i < elem->subelemsnum; i++) {
-		struct rnndelem *subelem = elem->subelems[i];
-		if (!strcmp(name, subelem->name)) {
-			return l_rnn_etype(L, rnndoff->rnn, subelem,
-					rnndoff->offset + subelem->offset);
-		}
-	}
+	subelem = rnn_subelem(rnndoff->rnn, rnndoff->elem, name);
+	if (!subelem)
+		return 0;
 
-	return 0;
+	return l_rnn_etype(L, rnndoff->rnn, subelem,
+			rnndoff->offset + subelem->offset);
 }
 
 static const struct luaL_Reg l_meta_rnn_struct[] = {
@@ -233,39 +255,31 @@ static int l_rnn_reg_meta_index(lua_State *L)
 	const char *name = lua_tostring(L, 2);
 	struct rnndelem *elem = rnndoff->elem;
 	struct rnntypeinfo *info = &elem->typeinfo;
-	struct rnnbitfield **bitfields;
-	int bitfieldsnum;
-	int i;
+	struct rnnbitfield *bf;
+	uint32_t regval;
 
 	switch (info->type) {
 	case RNN_TTYPE_BITSET:
-		bitfields = info->ebitset->bitfields;
-		bitfieldsnum = info->ebitset->bitfieldsnum;
-		break;
 	case RNN_TTYPE_INLINE_BITSET:
-		bitfields = info->bitfields;
-		bitfieldsnum = info->bitfieldsnum;
 		break;
 	default:
 		printf("invalid register type: %d\n", info->type);
 		return 0;
 	}
 
-	for (i = 0; i < bitfieldsnum; i++) {
-		struct rnnbitfield *bf = bitfields[i];
-		if (!strcmp(name, bf->name)) {
-			uint32_t regval = (reg_val(rnndoff->offset) & bf->mask) >> bf->low;
+	bf = rnn_bitfield(rnndoff->rnn, info, name);
+	if (!bf) {
+		printf("invalid member: %s\n", name);
+		return 0;
+	}
 
-			DBG("name=%s, info=%p, subelemsnum=%d, type=%d, regval=%x",
-					name, info, rnndoff->elem->subelemsnum,
-					bf->typeinfo.type, regval);
+	regval = (reg_val(rnndoff->offset) & bf->mask) >> bf->low;
 
-			return pushdecval(L, rnndoff->rnn, regval, &bf->typeinfo);
-		}
-	}
+	DBG("name=%s, info=%p, subelemsnum=%d, type=%d, regval=%x",
+			name, info, rnndoff->elem->subelemsnum,
+			bf->typeinfo.type, regval);
 
-	printf("invalid member: %s\n", name);
-	return 0;
+	return pushdecval(L, rnndoff->rnn, regval, &bf->typeinfo);
 }
 
 static const struct luaL_Reg l_meta_rnn_reg[] = {
@@ -304,6 +318,155 @@ static int l_rnn_meta_index(lua_State *L)
 	return l_rnn_etype(L, rnn, elem, elem->offset);
 }
 
+/*
+ * Handles:
+ *
+ * A register (or bitfield of a register) resolved once by name, with
+ * rnn.handle(r, "RB_MRT[1].CONTROL.BLEND"), so that a script can look
+ * up the names outside of the draw callback and then just call the
+ * handle for the current value, ie:
+ *
+ *    local blend = rnn.handle(r, "RB_MRT[1].CONTROL.BLEND")
+ *    function draw(primtype, nindx)
+ *      if blend() then ... end
+ *    end
+ *
+ * Registers without a type (ie. bitsets) return the raw value.
+ */
+
+struct rnnhandle {
+	struct rnn *rnn;
+	struct rnndelem *elem;
+	struct rnnbitfield *bf;   /* NULL for the whole register */
+	uint64_t offset;
+};
+
+static int resolve_handle(struct rnn *rnn, char *path, struct rnnhandle *h)
+{
+	struct rnndelem *elem = NULL;
+	uint64_t offset = 0;
+	char *tok, *save;
+
+	for (tok = strtok_r(path, ".", &save); tok;
+			tok = strtok_r(NULL, ".", &save)) {
+		char *idx = strchr(tok, '[');
+
+		if (idx)
+			*idx++ = '\0';
+
+		/* nothing can follow a bitfield: */
+		if (h->bf)
+			return -1;
+
+		if (!elem) {
+			elem = rnn_regelem(rnn, tok);
+			if (elem)
+				offset = elem->offset;
+		} else if (elem->type == RNN_ETYPE_ARRAY) {
+			/* a struct within an array, after the index: */
+			elem = rnn_subelem(rnn, elem, tok);
+			if (elem)
+				offset += elem->offset;
+		} else if (!idx) {
+			h->bf = rnn_bitfield(rnn, &elem->typeinfo, tok);
+			if (!h->bf)
+				return -1;
+			continue;
+		} else {
+			return -1;
+		}
+
+		if (!elem)
+			return -1;
+
+		if (elem->type != RNN_ETYPE_ARRAY) {
+			if (idx)
+				return -1;
+			continue;
+		}
+
+		/* arrays need an index, same as for r.RB_MRT[n].CONTROL: */
+		if (idx) {
+			char *end;
+			unsigned long n = strtoul(idx, &end, 0);
+			if ((end == idx) || strcmp(end, "]"))
+				return -1;
+			offset += elem->stride * n;
+			if (elem->subelemsnum == 1)
+				elem = elem->subelems[0];
+		} else {
+			return -1;
+		}
+	}
+
+	if (!elem || (elem->type != RNN_ETYPE_REG))
+		return -1;
+
+	h->rnn = rnn;
+	h->elem = elem;
+	h->offset = offset;
+
+	return 0;
+}
+
+static int l_rnn_handle_meta_call(lua_State *L)
+{
+	struct rnnhandle *h = luaL_checkudata(L, 1, "rnnmetahandle");
+	uint32_t regval = reg_val(h->offset);
+	struct rnntypeinfo *info = &h->elem->typeinfo;
+
+	if (h->bf) {
+		regval = (regval & h->bf->mask) >> h->bf->low;
+		info = &h->bf->typeinfo;
+	}
+
+	if (pushdecval(L, h->rnn, regval, info))
+		return 1;
+
+	lua_pushunsigned(L, regval);
+	return 1;
+}
+
+static const struct luaL_Reg l_meta_rnn_handle[] = {
+	{"__call", l_rnn_handle_meta_call},
+	{NULL, NULL}  /* sentinel */
+};
+
+/* returns nil if the name does not resolve to a register or bitfield: */
+static int l_rnn_handle(lua_State *L)
+{
+	struct rnn *rnn = luaL_checkudata(L, 1, "rnnmeta");
+	char *path = strdup(luaL_checkstring(L, 2));
+	struct rnnhandle h = {0}, *ret;
+	int err;
+
+	err = resolve_handle(rnn, path, &h);
+	free(path);
+
+	if (err)
+		return 0;
+
+	ret = lua_newuserdata(L, sizeof(*ret));
+	*ret = h;
+
+	/* keep the rnn object (which h->rnn points into) alive as long as
+	 * the handle.  In lua 5.2 a userdata's uservalue has to be a table
+	 * (or nil), so it goes in one:
+	 */
+	lua_createtable(L, 1, 0);
+	lua_pushvalue(L, 1);
+	lua_rawseti(L, -2, 1);
+	lua_setuservalue(L, -2);
+
+	luaL_newmetatable(L, "rnnmetahandle");
+	luaL_setfuncs(L, l_meta_rnn_handle, 0);
+	lua_pop(L, 1);
+
+	luaL_setmetatable(L, "rnnmetahandle");
+
+	return 1;
+}
+
 static int l_rnn_meta_gc(lua_State *L)
 {
 	// TODO
@@ -356,19 +519,15 @@ static int l_rnn_regval(lua_State *L)
 	struct rnn *rnn = lua_touserdata(L, 1);
 	uint32_t regbase = (uint32_t)lua_tonumber(L, 2);
 	uint32_t regval = (uint32_t)lua_tonumber(L, 3);
-	struct rnndecaddrinfo *info = rnn_reginfo(rnn, regbase);
+	const struct rnnreg *info = rnn_lookupreg(rnn, regbase);
 	char *decoded;
-	if (info && info->typeinfo) {
+	if (info->name && info->typeinfo) {
 		decoded = rnndec_decodeval(rnn->vc, info->typeinfo, regval, info->width);
 	} else {
 		asprintf(&decoded, "%08x", regval);
 	}
 	lua_pushstring(L, decoded);
 	free(decoded);
-	if (info) {
-		free(info->name);
-		free(info);
-	}
 	return 1;
 }
 
@@ -377,6 +536,7 @@ static const struct luaL_Reg l_rnn[] = {
 	{"enumname", l_rnn_enumname},
 	{"regname", l_rnn_regname},
 	{"regval", l_rnn_regval},
+	{"handle", l_rnn_handle},
 	{NULL, NULL}  /* sentinel */
 };
 
@@ -399,6 +559,35 @@ static int l_reg_lastval(lua_State *L)
 	return 1;
 }
 
+static int push_reglist(lua_State *L, const uint32_t *regs, uint32_t n)
+{
+	uint32_t i;
+
+	lua_createtable(L, n, 0);
+	for (i = 0; i < n; i++) {
+		lua_pushnumber(L, regs[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	return 1;
+}
+
+/* returns array of registers that have been written: */
+static int l_reg_written_list(lua_State *L)
+{
+	const uint32_t *regs;
+	uint32_t n = reg_written_list(&regs);
+	return push_reglist(L, regs, n);
+}
+
+/* returns array of registers written since last draw: */
+static int l_reg_rewritten_list(lua_State *L)
+{
+	const uint32_t *regs;
+	uint32_t n = reg_rewritten_list(&regs);
+	return push_reglist(L, regs, n);
+}
+
 static int l_reg_val(lua_State *L)
 {
 	uint32_t regbase = (uint32_t)lua_tonumber(L, 1);
@@ -406,13 +595,372 @@ static int l_reg_val(lua_State *L)
 	return 1;
 }
 
+/* Views of the register state, which can be indexed like arrays
+ * without building a table per draw:
+ *
+ *   regs.state[regbase] - current value of each register
+ *   regs.dirty[1..#regs.dirty] - registers written since the last
+ *                                draw, sorted, valid in draw()
+ */
+
+static const uint32_t *dirty_regs;
+static uint32_t dirty_n;
+
+static int l_regs_state_meta_index(lua_State *L)
+{
+	const uint32_t *vals;
+	uint32_t n = reg_vals(&vals);
+	lua_Number regbase = lua_tonumber(L, 2);
+
+	if ((regbase < 0) || (regbase >= n))
+		return 0;
+
+	lua_pushunsigned(L, vals[(uint32_t)regbase]);
+	return 1;
+}
+
+static int l_regs_state_meta_len(lua_State *L)
+{
+	const uint32_t *vals;
+	lua_pushnumber(L, reg_vals(&vals));
+	return 1;
+}
+
+static const struct luaL_Reg l_meta_regs_state[] = {
+	{"__index", l_regs_state_meta_index},
+	{"__len",   l_regs_state_meta_len},
+	{NULL, NULL}  /* sentinel */
+};
+
+static int l_regs_dirty_meta_index(lua_State *L)
+{
+	lua_Number i = lua_tonumber(L, 2);
+
+	if ((i < 1) || (i > dirty_n))
+		return 0;
+
+	lua_pushnumber(L, dirty_regs[(uint32_t)i - 1]);
+	return 1;
+}
+
+static int l_regs_dirty_meta_len(lua_State *L)
+{
+	lua_pushnumber(L, dirty_n);
+	return 1;
+}
+
+static const struct luaL_Reg l_meta_regs_dirty[] = {
+	{"__index", l_regs_dirty_meta_index},
+	{"__len",   l_regs_dirty_meta_len},
+	{NULL, NULL}  /* sentinel */
+};
+
+static void push_regs_view(lua_State *L, const char *name,
+		const struct luaL_Reg *meta)
+{
+	lua_newuserdata(L, 1);
+
+	luaL_newmetatable(L, name);
+	luaL_setfuncs(L, meta, 0);
+	lua_pop(L, 1);
+
+	luaL_setmetatable(L, name);
+}
+
 static const struct luaL_Reg l_regs[] = {
 	{"written", l_reg_written},
 	{"lastval", l_reg_lastval},
 	{"val",     l_reg_val},
+	{"written_list",   l_reg_written_list},
+	{"rewritten_list", l_reg_rewritten_list},
+	{NULL, NULL}  /* sentinel */
+};
+
+/* Expose the per-draw state files written by cffdump --export to the
+ * script environment as a "cols" library, so a script can look at
+ * previously exported traces without decoding them again.  Rows are
+ * numbered from zero, same as draw[N]:
+ */
+
+static struct colfile * l_tocols(lua_State *L)
+{
+	struct colfile **pf = luaL_checkudata(L, 1, "colsmeta");
+	if (!*pf)
+		luaL_error(L, "cols file is closed");
+	return *pf;
+}
+
+static int l_cols_meta_gc(lua_State *L)
+{
+	struct colfile **pf = luaL_checkudata(L, 1, "colsmeta");
+	colfile_close(*pf);
+	*pf = NULL;
+	return 0;
+}
+
+static const struct luaL_Reg l_meta_cols[] = {
+	{"__gc", l_cols_meta_gc},
+	{NULL, NULL}  /* sentinel */
+};
+
+/* returns nil if the file could not be opened: */
+static int l_cols_open(lua_State *L)
+{
+	struct colfile *f = colfile_open(luaL_checkstring(L, 1));
+	struct colfile **pf;
+
+	if (!f)
+		return 0;
+
+	pf = lua_newuserdata(L, sizeof(*pf));
+	*pf = f;
+
+	luaL_newmetatable(L, "colsmeta");
+	luaL_setfuncs(L, l_meta_cols, 0);
+	lua_pop(L, 1);
+
+	luaL_setmetatable(L, "colsmeta");
+
+	return 1;
+}
+
+static int l_cols_close(lua_State *L)
+{
+	return l_cols_meta_gc(L);
+}
+
+static int l_cols_nrows(lua_State *L)
+{
+	lua_pushnumber(L, colfile_nrows(l_tocols(L)));
+	return 1;
+}
+
+static int l_cols_ncols(lua_State *L)
+{
+	lua_pushnumber(L, colfile_ncols(l_tocols(L)));
+	return 1;
+}
+
+/* returns the column index for a column name or register offset, or
+ * nil if there is no such column:
+ */
+static int l_cols_column(lua_State *L)
+{
+	struct colfile *f = l_tocols(L);
+	int col;
+
+	if (lua_type(L, 2) == LUA_TNUMBER)
+		col = colfile_find_reg(f, (uint32_t)lua_tonumber(L, 2));
+	else
+		col = colfile_find(f, luaL_checkstring(L, 2));
+
+	if (col < 0)
+		return 0;
+
+	lua_pushnumber(L, col);
+	return 1;
+}
+
+static int l_cols_name(lua_State *L)
+{
+	struct colfile *f = l_tocols(L);
+	int col = luaL_checkint(L, 2);
+
+	if ((col < 0) || (col >= colfile_ncols(f)))
+		return 0;
+
+	lua_pushstring(L, colfile_name(f, col));
+	return 1;
+}
+
+/* returns the value of a column at a row, or nil if it has no value: */
+static int l_cols_val(lua_State *L)
+{
+	struct colfile *f = l_tocols(L);
+	int col = luaL_checkint(L, 2);
+	uint32_t row = (uint32_t)luaL_checkinteger(L, 3);
+
+	if ((col < 0) || (col >= colfile_ncols(f)) ||
+			!colfile_has_val(f, col, row))
+		return 0;
+
+	if (colfile_is_string(f, col))
+		lua_pushstring(L, colfile_string(f, col, row));
+	else
+		lua_pushnumber(L, colfile_val(f, col, row));
+
+	return 1;
+}
+
+static const struct luaL_Reg l_cols[] = {
+	{"open",   l_cols_open},
+	{"close",  l_cols_close},
+	{"nrows",  l_cols_nrows},
+	{"ncols",  l_cols_ncols},
+	{"column", l_cols_column},
+	{"name",   l_cols_name},
+	{"val",    l_cols_val},
 	{NULL, NULL}  /* sentinel */
 };
 
+/* Filters for the finer grained hooks, registered by the script with
+ * the "hooks" library, ie:
+ *
+ *   hooks.packets("CP_EVENT_WRITE", 0x30)  -- by name or opcode
+ *   hooks.regs(0x2100, 0x21ff)             -- a range of registers
+ *
+ * Multiple calls add to the set.  With no filter every packet/register
+ * write is passed to the hook.  Filtering is done before calling into
+ * the script, so a script that is only interested in a few things
+ * doesn't pay for a Lua call per packet or register write.
+ */
+
+#define MAX_OPCODES 0x100
+#define MAX_REGS    0x10000
+
+enum {
+	OPCODE_UNKNOWN,   /* name not yet compared to the filter */
+	OPCODE_PASS,
+	OPCODE_FAIL,
+};
+
+static struct {
+	int packets;                       /* any packet filter */
+	uint8_t opcodes[MAX_OPCODES];      /* opcodes given by number */
+	uint8_t cache[MAX_OPCODES];        /* OPCODE_x, per cmdstream */
+	char **names;                      /* opcodes given by name */
+	unsigned nnames;
+	uint8_t *regs;                     /* bitmap, NULL for no filter */
+} filter;
+
+static int l_hooks_packets(lua_State *L)
+{
+	int i, n = lua_gettop(L);
+
+	for (i = 1; i <= n; i++) {
+		if (lua_type(L, i) == LUA_TNUMBER) {
+			uint32_t opcode = (uint32_t)lua_tonumber(L, i);
+			if (opcode >= MAX_OPCODES)
+				return luaL_error(L, "invalid opcode: %u", opcode);
+			filter.opcodes[opcode] = 1;
+		} else {
+			const char *name = luaL_checkstring(L, i);
+			filter.names = realloc(filter.names,
+					(filter.nnames + 1) * sizeof(filter.names[0]));
+			filter.names[filter.nnames++] = strdup(name);
+		}
+	}
+
+	filter.packets = 1;
+	memset(filter.cache, OPCODE_UNKNOWN, sizeof(filter.cache));
+
+	return 0;
+}
+
+static int l_hooks_regs(lua_State *L)
+{
+	uint32_t first = (uint32_t)luaL_checkinteger(L, 1);
+	uint32_t last = first, i;
+
+	if (lua_gettop(L) >= 2)
+		last = (uint32_t)luaL_checkinteger(L, 2);
+
+	if ((first > last) || (last >= MAX_REGS))
+		return luaL_error(L, "invalid register range: %x-%x", first, last);
+
+	if (!filter.regs)
+		filter.regs = calloc(MAX_REGS / 8, 1);
+
+	for (i = first; i <= last; i++)
+		filter.regs[i / 8] |= 1 << (i % 8);
+
+	return 0;
+}
+
+static const struct luaL_Reg l_hooks[] = {
+	{"packets", l_hooks_packets},
+	{"regs",    l_hooks_regs},
+	{NULL, NULL}  /* sentinel */
+};
+
+static int packet_passes(uint32_t opcode, const char *name)
+{
+	unsigned i;
+
+	if (!filter.packets)
+		return 1;
+
+	if (opcode >= MAX_OPCODES)
+		return 0;
+
+	if (filter.opcodes[opcode])
+		return 1;
+
+	/* compare the name the first time an opcode is seen: */
+	if (filter.cache[opcode] == OPCODE_UNKNOWN) {
+		filter.cache[opcode] = OPCODE_FAIL;
+		for (i = 0; name && (i < filter.nnames); i++) {
+			if (!strcmp(name, filter.names[i])) {
+				filter.cache[opcode] = OPCODE_PASS;
+				break;
+			}
+		}
+	}
+
+	return filter.cache[opcode] == OPCODE_PASS;
+}
+
+static int reg_passes(uint32_t regbase)
+{
+	if (!filter.regs)
+		return 1;
+	if (regbase >= MAX_REGS)
+		return 0;
+	return filter.regs[regbase / 8] & (1 << (regbase % 8));
+}
+
+/* The payload of the packet passed to the packet() hook, which can be
+ * indexed like an array, pkt[1..#pkt], valid during the hook:
+ */
+
+static const uint32_t *pkt_dwords;
+static uint32_t pkt_n;
+static int pkt_ref = LUA_NOREF;
+
+static int l_pkt_meta_index(lua_State *L)
+{
+	lua_Number i = lua_tonumber(L, 2);
+
+	if ((i < 1) || (i > pkt_n))
+		return 0;
+
+	lua_pushunsigned(L, pkt_dwords[(uint32_t)i - 1]);
+	return 1;
+}
+
+static int l_pkt_meta_len(lua_State *L)
+{
+	lua_pushnumber(L, pkt_n);
+	return 1;
+}
+
+static const struct luaL_Reg l_meta_pkt[] = {
+	{"__index", l_pkt_meta_index},
+	{"__len",   l_pkt_meta_len},
+	{NULL, NULL}  /* sentinel */
+};
+
+static int has_hook(const char *name)
+{
+	int ret;
+
+	lua_getglobal(L, name);
+	ret = lua_isfunction(L, -1);
+	lua_pop(L, 1);
+
+	return ret;
+}
+
 /* called at start to load the script: */
 int script_load(const char *file)
 {
@@ -423,7 +971,18 @@ int script_load(const char *file)
 	L = luaL_newstate();
 	luaL_openlibs(L);
 	luaL_openlib(L, "regs", l_regs, 0);
+	lua_getglobal(L, "regs");
+	push_regs_view(L, "regsstatemeta", l_meta_regs_state);
+	lua_setfield(L, -2, "state");
+	push_regs_view(L, "regsdirtymeta", l_meta_regs_dirty);
+	lua_setfield(L, -2, "dirty");
+	lua_pop(L, 1);
 	luaL_openlib(L, "rnn", l_rnn, 0);
+	luaL_openlib(L, "cols", l_cols, 0);
+	luaL_openlib(L, "hooks", l_hooks, 0);
+
+	push_regs_view(L, "pktmeta", l_meta_pkt);
+	pkt_ref = luaL_ref(L, LUA_REGISTRYINDEX);
 
 	ret = luaL_loadfile(L, file);
 	if (ret)
@@ -433,9 +992,254 @@ int script_load(const char *file)
 	if (ret)
 		error("%s\n");
 
+	has_reduce = has_hook("reduce");
+
+	hooks.packet     = has_hook("packet");
+	hooks.reg_write  = has_hook("reg_write");
+	hooks.ib_enter   = has_hook("ib_enter");
+	hooks.ib_exit    = has_hook("ib_exit");
+	hooks.event      = has_hook("event");
+	hooks.state_load = has_hook("state_load");
+
 	return 0;
 }
 
+/*
+ * Map/reduce:
+ *
+ * If the script defines a reduce() hook, the value returned by
+ * end_cmdstream() is a result, and at the end of each cmdstream the
+ * list of results is passed to reduce(), in the main process.  Decoding
+ * serially that is a list of one.  With --jobs, each worker starts with
+ * a copy of the script state just after start_cmdstream(), calls draw()
+ * for its part of the cmdstream and then end_cmdstream(), and its
+ * result is serialized back to the main process, so reduce() gets the
+ * results in cmdstream order.
+ *
+ * Results can be (nested tables of) numbers, strings and booleans.
+ * A nil result is dropped.
+ */
+
+#define RESULT_MAXDEPTH 64
+
+enum {
+	RESULT_NIL    = 'z',
+	RESULT_BOOL   = 'b',
+	RESULT_NUMBER = 'n',
+	RESULT_STRING = 's',
+	RESULT_TABLE  = 't',
+	RESULT_END    = 'e',
+};
+
+/* list of results for the current cmdstream, in the registry: */
+static int results_ref = LUA_NOREF;
+static int nresults;
+
+/* serialize the value at the top of the stack: */
+static void write_result(lua_State *L, FILE *f, int depth)
+{
+	const char *str;
+	lua_Number num;
+	size_t len;
+
+	switch (lua_type(L, -1)) {
+	case LUA_TNIL:
+		fputc(RESULT_NIL, f);
+		break;
+	case LUA_TBOOLEAN:
+		fputc(RESULT_BOOL, f);
+		fputc(lua_toboolean(L, -1), f);
+		break;
+	case LUA_TNUMBER:
+		num = lua_tonumber(L, -1);
+		fputc(RESULT_NUMBER, f);
+		fwrite(&num, sizeof(num), 1, f);
+		break;
+	case LUA_TSTRING:
+		str = lua_tolstring(L, -1, &len);
+		fputc(RESULT_STRING, f);
+		fwrite(&len, sizeof(len), 1, f);
+		fwrite(str, 1, len, f);
+		break;
+	case LUA_TTABLE:
+		if (depth >= RESULT_MAXDEPTH)
+			luaL_error(L, "result nested too deeply");
+		luaL_checkstack(L, 3, "result nested too deeply");
+		fputc(RESULT_TABLE, f);
+		lua_pushnil(L);
+		while (lua_next(L, -2)) {
+			/* serialize a copy of the key, so lua_next() still
+			 * gets the original:
+			 */
+			lua_pushvalue(L, -2);
+			write_result(L, f, depth + 1);
+			lua_pop(L, 1);
+			write_result(L, f, depth + 1);
+			lua_pop(L, 1);
+		}
+		fputc(RESULT_END, f);
+		break;
+	default:
+		luaL_error(L, "cannot pass %s in result", luaL_typename(L, -1));
+	}
+}
+
+/* called in protected mode, with the file and result: */
+static int l_write_result(lua_State *L)
+{
+	FILE *f = lua_touserdata(L, 1);
+	lua_settop(L, 2);
+	write_result(L, f, 0);
+	return 0;
+}
+
+/* deserialize a value and push it, returns non-zero on error: */
+static int read_result(lua_State *L, FILE *f, int depth)
+{
+	lua_Number num;
+	size_t len;
+	char *str;
+	int c;
+
+	if (!lua_checkstack(L, 3))
+		return -1;
+
+	switch (fgetc(f)) {
+	case RESULT_NIL:
+		lua_pushnil(L);
+		return 0;
+	case RESULT_BOOL:
+		if ((c = fgetc(f)) == EOF)
+			return -1;
+		lua_pushboolean(L, c);
+		return 0;
+	case RESULT_NUMBER:
+		if (fread(&num, sizeof(num), 1, f) != 1)
+			return -1;
+		lua_pushnumber(L, num);
+		return 0;
+	case RESULT_STRING:
+		if (fread(&len, sizeof(len), 1, f) != 1)
+			return -1;
+		str = malloc(len + 1);
+		if (!str || (fread(str, 1, len, f) != len)) {
+			free(str);
+			return -1;
+		}
+		lua_pushlstring(L, str, len);
+		free(str);
+		return 0;
+	case RESULT_TABLE:
+		if (depth >= RESULT_MAXDEPTH)
+			return -1;
+		lua_newtable(L);
+		while ((c = fgetc(f)) != RESULT_END) {
+			if (c == EOF)
+				goto fail;
+			ungetc(c, f);
+			if (read_result(L, f, depth + 1))
+				goto fail;
+			if (read_result(L, f, depth + 1)) {
+				lua_pop(L, 1);
+				goto fail;
+			}
+			if (lua_isnil(L, -2)) {
+				lua_pop(L, 2);
+				goto fail;
+			}
+			lua_rawset(L, -3);
+		}
+		return 0;
+fail:
+		lua_pop(L, 1);
+		return -1;
+	default:
+		return -1;
+	}
+}
+
+/* append the value at the top of the stack to the results, and pop it: */
+static void add_result(lua_State *L)
+{
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		return;
+	}
+
+	if (results_ref == LUA_NOREF) {
+		lua_newtable(L);
+		results_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		nresults = 0;
+	}
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, results_ref);
+	lua_insert(L, -2);
+	lua_rawseti(L, -2, ++nresults);
+	lua_pop(L, 1);
+}
+
+int script_reduce_enabled(void)
+{
+	return L && has_reduce;
+}
+
+/* called in a worker at the end of its part of the cmdstream: */
+void script_end_worker(FILE *results)
+{
+	if (!L)
+		return;
+
+	lua_getglobal(L, "end_cmdstream");
+
+	/* do the call (0 arguments, 1 result) */
+	call(L, 0, 1);
+
+	lua_pushcfunction(L, l_write_result);
+	lua_pushlightuserdata(L, results);
+	lua_pushvalue(L, -3);
+	if (lua_pcall(L, 2, 0, 0) != 0)
+		error("error passing result: %s\n");
+	lua_pop(L, 1);
+
+	/* workers _exit(), so nothing else will flush it: */
+	fflush(results);
+}
+
+/* called in the main process for each worker's results, in order: */
+void script_collect(FILE *results)
+{
+	if (!L)
+		return;
+
+	rewind(results);
+	if (read_result(L, results, 0)) {
+		fprintf(stderr, "could not read script result\n");
+		return;
+	}
+
+	add_result(L);
+}
+
+/* called in the main process at the end of each cmdstream: */
+void script_reduce(void)
+{
+	if (!script_reduce_enabled())
+		return;
+
+	lua_getglobal(L, "reduce");
+	if (results_ref != LUA_NOREF) {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, results_ref);
+		luaL_unref(L, LUA_REGISTRYINDEX, results_ref);
+		results_ref = LUA_NOREF;
+	} else {
+		lua_newtable(L);
+	}
+	nresults = 0;
+
+	/* do the call (1 arguments, 0 result) */
+	call(L, 1, 0);
+}
+
 
 /* called at start of each cmdstream file: */
 void script_start_cmdstream(const char *name)
@@ -443,12 +1247,14 @@ void script_start_cmdstream(const char *name)
 	if (!L)
 		return;
 
+	/* opcode names could differ between generations: */
+	memset(filter.cache, OPCODE_UNKNOWN, sizeof(filter.cache));
+
 	lua_getglobal(L, "start_cmdstream");
 	lua_pushstring(L, name);
 
 	/* do the call (1 arguments, 0 result) */
-	if (lua_pcall(L, 1, 0, 0) != 0)
-		error("error running function `f': %s\n");
+	call(L, 1, 0);
 }
 
 /* called at each DRAW_INDX, calls script drawidx fxn to process
@@ -459,18 +1265,112 @@ void script_draw(const char *primtype, uint32_t nindx)
 	if (!L)
 		return;
 
+	dirty_n = reg_rewritten_list(&dirty_regs);
+
 	lua_getglobal(L, "draw");
 	lua_pushstring(L, primtype);
 	lua_pushnumber(L, nindx);
 
 	/* do the call (2 arguments, 0 result) */
-	if (lua_pcall(L, 2, 0, 0) != 0)
-		error("error running function `f': %s\n");
+	call(L, 2, 0);
+
+	dirty_n = 0;
 }
 
-/* maybe at some point it is interesting to add additional script
- * hooks for CP_EVENT_WRITE, etc?
- */
+/* called for each type3/type7 packet, before it is decoded: */
+void script_packet(uint32_t opcode, const char *name,
+		const uint32_t *dwords, uint32_t sizedwords, int level)
+{
+	if (!L || !hooks.packet || !packet_passes(opcode, name))
+		return;
+
+	pkt_dwords = dwords;
+	pkt_n = sizedwords;
+
+	lua_getglobal(L, "packet");
+	lua_pushstring(L, name);
+	lua_pushnumber(L, opcode);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, pkt_ref);
+	lua_pushnumber(L, level);
+
+	/* do the call (4 arguments, 0 result) */
+	call(L, 4, 0);
+
+	pkt_n = 0;
+}
+
+/* called for each register write: */
+void script_reg_write(uint32_t regbase, uint32_t val)
+{
+	if (!L || !hooks.reg_write || !reg_passes(regbase))
+		return;
+
+	lua_getglobal(L, "reg_write");
+	lua_pushnumber(L, regbase);
+	lua_pushunsigned(L, val);
+
+	/* do the call (2 arguments, 0 result) */
+	call(L, 2, 0);
+}
+
+static void call_ib_hook(const char *hook, uint64_t gpuaddr,
+		uint32_t sizedwords, int level)
+{
+	lua_getglobal(L, hook);
+	lua_pushnumber(L, gpuaddr);
+	lua_pushnumber(L, sizedwords);
+	lua_pushnumber(L, level);
+
+	/* do the call (3 arguments, 0 result) */
+	call(L, 3, 0);
+}
+
+/* called before and after decoding an IB (or draw state group): */
+void script_ib_enter(uint64_t gpuaddr, uint32_t sizedwords, int level)
+{
+	if (!L || !hooks.ib_enter)
+		return;
+	call_ib_hook("ib_enter", gpuaddr, sizedwords, level);
+}
+
+void script_ib_exit(uint64_t gpuaddr, uint32_t sizedwords, int level)
+{
+	if (!L || !hooks.ib_exit)
+		return;
+	call_ib_hook("ib_exit", gpuaddr, sizedwords, level);
+}
+
+/* called for CP_EVENT_WRITE: */
+void script_event(uint32_t event, const char *name)
+{
+	if (!L || !hooks.event)
+		return;
+
+	lua_getglobal(L, "event");
+	lua_pushstring(L, name);
+	lua_pushnumber(L, event);
+
+	/* do the call (2 arguments, 0 result) */
+	call(L, 2, 0);
+}
+
+/* called for CP_LOAD_STATE: */
+void script_state_load(const char *stage, const char *state,
+		uint32_t dst_off, uint32_t num_unit, uint64_t src_addr)
+{
+	if (!L || !hooks.state_load)
+		return;
+
+	lua_getglobal(L, "state_load");
+	lua_pushstring(L, stage);
+	lua_pushstring(L, state);
+	lua_pushnumber(L, dst_off);
+	lua_pushnumber(L, num_unit);
+	lua_pushnumber(L, src_addr);
+
+	/* do the call (5 arguments, 0 result) */
+	call(L, 5, 0);
+}
 
 /* called at end of each cmdstream file: */
 void script_end_cmdstream(void)
@@ -480,9 +1380,16 @@ void script_end_cmdstream(void)
 
 	lua_getglobal(L, "end_cmdstream");
 
+	if (has_reduce) {
+		/* do the call (0 arguments, 1 result) */
+		call(L, 0, 1);
+		add_result(L);
+		script_reduce();
+		return;
+	}
+
 	/* do the call (0 arguments, 0 result) */
-	if (lua_pcall(L, 0, 0, 0) != 0)
-		error("error running function `f': %s\n");
+	call(L, 0, 0);
 }
 
 /* called after last cmdstream file: */
@@ -494,8 +1401,7 @@ void script_finish(void)
 	lua_getglobal(L, "finish");
 
 	/* do the call (0 arguments, 0 result) */
-	if (lua_pcall(L, 0, 0, 0) != 0)
-		error("error running function `f': %s\n");
+	call(L, 0, 0);
 
 	lua_close(L);
 	L = NULL;
@@ -30,6 +30,7 @@
 #define SCRIPT_H_
 
 #include <stdint.h>
+#include <stdio.h>
 
 
 // XXX make script support optional
@@ -48,13 +49,46 @@ void script_start_cmdstream(const char *name);
  */
 void script_draw(const char *primtype, uint32_t nindx);
 
-/* maybe at some point it is interesting to add additional script
- * hooks for CP_EVENT_WRITE, etc?
+/* Finer grained hooks, which are only called into the script if it
+ * defines the corresponding function, and for packets and register
+ * writes only if they pass the filters set up by the script with the
+ * "hooks" library:
  */
 
-/* called at end of each cmdstream file: */
+/* calls packet(name, opcode, pkt, level), with the payload as pkt[1..n]: */
+void script_packet(uint32_t opcode, const char *name,
+		const uint32_t *dwords, uint32_t sizedwords, int level);
+
+/* calls reg_write(regbase, val): */
+void script_reg_write(uint32_t regbase, uint32_t val);
+
+/* calls ib_enter/ib_exit(gpuaddr, sizedwords, level): */
+void script_ib_enter(uint64_t gpuaddr, uint32_t sizedwords, int level);
+void script_ib_exit(uint64_t gpuaddr, uint32_t sizedwords, int level);
+
+/* calls event(name, event): */
+void script_event(uint32_t event, const char *name);
+
+/* calls state_load(stage, state, dst_off, num_unit, src_addr): */
+void script_state_load(const char *stage, const char *state,
+		uint32_t dst_off, uint32_t num_unit, uint64_t src_addr);
+
+/* called at end of each cmdstream file, if the script has a reduce()
+ * hook the value returned by end_cmdstream() is passed to reduce():
+ */
 void script_end_cmdstream(void);
 
+/* Parallel decode (--jobs) is possible for scripts which define a
+ * reduce() hook.  Each worker calls script_end_worker() at the end of
+ * its part of the cmdstream, the main process passes each worker's
+ * results to script_collect(), in cmdstream order, and then calls
+ * script_reduce() rather than script_end_cmdstream():
+ */
+int script_reduce_enabled(void);
+void script_end_worker(FILE *results);
+void script_collect(FILE *results);
+void script_reduce(void);
+
 /* called after last cmdstream file: */
 void script_finish(void);
 
@@ -0,0 +1,435 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "shaderdb.h"
+
+#define SHADERDB_BUCKETS 1024
+
+struct shaderdb {
+	char *dir;
+	struct shaderdb_entry *buckets[SHADERDB_BUCKETS];
+};
+
+/* FNV-1a, over the bytes of the binary: */
+static uint64_t hash_shader(const void *bin, uint32_t sizedwords)
+{
+	const uint8_t *p = bin;
+	uint64_t hash = 14695981039346656037ull;
+	uint32_t i;
+
+	for (i = 0; i < sizedwords * 4; i++)
+		hash = (hash ^ p[i]) * 1099511628211ull;
+
+	return hash;
+}
+
+struct shaderdb * shaderdb_new(const char *dir)
+{
+	struct shaderdb *db = calloc(1, sizeof(*db));
+
+	if (dir) {
+		if (mkdir(dir, 0755) && (errno != EEXIST)) {
+			fprintf(stderr, "could not create %s: %m\n", dir);
+			free(db);
+			return NULL;
+		}
+		db->dir = strdup(dir);
+	}
+
+	return db;
+}
+
+void shaderdb_free(struct shaderdb *db)
+{
+	if (!db)
+		return;
+	shaderdb_reset(db);
+	free(db->dir);
+	free(db);
+}
+
+void shaderdb_reset(struct shaderdb *db)
+{
+	unsigned i;
+
+	for (i = 0; i < SHADERDB_BUCKETS; i++) {
+		while (db->buckets[i]) {
+			struct shaderdb_entry *e = db->buckets[i];
+			db->buckets[i] = e->next;
+			free(e->dwords);
+			free(e);
+		}
+	}
+}
+
+struct shaderdb_entry * shaderdb_find(struct shaderdb *db, const void *bin,
+		uint32_t sizedwords, const char *ext, int first)
+{
+	uint64_t hash = hash_shader(bin, sizedwords);
+	struct shaderdb_entry **head = &db->buckets[hash % SHADERDB_BUCKETS];
+	struct shaderdb_entry *e;
+
+	for (e = *head; e; e = e->next) {
+		if ((e->hash == hash) && (e->sizedwords == sizedwords) &&
+				!strcmp(e->ext, ext) &&
+				!memcmp(e->dwords, bin, sizedwords * 4))
+			return e;
+	}
+
+	e = calloc(1, sizeof(*e));
+	e->hash = hash;
+	e->ext = ext;
+	e->sizedwords = sizedwords;
+	e->first = first;
+	e->dwords = malloc(sizedwords * 4);
+	memcpy(e->dwords, bin, sizedwords * 4);
+	e->next = *head;
+	*head = e;
+
+	return NULL;
+}
+
+static int write_all(int fd, const void *buf, size_t n)
+{
+	const char *p = buf;
+
+	while (n > 0) {
+		ssize_t ret = write(fd, p, n);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += ret;
+		n -= ret;
+	}
+
+	return 0;
+}
+
+/* save the disassembly, with the indentation it was printed with (level
+ * tabs at the start of each line) stripped:
+ */
+static int write_disasm(int fd, const char *text, size_t len, int level)
+{
+	const char *end = text + len;
+
+	while (text < end) {
+		const char *eol = memchr(text, '\n', end - text);
+		int i;
+
+		eol = eol ? eol + 1 : end;
+		for (i = 0; (i < level) && (text < eol) && (*text == '\t'); i++)
+			text++;
+		if (write_all(fd, text, eol - text))
+			return -1;
+		text = eol;
+	}
+
+	return 0;
+}
+
+/* write to a new temporary file next to path, returns its name: */
+static char * write_tmp(const char *path, const void *buf, size_t len,
+		int level)
+{
+	char *tmppath;
+	int fd, ret;
+
+	if (asprintf(&tmppath, "%s.XXXXXX", path) < 0)
+		return NULL;
+
+	fd = mkstemp(tmppath);
+	if (fd < 0) {
+		fprintf(stderr, "could not create %s: %m\n", tmppath);
+		free(tmppath);
+		return NULL;
+	}
+
+	fchmod(fd, 0644);
+	if (level >= 0)
+		ret = write_disasm(fd, buf, len, level);
+	else
+		ret = write_all(fd, buf, len);
+	if (close(fd))
+		ret = -1;
+
+	if (ret) {
+		fprintf(stderr, "could not write %s: %m\n", tmppath);
+		unlink(tmppath);
+		free(tmppath);
+		return NULL;
+	}
+
+	return tmppath;
+}
+
+static int append_index(struct shaderdb *db, uint64_t hash, const char *ext,
+		uint32_t sizedwords, uint32_t gpu_id, const char *trace, int draw)
+{
+	char *path, *line, *abstrace;
+	int fd, ret;
+
+	/* the trace is recorded with its full path, since the database
+	 * is for a whole corpus:
+	 */
+	abstrace = realpath(trace, NULL);
+	ret = asprintf(&line, "%016"PRIx64"\t%s\t%u\t%u\t%u\t%u\t%u\t%u\t%d\t%s\n",
+			hash, ext, gpu_id, sizedwords, disasm_stats.instrs,
+			disasm_stats.fullregs, disasm_stats.halfregs,
+			disasm_stats.consts, draw, abstrace ? abstrace : trace);
+	free(abstrace);
+	if (ret < 0)
+		return -1;
+
+	if (asprintf(&path, "%s/index", db->dir) < 0) {
+		free(line);
+		return -1;
+	}
+
+	fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+	ret = (fd < 0) ? -1 : write_all(fd, line, strlen(line));
+	if ((fd >= 0) && close(fd))
+		ret = -1;
+	if (ret)
+		fprintf(stderr, "could not write %s: %m\n", path);
+
+	free(path);
+	free(line);
+
+	return ret;
+}
+
+/* The binary only appears once everything else has been written, since
+ * its existence is what tells later runs the shader is already stored.
+ * So if a run dies part way through, the next one to see the shader adds
+ * it again (the index may then have a duplicate line, which queries
+ * skip):
+ */
+static void store(struct shaderdb *db, uint64_t hash, const void *bin,
+		uint32_t sizedwords, const char *ext, const char *text, size_t len,
+		int level, uint32_t gpu_id, const char *trace, int draw)
+{
+	char *path, *txtpath = NULL, *tmpbin = NULL, *tmptxt = NULL;
+
+	if (asprintf(&path, "%s/%016"PRIx64".%s", db->dir, hash, ext) < 0)
+		return;
+
+	if (!access(path, F_OK))
+		goto out;
+
+	if (asprintf(&txtpath, "%s.txt", path) < 0) {
+		txtpath = NULL;
+		goto out;
+	}
+
+	tmpbin = write_tmp(path, bin, sizedwords * 4, -1);
+	tmptxt = write_tmp(txtpath, text, len, level);
+	if (!tmpbin || !tmptxt)
+		goto out;
+
+	if (append_index(db, hash, ext, sizedwords, gpu_id, trace, draw))
+		goto out;
+
+	if (rename(tmptxt, txtpath)) {
+		fprintf(stderr, "could not create %s: %m\n", txtpath);
+		goto out;
+	}
+
+	/* if someone else stored the same shader meanwhile, theirs wins: */
+	if (link(tmpbin, path) && (errno != EEXIST))
+		fprintf(stderr, "could not create %s: %m\n", path);
+
+out:
+	if (tmpbin)
+		unlink(tmpbin);
+	if (tmptxt)
+		unlink(tmptxt);
+	free(tmpbin);
+	free(tmptxt);
+	free(txtpath);
+	free(path);
+}
+
+void shaderdb_disasm(struct shaderdb *db, const void *bin, uint32_t sizedwords,
+		const char *ext, shaderdb_disasm_t disasm, enum shader_t type,
+		int level, uint32_t gpu_id, const char *trace, int draw)
+{
+	char *text = NULL;
+	size_t len = 0;
+	FILE *f = NULL;
+
+	/* with a database, the disassembly is captured so it can be both
+	 * printed and saved:
+	 */
+	if (db->dir)
+		f = open_memstream(&text, &len);
+
+	if (!f) {
+		disasm((uint32_t *)bin, sizedwords, level, type);
+		return;
+	}
+
+	memset(&disasm_stats, 0, sizeof(disasm_stats));
+
+	disasm_set_output(f);
+	disasm((uint32_t *)bin, sizedwords, level, type);
+	disasm_set_output(NULL);
+
+	if (fclose(f)) {
+		fprintf(stderr, "could not capture disassembly: %m\n");
+	} else {
+		fwrite(text, 1, len, stdout);
+		store(db, hash_shader(bin, sizedwords), bin, sizedwords, ext,
+				text, len, level, gpu_id, trace, draw);
+	}
+
+	free(text);
+}
+
+static void print_file(const char *path)
+{
+	char buf[4096];
+	size_t n;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		fwrite(buf, 1, n, stdout);
+	fclose(f);
+}
+
+/* set of the hash/ext of the index lines seen so far, so that duplicates
+ * are only printed once:
+ */
+struct seen_set {
+	struct seen_key {
+		uint64_t hash;
+		char ext[8];
+	} *keys;
+	unsigned n, size;
+};
+
+/* returns non-zero if already seen: */
+static int seen_add(struct seen_set *set, uint64_t hash, const char *ext)
+{
+	unsigned i;
+
+	if (2 * (set->n + 1) > set->size) {
+		struct seen_set old = *set;
+
+		set->size = old.size ? 2 * old.size : 1024;
+		set->keys = calloc(set->size, sizeof(set->keys[0]));
+		set->n = 0;
+		for (i = 0; i < old.size; i++)
+			if (old.keys[i].ext[0])
+				seen_add(set, old.keys[i].hash, old.keys[i].ext);
+		free(old.keys);
+	}
+
+	for (i = hash & (set->size - 1); set->keys[i].ext[0];
+			i = (i + 1) & (set->size - 1)) {
+		if ((set->keys[i].hash == hash) &&
+				!strncmp(set->keys[i].ext, ext, sizeof(set->keys[i].ext)))
+			return 1;
+	}
+
+	set->keys[i].hash = hash;
+	strncpy(set->keys[i].ext, ext, sizeof(set->keys[i].ext) - 1);
+	set->n++;
+
+	return 0;
+}
+
+int shaderdb_query(const char *dir, const char *prefix)
+{
+	char *path, *line = NULL;
+	size_t len = 0, plen;
+	struct seen_set seen = {0};
+	int all = !strcmp(prefix, "all");
+	int n = 0;
+	FILE *f;
+
+	if (asprintf(&path, "%s/index", dir) < 0)
+		return -1;
+
+	f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "could not open %s: %m\n", path);
+		free(path);
+		return -1;
+	}
+	free(path);
+
+	plen = strlen(prefix);
+
+	while (getline(&line, &len, f) > 0) {
+		uint64_t hash;
+		char ext[8];
+
+		if (!all && strncmp(line, prefix, plen))
+			continue;
+
+		if ((sscanf(line, "%"SCNx64" %7s", &hash, ext) != 2) ||
+				seen_add(&seen, hash, ext))
+			continue;
+
+		fputs(line, stdout);
+		n++;
+
+		if (all)
+			continue;
+
+		/* hash is the first 16 characters: */
+		if (asprintf(&path, "%s/%.16s.%s.txt", dir, line, ext) >= 0) {
+			print_file(path);
+			free(path);
+		}
+		printf("\n");
+	}
+
+	free(seen.keys);
+	free(line);
+	fclose(f);
+
+	return n;
+}
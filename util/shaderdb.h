@@ -0,0 +1,109 @@
+/* -*- mode: C; c-file-style: "k&r"; tab-width 4; indent-tabs-mode: t; -*- */
+
+/*
+ * Copyright (C) 2017 Rob Clark <robclark@freedesktop.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Rob Clark <robclark@freedesktop.org>
+ */
+
+#ifndef SHADERDB_H_
+#define SHADERDB_H_
+
+#include <stdint.h>
+
+#include "disasm.h"
+
+/* Shader deduplication, and the shader database.
+ *
+ * Shaders are identified by a 64 bit hash of their binary, plus the
+ * stage, in the form of the raw shader file extension (vo3, fo3, etc)
+ * as written by --dump-shaders.  The decoders keep track of the shaders
+ * seen so far in the current file, so each unique shader is only
+ * disassembled once, and repeats print a reference to where it was
+ * first seen instead.
+ *
+ * With a database directory, each new shader is also added to a
+ * persistent database, which can be shared by any number of cffdump
+ * and pgmdump runs over a whole corpus of traces:
+ *
+ *    DIR/<hash>.<ext>      the shader binary (which pgmdump can read)
+ *    DIR/<hash>.<ext>.txt  its disassembly
+ *    DIR/index             one tab separated line per shader:
+ *
+ *       hash ext gpu_id sizedwords instrs fullregs halfregs consts draw trace
+ *
+ * where the register/const counts are the highest used plus one (in
+ * vec4 units), and trace and draw are where the shader was first seen
+ * (for pgmdump, draw is the index of the program in the file).  Several
+ * processes can add to the same database at once: the files are written
+ * under temporary names, the index line is appended with a single write,
+ * and the binary is only linked into place last, so a shader is never
+ * left half stored.
+ */
+
+struct shaderdb;
+
+struct shaderdb_entry {
+	uint64_t hash;
+	const char *ext;
+	uint32_t sizedwords;
+	int first;                /* draw (or program) where first seen */
+
+	/* private: */
+	uint32_t *dwords;
+	struct shaderdb_entry *next;
+};
+
+typedef int (*shaderdb_disasm_t)(uint32_t *dwords, int sizedwords, int level,
+		enum shader_t type);
+
+/* dir is the database directory, which is created if needed, or NULL for
+ * only deduplication.  Returns NULL if the directory cannot be created:
+ */
+struct shaderdb * shaderdb_new(const char *dir);
+void shaderdb_free(struct shaderdb *db);
+
+/* forget the shaders seen so far, ie. when starting on the next file: */
+void shaderdb_reset(struct shaderdb *db);
+
+/* returns the entry if the shader has been seen before, otherwise adds
+ * it (as first seen at draw/program first) and returns NULL:
+ */
+struct shaderdb_entry * shaderdb_find(struct shaderdb *db, const void *bin,
+		uint32_t sizedwords, const char *ext, int first);
+
+/* disassemble a shader (first seen, according to shaderdb_find()) to
+ * stdout with disasm(), and if there is a database and the shader is not
+ * already in it, add it:
+ */
+void shaderdb_disasm(struct shaderdb *db, const void *bin, uint32_t sizedwords,
+		const char *ext, shaderdb_disasm_t disasm, enum shader_t type,
+		int level, uint32_t gpu_id, const char *trace, int draw);
+
+/* print the index lines of the shaders whose hash starts with prefix (or
+ * all of them, for "all"), followed by the disassembly unless listing
+ * all of them.  Returns the number of matches, or -1 on error:
+ */
+int shaderdb_query(const char *dir, const char *prefix);
+
+#endif /* SHADERDB_H_ */
@@ -31,6 +31,8 @@
 #include <string.h>
 
 #include "redump.h"
+#include "io.h"
+#include "rdfile.h"
 
 #include "freedreno_z1xx.h"
 
@@ -175,18 +177,26 @@ static const char *param_names[] = {
 		"",
 };
 
-static void dump_file(int fd)
+static void dump_file(struct io *io)
 {
 	enum rd_sect_type type = RD_NONE;
+	struct rd_file rd;
 	void *buf = NULL;
 	int sz;
 
-	while ((read(fd, &type, sizeof(type)) > 0) && (read(fd, &sz, 4) > 0)) {
+	if (rd_file_init(&rd, io))
+		return;
+
+	while (rd_next_section_max(&rd, INT32_MAX) > 0) {
+		type = rd.type;
+		sz = rd.size;
+
 		free(buf);
 
 		buf = malloc(sz + 1);
 		((char *)buf)[sz] = '\0';
-		read(fd, buf, sz);
+		if (rd_read_payload(&rd, buf))
+			break;
 
 		switch(type) {
 		case RD_TEST:
@@ -213,12 +223,13 @@ int main(int argc, char **argv)
 	int i;
 
 	for (i = 1; i < argc; i++) {
-		int fd = open(argv[i], O_RDONLY);
-		if (fd < 0) {
-			fprintf(stderr, "could not open: %s\n", argv[1]);
+		struct io *io = io_open(argv[i]);
+		if (!io) {
+			fprintf(stderr, "could not open: %s\n", argv[i]);
 			return -1;
 		}
-		dump_file(fd);
+		dump_file(io);
+		io_close(io);
 	}
 
 	return 0;
@@ -21,9 +21,16 @@
  * SOFTWARE.
  */
 
+#include <signal.h>
+
 #include "wrap.h"
+#include "io.h"
+#include "rdfile.h"
+
+static struct io_writer *io;
+static uint64_t offset;         /* current offset in rd file */
 
-static int fd = -1;
+static void rd_write_error(int ret);
 static unsigned int gpu_id;
 
 #ifdef USE_PTHREADS
@@ -68,24 +75,92 @@ int wrap_printf(const char *format, ...)
 	return n;
 }
 
+/* on a crash, flush out what is buffered (which is the interesting part
+ * of the trace) before passing the signal on to whatever handler was
+ * there before, ie. the default one or a debugger/crash reporter:
+ */
+static const int crash_signals[] = {
+		SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT,
+};
+static struct sigaction old_actions[ARRAY_SIZE(crash_signals)];
+
+static void rd_crash(int sig, siginfo_t *info, void *ctx)
+{
+	struct sigaction *old = NULL;
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(crash_signals); i++)
+		if (crash_signals[i] == sig)
+			old = &old_actions[i];
+
+	if (io)
+		io_wflush_crash(io);
+
+	sigaction(sig, old, NULL);
+
+	if (old->sa_flags & SA_SIGINFO)
+		old->sa_sigaction(sig, info, ctx);
+	else if (old->sa_handler == SIG_DFL)
+		raise(sig);
+	else if (old->sa_handler != SIG_IGN)
+		old->sa_handler(sig);
+}
+
+static void rd_register(void)
+{
+	struct sigaction sa = {
+			.sa_sigaction = rd_crash,
+			.sa_flags     = SA_SIGINFO,
+	};
+	unsigned i;
+
+	/* writes are buffered, so make sure we don't lose the tail end
+	 * of the trace if the process exits without calling rd_end(), or
+	 * crashes:
+	 */
+	atexit(rd_end);
+
+	for (i = 0; i < ARRAY_SIZE(crash_signals); i++)
+		sigaction(crash_signals[i], &sa, &old_actions[i]);
+}
 
 void rd_start(const char *name, const char *fmt, ...)
 {
 	char buf[256];
 	static int cnt = 0;
+	static int registered = 0;
 	int n = cnt++;
 	const char *testnum;
+	const char *ext;
 	va_list  args;
 
+	ext = wrap_compress() ? ".rd.gz" : ".rd";
+
 	testnum = getenv("TESTNUM");
 	if (testnum) {
 		n = strtol(testnum, NULL, 0);
-		sprintf(buf, "%s-%04u.rd", name, n);
+		sprintf(buf, "%s-%04u%s", name, n, ext);
 	} else {
-		sprintf(buf, "/sdcard/trace.rd");
+		sprintf(buf, "/sdcard/trace%s", ext);
 	}
 
-	fd = open(buf, O_WRONLY| O_TRUNC | O_CREAT, 0644);
+	/* flush out the previous trace, if any: */
+	rd_end();
+
+	io = io_wopen(buf, wrap_compress(), 0);
+	if (!io) {
+		printf("could not open %s: %s\n", buf, strerror(errno));
+		exit(-1);
+	}
+
+	offset = 0;
+
+	rd_write_error(rd_file_write_header(io, &offset, wrap_rd_version()));
+
+	if (!registered) {
+		rd_register();
+		registered = 1;
+	}
 
 	va_start(args, fmt);
 	vsprintf(buf, fmt, args);
@@ -104,8 +179,14 @@ void rd_start(const char *name, const char *fmt, ...)
 
 void rd_end(void)
 {
-	close(fd);
-	fd = -1;
+	int ret;
+
+	if (!io)
+		return;
+	ret = io_wclose(io);
+	if (ret)
+		printf("error closing rd: %s\n", strerror(-ret));
+	io = NULL;
 }
 
 #if 0
@@ -114,47 +195,33 @@ volatile int*  __errno( void );
 #define errno (*__errno())
 #endif
 
-static void rd_write(const void *buf, int sz)
+static void rd_write_error(int ret)
 {
-	const uint8_t *cbuf = buf;
-	while (sz > 0) {
-		int ret = write(fd, cbuf, sz);
-		if (ret < 0) {
-			printf("error: %d (%s)\n", ret, strerror(errno));
-			printf("fd=%d, buf=%p, sz=%d\n", fd, buf, sz);
-			exit(-1);
-		}
-		cbuf += ret;
-		sz -= ret;
+	if (ret == -EFBIG) {
+		/* only the section is dropped, see rd_file_write_section(): */
+		printf("section too large for v1 rd file\n");
+	} else if (ret) {
+		printf("error writing rd: %d (%s)\n", ret, strerror(-ret));
+		exit(-1);
 	}
 }
 
-void rd_write_section(enum rd_sect_type type, const void *buf, int sz)
+void rd_write_section(enum rd_sect_type type, const void *buf, uint64_t sz)
 {
-	uint32_t val = ~0;
-
-	if (fd == -1) {
+	if (!io) {
 		rd_start("unknown", "unknown");
-		printf("opened rd, %d\n", fd);
+		printf("opened rd, %p\n", io);
 	}
 
 	if (type == RD_GPU_ID) {
 		gpu_id = *(unsigned int *)buf;
 	}
 
-	rd_write(&val, 4);
-	rd_write(&val, 4);
-
-	rd_write(&type, 4);
-	val = ALIGN(sz, 4);
-	rd_write(&val, 4);
-	rd_write(buf, sz);
-
-	val = 0;
-	rd_write(&val, ALIGN(sz, 4) - sz);
+	rd_write_error(rd_file_write_section(io, &offset, wrap_rd_version(),
+			type, buf, sz));
 
 	if (wrap_safe())
-		fsync(fd);
+		io_wflush(io, 1);
 }
 
 /* in safe mode, sync log file frequently, and insert delays before/after
@@ -171,6 +238,37 @@ unsigned int wrap_safe(void)
 	return val;
 }
 
+/* if non-zero, compress the rd file, with the value being the zlib
+ * compression level (1 is fastest, which is usually what you want for
+ * on-device captures).  The output is written to .rd.gz instead of .rd
+ */
+unsigned int wrap_compress(void)
+{
+	static unsigned int val = -1;
+	if (val == -1) {
+		const char *str = getenv("WRAP_COMPRESS");
+		val = str ? strtol(str, NULL, 0) : 0;
+		if (val > 9)
+			val = 9;
+	}
+	return val;
+}
+
+/* version of the rd file format to write, see redump.h.  Defaults to 1,
+ * which older tools can read, but is limited to 2GB sections.
+ */
+unsigned int wrap_rd_version(void)
+{
+	static unsigned int val = -1;
+	if (val == -1) {
+		const char *str = getenv("WRAP_RD_VERSION");
+		val = str ? strtol(str, NULL, 0) : 1;
+		if (val != 2)
+			val = 1;
+	}
+	return val;
+}
+
 /* if non-zero, emulate a different gpu-id.  The issueibcmds will be stubbed
  * so we don't actually submit cmds to the gpu.  This is useful to generate
  * cmdstream dumps for different gpu versions for comparision.
@@ -70,6 +70,8 @@ void * __rd_dlsym_helper(const char *name);
 
 
 unsigned int wrap_safe(void);
+unsigned int wrap_compress(void);
+unsigned int wrap_rd_version(void);
 unsigned int wrap_gpu_id(void);
 unsigned int wrap_gpu_id_patchid(void);
 unsigned int wrap_gmem_size(void);